@@ -7,6 +7,14 @@ GDxFrameResource::GDxFrameResource(ID3D12Device* device, UINT passCount, UINT ob
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
 		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
 
+	WorkerCmdListAllocs.resize(MAX_RECORDING_LIST_NUM);
+	for (auto i = 0u; i < MAX_RECORDING_LIST_NUM; i++)
+	{
+		ThrowIfFailed(device->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(WorkerCmdListAllocs[i].GetAddressOf())));
+	}
+
 	PassCB = std::make_unique<GDxUploadBuffer<PassConstants>>(device, passCount, true);
 	SsaoCB = std::make_unique<GDxUploadBuffer<SsaoConstants>>(device, 1, true);
 	MaterialBuffer = std::make_unique<GDxUploadBuffer<MaterialData>>(device, materialCount, false);
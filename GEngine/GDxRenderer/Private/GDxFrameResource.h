@@ -3,12 +3,20 @@
 #include "GDxPreInclude.h"
 #include "GDxMathHelper.h"
 #include "GDxUploadBuffer.h"
+#include "../Shaders/ShaderDefinition.h"
 
 // should be the same with the definition in Lighting.hlsli
 #define MAX_DIRECTIONAL_LIGHT_NUM 4
 #define MAX_POINT_LIGHT_NUM 1024
 #define MAX_SPOTLIGHT_NUM 1024
 
+// Draws recorded as indirect commands per frame, frames with more draws are recorded directly.
+// Bounds the upload ring space the commands take.
+#define MAX_INDIRECT_COMMAND_NUM 65536
+
+// Command lists a pass can be recorded into in parallel.
+#define MAX_RECORDING_LIST_NUM 8
+
 struct ObjectConstants
 {
 	DirectX::XMFLOAT4X4 World = GDxMathHelper::Identity4x4();
@@ -21,6 +29,9 @@ struct ObjectConstants
 	//UINT     ObjPad2;
 };
 
+// One 256 byte constant buffer slot per object.
+static_assert(sizeof(ObjectConstants) == 256, "ObjectConstants outgrew its constant buffer slot.");
+
 struct PassConstants
 {
 	DirectX::XMFLOAT4X4 View = GDxMathHelper::Identity4x4();
@@ -99,6 +110,30 @@ struct MaterialData
 	DirectX::XMFLOAT4 VectorParams[MATERIAL_MAX_VECTOR_NUM];
 };
 
+// should be the same with InstanceData in InstancedDefaultVS.hlsl
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World = GDxMathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 PrevWorld = GDxMathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 InvTransWorld = GDxMathHelper::Identity4x4();
+};
+
+// should be the same with MeshQuantization in VertexCompression.hlsli, an entry of GDxQuantizationTable
+struct MeshQuantizationData
+{
+	DirectX::XMFLOAT4 PositionScale = { 1.0f, 1.0f, 1.0f, 0.0f };
+	DirectX::XMFLOAT4 PositionOffset = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+// Argument layout of the G-Buffer command signature: object constants, material index, instance offset and
+// quantization table entry, then the draw.
+struct IndirectCommand
+{
+	D3D12_GPU_VIRTUAL_ADDRESS ObjectCbv;
+	UINT RootConstants[3];
+	D3D12_DRAW_INDEXED_ARGUMENTS DrawArguments;
+};
+
 struct SceneObjectSdfDescriptor
 {
 	DirectX::XMFLOAT4X4 objWorld;
@@ -129,6 +164,8 @@ public:
 	// We cannot reset the allocator until the GPU is done processing the commands.
 	// So each frame needs their own allocator.
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+	// One per worker command list.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> WorkerCmdListAllocs;
 
 	// We cannot update a cbuffer until the GPU is done processing the commands
 	// that reference it.  So each frame needs their own cbuffers.
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "GDxGeometryPool.h"
+
+
+GDxGeometryPool& GDxGeometryPool::GetInstance(bool bCompressedVertices)
+{
+	static GDxGeometryPool *instance = new GDxGeometryPool(sizeof(GRiVertex));
+	static GDxGeometryPool *compressedInstance = new GDxGeometryPool(sizeof(GRiCompressedVertex));
+	return bCompressedVertices ? *compressedInstance : *instance;
+}
+
+GDxGeometryPool::GDxGeometryPool(UINT vertexByteStride)
+{
+	mVertexByteStride = vertexByteStride;
+}
+
+void GDxGeometryPool::Create(ID3D12Device* device)
+{
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer((UINT64)GEOMETRY_POOL_VERTEX_NUM * mVertexByteStride),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(mVertexBuffer.GetAddressOf())));
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer((UINT64)GEOMETRY_POOL_INDEX_NUM * sizeof(std::uint32_t)),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(mIndexBuffer.GetAddressOf())));
+
+	mBufferState = D3D12_RESOURCE_STATE_COMMON;
+
+	mVertexAllocator.Init(GEOMETRY_POOL_VERTEX_NUM);
+	mIndexAllocator.Init(GEOMETRY_POOL_INDEX_NUM);
+}
+
+bool GDxGeometryPool::Allocate(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexNum, const void* indices, UINT indexNum, DXGI_FORMAT indexFormat, GDxGeometryAllocation& allocation)
+{
+	if (vertexNum == 0 || indexNum == 0)
+		return false;
+
+	if (mVertexBuffer == nullptr)
+		Create(device);
+
+	allocation.VertexBlock = mVertexAllocator.Allocate(vertexNum);
+	if (allocation.VertexBlock == GRiTlsfAllocator::InvalidBlock)
+		return false;
+
+	bool bShortIndices = indexFormat == DXGI_FORMAT_R16_UINT;
+	UINT indexSlotNum = bShortIndices ? (indexNum + 1) / 2 : indexNum;
+	allocation.IndexBlock = mIndexAllocator.Allocate(indexSlotNum);
+	if (allocation.IndexBlock == GRiTlsfAllocator::InvalidBlock)
+	{
+		mVertexAllocator.Free(allocation.VertexBlock);
+		allocation.VertexBlock = GRiTlsfAllocator::InvalidBlock;
+		return false;
+	}
+
+	allocation.BaseVertexLocation = mVertexAllocator.GetOffset(allocation.VertexBlock);
+	UINT indexSlot = mIndexAllocator.GetOffset(allocation.IndexBlock);
+	allocation.StartIndexLocation = bShortIndices ? indexSlot * 2 : indexSlot;
+
+	// Stage the vertices followed by the indices in one upload buffer.
+	UINT64 vertexByteSize = (UINT64)vertexNum * mVertexByteStride;
+	UINT64 indexByteSize = (UINT64)indexNum * (bShortIndices ? sizeof(std::uint16_t) : sizeof(std::uint32_t));
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> uploader;
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(vertexByteSize + indexByteSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(uploader.GetAddressOf())));
+
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(uploader->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+	memcpy(mappedData, vertices, (size_t)vertexByteSize);
+	memcpy(mappedData + vertexByteSize, indices, (size_t)indexByteSize);
+	uploader->Unmap(0, nullptr);
+
+	D3D12_RESOURCE_BARRIER barriers[2] = {
+		CD3DX12_RESOURCE_BARRIER::Transition(mVertexBuffer.Get(), mBufferState, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(mIndexBuffer.Get(), mBufferState, D3D12_RESOURCE_STATE_COPY_DEST)
+	};
+	cmdList->ResourceBarrier(2, barriers);
+
+	cmdList->CopyBufferRegion(mVertexBuffer.Get(), (UINT64)allocation.BaseVertexLocation * mVertexByteStride, uploader.Get(), 0, vertexByteSize);
+	cmdList->CopyBufferRegion(mIndexBuffer.Get(), (UINT64)indexSlot * sizeof(std::uint32_t), uploader.Get(), vertexByteSize, indexByteSize);
+
+	barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(mVertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+	barriers[1] = CD3DX12_RESOURCE_BARRIER::Transition(mIndexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+	cmdList->ResourceBarrier(2, barriers);
+	mBufferState = D3D12_RESOURCE_STATE_GENERIC_READ;
+
+	// Has to stay alive until the command list has been executed.
+	mUploaders.push_back(uploader);
+
+	return true;
+}
+
+void GDxGeometryPool::Free(const GDxGeometryAllocation& allocation)
+{
+	if (allocation.VertexBlock != GRiTlsfAllocator::InvalidBlock)
+		mVertexAllocator.Free(allocation.VertexBlock);
+	if (allocation.IndexBlock != GRiTlsfAllocator::InvalidBlock)
+		mIndexAllocator.Free(allocation.IndexBlock);
+}
+
+bool GDxGeometryPool::IsCreated() const
+{
+	return mVertexBuffer != nullptr;
+}
+
+D3D12_VERTEX_BUFFER_VIEW GDxGeometryPool::VertexBufferView() const
+{
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	vbv.BufferLocation = mVertexBuffer->GetGPUVirtualAddress();
+	vbv.StrideInBytes = mVertexByteStride;
+	vbv.SizeInBytes = GEOMETRY_POOL_VERTEX_NUM * mVertexByteStride;
+
+	return vbv;
+}
+
+D3D12_INDEX_BUFFER_VIEW GDxGeometryPool::IndexBufferView(DXGI_FORMAT format) const
+{
+	D3D12_INDEX_BUFFER_VIEW ibv;
+	ibv.BufferLocation = mIndexBuffer->GetGPUVirtualAddress();
+	ibv.Format = format;
+	ibv.SizeInBytes = GEOMETRY_POOL_INDEX_NUM * sizeof(std::uint32_t);
+
+	return ibv;
+}
+
+void GDxGeometryPool::DisposeUploaders()
+{
+	mUploaders.clear();
+}
+
+UINT GDxGeometryPool::GetUsedVertexNum()
+{
+	return mVertexAllocator.GetUsedSize();
+}
+
+UINT GDxGeometryPool::GetUsedIndexNum()
+{
+	return mIndexAllocator.GetUsedSize();
+}
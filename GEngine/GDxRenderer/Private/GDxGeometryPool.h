@@ -0,0 +1,73 @@
+#pragma once
+#include "GDxPreInclude.h"
+
+// Capacity of the shared buffers, in vertices and 32 bit indices. Meshes that don't fit anymore get buffers of their own.
+#define GEOMETRY_POOL_VERTEX_NUM (1 << 20)
+#define GEOMETRY_POOL_INDEX_NUM (1 << 22)
+
+
+struct GDxGeometryAllocation
+{
+	UINT VertexBlock = GRiTlsfAllocator::InvalidBlock;
+	UINT IndexBlock = GRiTlsfAllocator::InvalidBlock;
+
+	// Location of the geometry in the shared buffers, in vertices and indices of the format it was allocated with.
+	UINT BaseVertexLocation = 0;
+	UINT StartIndexLocation = 0;
+};
+
+// Vertex and index buffers shared by every static mesh, sub-allocated with a TLSF allocator each.
+// Meshes in the pool are bound with the same views, so consecutive draws of different meshes don't rebind.
+// There is one pool per vertex format, GRiVertex and GRiCompressedVertex. The index buffer holds both index formats,
+// 16 bit indices take half a 32 bit slot each and are bound with a view of the other format.
+class GDxGeometryPool
+{
+
+public:
+
+	static GDxGeometryPool& GetInstance(bool bCompressedVertices = false);
+
+	// Creates the shared buffers on the first call. Records the upload on the command list,
+	// returns false without recording anything if the pool is out of space. The vertices are in the format of the pool,
+	// the indices R16_UINT or R32_UINT.
+	bool Allocate(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const void* vertices, UINT vertexNum, const void* indices, UINT indexNum, DXGI_FORMAT indexFormat, GDxGeometryAllocation& allocation);
+
+	// The ranges are reused by the next allocation, the gpu must be done with them.
+	void Free(const GDxGeometryAllocation& allocation);
+
+	// False until the first mesh is allocated, the views are only valid afterwards.
+	bool IsCreated() const;
+
+	D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const;
+	// Both formats view the same buffer.
+	D3D12_INDEX_BUFFER_VIEW IndexBufferView(DXGI_FORMAT format = DXGI_FORMAT_R32_UINT) const;
+
+	// Releases the upload buffers of every upload recorded so far, once the gpu has executed them.
+	void DisposeUploaders();
+
+	UINT GetUsedVertexNum();
+	// In 32 bit slots.
+	UINT GetUsedIndexNum();
+
+private:
+
+	GDxGeometryPool(UINT vertexByteStride);
+	GDxGeometryPool(const GDxGeometryPool& rhs) = delete;
+	GDxGeometryPool& operator=(const GDxGeometryPool& rhs) = delete;
+
+	void Create(ID3D12Device* device);
+
+	UINT mVertexByteStride = 0;
+
+	GRiTlsfAllocator mVertexAllocator;
+	GRiTlsfAllocator mIndexAllocator;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mVertexBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mIndexBuffer = nullptr;
+
+	D3D12_RESOURCE_STATES mBufferState = D3D12_RESOURCE_STATE_COMMON;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mUploaders;
+
+};
+
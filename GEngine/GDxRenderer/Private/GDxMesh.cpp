@@ -11,6 +11,31 @@ GDxMesh::GDxMesh(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::
 	Create(device, cmdList, meshData);
 }
 
+GDxMesh::GDxMesh(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, GRiCookedMesh& cookedMesh, bool bCompressVertices)
+{
+	for (auto i = 0u; i < cookedMesh.GetSubmeshNum(); i++)
+	{
+		auto& cookedSubmesh = cookedMesh.GetSubmesh(i);
+		auto name = cookedMesh.GetSubmeshName(i);
+
+		GRiSubmesh submesh;
+		submesh.IndexCount = cookedSubmesh.IndexCount;
+		submesh.StartIndexLocation = cookedSubmesh.StartIndexLocation;
+		submesh.BaseVertexLocation = cookedSubmesh.BaseVertexLocation;
+		submesh.FirstMeshlet = cookedSubmesh.FirstMeshlet;
+		submesh.MeshletNum = cookedSubmesh.MeshletNum;
+
+		Submeshes[name] = submesh;
+		Submeshes[name].Name = name;
+	}
+
+	bounds = cookedMesh.GetBounds();
+
+	mVIBuffer = std::make_shared<GDxStaticVIBuffer>(device, cmdList,
+		cookedMesh.GetVertices(), cookedMesh.GetVertexNum(),
+		cookedMesh.GetIndices(), cookedMesh.GetIndexNum(), bCompressVertices);
+}
+
 void GDxMesh::Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiMeshData> meshData)
 {
 	UINT vertexOffset = 0;
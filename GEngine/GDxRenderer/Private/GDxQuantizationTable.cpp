@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "GDxQuantizationTable.h"
+
+
+GDxQuantizationTable& GDxQuantizationTable::GetInstance()
+{
+	static GDxQuantizationTable *instance = new GDxQuantizationTable();
+	return *instance;
+}
+
+GDxQuantizationTable::GDxQuantizationTable()
+{
+	mEntries.push_back(GRiVertexQuantization());
+}
+
+UINT GDxQuantizationTable::Add(const GRiVertexQuantization& quantization)
+{
+	if (mFreeEntries.size() > 0)
+	{
+		UINT index = mFreeEntries.back();
+		mFreeEntries.pop_back();
+		mEntries[index] = quantization;
+		return index;
+	}
+
+	mEntries.push_back(quantization);
+	return (UINT)mEntries.size() - 1;
+}
+
+void GDxQuantizationTable::Remove(UINT index)
+{
+	if (index == 0 || index >= mEntries.size())
+		ThrowGGiException("Invalid quantization table entry.");
+
+	mFreeEntries.push_back(index);
+}
+
+UINT GDxQuantizationTable::GetEntryNum() const
+{
+	return (UINT)mEntries.size();
+}
+
+const GRiVertexQuantization* GDxQuantizationTable::GetEntries() const
+{
+	return mEntries.data();
+}
+
@@ -0,0 +1,35 @@
+#pragma once
+#include "GDxPreInclude.h"
+
+
+// Dequantization of the compressed vertices of every live mesh. The G-Buffer draws index it with a root constant
+// instead of carrying it in the object constants and the instance data, the renderer uploads a copy every frame.
+// Entry 0 is the identity and stands for meshes with uncompressed vertices.
+class GDxQuantizationTable
+{
+
+public:
+
+	static GDxQuantizationTable& GetInstance();
+
+	// Index of the new entry, freed entries are reused.
+	UINT Add(const GRiVertexQuantization& quantization);
+
+	void Remove(UINT index);
+
+	// Including the identity and the free entries, which hold stale values nothing indexes.
+	UINT GetEntryNum() const;
+
+	const GRiVertexQuantization* GetEntries() const;
+
+private:
+
+	GDxQuantizationTable();
+	GDxQuantizationTable(const GDxQuantizationTable& rhs) = delete;
+	GDxQuantizationTable& operator=(const GDxQuantizationTable& rhs) = delete;
+
+	std::vector<GRiVertexQuantization> mEntries;
+	std::vector<UINT> mFreeEntries;
+
+};
+
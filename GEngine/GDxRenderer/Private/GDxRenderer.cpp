@@ -10,6 +10,8 @@
 #include "GDxInputLayout.h"
 #include "GDxShaderManager.h"
 #include "GDxStaticVIBuffer.h"
+#include "GDxGeometryPool.h"
+#include "GDxQuantizationTable.h"
 
 #include <WindowsX.h>
 
@@ -131,6 +133,7 @@ void GDxRenderer::Initialize()
 	BuildRootSignature();
 	BuildFrameResources();
 	BuildPSOs();
+	BuildCommandSignatures();
 
 	/*
 	ThrowIfFailed(mCommandList->Close());
@@ -169,6 +172,10 @@ void GDxRenderer::Initialize()
 	// Wait until initialization is complete.
 	FlushCommandQueue();
 
+	// The mesh uploads recorded since PreInitialize have been executed.
+	GDxGeometryPool::GetInstance().DisposeUploaders();
+	GDxGeometryPool::GetInstance(true).DisposeUploaders();
+
 	GRiOcclusionCullingRasterizer::GetInstance().Init(
 		DEPTH_READBACK_BUFFER_SIZE_X,
 		DEPTH_READBACK_BUFFER_SIZE_Y,
@@ -182,6 +189,45 @@ void GDxRenderer::Initialize()
 	);
 
 	BuildMeshSDF();
+
+#if USE_SDF_CLIPMAP
+	mSdfClipmap = std::make_unique<GRiSdfClipmap>();
+	mSdfClipmap->Init(
+		SDF_CLIPMAP_LEVEL_NUM,
+		SDF_CLIPMAP_RESOLUTION,
+		SDF_CLIPMAP_BRICK_SIZE,
+		SDF_CLIPMAP_VOXEL_SIZE,
+		SDF_CLIPMAP_TRUNCATION_VOXELS
+	);
+
+	UINT64 clipmapVoxelNum = (UINT64)SDF_CLIPMAP_LEVEL_NUM * SDF_CLIPMAP_RESOLUTION * SDF_CLIPMAP_RESOLUTION * SDF_CLIPMAP_RESOLUTION;
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(clipmapVoxelNum * sizeof(float)),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(mSdfClipmapBuffer.GetAddressOf())));
+	mSdfClipmapBufferState = D3D12_RESOURCE_STATE_COPY_DEST;
+
+	int clipmapBrickNum = SDF_CLIPMAP_RESOLUTION / SDF_CLIPMAP_BRICK_SIZE;
+	mSdfClipmapBrickPending = std::vector<UINT8>(SDF_CLIPMAP_LEVEL_NUM * clipmapBrickNum * clipmapBrickNum * clipmapBrickNum, 0);
+#endif
+
+#if USE_SDF_TILE_CULLING && !USE_SDF_CLIPMAP
+	mSdfTileCuller = std::make_unique<GRiSdfTileCuller>();
+	mSdfTileCuller->Init(SDF_TILE_NUM);
+#endif
+
+#if USE_CPU_LIGHT_CLUSTERING
+	mLightClusterer = std::make_unique<GRiClusteredLightAssigner>();
+	mLightClusterer->Init(CLUSTER_SIZE_X, CLUSTER_SIZE_Y, DepthSlicing_16, CLUSTER_NUM_Z);
+#if USE_LIGHT_BVH
+	mLightClusterer->SetLightBvhEnabled(true);
+#endif
+#endif
+
+	BuildDefaultLights();
 }
 
 void GDxRenderer::Draw(const GGiGameTimer* gt)
@@ -220,26 +266,7 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 	{
 		GDxGpuProfiler::GetGpuProfiler().StartGpuProfile("G-Buffer Pass");
 
-		mCommandList->RSSetViewports(1, &(mRtvHeaps["GBuffer"]->mRtv[0]->mViewport));
-		mCommandList->RSSetScissorRects(1, &(mRtvHeaps["GBuffer"]->mRtv[0]->mScissorRect));
-
-		mCommandList->SetGraphicsRootSignature(mRootSignatures["GBuffer"].Get());
-
-		mCommandList->SetPipelineState(mPSOs["GBuffer"].Get());
-
-		UINT objCBByteSize = GDxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-		auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-
-		auto passCB = mCurrFrameResource->PassCB->Resource();
-		mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-
-		//mCommandList->SetGraphicsRootDescriptorTable(2, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		mCommandList->SetGraphicsRootDescriptorTable(3, GetGpuSrv(mTextrueHeapIndex));
-
-		matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
-		mCommandList->SetGraphicsRootShaderResourceView(4, matBuffer->GetGPUVirtualAddress());
-
-		mCommandList->OMSetStencilRef(1);
+		SetGBufferPassState(mCommandList.Get());
 
 		// Indicate a state transition on the resource usage.
 		for (size_t i = 0; i < mRtvHeaps["GBuffer"]->mRtv.size(); i++)
@@ -259,12 +286,24 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 			mCommandList->ClearRenderTargetView(mRtvHeaps["GBuffer"]->mRtvHeap.handleCPU((UINT)i), clearColor, 0, nullptr);
 		}
 
-		// Specify the buffers we are going to render to.
-		//mCommandList->OMSetRenderTargets(mRtvHeaps["GBuffer"]->mRtvHeap.HeapDesc.NumDescriptors, &(mRtvHeaps["GBuffer"]->mRtvHeap.hCPUHeapStart), true, &DepthStencilView());
-		mCommandList->OMSetRenderTargets(mRtvHeaps["GBuffer"]->mRtvHeap.HeapDesc.NumDescriptors, &(mRtvHeaps["GBuffer"]->mRtvHeap.hCPUHeapStart), true, &DepthStencilView());
-
 		// For each render item...
+#if USE_SORTED_DRAWS
+		bool bDrawn = false;
+#if USE_PARALLEL_GBUFFER_RECORDING
+		bDrawn = RecordGBufferDrawsInParallel();
+#endif
+#if USE_INDIRECT_DRAWS
+		if (!bDrawn && bIndirectDrawsBuilt)
+		{
+			DrawIndirectSceneObjects(mCommandList.Get());
+			bDrawn = true;
+		}
+#endif
+		if (!bDrawn)
+			DrawSortedSceneObjects(mCommandList.Get(), true, true);
+#else
 		DrawSceneObjects(mCommandList.Get(), RenderLayer::Deferred, true, true, true);
+#endif
 
 		for (size_t i = 0; i < mRtvHeaps["GBuffer"]->mRtv.size(); i++)
 		{
@@ -316,6 +355,7 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 	}
 
 	// Tile/Cluster Pass
+#if !USE_CPU_LIGHT_CLUSTERING
 	{
 #if USE_TBDR
 		GDxGpuProfiler::GetGpuProfiler().StartGpuProfile("Tile Pass");
@@ -370,6 +410,7 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 		ThrowGGiException("TBDR/CBDR not enabled.");
 #endif
 	}
+#endif
 
 	// Screen Space Shadow Pass
 	{
@@ -381,6 +422,25 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 		mCommandList->RSSetViewports(1, &mScreenViewport);
 		mCommandList->RSSetScissorRects(1, &mScissorRect);
 
+#if USE_SDF_CLIPMAP
+		// Bricks recomposited this frame.
+		if (mSdfClipmapBrickCopies.size() > 0)
+		{
+			if (mSdfClipmapBufferState != D3D12_RESOURCE_STATE_COPY_DEST)
+			{
+				mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mSdfClipmapBuffer.Get(),
+					mSdfClipmapBufferState, D3D12_RESOURCE_STATE_COPY_DEST));
+			}
+
+			for (auto& copy : mSdfClipmapBrickCopies)
+				mCommandList->CopyBufferRegion(mSdfClipmapBuffer.Get(), copy.DstOffset, mUploadRing->Resource(), copy.SrcOffset, copy.Size);
+
+			mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mSdfClipmapBuffer.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+			mSdfClipmapBufferState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+		}
+#endif
+
 		mCommandList->SetGraphicsRootSignature(mRootSignatures["ScreenSpaceShadowPass"].Get());
 
 		mCommandList->SetPipelineState(mPSOs["ScreenSpaceShadowPass"].Get());
@@ -388,7 +448,7 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRtvHeaps["ScreenSpaceShadowPass"]->mRtv[0]->mResource.Get(),
 			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
 
-		mCommandList->SetGraphicsRoot32BitConstant(0, mSceneObjectSdfNum, 0);
+		mCommandList->SetGraphicsRoot32BitConstants(0, sizeof(SdfTileConstants) / 4, &mSdfTileConstants, 0);
 
 		auto meshSdfDesBuffer = mMeshSdfDescriptorBuffer->Resource();
 		mCommandList->SetGraphicsRootShaderResourceView(1, meshSdfDesBuffer->GetGPUVirtualAddress());
@@ -403,6 +463,17 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 		auto passCB = mCurrFrameResource->PassCB->Resource();
 		mCommandList->SetGraphicsRootConstantBufferView(5, passCB->GetGPUVirtualAddress());
 
+		mCommandList->SetGraphicsRootShaderResourceView(6, mSdfTileRangeAllocation.GpuAddress);
+
+		mCommandList->SetGraphicsRootShaderResourceView(7, mSdfTileObjectIndexAllocation.GpuAddress);
+
+		mCommandList->SetGraphicsRoot32BitConstants(8, sizeof(SdfClipmapConstants) / 4, &mSdfClipmapConstants, 0);
+
+		// The clipmap is bound either way, the shader only reads it if enabled.
+		auto clipmapAddress = mSdfClipmapBufferState == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE ?
+			mSdfClipmapBuffer->GetGPUVirtualAddress() : mSdfTileRangeAllocation.GpuAddress;
+		mCommandList->SetGraphicsRootShaderResourceView(9, clipmapAddress);
+
 		mCommandList->OMSetRenderTargets(1, &mRtvHeaps["ScreenSpaceShadowPass"]->mRtvHeap.handleCPU(0), false, nullptr);
 
 		// Clear the render target.
@@ -455,6 +526,10 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 
 		mCommandList->SetGraphicsRootDescriptorTable(6, GetGpuSrv(mIblIndex));
 
+		mCommandList->SetGraphicsRootShaderResourceView(7, mClusterLightRangeAllocation.GpuAddress);
+
+		mCommandList->SetGraphicsRootShaderResourceView(8, mClusterLightIndexAllocation.GpuAddress);
+
 		mCommandList->OMSetRenderTargets(1, &mRtvHeaps["LightPass"]->mRtvHeap.handleCPU(0), false, nullptr);
 
 		// Clear the render target.
@@ -765,6 +840,9 @@ void GDxRenderer::Draw(const GGiGameTimer* gt)
 	// set until the GPU finishes processing all the commands prior to this Signal().
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
 
+	// Transient uploads of this frame are recycled once the gpu passes the same fence point.
+	mUploadRing->FinishFrame(mCurrentFence);
+
 	GDxGpuProfiler::GetGpuProfiler().EndFrame();
 }
 
@@ -784,6 +862,8 @@ void GDxRenderer::Update(const GGiGameTimer* gt)
 		CloseHandle(eventHandle);
 	}
 
+	mUploadRing->ReleaseCompletedFrames(mFence->GetCompletedValue());
+
 	//
 	// Animate the lights (and hence shadows).
 	//
@@ -802,17 +882,31 @@ void GDxRenderer::Update(const GGiGameTimer* gt)
 
 	ScriptUpdate(gt);
 
+	UpdateSceneTransforms(gt);
+
 	UpdateObjectCBs(gt);
 	UpdateMaterialBuffer(gt);
+	UpdateQuantizationBuffer(gt);
 	UpdateSdfDescriptorBuffer(gt);
 	UpdateShadowTransform(gt);
 	UpdateMainPassCB(gt);
 	UpdateSkyPassCB(gt);
-	UpdateLightCB(gt);
+	UpdateSdfTileLists(gt);
+	UpdateSdfClipmapBricks(gt);
 
 	GGiCpuProfiler::GetInstance().EndCpuProfile("Cpu Update Constant Buffers");
 
+	UpdateSceneBvh(gt);
+
 	CullSceneObjects(gt);
+
+	// Lights are tested against the masked depth buffer CullSceneObjects() generated.
+	UpdateLightCB(gt);
+	UpdateLightClusters(gt);
+
+#if USE_SORTED_DRAWS
+	SortVisibleDraws(gt);
+#endif
 }
 
 void GDxRenderer::OnResize()
@@ -990,258 +1084,535 @@ void GDxRenderer::ScriptUpdate(const GGiGameTimer* gt)
 void GDxRenderer::UpdateObjectCBs(const GGiGameTimer* gt)
 {
 	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for (auto& e : pSceneObjects)
+	mUpdatedSceneObjects.clear();
+
+	// Only objects whose constants have changed are queued, they stay queued until every
+	// frame resource has the update.
+	GRiSceneObject::GetDirtyList().Drain([&](GRiSceneObject* so)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e.second->NumFramesDirty > 0)
-		{
-			e.second->UpdateTransform();
-
-			/*
-			auto dxTrans = dynamic_pointer_cast<GDxFloat4x4>(e.second->GetTransform());
-			if (dxTrans == nullptr)
-				ThrowGGiException("Cast failed from shared_ptr<GGiFloat4x4> to shared_ptr<GDxFloat4x4>.");
-
-			auto dxPrevTrans = dynamic_pointer_cast<GDxFloat4x4>(e.second->GetPrevTransform());
-			if (dxPrevTrans == nullptr)
-				ThrowGGiException("Cast failed from shared_ptr<GGiFloat4x4> to shared_ptr<GDxFloat4x4>.");
-
-			auto dxTexTrans = dynamic_pointer_cast<GDxFloat4x4>(e.second->GetTexTransform());
-			if (dxTexTrans == nullptr)
-				ThrowGGiException("Cast failed from shared_ptr<GGiFloat4x4> to shared_ptr<GDxFloat4x4>.");
-			*/
-			
-			//XMMATRIX renderObjectTrans = XMLoadFloat4x4(&(dxTrans->GetValue())); 
-			XMMATRIX renderObjectTrans = GDx::GGiToDxMatrix(e.second->GetTransform());
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(renderObjectTrans), renderObjectTrans);
-			XMMATRIX invTransWorld = XMMatrixTranspose(invWorld);
-			//XMMATRIX prevWorld = XMLoadFloat4x4(&(dxPrevTrans->GetValue()));
-			XMMATRIX prevWorld = GDx::GGiToDxMatrix(e.second->GetPrevTransform());
-			//auto tempSubTrans = e->GetSubmesh().Transform;
-			//XMMATRIX submeshTrans = XMLoadFloat4x4(&tempSubTrans);
-			//XMMATRIX texTransform = XMLoadFloat4x4(&(dxTexTrans->GetValue()));
-			XMMATRIX texTransform = GDx::GGiToDxMatrix(e.second->GetTexTransform());
-			//auto world = submeshTrans * renderObjectTrans;
-			auto world = renderObjectTrans;
-
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.PrevWorld, XMMatrixTranspose(prevWorld));
-			XMStoreFloat4x4(&objConstants.InvTransWorld, XMMatrixTranspose(invTransWorld));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			/*
-			if (e.second->GetMesh()->NumFramesDirty > 0)
-			{
-				objConstants.MaterialIndex = e.second->GetMaterial()->MatIndex;
-			}
-			*/
+		// Not added to the scene yet, SetObjIndex() queues it again.
+		if (so->GetObjIndex() >= MAX_SCENE_OBJECT_NUM)
+			return false;
 
-			currObjectCB->CopyData(e.second->GetObjIndex(), objConstants);
+		so->UpdateTransform();
 
-			// Next FrameResource need to be updated too.
-			e.second->NumFramesDirty--;
+		/*
+		auto dxTrans = dynamic_pointer_cast<GDxFloat4x4>(so->GetTransform());
+		if (dxTrans == nullptr)
+			ThrowGGiException("Cast failed from shared_ptr<GGiFloat4x4> to shared_ptr<GDxFloat4x4>.");
+
+		auto dxPrevTrans = dynamic_pointer_cast<GDxFloat4x4>(so->GetPrevTransform());
+		if (dxPrevTrans == nullptr)
+			ThrowGGiException("Cast failed from shared_ptr<GGiFloat4x4> to shared_ptr<GDxFloat4x4>.");
+
+		auto dxTexTrans = dynamic_pointer_cast<GDxFloat4x4>(so->GetTexTransform());
+		if (dxTexTrans == nullptr)
+			ThrowGGiException("Cast failed from shared_ptr<GGiFloat4x4> to shared_ptr<GDxFloat4x4>.");
+		*/
+		
+		//XMMATRIX renderObjectTrans = XMLoadFloat4x4(&(dxTrans->GetValue())); 
+		XMMATRIX renderObjectTrans = GDx::GGiToDxMatrix(so->GetTransform());
+		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(renderObjectTrans), renderObjectTrans);
+		XMMATRIX invTransWorld = XMMatrixTranspose(invWorld);
+		//XMMATRIX prevWorld = XMLoadFloat4x4(&(dxPrevTrans->GetValue()));
+		XMMATRIX prevWorld = GDx::GGiToDxMatrix(so->GetPrevTransform());
+		//auto tempSubTrans = e->GetSubmesh().Transform;
+		//XMMATRIX submeshTrans = XMLoadFloat4x4(&tempSubTrans);
+		//XMMATRIX texTransform = XMLoadFloat4x4(&(dxTexTrans->GetValue()));
+		XMMATRIX texTransform = GDx::GGiToDxMatrix(so->GetTexTransform());
+		//auto world = submeshTrans * renderObjectTrans;
+		auto world = renderObjectTrans;
+
+		ObjectConstants objConstants;
+		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&objConstants.PrevWorld, XMMatrixTranspose(prevWorld));
+		XMStoreFloat4x4(&objConstants.InvTransWorld, XMMatrixTranspose(invTransWorld));
+		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		/*
+		if (so->GetMesh()->NumFramesDirty > 0)
+		{
+			objConstants.MaterialIndex = so->GetMaterial()->MatIndex;
 		}
+		*/
+
+		currObjectCB->CopyData(so->GetObjIndex(), objConstants);
+
+		mUpdatedSceneObjects.push_back(so);
+
+		// Next FrameResource need to be updated too.
+		so->NumFramesDirty--;
+
+		return so->NumFramesDirty > 0;
 	}
+	);
 }
 
 void GDxRenderer::UpdateLightCB(const GGiGameTimer* gt)
 {
-	LightConstants lightCB;
+	auto LightCB = mCurrFrameResource->LightCB.get();
+
+	GGiFloat4x4 cameraView = pCamera->GetView();
+	GGiFloat4x4 cameraProj = pCamera->GetProj();
+	float frustumPlanes[6][4];
+	GRiDynamicAabbTree::ExtractFrustumPlanes(cameraView * cameraProj, frustumPlanes);
+#if USE_LIGHT_OCCLUSION_CULLING && USE_MASKED_DEPTH_BUFFER
+	// There is no depth to reproject in the first frame.
+	XMMATRIX viewProj = XMMatrixMultiply(GDx::GGiToDxMatrix(cameraView), GDx::GGiToDxMatrix(cameraProj));
+	mLightManager->Cull(mRendererThreadPool.get(), frustumPlanes, mFrameCount != 0 ? &viewProj.r[0] : nullptr);
+#else
+	mLightManager->Cull(mRendererThreadPool.get(), frustumPlanes);
+#endif
+
+	// Every frame resource collects the changes of the frames since it was last written, and only uploads those.
+	auto& pointLights = mLightManager->GetVisiblePointLights();
+	UINT pointLightNum = min((UINT)pointLights.size(), (UINT)MAX_POINT_LIGHT_NUM);
+	auto changedRange = mLightManager->GetChangedPointLightRange();
+	if (changedRange.Num > 0)
+	{
+		for (auto i = 0; i < NUM_FRAME_RESOURCES; i++)
+		{
+			if (mPointLightUploadBegin[i] >= mPointLightUploadEnd[i])
+			{
+				mPointLightUploadBegin[i] = changedRange.First;
+				mPointLightUploadEnd[i] = changedRange.First + changedRange.Num;
+			}
+			else
+			{
+				mPointLightUploadBegin[i] = min(mPointLightUploadBegin[i], changedRange.First);
+				mPointLightUploadEnd[i] = max(mPointLightUploadEnd[i], changedRange.First + changedRange.Num);
+			}
+		}
+	}
+
+	UINT uploadBegin = mPointLightUploadBegin[mCurrFrameResourceIndex];
+	UINT uploadEnd = min(mPointLightUploadEnd[mCurrFrameResourceIndex], pointLightNum);
+	if (uploadBegin < uploadEnd)
+	{
+		LightCB->CopyBytes(0,
+			offsetof(LightConstants, pointLight) + sizeof(GRiPointLight) * uploadBegin,
+			&pointLights[uploadBegin],
+			sizeof(GRiPointLight) * (uploadEnd - uploadBegin));
+	}
+	mPointLightUploadBegin[mCurrFrameResourceIndex] = 0;
+	mPointLightUploadEnd[mCurrFrameResourceIndex] = 0;
+
+	auto& dirLights = mLightManager->GetDirectionalLights();
+	UINT dirLightNum = min((UINT)dirLights.size(), (UINT)MAX_DIRECTIONAL_LIGHT_NUM);
+	if (mLightManager->HaveDirectionalLightsChanged())
+		mDirLightFramesDirty = NUM_FRAME_RESOURCES;
+	if (mDirLightFramesDirty > 0)
+	{
+		if (dirLightNum > 0)
+			LightCB->CopyBytes(0, offsetof(LightConstants, dirLight), dirLights.data(), sizeof(GRiDirectionalLight) * dirLightNum);
+		mDirLightFramesDirty--;
+	}
 
 	auto pos = pCamera->GetPosition();
-	lightCB.cameraPosition = DirectX::XMFLOAT3(pos[0], pos[1], pos[2]);
-
-	lightCB.dirLight[0].Direction[0] = 0.57735f;
-	lightCB.dirLight[0].Direction[1] = -0.57735f;
-	lightCB.dirLight[0].Direction[2] = -0.57735f;
-	lightCB.dirLight[0].DiffuseColor[0] = 0.7f;
-	lightCB.dirLight[0].DiffuseColor[1] = 0.7f;
-	lightCB.dirLight[0].DiffuseColor[2] = 0.6f;
-	lightCB.dirLight[0].DiffuseColor[3] = 1.0f;
-	lightCB.dirLight[0].AmbientColor[0] = 0.0f;
-	lightCB.dirLight[0].AmbientColor[1] = 0.0f;
-	lightCB.dirLight[0].AmbientColor[2] = 0.0f;
-	lightCB.dirLight[0].AmbientColor[3] = 1.0f;
-	lightCB.dirLight[0].Intensity = 3.0f;
-
-	lightCB.dirLight[1].Direction[0] = -0.57735f;
-	lightCB.dirLight[1].Direction[1] = -0.57735f;
-	lightCB.dirLight[1].Direction[2] = -0.57735f;
-	lightCB.dirLight[1].DiffuseColor[0] = 0.6f;
-	lightCB.dirLight[1].DiffuseColor[1] = 0.6f;
-	lightCB.dirLight[1].DiffuseColor[2] = 0.6f;
-	lightCB.dirLight[1].DiffuseColor[3] = 1.0f;
-	lightCB.dirLight[1].AmbientColor[0] = 0.0f;
-	lightCB.dirLight[1].AmbientColor[1] = 0.0f;
-	lightCB.dirLight[1].AmbientColor[2] = 0.0f;
-	lightCB.dirLight[1].AmbientColor[3] = 1.0f;
-	lightCB.dirLight[1].Intensity = 3.0f;
-
-	lightCB.dirLight[2].Direction[0] = 0.0;
-	lightCB.dirLight[2].Direction[1] = -0.707f;
-	lightCB.dirLight[2].Direction[2] = 0.707f;
-	lightCB.dirLight[2].DiffuseColor[0] = 0.5f;
-	lightCB.dirLight[2].DiffuseColor[1] = 0.5f;
-	lightCB.dirLight[2].DiffuseColor[2] = 0.5f;
-	lightCB.dirLight[2].DiffuseColor[3] = 1.0f;
-	lightCB.dirLight[2].AmbientColor[0] = 0.0f;
-	lightCB.dirLight[2].AmbientColor[1] = 0.0f;
-	lightCB.dirLight[2].AmbientColor[2] = 0.0f;
-	lightCB.dirLight[2].AmbientColor[3] = 1.0f;
-	lightCB.dirLight[2].Intensity = 3.0f;
-
-	lightCB.pointLight[0].Color[0] = 1.0f;
-	lightCB.pointLight[0].Color[1] = 1.0f;
-	lightCB.pointLight[0].Color[2] = 1.0f;
-	lightCB.pointLight[0].Color[3] = 1.0f;
-	lightCB.pointLight[0].Intensity = 100.0f;
-	lightCB.pointLight[0].Position[0] = 0.0f;
-	lightCB.pointLight[0].Position[1] = -4.0f;
-	lightCB.pointLight[0].Position[2] = 0.0f;
-	lightCB.pointLight[0].Range = 100.0f;
+	DirectX::XMFLOAT3 cameraPosition(pos[0], pos[1], pos[2]);
+	LightCB->CopyBytes(0, offsetof(LightConstants, cameraPosition), &cameraPosition, sizeof(cameraPosition));
 
-	/*
-	int lightCount = 16;
-	for (int i = -lightCount; i < lightCount; i++)
+	// pointLightCount and dirLightCount.
+	int lightCounts[2] = { (int)pointLightNum, (int)dirLightNum };
+	LightCB->CopyBytes(0, offsetof(LightConstants, pointLightCount), lightCounts, sizeof(lightCounts));
+}
+
+void GDxRenderer::UpdateLightClusters(const GGiGameTimer* gt)
+{
+	// The lists are bound either way, the shader only reads them if enabled.
+	mClusterLightRangeAllocation = mUploadRing->AllocateArray<UINT>(2);
+	mClusterLightIndexAllocation = mUploadRing->AllocateArray<UINT>(1);
+
+#if USE_CPU_LIGHT_CLUSTERING
+	// Same lights as the light cb, so the indices address its point light array.
+	auto& pointLights = mLightManager->GetVisiblePointLights();
+	UINT pointLightNum = min((UINT)pointLights.size(), (UINT)MAX_POINT_LIGHT_NUM);
+
+	GGiFloat4x4 cameraProj = pCamera->GetProj();
+	mLightClusterer->Assign(mRendererThreadPool.get(), mClientWidth, mClientHeight, pCamera->GetView(),
+		cameraProj.GetElement(0, 0), cameraProj.GetElement(1, 1), pointLights.data(), pointLightNum);
+
+	auto& clusterRanges = mLightClusterer->GetClusterRanges();
+	auto& lightIndices = mLightClusterer->GetLightIndices();
+
+	mClusterLightRangeAllocation = mUploadRing->AllocateArray<UINT>((UINT)clusterRanges.size());
+	UINT* ranges = (UINT*)mClusterLightRangeAllocation.CpuAddress;
+	memcpy(ranges, clusterRanges.data(), sizeof(UINT) * clusterRanges.size());
+
+	// The root srv has no size, the shader reads whatever the ranges point at, so the whole list is uploaded. If the
+	// ring can't hold it this frame the clusters are left empty and the overflow is reported.
+	UINT indexNum = (UINT)lightIndices.size();
+	if (indexNum > 0)
 	{
-		for (int j = -lightCount; j < lightCount; j++)
+		auto indexAllocation = mUploadRing->TryAllocateArray<UINT>(indexNum);
+		if (indexAllocation.CpuAddress != nullptr)
+		{
+			mClusterLightIndexAllocation = indexAllocation;
+			memcpy(mClusterLightIndexAllocation.CpuAddress, lightIndices.data(), sizeof(UINT) * indexNum);
+			bClusterLightIndexOverflow = false;
+		}
+		else
 		{
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Color[0] = ((abs(i * j + 1) % 8) * 0.1f + 0.2f);
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Color[1] = ((abs(i * j + 2) % 7) * 0.1f + 0.3f);
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Color[2] = ((abs(i * j) % 6) * 0.1f + 0.4f);
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Color[3] = 1.0f;
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Intensity = 500.0f;
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Position[0] = i * 30.0f;
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Position[1] = -15.0f;
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Position[2] = j * 30.0f;
-			lightCB.pointLight[(i + lightCount) * 2 * lightCount + j + lightCount].Range = 50.0f;
+			memset(ranges, 0, sizeof(UINT) * clusterRanges.size());
+			if (!bClusterLightIndexOverflow)
+			{
+				std::wstring text = L"Cluster light index list of " + std::to_wstring(indexNum) + L" entries doesn't fit the upload ring, clustered point lights are skipped.\n";
+				OutputDebugString(text.c_str());
+				bClusterLightIndexOverflow = true;
+			}
 		}
 	}
-	*/
+#endif
+}
 
-	lightCB.pointLight[0].Color[0] = 1.0f;
-	lightCB.pointLight[0].Color[1] = 1.0f;
-	lightCB.pointLight[0].Color[2] = 1.0f;
-	lightCB.pointLight[0].Color[3] = 1.0f;
-	lightCB.pointLight[0].Intensity = 5000.0f;
-	lightCB.pointLight[0].Position[0] = 0.0f;
-	lightCB.pointLight[0].Position[1] = 0.0f;
-	lightCB.pointLight[0].Position[2] = 0.0f;
-	lightCB.pointLight[0].Range = 50000.0f;
-
-	lightCB.pointLight[1].Color[0] = 1.0f;
-	lightCB.pointLight[1].Color[1] = 1.0f;
-	lightCB.pointLight[1].Color[2] = 1.0f;
-	lightCB.pointLight[1].Color[3] = 1.0f;
-	lightCB.pointLight[1].Intensity = 5000.0f;
-	lightCB.pointLight[1].Position[0] = 800.0f;
-	lightCB.pointLight[1].Position[1] = 0.0f;
-	lightCB.pointLight[1].Position[2] = 800.0f;
-	lightCB.pointLight[1].Range = 50000.0f;
-
-	lightCB.pointLight[2].Color[0] = 1.0f;
-	lightCB.pointLight[2].Color[1] = 1.0f;
-	lightCB.pointLight[2].Color[2] = 1.0f;
-	lightCB.pointLight[2].Color[3] = 1.0f;
-	lightCB.pointLight[2].Intensity = 5000.0f;
-	lightCB.pointLight[2].Position[0] = 800.0f;
-	lightCB.pointLight[2].Position[1] = 0.0f;
-	lightCB.pointLight[2].Position[2] = -800.0f;
-	lightCB.pointLight[2].Range = 50000.0f;
-
-	lightCB.dirLightCount = 3;
-	lightCB.pointLightCount = 0;// 4 * lightCount * lightCount;
+void GDxRenderer::BuildDefaultLights()
+{
+	float directions[3][3] = {
+		{ 0.57735f, -0.57735f, -0.57735f },
+		{ -0.57735f, -0.57735f, -0.57735f },
+		{ 0.0f, -0.707f, 0.707f }
+	};
+	float colors[3][4] = {
+		{ 0.7f, 0.7f, 0.6f, 1.0f },
+		{ 0.6f, 0.6f, 0.6f, 1.0f },
+		{ 0.5f, 0.5f, 0.5f, 1.0f }
+	};
 
-	auto LightCB = mCurrFrameResource->LightCB.get();
-	LightCB->CopyData(0, lightCB);
+	for (auto i = 0; i < 3; i++)
+	{
+		GRiDirectionalLight light;
+		for (auto k = 0; k < 3; k++)
+			light.Direction[k] = directions[i][k];
+		for (auto k = 0; k < 4; k++)
+		{
+			light.DiffuseColor[k] = colors[i][k];
+			light.AmbientColor[k] = k == 3 ? 1.0f : 0.0f;
+		}
+		light.Intensity = 3.0f;
+		mLightManager->AddDirectionalLight(light);
+	}
 }
 
 void GDxRenderer::UpdateMaterialBuffer(const GGiGameTimer* gt)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
-	for (auto& e : pMaterials)
+
+	// Only materials whose constants have changed are queued.  If the cbuffer
+	// data changes, it needs to be updated for each FrameResource.
+	GRiMaterial::GetDirtyList().Drain([&](GRiMaterial* mat)
 	{
-		// Only update the cbuffer data if the constants have changed.  If the cbuffer
-		// data changes, it needs to be updated for each FrameResource.
-		GRiMaterial* mat = e.second;
-		if (mat->NumFramesDirty > 0)
+		// Stays queued until the material is registered.
+		if (mat->MatIndex < 0)
+			return true;
+
+		MaterialData matData;
+		int i;
+		XMMATRIX matTransform = DirectX::XMMatrixScaling(mat->GetScaleX(), mat->GetScaleY(), 1.0f);
+		//GGiFloat4x4* ggiMat = mat->MatTransform.get();
+		//GDxFloat4x4* dxMat = dynamic_cast<GDxFloat4x4*>(ggiMat);
+		//if (dxMat == nullptr)
+			//ThrowDxException(L"Dynamic cast from GRiFloat4x4 to GDxFloat4x4 failed.");
+		//XMMATRIX matTransform = XMLoadFloat4x4(&dxMat->GetValue());
+		XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+
+		size_t texNum = mat->GetTextureNum();
+		if (texNum > MATERIAL_MAX_TEXTURE_NUM)
+			ThrowDxException(L"Material (CBIndex : " + std::to_wstring(mat->MatIndex) + L" ) texture number exceeds MATERIAL_MAX_TEXTURE_NUM.");
+		for (i = 0; i < texNum; i++)
 		{
-			MaterialData matData;
-			int i;
-			XMMATRIX matTransform = DirectX::XMMatrixScaling(mat->GetScaleX(), mat->GetScaleY(), 1.0f);
-			//GGiFloat4x4* ggiMat = mat->MatTransform.get();
-			//GDxFloat4x4* dxMat = dynamic_cast<GDxFloat4x4*>(ggiMat);
-			//if (dxMat == nullptr)
-				//ThrowDxException(L"Dynamic cast from GRiFloat4x4 to GDxFloat4x4 failed.");
-			//XMMATRIX matTransform = XMLoadFloat4x4(&dxMat->GetValue());
-			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-
-			size_t texNum = mat->GetTextureNum();
-			if (texNum > MATERIAL_MAX_TEXTURE_NUM)
-				ThrowDxException(L"Material (CBIndex : " + std::to_wstring(mat->MatIndex) + L" ) texture number exceeds MATERIAL_MAX_TEXTURE_NUM.");
-			for (i = 0; i < texNum; i++)
-			{
-				auto texName = mat->GetTextureUniqueNameByIndex(i);
-				if (pTextures.find(texName) == pTextures.end())
-					ThrowGGiException(L"Texture" + texName + L" not found.");
-				matData.TextureIndex[i] = pTextures[texName]->texIndex;
-			}
+			auto texName = mat->GetTextureUniqueNameByIndex(i);
+			if (pTextures.find(texName) == pTextures.end())
+				ThrowGGiException(L"Texture" + texName + L" not found.");
+			matData.TextureIndex[i] = pTextures[texName]->texIndex;
+		}
 
-			size_t scalarNum = mat->GetScalarNum();
-			if (scalarNum > MATERIAL_MAX_SCALAR_NUM)
-				ThrowDxException(L"Material (CBIndex : " + std::to_wstring(mat->MatIndex) + L" ) scalar number exceeds MATERIAL_MAX_SCALAR_NUM.");
-			for (i = 0; i < scalarNum; i++)
-			{
-				matData.ScalarParams[i] = mat->GetScalar(i);
-			}
+		size_t scalarNum = mat->GetScalarNum();
+		if (scalarNum > MATERIAL_MAX_SCALAR_NUM)
+			ThrowDxException(L"Material (CBIndex : " + std::to_wstring(mat->MatIndex) + L" ) scalar number exceeds MATERIAL_MAX_SCALAR_NUM.");
+		for (i = 0; i < scalarNum; i++)
+		{
+			matData.ScalarParams[i] = mat->GetScalar(i);
+		}
+
+		size_t vectorNum = mat->GetVectorNum();
+		if (vectorNum > MATERIAL_MAX_VECTOR_NUM)
+			ThrowDxException(L"Material (CBIndex : " + std::to_wstring(mat->MatIndex) + L" ) vector number exceeds MATERIAL_MAX_VECTOR_NUM.");
+		for (i = 0; i < vectorNum; i++)
+		{
+			XMVECTOR ggiVec = mat->GetVector(i);
+			DirectX::XMStoreFloat4(&matData.VectorParams[i], ggiVec);
+		}
+		//matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+		//matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+		//matData.Roughness = mat->Roughness;
+		//matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+		//matData.FresnelR0 = mat->FresnelR0;
+
+		currMaterialBuffer->CopyData(mat->MatIndex, matData);
+
+		// Next FrameResource need to be updated too.
+		mat->NumFramesDirty--;
+
+		return mat->NumFramesDirty > 0;
+	}
+	);
+}
+
+void GDxRenderer::UpdateQuantizationBuffer(const GGiGameTimer* gt)
+{
+	// The whole table is a few bytes per mesh, so every frame gets a copy of its own in the upload ring and meshes
+	// can come and go without waiting for the frames in flight.
+	auto& table = GDxQuantizationTable::GetInstance();
+	UINT entryNum = table.GetEntryNum();
+	mQuantizationAllocation = mUploadRing->AllocateArray<MeshQuantizationData>(entryNum);
+	auto entries = reinterpret_cast<MeshQuantizationData*>(mQuantizationAllocation.CpuAddress);
+	auto quantizations = table.GetEntries();
+	for (auto i = 0u; i < entryNum; i++)
+	{
+		MeshQuantizationData entry;
+		entry.PositionScale = XMFLOAT4(quantizations[i].Scale[0], quantizations[i].Scale[1], quantizations[i].Scale[2], 0.0f);
+		entry.PositionOffset = XMFLOAT4(quantizations[i].Offset[0], quantizations[i].Offset[1], quantizations[i].Offset[2], 0.0f);
+		memcpy(&entries[i], &entry, sizeof(MeshQuantizationData));
+	}
+}
 
-			size_t vectorNum = mat->GetVectorNum();
-			if (vectorNum > MATERIAL_MAX_VECTOR_NUM)
-				ThrowDxException(L"Material (CBIndex : " + std::to_wstring(mat->MatIndex) + L" ) vector number exceeds MATERIAL_MAX_VECTOR_NUM.");
-			for (i = 0; i < vectorNum; i++)
+void GDxRenderer::UpdateSdfDescriptorBuffer(const GGiGameTimer* gt)
+{
+	auto currDescBuffer = mCurrFrameResource->SceneObjectSdfDescriptorBuffer.get();
+
+	auto hasSdf = [](GRiSceneObject* so)
+	{
+		return so->GetMesh()->GetSdf() != nullptr && so->GetMesh()->GetSdf()->size() > 0;
+	};
+
+	// Only objects that moved or changed their mesh need a new descriptor, unless the slots have to be reassigned.
+	bool bReassignSlots = mSdfSlotLayerVersion != mSceneObjectLayerVersion;
+	for (auto so : mUpdatedSceneObjects)
+	{
+		auto slot = mSceneObjectSdfSlots.find(so);
+		if (slot != mSceneObjectSdfSlots.end() && (slot->second >= 0) != hasSdf(so))
+			bReassignSlots = true;
+	}
+
+	if (bReassignSlots)
+	{
+		mSdfSceneObjects.clear();
+		mSceneObjectSdfSlots.clear();
+		for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
+		{
+			int sdfSlot = -1;
+			if (hasSdf(so))
 			{
-				XMVECTOR ggiVec = mat->GetVector(i);
-				DirectX::XMStoreFloat4(&matData.VectorParams[i], ggiVec);
+				sdfSlot = (int)mSdfSceneObjects.size();
+				mSdfSceneObjects.push_back(so);
 			}
-			//matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-			//matData.NormalMapIndex = mat->NormalSrvHeapIndex;
-			//matData.Roughness = mat->Roughness;
-			//matData.DiffuseAlbedo = mat->DiffuseAlbedo;
-			//matData.FresnelR0 = mat->FresnelR0;
+			mSceneObjectSdfSlots[so] = sdfSlot;
+		}
+		mSceneObjectSdfNum = (UINT)mSdfSceneObjects.size();
+		mSceneObjectSdfBounds.resize(mSceneObjectSdfNum);
+		for (auto i = 0u; i < mSceneObjectSdfNum; i++)
+			UpdateSceneObjectSdfDescriptor(i);
+
+		mSdfSlotLayerVersion = mSceneObjectLayerVersion;
+		mSdfDescriptorFramesDirty = NUM_FRAME_RESOURCES;
+	}
+	else
+	{
+		// A changed object shows up in mUpdatedSceneObjects once for every frame resource, so each descriptor
+		// buffer gets the copy.
+		for (auto so : mUpdatedSceneObjects)
+		{
+			auto slot = mSceneObjectSdfSlots.find(so);
+			if (slot == mSceneObjectSdfSlots.end() || slot->second < 0)
+				continue;
+
+			UpdateSceneObjectSdfDescriptor(slot->second);
+			if (mSdfDescriptorFramesDirty == 0)
+				currDescBuffer->CopyData(slot->second, mSceneObjectSdfDescriptors[slot->second]);
+		}
+	}
 
-			currMaterialBuffer->CopyData(mat->MatIndex, matData);
+	// Frame resources recorded before the slots were reassigned get the whole list.
+	if (mSdfDescriptorFramesDirty > 0)
+	{
+		for (auto i = 0u; i < mSceneObjectSdfNum; i++)
+			currDescBuffer->CopyData(i, mSceneObjectSdfDescriptors[i]);
+		mSdfDescriptorFramesDirty--;
+	}
 
-			// Next FrameResource need to be updated too.
-			mat->NumFramesDirty--;
+#if USE_SDF_CLIPMAP
+	// Only objects that moved, appeared or disappeared invalidate clipmap bricks.
+	if (bReassignSlots)
+	{
+		std::unordered_set<UINT> clipmapObjects;
+		for (auto so : mSdfSceneObjects)
+		{
+			mSdfClipmap->SetObject(so->GetObjIndex(), so->GetMesh(), so->GetTransform());
+			clipmapObjects.insert(so->GetObjIndex());
 		}
+		for (auto id : mSdfClipmap->GetObjectIds())
+		{
+			if (clipmapObjects.find(id) == clipmapObjects.end())
+				mSdfClipmap->RemoveObject(id);
+		}
+	}
+	else
+	{
+		for (auto so : mUpdatedSceneObjects)
+		{
+			auto slot = mSceneObjectSdfSlots.find(so);
+			if (slot != mSceneObjectSdfSlots.end() && slot->second >= 0)
+				mSdfClipmap->SetObject(so->GetObjIndex(), so->GetMesh(), so->GetTransform());
+		}
+	}
+
+	auto eyePos = pCamera->GetPosition();
+	mSdfClipmap->Update(mRendererThreadPool.get(), eyePos[0], eyePos[1], eyePos[2]);
+#endif
+}
+
+void GDxRenderer::UpdateSceneObjectSdfDescriptor(UINT sdfSlot)
+{
+	auto so = mSdfSceneObjects[sdfSlot];
+	auto& desc = mSceneObjectSdfDescriptors[sdfSlot];
+
+	desc.SdfIndex = so->GetMesh()->mSdfIndex;
+	auto trans = GDx::GGiToDxMatrix(so->GetTransform());
+	DirectX::XMStoreFloat4x4(&desc.objWorld, XMMatrixTranspose(trans));
+	auto invTrans = DirectX::XMMatrixInverse(&XMMatrixDeterminant(trans), trans);
+	DirectX::XMStoreFloat4x4(&desc.objInvWorld, XMMatrixTranspose(invTrans));
+	auto invTrans_IT = XMMatrixTranspose(trans);
+	DirectX::XMStoreFloat4x4(&desc.objInvWorld_IT, XMMatrixTranspose(invTrans_IT));
+
+	// The sdf volume is a cube centered at the mesh origin.
+	GRiBoundingBox& sdfBounds = mSceneObjectSdfBounds[sdfSlot];
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, trans);
+	float halfExtent = mMeshSdfDescriptors[so->GetMesh()->mSdfIndex].HalfExtent;
+	for (auto k = 0; k < 3; k++)
+	{
+		sdfBounds.Center[k] = world.m[3][k];
+		sdfBounds.Extents[k] = halfExtent * (fabsf(world.m[0][k]) + fabsf(world.m[1][k]) + fabsf(world.m[2][k]));
 	}
 }
 
-void GDxRenderer::UpdateSdfDescriptorBuffer(const GGiGameTimer* gt)
+void GDxRenderer::UpdateSdfTileLists(const GGiGameTimer* gt)
 {
-	auto currDescBuffer = mCurrFrameResource->SceneObjectSdfDescriptorBuffer.get();
+	mSdfTileConstants.SceneObjectNum = mSceneObjectSdfNum;
+	mSdfTileConstants.Enabled = 0;
+
+	// The lists are bound either way, the shader only reads them if enabled.
+	mSdfTileRangeAllocation = mUploadRing->AllocateArray<UINT>(2);
+	mSdfTileObjectIndexAllocation = mUploadRing->AllocateArray<UINT>(1);
+
+#if USE_SDF_TILE_CULLING && !USE_SDF_CLIPMAP
+	float lightDir[3] = {
+		mMainPassCB.MainDirectionalLightDir.x,
+		mMainPassCB.MainDirectionalLightDir.y,
+		mMainPassCB.MainDirectionalLightDir.z
+	};
+	mSdfTileCuller->Build(mRendererThreadPool.get(), lightDir, mSceneObjectSdfBounds);
 
-	int soSdfIndex = 0;
-	for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
+	auto& tileRanges = mSdfTileCuller->GetTileRanges();
+	auto& objectIndices = mSdfTileCuller->GetObjectIndices();
+
+	// Every shadow ray marches all objects if the lists don't fit.
+	if (objectIndices.size() > SDF_TILE_MAX_INDEX_NUM)
+		return;
+
+	mSdfTileRangeAllocation = mUploadRing->AllocateArray<UINT>((UINT)tileRanges.size());
+	memcpy(mSdfTileRangeAllocation.CpuAddress, tileRanges.data(), sizeof(UINT) * tileRanges.size());
+	if (objectIndices.size() > 0)
+	{
+		mSdfTileObjectIndexAllocation = mUploadRing->AllocateArray<UINT>((UINT)objectIndices.size());
+		memcpy(mSdfTileObjectIndexAllocation.CpuAddress, objectIndices.data(), sizeof(UINT) * objectIndices.size());
+	}
+
+	auto& grid = mSdfTileCuller->GetGrid();
+	mSdfTileConstants.TileNum = (UINT)grid.TileNum;
+	mSdfTileConstants.Origin = XMFLOAT2(grid.Origin[0], grid.Origin[1]);
+	mSdfTileConstants.AxisU = XMFLOAT3(grid.AxisU);
+	mSdfTileConstants.InvTileSize = 1.0f / grid.TileSize;
+	mSdfTileConstants.AxisV = XMFLOAT3(grid.AxisV);
+	mSdfTileConstants.Enabled = 1;
+#endif
+}
+
+void GDxRenderer::UpdateSdfClipmapBricks(const GGiGameTimer* gt)
+{
+	mSdfClipmapBrickCopies.clear();
+	mSdfClipmapConstants.Enabled = 0;
+
+#if USE_SDF_CLIPMAP
+	int brickSize = mSdfClipmap->GetBrickSize();
+	int brickNum = mSdfClipmap->GetResolution() / brickSize;
+	UINT brickVoxelNum = (UINT)(brickSize * brickSize * brickSize);
+	UINT64 brickByteSize = sizeof(float) * brickVoxelNum;
+
+	// Index of the brick in the clipmap buffer, levels are stored one after another.
+	auto getBrickIndex = [&](const GRiSdfClipmapBrick& brick)
+	{
+		return brick.Level * brickNum * brickNum * brickNum + mSdfClipmap->GetBrickSlot(brick);
+	};
+
+	// A brick recomposited again before its upload is sent once, with the latest distances.
+	for (auto& brick : mSdfClipmap->GetUpdatedBricks())
 	{
-		if (so->GetMesh()->GetSdf() != nullptr && so->GetMesh()->GetSdf()->size() > 0)
+		auto index = getBrickIndex(brick);
+		if (!mSdfClipmapBrickPending[index])
 		{
-			so->UpdateTransform();
-			mSceneObjectSdfDescriptors[soSdfIndex].SdfIndex = so->GetMesh()->mSdfIndex;
-			auto trans = GDx::GGiToDxMatrix(so->GetTransform());
-			DirectX::XMStoreFloat4x4(&mSceneObjectSdfDescriptors[soSdfIndex].objWorld, XMMatrixTranspose(trans));
-			auto invTrans = DirectX::XMMatrixInverse(&XMMatrixDeterminant(trans), trans);
-			DirectX::XMStoreFloat4x4(&mSceneObjectSdfDescriptors[soSdfIndex].objInvWorld, XMMatrixTranspose(invTrans));
-			auto invTrans_IT = XMMatrixTranspose(trans);
-			DirectX::XMStoreFloat4x4(&mSceneObjectSdfDescriptors[soSdfIndex].objInvWorld_IT, XMMatrixTranspose(invTrans_IT));
+			mSdfClipmapBrickPending[index] = 1;
+			mSdfClipmapPendingBricks.push_back(brick);
+		}
+	}
 
-			currDescBuffer->CopyData(soSdfIndex, mSceneObjectSdfDescriptors[soSdfIndex]);
+	if (mSdfClipmapPendingBricks.size() > 0)
+	{
+		// In buffer order, so neighbouring bricks go out with one copy and the finest level comes first.
+		std::sort(mSdfClipmapPendingBricks.begin(), mSdfClipmapPendingBricks.end(),
+			[&](const GRiSdfClipmapBrick& a, const GRiSdfClipmapBrick& b) { return getBrickIndex(a) < getBrickIndex(b); });
 
-			soSdfIndex++;
+		UINT uploadNum = min((UINT)mSdfClipmapPendingBricks.size(), (UINT)SDF_CLIPMAP_MAX_UPLOAD_BRICK_NUM);
+		mSdfClipmapBrickAllocation = mUploadRing->AllocateArray<float>(uploadNum * brickVoxelNum);
+		float* data = (float*)mSdfClipmapBrickAllocation.CpuAddress;
+
+		int prevIndex = -2;
+		for (auto i = 0u; i < uploadNum; i++)
+		{
+			auto& brick = mSdfClipmapPendingBricks[i];
+			auto index = getBrickIndex(brick);
+			mSdfClipmap->CopyBrick(brick, data + (UINT64)i * brickVoxelNum);
+			mSdfClipmapBrickPending[index] = 0;
+
+			if (index == prevIndex + 1)
+			{
+				mSdfClipmapBrickCopies.back().Size += brickByteSize;
+			}
+			else
+			{
+				SdfClipmapBrickCopy copy;
+				copy.SrcOffset = mSdfClipmapBrickAllocation.Offset + i * brickByteSize;
+				copy.DstOffset = index * brickByteSize;
+				copy.Size = brickByteSize;
+				mSdfClipmapBrickCopies.push_back(copy);
+			}
+			prevIndex = index;
 		}
+		mSdfClipmapPendingBricks.erase(mSdfClipmapPendingBricks.begin(), mSdfClipmapPendingBricks.begin() + uploadNum);
 	}
-	mSceneObjectSdfNum = soSdfIndex;
+
+	mSdfClipmapConstants.Resolution = (UINT)mSdfClipmap->GetResolution();
+	mSdfClipmapConstants.BrickSize = (UINT)brickSize;
+	mSdfClipmapConstants.LevelNum = (UINT)mSdfClipmap->GetLevelNum();
+	for (auto l = 0; l < mSdfClipmap->GetLevelNum(); l++)
+	{
+		auto& level = mSdfClipmap->GetLevel(l);
+		mSdfClipmapConstants.Levels[l].Origin = XMINT3(level.Origin[0] * brickSize, level.Origin[1] * brickSize, level.Origin[2] * brickSize);
+		mSdfClipmapConstants.Levels[l].VoxelSize = level.VoxelSize;
+	}
+
+	// Stale bricks would be marched at their new place in the window, the objects are marched until all arrived.
+	mSdfClipmapConstants.Enabled = mSdfClipmapPendingBricks.size() == 0 ? 1 : 0;
+#endif
 }
 
 void GDxRenderer::UpdateShadowTransform(const GGiGameTimer* gt)
@@ -1401,6 +1772,96 @@ void GDxRenderer::UpdateSkyPassCB(const GGiGameTimer* gt)
 	currPassCB->CopyData(0, mSkyPassCB);
 }
 
+void GDxRenderer::UpdateSceneTransforms(const GGiGameTimer* gt)
+{
+	auto& store = GRiSceneStore::GetInstance();
+
+	// Only objects whose transform or mesh changed since the last frame, and their descendants, are visited.
+	// Levels are processed in order so that every parent is up to date before its children.
+	mDirtyBoundsIndices.clear();
+	store.BeginWorldUpdate();
+	for (auto level = 0u; level < store.GetLevelNum(); level++)
+	{
+		auto& dirtyLevel = store.GatherDirtyLevel(level);
+		if (dirtyLevel.size() == 0)
+			continue;
+
+		UINT32 step;
+		if (dirtyLevel.size() > 100)
+			step = (UINT32)(dirtyLevel.size() / mRendererThreadPool->GetThreadNum()) + 1;
+		else
+			step = 100;
+		for (auto i = 0u; i < dirtyLevel.size(); i += step)
+		{
+			mRendererThreadPool->Enqueue([&, i]
+			{
+				UINT num = min(step, (UINT32)dirtyLevel.size() - i);
+				store.UpdateWorlds(&dirtyLevel[i], num);
+			}
+			);
+		}
+
+		mRendererThreadPool->Flush();
+
+		mDirtyBoundsIndices.insert(mDirtyBoundsIndices.end(), dirtyLevel.begin(), dirtyLevel.end());
+	}
+
+	// Neither the spatial index nor the dirty list is thread safe. Children of moved objects need their constant
+	// buffers updated as well.
+	for (auto dense : mDirtyBoundsIndices)
+	{
+		store.GetOwners()[dense]->UpdateSpatialProxy();
+		store.GetOwners()[dense]->MarkDirty();
+	}
+}
+
+void GDxRenderer::UpdateSceneBvh(const GGiGameTimer* gt)
+{
+	for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
+	{
+		if (so->GetMesh()->GetBvh() == nullptr)
+			BuildMeshBvh(so->GetMesh());
+	}
+
+	mSceneBvh->Update(pSceneObjectLayer[(int)RenderLayer::Deferred]);
+}
+
+void GDxRenderer::BuildMeshBvh(GRiMesh* mesh)
+{
+	GDxMesh* dxMesh = dynamic_cast<GDxMesh*>(mesh);
+	if (dxMesh == nullptr)
+		ThrowGGiException("cast failed from GRiMesh* to GDxMesh*.");
+	shared_ptr<GDxStaticVIBuffer> dxViBuffer = dynamic_pointer_cast<GDxStaticVIBuffer>(dxMesh->mVIBuffer);
+	if (dxViBuffer == nullptr)
+		ThrowGGiException("cast failed from shared_ptr<GDxVertexIndexBuffer> to shared_ptr<GDxStaticVIBuffer>.");
+
+	auto vertices = (GRiVertex*)dxViBuffer->VertexBufferCPU->GetBufferPointer();
+	UINT vertexCount = (UINT)(dxViBuffer->VertexBufferCPU->GetBufferSize() / sizeof(GRiVertex));
+
+	std::vector<float> positions(vertexCount * 3);
+	for (UINT i = 0; i < vertexCount; i++)
+	{
+		positions[i * 3 + 0] = vertices[i].Position[0];
+		positions[i * 3 + 1] = vertices[i].Position[1];
+		positions[i * 3 + 2] = vertices[i].Position[2];
+	}
+
+	std::vector<UINT> triIndices;
+	for (auto submesh : mesh->Submeshes)
+	{
+		auto startIndexLocation = submesh.second.StartIndexLocation;
+		auto baseVertexLocation = submesh.second.BaseVertexLocation;
+		for (UINT i = 0; i < submesh.second.IndexCount; i++)
+		{
+			triIndices.push_back(dxViBuffer->GetIndex(startIndexLocation + i) + baseVertexLocation);
+		}
+	}
+
+	auto bvh = std::make_shared<GRiMeshBvh>();
+	bvh->Build(std::move(positions), std::move(triIndices));
+	mesh->SetBvh(bvh);
+}
+
 void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 {
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1409,7 +1870,12 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 
 	for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
 	{
+#if USE_SPATIAL_INDEX_CULLING
+		// Objects outside of the frustum are never visited by the spatial index query.
+		so->SetCullState(CullState::FrustumCulled);
+#else
 		so->SetCullState(CullState::Visible);
+#endif
 	}
 
 	numVisible = 0;
@@ -1450,6 +1916,19 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
 	XMMATRIX invPrevViewProj = XMMatrixInverse(&XMMatrixDeterminant(prevViewProj), prevViewProj);
 
+#if USE_SPATIAL_INDEX_CULLING
+	GGiFloat4x4 cameraView = pCamera->GetView();
+	GGiFloat4x4 cameraProj = pCamera->GetProj();
+	float frustumPlanes[6][4];
+	GRiDynamicAabbTree::ExtractFrustumPlanes(cameraView * cameraProj, frustumPlanes);
+
+	mFrustumVisibleSceneObjects.clear();
+	mSpatialIndex->QueryFrustum(frustumPlanes, mFrustumVisibleSceneObjects);
+	for (auto so : mFrustumVisibleSceneObjects)
+	{
+		so->SetCullState(CullState::Visible);
+	}
+#else
 	BoundingFrustum cameraFrustum;
 #if USE_REVERSE_Z
 	BoundingFrustum::CreateFromMatrix(cameraFrustum, revProj);
@@ -1457,6 +1936,17 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 	BoundingFrustum::CreateFromMatrix(mCameraFrustum, proj);
 #endif
 
+	// Move the frustum to world space once instead of moving every object to view space.
+	BoundingFrustum worldFrustum;
+	cameraFrustum.Transform(worldFrustum, invView);
+
+	auto& store = GRiSceneStore::GetInstance();
+	float* worldBoundMins = store.GetWorldBoundMins();
+	float* worldBoundMaxs = store.GetWorldBoundMaxs();
+	float* worldSpheres = store.GetWorldSpheres();
+
+	mFrustumVisibleSceneObjects.clear();
+
 	UINT32 fcStep;
 	if (pSceneObjectLayer[(int)RenderLayer::Deferred].size() > 100)
 		fcStep = (UINT32)(pSceneObjectLayer[(int)RenderLayer::Deferred].size() / mRendererThreadPool->GetThreadNum()) + 1;
@@ -1469,20 +1959,22 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 			for (auto j = i; j < i + fcStep && j < pSceneObjectLayer[(int)RenderLayer::Deferred].size(); j++)
 			{
 				auto so = pSceneObjectLayer[(int)RenderLayer::Deferred][j];
-
-				XMMATRIX world = GDx::GGiToDxMatrix(so->GetTransform());
-
-				XMMATRIX localToView = XMMatrixMultiply(world, view);
-
-				BoundingBox bounds;
-				bounds.Center = DirectX::XMFLOAT3(so->GetMesh()->bounds.Center);
-				bounds.Extents = DirectX::XMFLOAT3(so->GetMesh()->bounds.Extents);
-
-				BoundingBox worldBounds;
-				bounds.Transform(worldBounds, localToView);
-
-				// Perform the box/frustum intersection test in local space.
-				if ((cameraFrustum.Contains(worldBounds) == DirectX::DISJOINT))
+				UINT dense = store.GetDenseIndex(so->GetHandle());
+
+				// The cheaper sphere test settles most objects, the box is only tested on the frustum border.
+				float* sphereData = worldSpheres + dense * 4;
+				BoundingSphere worldSphere(XMFLOAT3(sphereData), sphereData[3]);
+				auto sphereContainment = worldFrustum.Contains(worldSphere);
+				if (sphereContainment == DirectX::CONTAINS)
+					continue;
+
+				float* boundMin = worldBoundMins + dense * 3;
+				float* boundMax = worldBoundMaxs + dense * 3;
+				BoundingBox worldBounds(
+					XMFLOAT3((boundMin[0] + boundMax[0]) * 0.5f, (boundMin[1] + boundMax[1]) * 0.5f, (boundMin[2] + boundMax[2]) * 0.5f),
+					XMFLOAT3((boundMax[0] - boundMin[0]) * 0.5f, (boundMax[1] - boundMin[1]) * 0.5f, (boundMax[2] - boundMin[2]) * 0.5f));
+
+				if (sphereContainment == DirectX::DISJOINT || worldFrustum.Contains(worldBounds) == DirectX::DISJOINT)
 				{
 					so->SetCullState(CullState::FrustumCulled);
 				}
@@ -1493,6 +1985,13 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 
 	mRendererThreadPool->Flush();
 
+	for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
+	{
+		if (so->GetCullState() == CullState::Visible)
+			mFrustumVisibleSceneObjects.push_back(so);
+	}
+#endif
+
 	GGiCpuProfiler::GetInstance().EndCpuProfile("Frustum Culling");
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1559,34 +2058,33 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 		//GGiCpuProfiler::GetInstance().StartCpuProfile("Rasterization");
 
 		UINT32 ocStep;
-		if (pSceneObjectLayer[(int)RenderLayer::Deferred].size() > 100)
-			ocStep = (UINT32)(pSceneObjectLayer[(int)RenderLayer::Deferred].size() / mRendererThreadPool->GetThreadNum()) + 1;
+		if (mFrustumVisibleSceneObjects.size() > 100)
+			ocStep = (UINT32)(mFrustumVisibleSceneObjects.size() / mRendererThreadPool->GetThreadNum()) + 1;
 		else
 			ocStep = 100;
-		for (auto i = 0u; i < pSceneObjectLayer[(int)RenderLayer::Deferred].size(); i += ocStep)
+		for (auto i = 0u; i < mFrustumVisibleSceneObjects.size(); i += ocStep)
 		{
 			mRendererThreadPool->Enqueue([&, i]//pSceneObjectLayer, &viewProj]
 			{
-				for (auto j = i; j < i + ocStep && j < pSceneObjectLayer[(int)RenderLayer::Deferred].size(); j++)
+				for (auto j = i; j < i + ocStep && j < mFrustumVisibleSceneObjects.size(); j++)
 				{
-					auto so = pSceneObjectLayer[(int)RenderLayer::Deferred][j];
+					auto so = mFrustumVisibleSceneObjects[j];
 
 					if (so->GetCullState() == CullState::FrustumCulled)
 						continue;
 
-					XMMATRIX sceneObjectTrans = GDx::GGiToDxMatrix(so->GetTransform());
-
-					XMMATRIX worldViewProj = XMMatrixMultiply(sceneObjectTrans, viewProj);
+					// The cached world bounds are tested directly with the view projection.
+					GRiBoundingBox worldBounds = so->GetWorldBounds();
 
 #if USE_MASKED_DEPTH_BUFFER
 					auto bOccCulled = !GRiOcclusionCullingRasterizer::GetInstance().RectTestBBoxMasked(
-						so->GetMesh()->bounds,
-						worldViewProj.r
+						worldBounds,
+						viewProj.r
 					);
 #else
 					auto bOccCulled = !GRiOcclusionCullingRasterizer::GetInstance().RasterizeAndTestBBox(
-						so->GetMesh()->bounds,
-						worldViewProj.r,
+						worldBounds,
+						viewProj.r,
 						reprojectedDepthBuffer,
 						outputTest
 					);
@@ -1637,6 +2135,382 @@ void GDxRenderer::CullSceneObjects(const GGiGameTimer* gt)
 	}
 }
 
+void GDxRenderer::SortVisibleDraws(const GGiGameTimer* gt)
+{
+	GGiCpuProfiler::GetInstance().StartCpuProfile("Draw Sorting");
+
+	mSortedDrawObjects.clear();
+	mSortedDrawObjectOffsets.clear();
+
+	// Resolve the packets serially, rebuilding them is not thread safe.
+	UINT drawNum = 0;
+	for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
+	{
+		if (so->GetCullState() != CullState::Visible)
+			continue;
+
+		auto& packets = static_cast<GDxSceneObject*>(so)->GetDrawPackets();
+		if (packets.size() == 0)
+			continue;
+
+		mSortedDrawObjects.push_back(so);
+		mSortedDrawObjectOffsets.push_back(drawNum);
+		drawNum += (UINT)packets.size();
+	}
+
+	mSortedDrawPackets.resize(drawNum);
+	mSortedDrawKeys.resize(drawNum);
+	mSortedDrawOrder.resize(drawNum);
+	mSortedDrawDenseIndices.resize(drawNum);
+
+	auto& store = GRiSceneStore::GetInstance();
+	float* worldSpheres = store.GetWorldSpheres();
+	GGiFloat4x4 view = pCamera->GetView();
+	float viewZ[4] = { view.GetElement(0, 2), view.GetElement(1, 2), view.GetElement(2, 2), view.GetElement(3, 2) };
+	float nearZ = pCamera->GetNearZ();
+	float farZ = pCamera->GetFarZ();
+
+	UINT32 step;
+	if (mSortedDrawObjects.size() > 100)
+		step = (UINT32)(mSortedDrawObjects.size() / mRendererThreadPool->GetThreadNum()) + 1;
+	else
+		step = 100;
+	for (auto i = 0u; i < mSortedDrawObjects.size(); i += step)
+	{
+		mRendererThreadPool->Enqueue([&, i]
+		{
+			for (auto j = i; j < i + step && j < mSortedDrawObjects.size(); j++)
+			{
+				auto so = mSortedDrawObjects[j];
+
+				// Depth of the nearest point of the bounding sphere, objects the camera is inside sort first.
+				UINT dense = store.GetDenseIndex(so->GetHandle());
+				float* sphere = worldSpheres + dense * 4;
+				float viewDepth = sphere[0] * viewZ[0] + sphere[1] * viewZ[1] + sphere[2] * viewZ[2] + viewZ[3] - sphere[3];
+				UINT depth = GRiDrawKey::QuantizeDepth(viewDepth, nearZ, farZ);
+
+				auto& packets = static_cast<GDxSceneObject*>(so)->GetDrawPackets();
+				UINT drawIndex = mSortedDrawObjectOffsets[j];
+				for (auto& packet : packets)
+				{
+					// The deferred layer is drawn with the G-Buffer pipeline state of the vertex format.
+					UINT pso = packet.Quantization != nullptr ? 1 : 0;
+					mSortedDrawKeys[drawIndex] = GRiDrawKey::Encode((UINT)RenderLayer::Deferred, pso, packet.MeshId, packet.MaterialIndex, depth);
+					mSortedDrawOrder[drawIndex] = drawIndex;
+					mSortedDrawPackets[drawIndex] = &packet;
+					mSortedDrawDenseIndices[drawIndex] = dense;
+					drawIndex++;
+				}
+			}
+		}
+		);
+	}
+
+	mRendererThreadPool->Flush();
+
+	mDrawSorter.Sort(mRendererThreadPool.get(), mSortedDrawKeys, mSortedDrawOrder);
+
+	GGiCpuProfiler::GetInstance().EndCpuProfile("Draw Sorting");
+
+#if USE_AUTO_INSTANCING
+	BatchInstances(gt);
+#endif
+
+#if USE_MESHLET_CULLING
+	CullMeshlets(gt);
+#endif
+
+#if USE_INDIRECT_DRAWS
+	BuildIndirectDraws(gt);
+#endif
+}
+
+void GDxRenderer::BatchInstances(const GGiGameTimer* gt)
+{
+	GGiCpuProfiler::GetInstance().StartCpuProfile("Instance Batching");
+
+	// Batch keys in sorted order, so that the instances of a batch are front to back.
+	mInstanceBatchKeys.resize(mSortedDrawOrder.size());
+	for (auto i = 0u; i < mSortedDrawOrder.size(); i++)
+	{
+		auto& packet = *mSortedDrawPackets[mSortedDrawOrder[i]];
+		mInstanceBatchKeys[i] = GRiInstanceBatcher::MakeBatchKey((UINT)packet.PrimitiveTopology, packet.MeshId, packet.SubmeshIndex, packet.MaterialIndex);
+	}
+
+	mInstanceBatcher.Build(mRendererThreadPool.get(), mInstanceBatchKeys, AUTO_INSTANCING_MIN_INSTANCE_NUM, MAX_INSTANCE_NUM);
+
+	// Pack the transforms of every batched draw into the instance data of the frame.
+	auto& instanceItems = mInstanceBatcher.GetInstanceItems();
+	mInstanceAllocation = mUploadRing->AllocateArray<InstanceData>((UINT)instanceItems.size());
+	auto instances = reinterpret_cast<InstanceData*>(mInstanceAllocation.CpuAddress);
+	auto& store = GRiSceneStore::GetInstance();
+	GGiFloat4x4* worlds = store.GetWorlds();
+	GGiFloat4x4* prevWorlds = store.GetPrevWorlds();
+
+	UINT32 step;
+	if (instanceItems.size() > 100)
+		step = (UINT32)(instanceItems.size() / mRendererThreadPool->GetThreadNum()) + 1;
+	else
+		step = 100;
+	for (auto i = 0u; i < instanceItems.size(); i += step)
+	{
+		mRendererThreadPool->Enqueue([&, i]
+		{
+			for (auto j = i; j < i + step && j < instanceItems.size(); j++)
+			{
+				UINT drawIndex = mSortedDrawOrder[instanceItems[j]];
+				UINT dense = mSortedDrawDenseIndices[drawIndex];
+
+				XMMATRIX world = GDx::GGiToDxMatrix(worlds[dense]);
+				XMMATRIX prevWorld = GDx::GGiToDxMatrix(prevWorlds[dense]);
+				XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+				XMMATRIX invTransWorld = XMMatrixTranspose(invWorld);
+
+				InstanceData instanceData;
+				XMStoreFloat4x4(&instanceData.World, XMMatrixTranspose(world));
+				XMStoreFloat4x4(&instanceData.PrevWorld, XMMatrixTranspose(prevWorld));
+				XMStoreFloat4x4(&instanceData.InvTransWorld, XMMatrixTranspose(invTransWorld));
+				memcpy(&instances[j], &instanceData, sizeof(InstanceData));
+			}
+		}
+		);
+	}
+
+	mRendererThreadPool->Flush();
+
+	GGiCpuProfiler::GetInstance().EndCpuProfile("Instance Batching");
+}
+
+void GDxRenderer::CullMeshlets(const GGiGameTimer* gt)
+{
+	GGiCpuProfiler::GetInstance().StartCpuProfile("Meshlet Culling");
+
+	// The instances of a batch share one draw, so only the single draws are split into meshlets.
+#if USE_AUTO_INSTANCING
+	auto& singleItems = mInstanceBatcher.GetSingleItems();
+	UINT singleNum = (UINT)singleItems.size();
+#else
+	UINT singleNum = (UINT)mSortedDrawOrder.size();
+#endif
+
+	auto& store = GRiSceneStore::GetInstance();
+	GGiFloat4x4* worlds = store.GetWorlds();
+
+	mMeshletCuller.Reset();
+	mSingleMeshletDraws.resize(singleNum);
+	for (auto i = 0u; i < singleNum; i++)
+	{
+#if USE_AUTO_INSTANCING
+		UINT drawIndex = mSortedDrawOrder[singleItems[i]];
+#else
+		UINT drawIndex = mSortedDrawOrder[i];
+#endif
+		auto packet = mSortedDrawPackets[drawIndex];
+		if (packet->MeshletNum == 0 || packet->PrimitiveTopology != D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
+		{
+			mSingleMeshletDraws[i] = (UINT)-1;
+			continue;
+		}
+
+		auto& world = worlds[mSortedDrawDenseIndices[drawIndex]];
+		float worldElements[16];
+		for (auto r = 0; r < 4; r++)
+		{
+			for (auto c = 0; c < 4; c++)
+				worldElements[r * 4 + c] = world.GetElement(r, c);
+		}
+		mSingleMeshletDraws[i] = mMeshletCuller.AddDraw(packet->Meshlets, packet->FirstMeshlet, packet->MeshletNum, worldElements, packet->MeshletIndexOffset);
+	}
+
+	GGiFloat4x4 cameraView = pCamera->GetView();
+	GGiFloat4x4 cameraProj = pCamera->GetProj();
+	float frustumPlanes[6][4];
+	GRiDynamicAabbTree::ExtractFrustumPlanes(cameraView * cameraProj, frustumPlanes);
+	auto cameraPosition = pCamera->GetPosition();
+
+#if USE_MASKED_DEPTH_BUFFER
+	// The masked depth buffer is reprojected for this view projection in CullSceneObjects.
+	XMMATRIX viewProj = XMMatrixMultiply(GDx::GGiToDxMatrix(cameraView), GDx::GGiToDxMatrix(cameraProj));
+	mMeshletCuller.Cull(mRendererThreadPool.get(), frustumPlanes, cameraPosition.data(), mFrameCount != 0 ? &viewProj.r[0] : nullptr);
+#else
+	mMeshletCuller.Cull(mRendererThreadPool.get(), frustumPlanes, cameraPosition.data());
+#endif
+
+	auto stats = mMeshletCuller.GetStats();
+	numMeshletCulledTriangles = (int)(stats.TriangleNum - stats.VisibleTriangleNum);
+	numMeshletVisibleTriangles = (int)stats.VisibleTriangleNum;
+
+	GGiCpuProfiler::GetInstance().EndCpuProfile("Meshlet Culling");
+}
+
+void GDxRenderer::BuildIndirectDraws(const GGiGameTimer* gt)
+{
+#if USE_AUTO_INSTANCING
+	auto& singleItems = mInstanceBatcher.GetSingleItems();
+	auto& batches = mInstanceBatcher.GetBatches();
+	auto& instanceItems = mInstanceBatcher.GetInstanceItems();
+	UINT singleNum = (UINT)singleItems.size();
+	UINT batchNum = (UINT)batches.size();
+#else
+	UINT singleNum = (UINT)mSortedDrawOrder.size();
+	UINT batchNum = 0;
+#endif
+
+#if USE_MESHLET_CULLING
+	// Single draws with meshlets get a command per visible index range, none if every meshlet was culled.
+	mSingleCommandOffsets.resize(singleNum);
+	UINT singleCommandNum = 0;
+	for (auto i = 0u; i < singleNum; i++)
+	{
+		mSingleCommandOffsets[i] = singleCommandNum;
+		singleCommandNum += mSingleMeshletDraws[i] != (UINT)-1 ? mMeshletCuller.GetRangeNum(mSingleMeshletDraws[i]) : 1;
+	}
+#else
+	UINT singleCommandNum = singleNum;
+#endif
+	UINT itemNum = singleNum + batchNum;
+	UINT drawNum = singleCommandNum + batchNum;
+
+	// The argument buffer is full, DrawSortedSceneObjects records this frame instead.
+	bIndirectDrawsBuilt = drawNum <= MAX_INDIRECT_COMMAND_NUM;
+	if (!bIndirectDrawsBuilt)
+		return;
+
+	GGiCpuProfiler::GetInstance().StartCpuProfile("Indirect Argument Building");
+
+	mIndirectDraws.resize(drawNum);
+	mIndirectDrawPackets.resize(drawNum);
+	mIndirectCommandAllocation = mUploadRing->AllocateArray<IndirectCommand>(drawNum);
+
+	// Only draws in the geometry pool of their vertex format can go with the buffers bound once for the indirect submission.
+	D3D12_GPU_VIRTUAL_ADDRESS poolVertexBuffers[2] = { 0, 0 };
+	D3D12_GPU_VIRTUAL_ADDRESS poolIndexBuffers[2] = { 0, 0 };
+	for (auto k = 0; k < 2; k++)
+	{
+		auto& geometryPool = GDxGeometryPool::GetInstance(k == 1);
+		if (geometryPool.IsCreated())
+		{
+			poolVertexBuffers[k] = geometryPool.VertexBufferView().BufferLocation;
+			poolIndexBuffers[k] = geometryPool.IndexBufferView().BufferLocation;
+		}
+	}
+
+	UINT objCBByteSize = GDxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	D3D12_GPU_VIRTUAL_ADDRESS objectCBAddress = mCurrFrameResource->ObjectCB->Resource()->GetGPUVirtualAddress();
+
+	UINT32 step;
+	if (itemNum > 100)
+		step = itemNum / mRendererThreadPool->GetThreadNum() + 1;
+	else
+		step = 100;
+	for (auto i = 0u; i < itemNum; i += step)
+	{
+		mRendererThreadPool->Enqueue([&, i]
+		{
+			for (auto j = i; j < i + step && j < itemNum; j++)
+			{
+				const GDxDrawPacket* packet;
+				UINT instanceNum = 1;
+				UINT firstInstance = 0;
+				bool bInstanced = false;
+#if USE_AUTO_INSTANCING
+				if (j < singleNum)
+				{
+					packet = mSortedDrawPackets[mSortedDrawOrder[singleItems[j]]];
+				}
+				else
+				{
+					// Every instance of a batch shares the geometry and the material, the first one stands for all.
+					auto& batch = batches[j - singleNum];
+					packet = mSortedDrawPackets[mSortedDrawOrder[instanceItems[batch.FirstInstance]]];
+					instanceNum = batch.InstanceNum;
+					firstInstance = batch.FirstInstance;
+					bInstanced = true;
+				}
+#else
+				packet = mSortedDrawPackets[mSortedDrawOrder[j]];
+#endif
+
+				bool bCompressed = packet->Quantization != nullptr;
+				bool bShortIndices = packet->IndexBufferView.Format == DXGI_FORMAT_R16_UINT;
+				UINT pool = bCompressed ? 1 : 0;
+				bool bPooled = poolVertexBuffers[pool] != 0 &&
+					packet->VertexBufferView.BufferLocation == poolVertexBuffers[pool] &&
+					packet->IndexBufferView.BufferLocation == poolIndexBuffers[pool] &&
+					packet->PrimitiveTopology == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+				IndirectPipeline pipeline;
+				if (bPooled && bShortIndices)
+				{
+					if (bCompressed)
+						pipeline = bInstanced ? IndirectPipeline::ShortIndexCompressedGBufferInstanced : IndirectPipeline::ShortIndexCompressedGBuffer;
+					else
+						pipeline = bInstanced ? IndirectPipeline::ShortIndexGBufferInstanced : IndirectPipeline::ShortIndexGBuffer;
+				}
+				else if (bCompressed)
+				{
+					if (bPooled)
+						pipeline = bInstanced ? IndirectPipeline::CompressedGBufferInstanced : IndirectPipeline::CompressedGBuffer;
+					else
+						pipeline = bInstanced ? IndirectPipeline::DirectCompressedGBufferInstanced : IndirectPipeline::DirectCompressedGBuffer;
+				}
+				else
+				{
+					if (bPooled)
+						pipeline = bInstanced ? IndirectPipeline::GBufferInstanced : IndirectPipeline::GBuffer;
+					else
+						pipeline = bInstanced ? IndirectPipeline::DirectGBufferInstanced : IndirectPipeline::DirectGBuffer;
+				}
+
+#if USE_MESHLET_CULLING
+				UINT command = j < singleNum ? mSingleCommandOffsets[j] : singleCommandNum + j - singleNum;
+#else
+				UINT command = j;
+#endif
+
+				GRiIndirectDraw draw;
+				draw.PipelineIndex = (UINT)pipeline;
+				draw.ConstantBufferAddress = objectCBAddress + packet->ObjIndex * objCBByteSize;
+				draw.RootConstants[0] = packet->MaterialIndex;
+				draw.RootConstants[1] = firstInstance;
+				draw.RootConstants[2] = packet->QuantizationIndex;
+				draw.DrawArguments.IndexCountPerInstance = packet->IndexCount;
+				draw.DrawArguments.InstanceCount = instanceNum;
+				draw.DrawArguments.StartIndexLocation = packet->StartIndexLocation;
+				draw.DrawArguments.BaseVertexLocation = packet->BaseVertexLocation;
+				draw.DrawArguments.StartInstanceLocation = 0;
+
+#if USE_MESHLET_CULLING
+				if (j < singleNum && mSingleMeshletDraws[j] != (UINT)-1)
+				{
+					UINT rangeNum = mMeshletCuller.GetRangeNum(mSingleMeshletDraws[j]);
+					const UINT* ranges = mMeshletCuller.GetRanges(mSingleMeshletDraws[j]);
+					for (auto r = 0u; r < rangeNum; r++)
+					{
+						draw.DrawArguments.StartIndexLocation = ranges[r * 2];
+						draw.DrawArguments.IndexCountPerInstance = ranges[r * 2 + 1];
+						mIndirectDraws[command + r] = draw;
+						mIndirectDrawPackets[command + r] = packet;
+					}
+					continue;
+				}
+#endif
+
+				mIndirectDraws[command] = draw;
+				mIndirectDrawPackets[command] = packet;
+			}
+		}
+		);
+	}
+
+	mRendererThreadPool->Flush();
+
+	mIndirectArgumentBuilder.Build(mRendererThreadPool.get(), mIndirectDraws, (UINT)IndirectPipeline::Count,
+		mIndirectCommandAllocation.CpuAddress, drawNum);
+
+	GGiCpuProfiler::GetInstance().EndCpuProfile("Indirect Argument Building");
+}
+
 #pragma endregion
 
 #pragma region Initialization
@@ -1657,15 +2531,18 @@ void GDxRenderer::BuildRootSignature()
 		CD3DX12_DESCRIPTOR_RANGE range;
 		range.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, MAX_TEXTURE_NUM, 0);
 
-		CD3DX12_ROOT_PARAMETER gBufferRootParameters[5];
+		CD3DX12_ROOT_PARAMETER gBufferRootParameters[7];
 		gBufferRootParameters[0].InitAsConstantBufferView(0);
-		gBufferRootParameters[1].InitAsConstants(1, 0, 1);
+		// Material index, instance offset and quantization table entry.
+		gBufferRootParameters[1].InitAsConstants(3, 0, 1);
 		gBufferRootParameters[2].InitAsConstantBufferView(1);
 		gBufferRootParameters[3].InitAsDescriptorTable(1, &range, D3D12_SHADER_VISIBILITY_ALL);
 		gBufferRootParameters[4].InitAsShaderResourceView(0, 1);
+		gBufferRootParameters[5].InitAsShaderResourceView(1, 1);
+		gBufferRootParameters[6].InitAsShaderResourceView(2, 1);
 
 		// A root signature is an array of root parameters.
-		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, gBufferRootParameters,
+		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, gBufferRootParameters,
 			0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 		CD3DX12_STATIC_SAMPLER_DESC StaticSamplers[2];
@@ -1848,16 +2725,20 @@ void GDxRenderer::BuildRootSignature()
 		CD3DX12_DESCRIPTOR_RANGE rangeDepth;
 		rangeDepth.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, (UINT)1, 2);
 
-		CD3DX12_ROOT_PARAMETER gScreenSpaceShadowRootParameters[6];
-		gScreenSpaceShadowRootParameters[0].InitAsConstants(1, 0);
+		CD3DX12_ROOT_PARAMETER gScreenSpaceShadowRootParameters[10];
+		gScreenSpaceShadowRootParameters[0].InitAsConstants(sizeof(SdfTileConstants) / 4, 0);
 		gScreenSpaceShadowRootParameters[1].InitAsShaderResourceView(0, 0);
 		gScreenSpaceShadowRootParameters[2].InitAsShaderResourceView(1, 0);
 		gScreenSpaceShadowRootParameters[3].InitAsDescriptorTable(1, &rangeDepth, D3D12_SHADER_VISIBILITY_ALL);
 		gScreenSpaceShadowRootParameters[4].InitAsDescriptorTable(1, &range, D3D12_SHADER_VISIBILITY_ALL);
 		gScreenSpaceShadowRootParameters[5].InitAsConstantBufferView(1);
+		gScreenSpaceShadowRootParameters[6].InitAsShaderResourceView(3, 0);
+		gScreenSpaceShadowRootParameters[7].InitAsShaderResourceView(4, 0);
+		gScreenSpaceShadowRootParameters[8].InitAsConstants(sizeof(SdfClipmapConstants) / 4, 2);
+		gScreenSpaceShadowRootParameters[9].InitAsShaderResourceView(5, 0);
 
 		// A root signature is an array of root parameters.
-		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, gScreenSpaceShadowRootParameters,
+		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(10, gScreenSpaceShadowRootParameters,
 			0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 		CD3DX12_STATIC_SAMPLER_DESC StaticSamplers[2];
@@ -1911,7 +2792,7 @@ void GDxRenderer::BuildRootSignature()
 		CD3DX12_DESCRIPTOR_RANGE rangeIBL;
 		rangeIBL.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, (UINT)mPrefilterLevels + (UINT)1 + (UINT)1, mRtvHeaps["GBuffer"]->mRtvHeap.HeapDesc.NumDescriptors + 3);
 
-		CD3DX12_ROOT_PARAMETER gLightPassRootParameters[7];
+		CD3DX12_ROOT_PARAMETER gLightPassRootParameters[9];
 		gLightPassRootParameters[0].InitAsConstantBufferView(0);
 		gLightPassRootParameters[1].InitAsConstantBufferView(1);
 		gLightPassRootParameters[2].InitAsDescriptorTable(1, &rangeUav, D3D12_SHADER_VISIBILITY_ALL);
@@ -1919,9 +2800,11 @@ void GDxRenderer::BuildRootSignature()
 		gLightPassRootParameters[4].InitAsDescriptorTable(1, &rangeDepth, D3D12_SHADER_VISIBILITY_ALL);
 		gLightPassRootParameters[5].InitAsDescriptorTable(1, &rangeShadow, D3D12_SHADER_VISIBILITY_ALL);
 		gLightPassRootParameters[6].InitAsDescriptorTable(1, &rangeIBL, D3D12_SHADER_VISIBILITY_ALL);
+		gLightPassRootParameters[7].InitAsShaderResourceView(0, 1);
+		gLightPassRootParameters[8].InitAsShaderResourceView(1, 1);
 
 		// A root signature is an array of root parameters.
-		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, gLightPassRootParameters,
+		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(9, gLightPassRootParameters,
 			0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 		CD3DX12_STATIC_SAMPLER_DESC StaticSamplers[2];
@@ -2690,6 +3573,19 @@ void GDxRenderer::BuildPSOs()
 		gBufferPsoDesc.SampleDesc.Count = 1;// don't use msaa in deferred rendering.
 		//deferredPSO = sysRM->CreatePSO(StringID("deferredPSO"), descPipelineState);
 		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&gBufferPsoDesc, IID_PPV_ARGS(&mPSOs["GBuffer"])));
+
+		// Same state, the transforms come from the instance buffer instead of the object constants.
+		gBufferPsoDesc.VS = GDxShaderManager::LoadShader(L"Shaders\\InstancedDefaultVS.cso");
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&gBufferPsoDesc, IID_PPV_ARGS(&mPSOs["GBufferInstanced"])));
+
+		// Both again for meshes with compressed vertices.
+		gBufferPsoDesc.InputLayout.pInputElementDescs = GDxInputLayout::CompressedLayout;
+		gBufferPsoDesc.InputLayout.NumElements = _countof(GDxInputLayout::CompressedLayout);
+		gBufferPsoDesc.VS = GDxShaderManager::LoadShader(L"Shaders\\CompressedDefaultVS.cso");
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&gBufferPsoDesc, IID_PPV_ARGS(&mPSOs["GBufferCompressed"])));
+
+		gBufferPsoDesc.VS = GDxShaderManager::LoadShader(L"Shaders\\CompressedInstancedDefaultVS.cso");
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&gBufferPsoDesc, IID_PPV_ARGS(&mPSOs["GBufferInstancedCompressed"])));
 	}
 
 	// PSO for depth downsample pass
@@ -3178,6 +4074,40 @@ void GDxRenderer::BuildPSOs()
 
 }
 
+void GDxRenderer::BuildCommandSignatures()
+{
+	static_assert(sizeof(GRiDrawIndexedArguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS), "Draw argument layouts don't match.");
+
+	// G-Buffer command signature
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argumentDescs[3] = {};
+		argumentDescs[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+		argumentDescs[0].ConstantBufferView.RootParameterIndex = 0;
+		// Material index, instance offset and quantization table entry.
+		argumentDescs[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+		argumentDescs[1].Constant.RootParameterIndex = 1;
+		argumentDescs[1].Constant.DestOffsetIn32BitValues = 0;
+		argumentDescs[1].Constant.Num32BitValuesToSet = 3;
+		argumentDescs[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+		D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+		commandSignatureDesc.ByteStride = sizeof(IndirectCommand);
+		commandSignatureDesc.NumArgumentDescs = _countof(argumentDescs);
+		commandSignatureDesc.pArgumentDescs = argumentDescs;
+
+		ThrowIfFailed(md3dDevice->CreateCommandSignature(&commandSignatureDesc, mRootSignatures["GBuffer"].Get(),
+			IID_PPV_ARGS(mCommandSignatures["GBuffer"].GetAddressOf())));
+
+		GRiIndirectCommandLayout layout;
+		layout.Stride = sizeof(IndirectCommand);
+		layout.ConstantBufferOffset = offsetof(IndirectCommand, ObjectCbv);
+		layout.RootConstantOffset = offsetof(IndirectCommand, RootConstants);
+		layout.RootConstantNum = 3;
+		layout.DrawArgumentsOffset = offsetof(IndirectCommand, DrawArguments);
+		mIndirectArgumentBuilder.SetLayout(layout);
+	}
+}
+
 void GDxRenderer::BuildFrameResources()
 {
 	for (int i = 0; i < NUM_FRAME_RESOURCES; ++i)
@@ -3186,6 +4116,8 @@ void GDxRenderer::BuildFrameResources()
 			2, MAX_SCENE_OBJECT_NUM, MAX_MATERIAL_NUM));//(UINT)pSceneObjects.size(), (UINT)pMaterials.size()));
 	}
 
+	mUploadRing = std::make_unique<GDxUploadRingBuffer>(md3dDevice.Get(), UPLOAD_RING_SIZE);
+
 	for (auto i = 0u; i < (6 * mPrefilterLevels); i++)
 	{
 		PreIntegrationPassCbs.push_back(std::make_unique<GDxUploadBuffer<SkyPassConstants>>(md3dDevice.Get(), 1, true));
@@ -3400,6 +4332,19 @@ void GDxRenderer::CreateCommandObjects()
 	// to the command list we will Reset it, and it needs to be closed before
 	// calling Reset.
 	mCommandList->Close();
+
+	// Worker lists for parallel recording, reset with the allocators of the current frame resource.
+	mWorkerCommandLists.resize(MAX_RECORDING_LIST_NUM);
+	for (auto i = 0u; i < MAX_RECORDING_LIST_NUM; i++)
+	{
+		ThrowIfFailed(md3dDevice->CreateCommandList(
+			0,
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			mDirectCmdListAlloc.Get(),
+			nullptr,
+			IID_PPV_ARGS(mWorkerCommandLists[i].GetAddressOf())));
+		mWorkerCommandLists[i]->Close();
+	}
 }
 
 void GDxRenderer::CreateSwapChain()
@@ -3463,57 +4408,499 @@ void GDxRenderer::InitializeGpuProfiler()
 
 void GDxRenderer::DrawSceneObjects(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, bool bSetObjCb, bool bSetSubmeshCb, bool bCheckCullState)
 {
+	// Deferred objects are drawn with the G-Buffer pipeline state bound, or the compressed one for compressed vertices.
+	bool bCompressedBound = false;
+
 	// For each render item...
 	for (size_t i = 0; i < pSceneObjectLayer[((int)layer)].size(); ++i)
 	{
 		auto sObject = pSceneObjectLayer[((int)layer)][i];
 		if (!bCheckCullState || (bCheckCullState && (sObject->GetCullState() == CullState::Visible)))
+		{
+			if (layer == RenderLayer::Deferred)
+			{
+				auto& packets = static_cast<GDxSceneObject*>(sObject)->GetDrawPackets();
+				bool bCompressed = packets.size() > 0 && packets[0].Quantization != nullptr;
+				if (bCompressed != bCompressedBound)
+				{
+					cmdList->SetPipelineState(mPSOs[bCompressed ? "GBufferCompressed" : "GBuffer"].Get());
+					bCompressedBound = bCompressed;
+				}
+			}
 			DrawSceneObject(cmdList, sObject, bSetObjCb, bSetSubmeshCb);
+		}
 	}
+
+	if (bCompressedBound)
+		cmdList->SetPipelineState(mPSOs["GBuffer"].Get());
 }
 
 void GDxRenderer::DrawSceneObject(ID3D12GraphicsCommandList* cmdList, GRiSceneObject* sObject, bool bSetObjCb, bool bSetSubmeshCb, bool bCheckCullState)
 {
-	GDxSceneObject* dxSO = dynamic_cast<GDxSceneObject*>(sObject);
-	if (dxSO == NULL)
-	{
-		ThrowGGiException("Cast failed : from GRiSceneObject* to GDxSceneObject*.")
-	}
-
-	GDxMesh* dxMesh = dynamic_cast<GDxMesh*>(sObject->GetMesh());
-	if (dxMesh == NULL)
-	{
-		ThrowGGiException("Cast failed : from GRiMesh* to GDxMesh*.")
-	}
+	// Every scene object is created by the GDx renderer factory.
+	auto& packets = static_cast<GDxSceneObject*>(sObject)->GetDrawPackets();
+	if (packets.size() == 0)
+		return;
 
-	cmdList->IASetVertexBuffers(0, 1, &dxMesh->mVIBuffer->VertexBufferView());
-	cmdList->IASetIndexBuffer(&dxMesh->mVIBuffer->IndexBufferView());
-	cmdList->IASetPrimitiveTopology(dxSO->GetPrimitiveTopology());
+	// All packets of an object share its buffers, topology and constants.
+	auto& first = packets[0];
+	cmdList->IASetVertexBuffers(0, 1, &first.VertexBufferView);
+	cmdList->IASetIndexBuffer(&first.IndexBufferView);
+	cmdList->IASetPrimitiveTopology(first.PrimitiveTopology);
 
 	if (bSetObjCb)
 	{
 		UINT objCBByteSize = GDxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 		auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + sObject->GetObjIndex() * objCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + first.ObjIndex * objCBByteSize;
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 	}
 
 	if (!bCheckCullState || (bCheckCullState && (sObject->GetCullState() == CullState::Visible)))
 	{
-		//cmdList->DrawIndexedInstanced(dxMesh->mVIBuffer->IndexCount, 1, 0, 0, 0);
-		for (auto& submesh : dxMesh->Submeshes)
+		for (auto& packet : packets)
 		{
 			if (bSetSubmeshCb)
 			{
-				auto overrideMat = dxSO->GetOverrideMaterial(submesh.first);
-				if (overrideMat != nullptr)
-					cmdList->SetGraphicsRoot32BitConstants(1, 1, &(overrideMat->MatIndex), 0);
-				else
-					cmdList->SetGraphicsRoot32BitConstants(1, 1, &(submesh.second.GetMaterial()->MatIndex), 0);
+				cmdList->SetGraphicsRoot32BitConstants(1, 1, &packet.MaterialIndex, 0);
+				// Only the G-Buffer pipeline states read compressed vertices.
+				if (packet.Quantization != nullptr)
+					cmdList->SetGraphicsRoot32BitConstants(1, 1, &packet.QuantizationIndex, 2);
+			}
+			cmdList->DrawIndexedInstanced(packet.IndexCount, 1, packet.StartIndexLocation, packet.BaseVertexLocation, 0);
+		}
+	}
+}
+
+void GDxRenderer::DrawSortedSceneObjects(ID3D12GraphicsCommandList* cmdList, bool bSetObjCb, bool bSetSubmeshCb)
+{
+	GDxSortedDrawStats stats;
+	DrawSortedSceneObjectRange(cmdList, 0, GetSortedDrawItemNum(), bSetObjCb, bSetSubmeshCb, stats);
+
+	numDraws = stats.Draws;
+	numStateChanges = stats.StateChanges;
+	numInstancedDraws = stats.InstancedDraws;
+	numInstances = stats.Instances;
+
+	// DrawSceneObject binds the buffers, topology and object constants once per object and the material per draw.
+	int unsortedStateChanges = (int)mSortedDrawObjects.size() * (bSetObjCb ? 4 : 3) + (bSetSubmeshCb ? (int)mSortedDrawOrder.size() : 0);
+	numStateChangesSaved = unsortedStateChanges - numStateChanges;
+}
+
+UINT GDxRenderer::GetSortedDrawItemNum()
+{
+#if USE_AUTO_INSTANCING
+	return (UINT)(mInstanceBatcher.GetSingleItems().size() + mInstanceBatcher.GetBatches().size());
+#else
+	return (UINT)mSortedDrawOrder.size();
+#endif
+}
+
+void GDxRenderer::DrawSortedSceneObjectRange(ID3D12GraphicsCommandList* cmdList, UINT firstItem, UINT itemNum, bool bSetObjCb, bool bSetSubmeshCb, GDxSortedDrawStats& stats)
+{
+	UINT objCBByteSize = GDxUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+
+	// Only bind what differs from the previous draw, sorted draws share buffers and materials in runs.
+	D3D12_GPU_VIRTUAL_ADDRESS lastVertexBuffer = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS lastIndexBuffer = 0;
+	DXGI_FORMAT lastIndexFormat = DXGI_FORMAT_UNKNOWN;
+	D3D12_PRIMITIVE_TOPOLOGY lastTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	UINT lastObjIndex = (UINT)-1;
+	UINT lastMaterialIndex = (UINT)-1;
+	UINT lastQuantizationIndex = (UINT)-1;
+
+	// The G-Buffer pipeline state is bound, other vertex formats and instancing switch it. Looked up with find,
+	// worker threads may record ranges at the same time.
+	ID3D12PipelineState* gBufferPso = mPSOs.find("GBuffer")->second.Get();
+	ID3D12PipelineState* singlePsos[2] = { gBufferPso, mPSOs.find("GBufferCompressed")->second.Get() };
+	ID3D12PipelineState* lastPso = gBufferPso;
+
+	// Items are the draws left out of the instance batches in sorted order, then the batches.
+#if USE_AUTO_INSTANCING
+	auto& singleItems = mInstanceBatcher.GetSingleItems();
+	UINT singleNum = (UINT)singleItems.size();
+#else
+	UINT singleNum = (UINT)mSortedDrawOrder.size();
+#endif
+	UINT endItem = firstItem + itemNum;
+
+	for (auto i = firstItem; i < endItem && i < singleNum; i++)
+	{
+#if USE_AUTO_INSTANCING
+		auto& packet = *mSortedDrawPackets[mSortedDrawOrder[singleItems[i]]];
+#else
+		auto& packet = *mSortedDrawPackets[mSortedDrawOrder[i]];
+#endif
+
+#if USE_MESHLET_CULLING
+		// Every meshlet of the draw was culled.
+		UINT meshletDraw = mSingleMeshletDraws[i];
+		if (meshletDraw != (UINT)-1 && mMeshletCuller.GetRangeNum(meshletDraw) == 0)
+			continue;
+#endif
+
+		ID3D12PipelineState* pso = singlePsos[packet.Quantization != nullptr ? 1 : 0];
+		if (pso != lastPso)
+		{
+			cmdList->SetPipelineState(pso);
+			lastPso = pso;
+			stats.StateChanges++;
+		}
+
+		if (packet.VertexBufferView.BufferLocation != lastVertexBuffer)
+		{
+			cmdList->IASetVertexBuffers(0, 1, &packet.VertexBufferView);
+			lastVertexBuffer = packet.VertexBufferView.BufferLocation;
+			stats.StateChanges++;
+		}
+
+		// The geometry pool views its index buffer with either format.
+		if (packet.IndexBufferView.BufferLocation != lastIndexBuffer || packet.IndexBufferView.Format != lastIndexFormat)
+		{
+			cmdList->IASetIndexBuffer(&packet.IndexBufferView);
+			lastIndexBuffer = packet.IndexBufferView.BufferLocation;
+			lastIndexFormat = packet.IndexBufferView.Format;
+			stats.StateChanges++;
+		}
+
+		if (packet.PrimitiveTopology != lastTopology)
+		{
+			cmdList->IASetPrimitiveTopology(packet.PrimitiveTopology);
+			lastTopology = packet.PrimitiveTopology;
+			stats.StateChanges++;
+		}
+
+		if (bSetObjCb && packet.ObjIndex != lastObjIndex)
+		{
+			D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + packet.ObjIndex * objCBByteSize;
+			cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+			lastObjIndex = packet.ObjIndex;
+			stats.StateChanges++;
+		}
+
+		if (bSetSubmeshCb && packet.MaterialIndex != lastMaterialIndex)
+		{
+			cmdList->SetGraphicsRoot32BitConstants(1, 1, &packet.MaterialIndex, 0);
+			lastMaterialIndex = packet.MaterialIndex;
+			stats.StateChanges++;
+		}
+
+		if (bSetSubmeshCb && packet.Quantization != nullptr && packet.QuantizationIndex != lastQuantizationIndex)
+		{
+			cmdList->SetGraphicsRoot32BitConstants(1, 1, &packet.QuantizationIndex, 2);
+			lastQuantizationIndex = packet.QuantizationIndex;
+			stats.StateChanges++;
+		}
+
+#if USE_MESHLET_CULLING
+		if (meshletDraw != (UINT)-1)
+		{
+			UINT rangeNum = mMeshletCuller.GetRangeNum(meshletDraw);
+			const UINT* ranges = mMeshletCuller.GetRanges(meshletDraw);
+			for (auto r = 0u; r < rangeNum; r++)
+				cmdList->DrawIndexedInstanced(ranges[r * 2 + 1], 1, ranges[r * 2], packet.BaseVertexLocation, 0);
+			stats.Draws += rangeNum;
+			continue;
+		}
+#endif
+
+		cmdList->DrawIndexedInstanced(packet.IndexCount, 1, packet.StartIndexLocation, packet.BaseVertexLocation, 0);
+		stats.Draws++;
+	}
+
+#if USE_AUTO_INSTANCING
+	auto& batches = mInstanceBatcher.GetBatches();
+	auto& instanceItems = mInstanceBatcher.GetInstanceItems();
+	UINT firstBatch = firstItem > singleNum ? firstItem - singleNum : 0;
+	UINT endBatch = endItem > singleNum ? endItem - singleNum : 0;
+	ID3D12PipelineState* instancedPsos[2] = { mPSOs.find("GBufferInstanced")->second.Get(), mPSOs.find("GBufferInstancedCompressed")->second.Get() };
+
+	for (auto b = firstBatch; b < endBatch; b++)
+	{
+		auto& batch = batches[b];
+
+		// Every instance of a batch shares the geometry and the material, the first one stands for all.
+		auto& packet = *mSortedDrawPackets[mSortedDrawOrder[instanceItems[batch.FirstInstance]]];
+
+		ID3D12PipelineState* pso = instancedPsos[packet.Quantization != nullptr ? 1 : 0];
+		if (pso != lastPso)
+		{
+			cmdList->SetPipelineState(pso);
+			lastPso = pso;
+			stats.StateChanges++;
+		}
+
+		if (packet.VertexBufferView.BufferLocation != lastVertexBuffer)
+		{
+			cmdList->IASetVertexBuffers(0, 1, &packet.VertexBufferView);
+			lastVertexBuffer = packet.VertexBufferView.BufferLocation;
+			stats.StateChanges++;
+		}
+
+		if (packet.IndexBufferView.BufferLocation != lastIndexBuffer || packet.IndexBufferView.Format != lastIndexFormat)
+		{
+			cmdList->IASetIndexBuffer(&packet.IndexBufferView);
+			lastIndexBuffer = packet.IndexBufferView.BufferLocation;
+			lastIndexFormat = packet.IndexBufferView.Format;
+			stats.StateChanges++;
+		}
+
+		if (packet.PrimitiveTopology != lastTopology)
+		{
+			cmdList->IASetPrimitiveTopology(packet.PrimitiveTopology);
+			lastTopology = packet.PrimitiveTopology;
+			stats.StateChanges++;
+		}
+
+		UINT batchConstants[3] = { packet.MaterialIndex, batch.FirstInstance, packet.QuantizationIndex };
+		cmdList->SetGraphicsRoot32BitConstants(1, 3, batchConstants, 0);
+		stats.StateChanges++;
+
+		cmdList->DrawIndexedInstanced(packet.IndexCount, batch.InstanceNum, packet.StartIndexLocation, packet.BaseVertexLocation, 0);
+		stats.Draws++;
+		stats.InstancedDraws++;
+		stats.Instances += batch.InstanceNum;
+	}
+#endif
+
+	if (lastPso != gBufferPso)
+		cmdList->SetPipelineState(gBufferPso);
+}
+
+void GDxRenderer::SetGBufferPassState(ID3D12GraphicsCommandList* cmdList)
+{
+	// Looked up with find, worker threads may set up their lists at the same time.
+	auto& gBufferRtvHeap = mRtvHeaps.find("GBuffer")->second;
+
+	cmdList->RSSetViewports(1, &(gBufferRtvHeap->mRtv[0]->mViewport));
+	cmdList->RSSetScissorRects(1, &(gBufferRtvHeap->mRtv[0]->mScissorRect));
+
+	cmdList->SetGraphicsRootSignature(mRootSignatures.find("GBuffer")->second.Get());
+
+	cmdList->SetPipelineState(mPSOs.find("GBuffer")->second.Get());
+
+	auto passCB = mCurrFrameResource->PassCB->Resource();
+	cmdList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+
+	cmdList->SetGraphicsRootDescriptorTable(3, GetGpuSrv(mTextrueHeapIndex));
+
+	auto matBuffer = mCurrFrameResource->MaterialBuffer->Resource();
+	cmdList->SetGraphicsRootShaderResourceView(4, matBuffer->GetGPUVirtualAddress());
+
+	// Nothing was batched yet without auto instancing, the ring stands in for the unused instance data.
+	D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = mInstanceAllocation.GpuAddress;
+	if (instanceAddress == 0)
+		instanceAddress = mUploadRing->Resource()->GetGPUVirtualAddress();
+	cmdList->SetGraphicsRootShaderResourceView(5, instanceAddress);
+
+	cmdList->SetGraphicsRootShaderResourceView(6, mQuantizationAllocation.GpuAddress);
+
+	cmdList->OMSetStencilRef(1);
+
+	// Specify the buffers we are going to render to.
+	auto dsv = DepthStencilView();
+	cmdList->OMSetRenderTargets(gBufferRtvHeap->mRtvHeap.HeapDesc.NumDescriptors, &(gBufferRtvHeap->mRtvHeap.hCPUHeapStart), true, &dsv);
+}
+
+bool GDxRenderer::RecordGBufferDrawsInParallel()
+{
+	UINT maxListNum = (UINT)mRendererThreadPool->GetThreadNum();
+	if (maxListNum > MAX_RECORDING_LIST_NUM)
+		maxListNum = MAX_RECORDING_LIST_NUM;
+
+	numRecordingLists = 1;
+
+	// Items are the indirect commands if they were built, the sorted draws otherwise.
+	UINT itemNum = GetSortedDrawItemNum();
+#if USE_INDIRECT_DRAWS
+	if (bIndirectDrawsBuilt)
+		itemNum = (UINT)mIndirectArgumentBuilder.GetCommandDraws().size();
+#endif
+
+	mGBufferListScheduler.Schedule(itemNum, maxListNum, PARALLEL_RECORDING_MIN_DRAW_NUM);
+	UINT listNum = mGBufferListScheduler.GetListNum();
+	if (listNum < 2)
+		return false;
+
+	// What the main list holds so far goes to the queue ahead of the worker lists.
+	ThrowIfFailed(mCommandList->Close());
+
+	for (auto i = 0u; i < listNum; i++)
+		mWorkerDrawStats[i] = GDxSortedDrawStats();
+
+	mGBufferListRecorder.pRenderer = this;
+	mGBufferListScheduler.Record(mRendererThreadPool.get(), &mGBufferListRecorder);
+
+	std::vector<ID3D12CommandList*> cmdsLists;
+	cmdsLists.push_back(mCommandList.Get());
+	for (auto i = 0u; i < listNum; i++)
+		cmdsLists.push_back(mWorkerCommandLists[i].Get());
+	mCommandQueue->ExecuteCommandLists((UINT)cmdsLists.size(), cmdsLists.data());
+
+	// The main list carries on with the rest of the frame, its allocator keeps the submitted commands alive.
+	ThrowIfFailed(mCommandList->Reset(mCurrFrameResource->CmdListAlloc.Get(), nullptr));
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	numDraws = 0;
+	numStateChanges = 0;
+	numInstancedDraws = 0;
+	numInstances = 0;
+	numIndirectCommands = 0;
+	numExecuteIndirects = 0;
+	for (auto i = 0u; i < listNum; i++)
+	{
+		numDraws += mWorkerDrawStats[i].Draws;
+		numStateChanges += mWorkerDrawStats[i].StateChanges;
+		numInstancedDraws += mWorkerDrawStats[i].InstancedDraws;
+		numInstances += mWorkerDrawStats[i].Instances;
+		numIndirectCommands += mWorkerDrawStats[i].IndirectCommands;
+		numExecuteIndirects += mWorkerDrawStats[i].ExecuteIndirects;
+	}
+	numRecordingLists = (int)listNum;
+
+	return true;
+}
+
+void GDxRenderer::GBufferListRecorder::BeginList(UINT listIndex)
+{
+	auto cmdListAlloc = pRenderer->mCurrFrameResource->WorkerCmdListAllocs[listIndex];
+	auto cmdList = pRenderer->mWorkerCommandLists[listIndex].Get();
+
+	// Every worker list is recorded once per frame, so the allocator is free to reset here.
+	ThrowIfFailed(cmdListAlloc->Reset());
+	ThrowIfFailed(cmdList->Reset(cmdListAlloc.Get(), pRenderer->mPSOs.find("GBuffer")->second.Get()));
+
+	ID3D12DescriptorHeap* descriptorHeaps[] = { pRenderer->mSrvDescriptorHeap.Get() };
+	cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+	pRenderer->SetGBufferPassState(cmdList);
+}
+
+void GDxRenderer::GBufferListRecorder::RecordItems(UINT listIndex, UINT firstItem, UINT itemNum)
+{
+	auto cmdList = pRenderer->mWorkerCommandLists[listIndex].Get();
+	auto& stats = pRenderer->mWorkerDrawStats[listIndex];
+#if USE_INDIRECT_DRAWS
+	if (pRenderer->bIndirectDrawsBuilt)
+	{
+		pRenderer->DrawIndirectSceneObjectRange(cmdList, firstItem, itemNum, stats);
+		return;
+	}
+#endif
+	pRenderer->DrawSortedSceneObjectRange(cmdList, firstItem, itemNum, true, true, stats);
+}
+
+void GDxRenderer::GBufferListRecorder::EndList(UINT listIndex)
+{
+	ThrowIfFailed(pRenderer->mWorkerCommandLists[listIndex]->Close());
+}
+
+void GDxRenderer::DrawIndirectSceneObjects(ID3D12GraphicsCommandList* cmdList)
+{
+	GDxSortedDrawStats stats;
+	DrawIndirectSceneObjectRange(cmdList, 0, (UINT)mIndirectArgumentBuilder.GetCommandDraws().size(), stats);
+
+	numDraws = stats.Draws;
+	numStateChanges = stats.StateChanges;
+	numInstancedDraws = stats.InstancedDraws;
+	numInstances = stats.Instances;
+	numIndirectCommands = stats.IndirectCommands;
+	numExecuteIndirects = stats.ExecuteIndirects;
+	numRecordingLists = 1;
+}
+
+void GDxRenderer::DrawIndirectSceneObjectRange(ID3D12GraphicsCommandList* cmdList, UINT firstCommand, UINT commandNum, GDxSortedDrawStats& stats)
+{
+	// Looked up with find, worker threads may record their ranges at the same time.
+	auto argumentBuffer = mUploadRing->Resource();
+	auto commandSignature = mCommandSignatures.find("GBuffer")->second.Get();
+	auto& commandDraws = mIndirectArgumentBuilder.GetCommandDraws();
+	UINT endCommand = firstCommand + commandNum;
+
+	// Geometry pool and index format whose buffers are bound, -1 for none.
+	int boundPool = -1;
+	for (auto& range : mIndirectArgumentBuilder.GetRanges())
+	{
+		// Only the part of the pipeline range inside [firstCommand, endCommand) is recorded here.
+		UINT rangeFirst = max(range.FirstCommand, firstCommand);
+		UINT rangeEnd = min(range.FirstCommand + range.CommandNum, endCommand);
+		if (rangeFirst >= rangeEnd)
+			continue;
+		UINT rangeNum = rangeEnd - rangeFirst;
+
+		auto pipeline = (IndirectPipeline)range.PipelineIndex;
+		bool bInstanced = pipeline == IndirectPipeline::GBufferInstanced || pipeline == IndirectPipeline::DirectGBufferInstanced ||
+			pipeline == IndirectPipeline::CompressedGBufferInstanced || pipeline == IndirectPipeline::DirectCompressedGBufferInstanced ||
+			pipeline == IndirectPipeline::ShortIndexGBufferInstanced || pipeline == IndirectPipeline::ShortIndexCompressedGBufferInstanced;
+		bool bPooled = pipeline != IndirectPipeline::DirectGBuffer && pipeline != IndirectPipeline::DirectGBufferInstanced &&
+			pipeline != IndirectPipeline::DirectCompressedGBuffer && pipeline != IndirectPipeline::DirectCompressedGBufferInstanced;
+
+		// Every command of a range shares the vertex and index formats, the first one stands for all.
+		auto firstPacket = mIndirectDrawPackets[commandDraws[rangeFirst]];
+		bool bCompressed = firstPacket->Quantization != nullptr;
+		DXGI_FORMAT indexFormat = firstPacket->IndexBufferView.Format;
+
+		if (bCompressed)
+			cmdList->SetPipelineState(mPSOs.find(bInstanced ? "GBufferInstancedCompressed" : "GBufferCompressed")->second.Get());
+		else
+			cmdList->SetPipelineState(mPSOs.find(bInstanced ? "GBufferInstanced" : "GBuffer")->second.Get());
+		stats.StateChanges++;
+
+		if (bPooled)
+		{
+			// Every command of the range draws from the shared buffers, the signature sets the rest.
+			int pool = (bCompressed ? 2 : 0) + (indexFormat == DXGI_FORMAT_R16_UINT ? 1 : 0);
+			if (boundPool != pool)
+			{
+				auto& geometryPool = GDxGeometryPool::GetInstance(bCompressed);
+				D3D12_VERTEX_BUFFER_VIEW vertexBufferView = geometryPool.VertexBufferView();
+				D3D12_INDEX_BUFFER_VIEW indexBufferView = geometryPool.IndexBufferView(indexFormat);
+				cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+				cmdList->IASetIndexBuffer(&indexBufferView);
+				cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+				boundPool = pool;
+				stats.StateChanges += 3;
+			}
+
+			cmdList->ExecuteIndirect(commandSignature, rangeNum, argumentBuffer,
+				mIndirectCommandAllocation.Offset + (UINT64)rangeFirst * sizeof(IndirectCommand), nullptr, 0);
+			stats.IndirectCommands += rangeNum;
+			stats.ExecuteIndirects++;
+		}
+		else
+		{
+			for (auto c = rangeFirst; c < rangeEnd; c++)
+			{
+				auto& draw = mIndirectDraws[commandDraws[c]];
+				auto packet = mIndirectDrawPackets[commandDraws[c]];
+
+				cmdList->IASetVertexBuffers(0, 1, &packet->VertexBufferView);
+				cmdList->IASetIndexBuffer(&packet->IndexBufferView);
+				cmdList->IASetPrimitiveTopology(packet->PrimitiveTopology);
+				cmdList->SetGraphicsRootConstantBufferView(0, draw.ConstantBufferAddress);
+				cmdList->SetGraphicsRoot32BitConstants(1, 3, draw.RootConstants, 0);
+				stats.StateChanges += 5;
+
+				auto& args = draw.DrawArguments;
+				cmdList->DrawIndexedInstanced(args.IndexCountPerInstance, args.InstanceCount, args.StartIndexLocation, args.BaseVertexLocation, args.StartInstanceLocation);
 			}
-			cmdList->DrawIndexedInstanced(submesh.second.IndexCount, 1, submesh.second.StartIndexLocation, submesh.second.BaseVertexLocation, 0);
+			// Pool buffers have to be bound again for a later indirect range.
+			boundPool = -1;
+		}
+
+		stats.Draws += rangeNum;
+		if (bInstanced)
+		{
+			stats.InstancedDraws += rangeNum;
+			for (auto c = rangeFirst; c < rangeEnd; c++)
+				stats.Instances += mIndirectDraws[commandDraws[c]].DrawArguments.InstanceCount;
 		}
 	}
+
+	cmdList->SetPipelineState(mPSOs.find("GBuffer")->second.Get());
 }
 
 #pragma endregion
@@ -3565,112 +4952,25 @@ GRiSceneObject* GDxRenderer::SelectSceneObject(int sx, int sy)
 	XMMATRIX dxView = GDx::GGiToDxMatrix(pCamera->GetView());
 	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(dxView), dxView);
 
-	GRiSceneObject* pickedSceneObject = nullptr;
-	float tPicked = GGiEngineUtil::Infinity;
-
-	// Check if we picked an opaque render item.  A real app might keep a separate "picking list"
-	// of objects that can be selected.   
-	for (auto so : pSceneObjectLayer[(int)RenderLayer::Deferred])
-	{
-		auto mesh = so->GetMesh();
-
-		XMMATRIX W = GDx::GGiToDxMatrix(so->GetTransform());
-
-		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
-
-		// Tranform ray to vi space of Mesh.
-		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
-
-		XMVECTOR rayOrigin = XMVector3TransformCoord(viewRayOrigin, toLocal);
-		XMVECTOR rayDir = XMVector3TransformNormal(viewRayDir, toLocal);
-
-		// Make the ray direction unit length for the intersection tests.
-		rayDir = XMVector3Normalize(rayDir);
-
-		// If we hit the bounding box of the Mesh, then we might have picked a Mesh triangle,
-		// so do the ray/triangle tests.
-		//
-		// If we did not hit the bounding box, then it is impossible that we hit 
-		// the Mesh, so do not waste effort doing ray/triangle tests.
-		BoundingBox bBox;
-		bBox.Center.x = /*so->GetLocation()[0] +*/ so->GetMesh()->bounds.Center[0];
-		bBox.Center.y = /*so->GetLocation()[1] +*/ so->GetMesh()->bounds.Center[1];
-		bBox.Center.z = /*so->GetLocation()[2] +*/ so->GetMesh()->bounds.Center[2];
-		bBox.Extents.x = so->GetMesh()->bounds.Extents[0];
-		bBox.Extents.y = so->GetMesh()->bounds.Extents[1];
-		bBox.Extents.z = so->GetMesh()->bounds.Extents[2];
-		float tmin = 0.0f;
-		if (bBox.Intersects(rayOrigin, rayDir, tmin))
-		{
-			// NOTE: For the demo, we know what to cast the vertex/index data to.  If we were mixing
-			// formats, some metadata would be needed to figure out what to cast it to.
-			GDxMesh* dxMesh = dynamic_cast<GDxMesh*>(so->GetMesh());
-			if (dxMesh == nullptr)
-				ThrowGGiException("cast failed from GRiMesh* to GDxMesh*.");
-			shared_ptr<GDxStaticVIBuffer> dxViBuffer = dynamic_pointer_cast<GDxStaticVIBuffer>(dxMesh->mVIBuffer);
-			if (dxViBuffer == nullptr)
-				ThrowGGiException("cast failed from shared_ptr<GDxStaticVIBuffer> to shared_ptr<GDxStaticVIBuffer>.");
-			
-			auto vertices = (GRiVertex*)dxViBuffer->VertexBufferCPU->GetBufferPointer();
-			auto indices = (std::uint32_t*)dxViBuffer->IndexBufferCPU->GetBufferPointer();
-			UINT triCount = dxMesh->mVIBuffer->IndexCount / 3;
-
-			// Find the nearest ray/triangle intersection.
-			tmin = GGiEngineUtil::Infinity;
-			for (auto submesh : so->GetMesh()->Submeshes)
-			{
-				auto startIndexLocation = submesh.second.StartIndexLocation;
-				auto baseVertexLocation = submesh.second.BaseVertexLocation;
-
-				for (size_t i = 0; i < (submesh.second.IndexCount / 3); i++)
-				{
-					// Indices for this triangle.
-					UINT i0 = indices[startIndexLocation + i * 3 + 0] + baseVertexLocation;
-					UINT i1 = indices[startIndexLocation + i * 3 + 1] + baseVertexLocation;
-					UINT i2 = indices[startIndexLocation + i * 3 + 2] + baseVertexLocation;
-
-					// Vertices for this triangle.
-					XMFLOAT3 v0f;
-					XMFLOAT3 v1f;
-					XMFLOAT3 v2f;
-					v0f.x = vertices[i0].Position[0];
-					v0f.y = vertices[i0].Position[1];
-					v0f.z = vertices[i0].Position[2];
-					v1f.x = vertices[i1].Position[0];
-					v1f.y = vertices[i1].Position[1];
-					v1f.z = vertices[i1].Position[2];
-					v2f.x = vertices[i2].Position[0];
-					v2f.y = vertices[i2].Position[1];
-					v2f.z = vertices[i2].Position[2];
-					XMVECTOR v0 = XMLoadFloat3(&v0f);
-					XMVECTOR v1 = XMLoadFloat3(&v1f);
-					XMVECTOR v2 = XMLoadFloat3(&v2f);
-
-					// We have to iterate over all the triangles in order to find the nearest intersection.
-					float t = 0.0f;
-					if (TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-					{
-						if (t < tmin)
-						{
-							// This is the new nearest picked triangle.
-							tmin = t;
-						}
-					}
-				}
-			}
-
-			std::vector<float> soScale = so->GetScale();
-			float relSize = (float)pow(soScale[0] * soScale[0] + soScale[1] * soScale[1] + soScale[2] * soScale[2], 0.5);
-			tmin *= relSize;
+	// Tranform ray to world space, the scene bvh handles the transform into every mesh space.
+	XMFLOAT3 rayOrigin;
+	XMFLOAT3 rayDir;
+	XMStoreFloat3(&rayOrigin, XMVector3TransformCoord(viewRayOrigin, invView));
+	XMStoreFloat3(&rayDir, XMVector3Normalize(XMVector3TransformNormal(viewRayDir, invView)));
 
-			if (tmin < tPicked)
-			{
-				tPicked = tmin;
-				pickedSceneObject = so;
-			}
-		}
-	}
-	return pickedSceneObject;
+	GRiRay ray;
+	ray.Origin[0] = rayOrigin.x;
+	ray.Origin[1] = rayOrigin.y;
+	ray.Origin[2] = rayOrigin.z;
+	ray.Direction[0] = rayDir.x;
+	ray.Direction[1] = rayDir.y;
+	ray.Direction[2] = rayDir.z;
+	ray.tMax = GGiEngineUtil::Infinity;
+
+	GRiRayHit hit;
+	if (Raycast(ray, hit))
+		return hit.SceneObject;
+	return nullptr;
 }
 
 std::vector<ProfileData> GDxRenderer::GetGpuProfiles()
@@ -3708,123 +5008,138 @@ void GDxRenderer::BuildMeshSDF()
 		if (dxViBuffer == nullptr)
 			ThrowGGiException("cast failed from shared_ptr<GDxStaticVIBuffer> to shared_ptr<GDxStaticVIBuffer>.");
 
-		auto vertices = (GRiVertex*)dxViBuffer->VertexBufferCPU->GetBufferPointer();
-		auto indices = (std::uint32_t*)dxViBuffer->IndexBufferCPU->GetBufferPointer();
-		UINT triCount = dxMesh->mVIBuffer->IndexCount / 3;
-
-		// Collect primitives.
-		for (auto &submesh : dxMesh->Submeshes)
+		// Meshes loaded from a cooked file that already stores their sdf skip the generation.
+		dxMesh->SetSdfResolution(64);
+		auto sdfRes = dxMesh->GetSdfResolution();
+		std::vector<float> sdf;
+		float sdfExtent = 0.0f;
+		if (dxMesh->GetSdf() != nullptr && dxMesh->GetSdf()->size() == sdfRes * sdfRes * sdfRes)
 		{
-			auto startIndexLocation = submesh.second.StartIndexLocation;
-			auto baseVertexLocation = submesh.second.BaseVertexLocation;
+			sdf = *dxMesh->GetSdf();
+			sdfExtent = dxMesh->GetSdfExtent();
+		}
+		else
+		{
+			auto vertices = (GRiVertex*)dxViBuffer->VertexBufferCPU->GetBufferPointer();
+			UINT triCount = dxMesh->mVIBuffer->IndexCount / 3;
 
-			for (size_t i = 0; i < (submesh.second.IndexCount / 3); i++)
+			// Collect primitives.
+			for (auto &submesh : dxMesh->Submeshes)
 			{
-				// Indices for this triangle.
-				UINT i0 = indices[startIndexLocation + i * 3 + 0] + baseVertexLocation;
+				auto startIndexLocation = submesh.second.StartIndexLocation;
+				auto baseVertexLocation = submesh.second.BaseVertexLocation;
+
+				for (size_t i = 0; i < (submesh.second.IndexCount / 3); i++)
+				{
+					// Indices for this triangle.
+					UINT i0 = dxViBuffer->GetIndex((UINT)(startIndexLocation + i * 3 + 0)) + baseVertexLocation;
+					UINT i1 = dxViBuffer->GetIndex((UINT)(startIndexLocation + i * 3 + 1)) + baseVertexLocation;
+					UINT i2 = dxViBuffer->GetIndex((UINT)(startIndexLocation + i * 3 + 2)) + baseVertexLocation;
 
-				auto prim = std::make_shared<GRiKdPrimitive>(&vertices[i0], &vertices[i0 + 1], &vertices[i0 + 2]);
+					auto prim = std::make_shared<GRiKdPrimitive>(&vertices[i0], &vertices[i1], &vertices[i2]);
 
-				prims.push_back(prim);
+					prims.push_back(prim);
+				}
 			}
-		}
 
-		int isectCost = 80;
-		int travCost = 1;
-		float emptyBonus = 0.5f;
-		int maxPrims = 1;
-		int maxDepth = -1;
+			int isectCost = 80;
+			int travCost = 1;
+			float emptyBonus = 0.5f;
+			int maxPrims = 1;
+			int maxDepth = -1;
 
-		auto pAcceleratorTree = std::make_shared<GRiKdTree>(std::move(prims), isectCost, travCost, emptyBonus,
-			maxPrims, maxDepth);
+			auto pAcceleratorTree = std::make_shared<GRiKdTree>(std::move(prims), isectCost, travCost, emptyBonus,
+				maxPrims, maxDepth);
 
-		dxMesh->SetSdfResolution(64);
-		auto sdfRes = dxMesh->GetSdfResolution();
-		auto sdf = std::vector<float>(sdfRes * sdfRes * sdfRes);
+			sdf.resize(sdfRes * sdfRes * sdfRes);
 
-		float maxExtent = 0.0f;
-		for (int dim = 0; dim < 3; dim++)
-		{
-			float range = abs(dxMesh->bounds.Center[dim] + dxMesh->bounds.Extents[dim]);
-			if (range > maxExtent)
-				maxExtent = range;
-			range = abs(dxMesh->bounds.Center[dim] - dxMesh->bounds.Extents[dim]);
-			if (range > maxExtent)
-				maxExtent = range;
-		}
-		auto sdfExtent = maxExtent * 1.4f * 2.0f;// 1.4f * dxMesh->bounds.Extents[dxMesh->bounds.MaximumExtent()] * 2.0f;
-		auto sdfUnit = sdfExtent / (float)sdfRes;
-		auto initMinDisFront = 1.414f * sdfExtent;
-		auto initMaxDisBack = -1.414f * sdfExtent;
+			float maxExtent = 0.0f;
+			for (int dim = 0; dim < 3; dim++)
+			{
+				float range = abs(dxMesh->bounds.Center[dim] + dxMesh->bounds.Extents[dim]);
+				if (range > maxExtent)
+					maxExtent = range;
+				range = abs(dxMesh->bounds.Center[dim] - dxMesh->bounds.Extents[dim]);
+				if (range > maxExtent)
+					maxExtent = range;
+			}
+			sdfExtent = maxExtent * 1.4f * 2.0f;// 1.4f * dxMesh->bounds.Extents[dxMesh->bounds.MaximumExtent()] * 2.0f;
+			auto sdfUnit = sdfExtent / (float)sdfRes;
+			auto initMinDisFront = 1.414f * sdfExtent;
+			auto initMaxDisBack = -1.414f * sdfExtent;
 
-		for (int z = 0; z < sdfRes; z++)
-		{
-			for (int y = 0; y < sdfRes; y++)
+			for (int z = 0; z < sdfRes; z++)
 			{
-				for (int x = 0; x < sdfRes; x++)
+				for (int y = 0; y < sdfRes; y++)
 				{
-					mRendererThreadPool->Enqueue([&, x, y, z]
-						{
-							int index = z * sdfRes * sdfRes + y * sdfRes + x;
-							sdf[index] = 0.0f;
-
-							GGiFloat3 rayOrigin(
-								((float)x - sdfRes / 2 + 0.5f) * sdfUnit,
-								((float)y - sdfRes / 2 + 0.5f) * sdfUnit,
-								((float)z - sdfRes / 2 + 0.5f) * sdfUnit
-							);
-
-							static int rayNum = 128;
-							static float fibParam = 2 * GGiEngineUtil::PI * 0.618f;
-							float fibInter = 0.0f;
-							GRiRay ray;
-							float minDist = initMinDisFront;
-							float outDis = 999.0f;
-							int numFront = 0;
-							int numBack = 0;
-							bool bBackFace;
-
-							ray.Origin[0] = rayOrigin.x;
-							ray.Origin[1] = rayOrigin.y;
-							ray.Origin[2] = rayOrigin.z;
-
-							// Fibonacci lattices.
-							for (int n = 0; n < rayNum; n++)
+					for (int x = 0; x < sdfRes; x++)
+					{
+						mRendererThreadPool->Enqueue([&, x, y, z]
 							{
-								ray.Direction[1] = (float)(2 * n + 1) / (float)rayNum - 1;
-								fibInter = sqrt(1.0f - ray.Direction[1] * ray.Direction[1]);
-								ray.Direction[0] = fibInter * cos(fibParam * n);
-								ray.Direction[2] = fibInter * sin(fibParam * n);
+								int index = z * sdfRes * sdfRes + y * sdfRes + x;
+								sdf[index] = 0.0f;
+
+								GGiFloat3 rayOrigin(
+									((float)x - sdfRes / 2 + 0.5f) * sdfUnit,
+									((float)y - sdfRes / 2 + 0.5f) * sdfUnit,
+									((float)z - sdfRes / 2 + 0.5f) * sdfUnit
+								);
+
+								static int rayNum = 128;
+								static float fibParam = 2 * GGiEngineUtil::PI * 0.618f;
+								float fibInter = 0.0f;
+								GRiRay ray;
+								float minDist = initMinDisFront;
+								float outDis = 999.0f;
+								int numFront = 0;
+								int numBack = 0;
+								bool bBackFace;
+
+								ray.Origin[0] = rayOrigin.x;
+								ray.Origin[1] = rayOrigin.y;
+								ray.Origin[2] = rayOrigin.z;
+
+								// Fibonacci lattices.
+								for (int n = 0; n < rayNum; n++)
+								{
+									ray.Direction[1] = (float)(2 * n + 1) / (float)rayNum - 1;
+									fibInter = sqrt(1.0f - ray.Direction[1] * ray.Direction[1]);
+									ray.Direction[0] = fibInter * cos(fibParam * n);
+									ray.Direction[2] = fibInter * sin(fibParam * n);
 
-								ray.tMax = 99999.0f;
+									ray.tMax = 99999.0f;
 
-								if (pAcceleratorTree->IntersectDis(ray, &outDis, bBackFace))
-								{
-									if (bBackFace)
-									{
-										numBack++;
-									}
-									else
+									if (pAcceleratorTree->IntersectDis(ray, &outDis, bBackFace))
 									{
-										numFront++;
+										if (bBackFace)
+										{
+											numBack++;
+										}
+										else
+										{
+											numFront++;
+										}
+										if (outDis < minDist)
+											minDist = outDis;
 									}
-									if (outDis < minDist)
-										minDist = outDis;
 								}
-							}
 
-							sdf[index] = minDist;
-							if (numBack > numFront)
-								sdf[index] *= -1;
-						}
-					);
+								sdf[index] = minDist;
+								if (numBack > numFront)
+									sdf[index] *= -1;
+							}
+						);
+					}
 				}
 			}
-		}
 
-		mRendererThreadPool->Flush();
+			mRendererThreadPool->Flush();
 
-		dxMesh->InitializeSdf(sdf);
+			dxMesh->InitializeSdf(sdf);
+
+			if (!dxMesh->CookedFile.empty())
+				GRiMeshCooker::WriteSdf(dxMesh->CookedFile, sdfRes, sdfExtent, sdf.data());
+		}
 
 		ResetCommandList();
 
@@ -3881,6 +5196,7 @@ void GDxRenderer::BuildMeshSDF()
 		hDescriptor.Offset(mCbvSrvUavDescriptorSize);
 
 		dxMesh->mSdfIndex = sdfIndex;
+		dxMesh->SetSdfExtent(sdfExtent);
 		mMeshSdfDescriptors[sdfIndex].HalfExtent = 0.5f * sdfExtent;
 		mMeshSdfDescriptors[sdfIndex].Radius = 0.707f * sdfExtent;
 		mMeshSdfDescriptors[sdfIndex].Resolution = sdfRes;
@@ -3936,13 +5252,13 @@ void GDxRenderer::BuildMeshSDF()
 			{
 				// Indices for this triangle.
 				UINT i0 = indices[startIndexLocation + i * 3 + 0] + baseVertexLocation;
-				//UINT i1 = indices[startIndexLocation + i * 3 + 1] + baseVertexLocation;
-				//UINT i2 = indices[startIndexLocation + i * 3 + 2] + baseVertexLocation;
+				UINT i1 = indices[startIndexLocation + i * 3 + 1] + baseVertexLocation;
+				UINT i2 = indices[startIndexLocation + i * 3 + 2] + baseVertexLocation;
 
 				GRiVertex verticesWorld[3];
 				auto vert1 = XMFLOAT4(vertices[i0].Position[0], vertices[i0].Position[1], vertices[i0].Position[2], 1.0f);
-				auto vert2 = XMFLOAT4(vertices[i0 + 1].Position[0], vertices[i0 + 1].Position[1], vertices[i0 + 1].Position[2], 1.0f);
-				auto vert3 = XMFLOAT4(vertices[i0 + 2].Position[0], vertices[i0 + 2].Position[1], vertices[i0 + 2].Position[2], 1.0f);
+				auto vert2 = XMFLOAT4(vertices[i1].Position[0], vertices[i1].Position[1], vertices[i1].Position[2], 1.0f);
+				auto vert3 = XMFLOAT4(vertices[i2].Position[0], vertices[i2].Position[1], vertices[i2].Position[2], 1.0f);
 				auto vertVec1 = XMLoadFloat4(&vert1);
 				auto vertVec2 = XMLoadFloat4(&vert2);
 				auto vertVec3 = XMLoadFloat4(&vert3);
@@ -9,6 +9,7 @@
 #include "GDxGeometryGenerator.h"
 #include "GDxSceneObject.h"
 #include "GDxImgui.h"
+#include "GDxRenderer.h"
 
 
 GDxRendererFactory::GDxRendererFactory(ID3D12Device* device,
@@ -69,6 +70,12 @@ GRiMesh* GDxRendererFactory::CreateMesh(std::vector<GRiMeshData> meshData)
 	return ret;
 }
 
+GRiMesh* GDxRendererFactory::CreateMesh(GRiCookedMesh& cookedMesh)
+{
+	GRiMesh* ret = new GDxMesh(pDevice, pCommandList, cookedMesh, USE_COMPRESSED_VERTICES);
+	return ret;
+}
+
 GRiGeometryGenerator* GDxRendererFactory::CreateGeometryGenerator()
 {
 	GRiGeometryGenerator* ret = new GDxGeometryGenerator();
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "GDxSceneObject.h"
 #include "GDxFloat4x4.h"
+#include "GDxMesh.h"
 
 
 /*
@@ -22,11 +23,73 @@ D3D12_PRIMITIVE_TOPOLOGY GDxSceneObject::GetPrimitiveTopology()
 void GDxSceneObject::SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topo)
 {
 	PrimitiveType = topo;
+	mDrawStateVersion++;
 	MarkDirty();
 }
 
+const std::vector<GDxDrawPacket>& GDxSceneObject::GetDrawPackets()
+{
+	if (pDrawPacketMesh != Mesh ||
+		mDrawPacketVersion != mDrawStateVersion ||
+		(Mesh != nullptr && mDrawPacketMeshVersion != Mesh->MaterialVersion))
+	{
+		BuildDrawPackets();
+	}
+	return mDrawPackets;
+}
+
+void GDxSceneObject::BuildDrawPackets()
+{
+	mDrawPackets.clear();
+
+	pDrawPacketMesh = Mesh;
+	mDrawPacketVersion = mDrawStateVersion;
+	if (Mesh == nullptr)
+		return;
+	mDrawPacketMeshVersion = Mesh->MaterialVersion;
+
+	GDxMesh* dxMesh = dynamic_cast<GDxMesh*>(Mesh);
+	if (dxMesh == nullptr)
+		ThrowGGiException("Cast failed : from GRiMesh* to GDxMesh*.");
+
+	GDxDrawPacket packet;
+	packet.VertexBufferView = dxMesh->mVIBuffer->VertexBufferView();
+	packet.IndexBufferView = dxMesh->mVIBuffer->IndexBufferView();
+	packet.PrimitiveTopology = PrimitiveType;
+	packet.Quantization = dxMesh->mVIBuffer->bCompressedVertices ? &dxMesh->mVIBuffer->Quantization : nullptr;
+	packet.QuantizationIndex = dxMesh->mVIBuffer->QuantizationIndex;
+	packet.ObjIndex = ObjIndex;
+	packet.MeshId = Mesh->MeshId;
+	packet.Meshlets = Mesh->GetMeshlets().get();
+	packet.MeshletIndexOffset = dxMesh->mVIBuffer->StartIndexLocation;
+
+	mDrawPackets.reserve(dxMesh->Submeshes.size());
+	packet.SubmeshIndex = 0;
+	for (auto& submesh : dxMesh->Submeshes)
+	{
+		auto overrideMat = GetOverrideMaterial(submesh.first);
+		if (overrideMat != nullptr)
+			packet.MaterialIndex = (UINT)overrideMat->MatIndex;
+		else
+			packet.MaterialIndex = (UINT)submesh.second.GetMaterial()->MatIndex;
+		packet.IndexCount = submesh.second.IndexCount;
+		packet.StartIndexLocation = submesh.second.StartIndexLocation + dxMesh->mVIBuffer->StartIndexLocation;
+		packet.BaseVertexLocation = submesh.second.BaseVertexLocation + (INT)dxMesh->mVIBuffer->BaseVertexLocation;
+		packet.FirstMeshlet = submesh.second.FirstMeshlet;
+		packet.MeshletNum = packet.Meshlets != nullptr ? submesh.second.MeshletNum : 0;
+		mDrawPackets.push_back(packet);
+		packet.SubmeshIndex++;
+	}
+}
+
 void GDxSceneObject::UpdateTransform()
 {
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	float* Location = store.GetLocations() + dense * 3;
+	float* Rotation = store.GetRotations() + dense * 3;
+	float* Scale = store.GetScales() + dense * 3;
+
 	auto t = DirectX::XMMatrixTranslation(Location[0], Location[1], Location[2]);
 	auto r = DirectX::XMMatrixRotationRollPitchYaw(Rotation[0] * GGiEngineUtil::PI / 180.0f, Rotation[1] * GGiEngineUtil::PI / 180.0f, Rotation[2] * GGiEngineUtil::PI / 180.0f);
 	auto s = DirectX::XMMatrixScaling(Scale[0], Scale[1], Scale[2]);
@@ -36,8 +99,7 @@ void GDxSceneObject::UpdateTransform()
 	//GDxFloat4x4* trans = new GDxFloat4x4();
 	//trans->SetValue(transfloat4x4);
 	//std::shared_ptr<GGiFloat4x4> temp(trans);
-	mTransform = GDx::DxToGGiMatrix(transMat);
-	bTransformDirty = false;
+	SetTransform(GDx::DxToGGiMatrix(transMat));
 }
 
 
@@ -3,29 +3,74 @@
 #include "GDxUtil.h"
 
 
-GDxStaticVIBuffer::GDxStaticVIBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices) : GDxVertexIndexBuffer(device, cmdList, vertices, indices)
+GDxStaticVIBuffer::GDxStaticVIBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices) : GDxStaticVIBuffer(device, cmdList, vertices.data(), (UINT)vertices.size(), indices.data(), (UINT)indices.size())
 {
-	Create(device, cmdList, vertices, indices);
+}
+
+GDxStaticVIBuffer::GDxStaticVIBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum, bool bCompressVertices) : GDxVertexIndexBuffer(device, cmdList, vertices, vertexNum, indices, indexNum, bCompressVertices)
+{
+	Create(device, cmdList, vertices, vertexNum, indices, indexNum);
+}
+
+GDxStaticVIBuffer::~GDxStaticVIBuffer()
+{
+	if (bPooled)
+		GDxGeometryPool::GetInstance(bCompressedVertices).Free(PoolAllocation);
 }
 
 
-void GDxStaticVIBuffer::Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices)
+void GDxStaticVIBuffer::Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum)
 {
-	ThrowIfFailed(D3DCreateBlob(VertexBufferByteSize, &VertexBufferCPU));
-	CopyMemory(VertexBufferCPU->GetBufferPointer(), vertices.data(), VertexBufferByteSize);
+	ThrowIfFailed(D3DCreateBlob(vertexNum * sizeof(GRiVertex), &VertexBufferCPU));
+	CopyMemory(VertexBufferCPU->GetBufferPointer(), vertices, vertexNum * sizeof(GRiVertex));
 
+	// Both copies of the indices are stored in IndexFormat.
 	ThrowIfFailed(D3DCreateBlob(IndexBufferByteSize, &IndexBufferCPU));
-	CopyMemory(IndexBufferCPU->GetBufferPointer(), indices.data(), IndexBufferByteSize);
+	if (IndexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		auto shortIndices = (std::uint16_t*)IndexBufferCPU->GetBufferPointer();
+		for (UINT i = 0; i < indexNum; i++)
+			shortIndices[i] = (std::uint16_t)indices[i];
+	}
+	else
+	{
+		CopyMemory(IndexBufferCPU->GetBufferPointer(), indices, IndexBufferByteSize);
+	}
+	const void* gpuIndices = IndexBufferCPU->GetBufferPointer();
+
+	const void* gpuVertices = vertices;
+	std::vector<GRiCompressedVertex> compressedVertices;
+	if (bCompressedVertices)
+	{
+		// GRiVertex has no tangent sign, the compressed vertices get it from the uv winding.
+		std::vector<float> tangentSigns(vertexNum);
+		GRiMeshData::ComputeTangentSigns(vertices, vertexNum, indices, indexNum, tangentSigns.data());
+
+		compressedVertices.resize(vertexNum);
+		GRiVertexCompressor::Encode(vertices, vertexNum, Quantization, compressedVertices.data(), tangentSigns.data());
+		gpuVertices = compressedVertices.data();
+	}
+
+	bPooled = GDxGeometryPool::GetInstance(bCompressedVertices).Allocate(device, cmdList, gpuVertices, vertexNum, gpuIndices, indexNum, IndexFormat, PoolAllocation);
+	if (bPooled)
+	{
+		BaseVertexLocation = PoolAllocation.BaseVertexLocation;
+		StartIndexLocation = PoolAllocation.StartIndexLocation;
+		return;
+	}
 
 	VertexBufferGPU = GDxUtil::CreateDefaultBuffer(device,
-		cmdList, vertices.data(), VertexBufferByteSize, VertexBufferUploader);
+		cmdList, gpuVertices, VertexBufferByteSize, VertexBufferUploader);
 
 	IndexBufferGPU = GDxUtil::CreateDefaultBuffer(device,
-		cmdList, indices.data(), IndexBufferByteSize, IndexBufferUploader);
+		cmdList, gpuIndices, IndexBufferByteSize, IndexBufferUploader);
 }
 
 D3D12_INDEX_BUFFER_VIEW GDxStaticVIBuffer::IndexBufferView() const
 {
+	if (bPooled)
+		return GDxGeometryPool::GetInstance(bCompressedVertices).IndexBufferView(IndexFormat);
+
 	D3D12_INDEX_BUFFER_VIEW ibv;
 	ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
 	ibv.Format = IndexFormat;
@@ -36,6 +81,9 @@ D3D12_INDEX_BUFFER_VIEW GDxStaticVIBuffer::IndexBufferView() const
 
 D3D12_VERTEX_BUFFER_VIEW GDxStaticVIBuffer::VertexBufferView() const
 {
+	if (bPooled)
+		return GDxGeometryPool::GetInstance(bCompressedVertices).VertexBufferView();
+
 	D3D12_VERTEX_BUFFER_VIEW vbv;
 	vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
 	vbv.StrideInBytes = VertexByteStride;
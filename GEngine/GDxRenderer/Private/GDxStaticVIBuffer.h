@@ -1,22 +1,47 @@
 #pragma once
 
 #include "GDxVertexIndexBuffer.h"
+#include "GDxGeometryPool.h"
 
 class GDxStaticVIBuffer : public GDxVertexIndexBuffer
 {
 public:
 	GDxStaticVIBuffer() = delete;
-	~GDxStaticVIBuffer() = default;
+	~GDxStaticVIBuffer();
 
 	GDxStaticVIBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices);
 
-	virtual void Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices) override;
+	// The data is copied before returning, e.g. from a mapped cooked mesh file.
+	// Compressed vertices are only uploaded compressed, the system memory copy keeps the GRiVertex ones.
+	GDxStaticVIBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum, bool bCompressVertices = false);
+
+	virtual void Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum) override;
 
 	// System memory copies.  Use Blobs because the vertex/index format can be generic.
 	// It is up to the client to cast appropriately.  
 	Microsoft::WRL::ComPtr<ID3DBlob> VertexBufferCPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3DBlob> IndexBufferCPU = nullptr;
 
+	// System memory indices as stored, IndexType has to match IndexFormat.
+	template<typename IndexType>
+	const IndexType* GetIndices() const
+	{
+		assert(sizeof(IndexType) == IndexByteStride);
+		return (const IndexType*)IndexBufferCPU->GetBufferPointer();
+	}
+
+	// System memory index i widened to 32 bits, for the cpu side consumers that take either width.
+	UINT GetIndex(UINT i) const
+	{
+		if (IndexFormat == DXGI_FORMAT_R16_UINT)
+			return GetIndices<std::uint16_t>()[i];
+		return GetIndices<std::uint32_t>()[i];
+	}
+
+	// The geometry lives in the shared geometry pool of its vertex format, the buffers below are only used if it didn't fit.
+	bool bPooled = false;
+	GDxGeometryAllocation PoolAllocation;
+
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferGPU = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferGPU = nullptr;
 
@@ -57,6 +57,20 @@ public:
 		memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
 	}
 
+	// Writes part of an element, e.g. the changed range of an array in a large constant buffer.
+	void CopyBytes(int elementIndex, UINT64 byteOffset, const void* data, UINT64 byteSize)
+	{
+		assert(byteOffset + byteSize <= sizeof(T));
+		memcpy(&mMappedData[elementIndex*mElementByteSize + byteOffset], data, byteSize);
+	}
+
+	// Only valid for tightly packed (non constant) buffers.
+	void CopyData(int startIndex, const T* data, UINT elementCount)
+	{
+		assert(!mIsConstantBuffer);
+		memcpy(&mMappedData[startIndex*mElementByteSize], data, sizeof(T) * elementCount);
+	}
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
 	BYTE* mMappedData = nullptr;
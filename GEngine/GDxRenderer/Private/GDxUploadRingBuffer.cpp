@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "GDxUploadRingBuffer.h"
+
+
+GDxUploadRingBuffer::GDxUploadRingBuffer(ID3D12Device* device, UINT64 capacity)
+{
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(capacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mUploadBuffer)));
+
+	ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
+
+	mAllocator.Init(capacity);
+}
+
+GDxUploadRingBuffer::~GDxUploadRingBuffer()
+{
+	if (mUploadBuffer != nullptr)
+		mUploadBuffer->Unmap(0, nullptr);
+
+	mMappedData = nullptr;
+}
+
+ID3D12Resource* GDxUploadRingBuffer::Resource()const
+{
+	return mUploadBuffer.Get();
+}
+
+GDxUploadAllocation GDxUploadRingBuffer::Allocate(UINT64 size, UINT64 alignment)
+{
+	auto allocation = TryAllocate(size, alignment);
+	if (allocation.CpuAddress == nullptr)
+		ThrowGGiException("Upload ring buffer is out of space.");
+
+	return allocation;
+}
+
+GDxUploadAllocation GDxUploadRingBuffer::TryAllocate(UINT64 size, UINT64 alignment)
+{
+	GDxUploadAllocation allocation;
+	UINT64 offset = mAllocator.Allocate(size, alignment);
+	if (offset == GRiRingAllocator::InvalidOffset)
+		return allocation;
+
+	allocation.CpuAddress = mMappedData + offset;
+	allocation.GpuAddress = mUploadBuffer->GetGPUVirtualAddress() + offset;
+	allocation.Offset = offset;
+	allocation.Size = size;
+	return allocation;
+}
+
+void GDxUploadRingBuffer::FinishFrame(UINT64 fenceValue)
+{
+	mAllocator.FinishFrame(fenceValue);
+}
+
+void GDxUploadRingBuffer::ReleaseCompletedFrames(UINT64 completedFenceValue)
+{
+	mAllocator.ReleaseCompletedFrames(completedFenceValue);
+}
+
+UINT64 GDxUploadRingBuffer::GetUsedSize()
+{
+	return mAllocator.GetUsedSize();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "GDxPreInclude.h"
+#include "GDxUtil.h"
+
+
+// Piece of the upload ring, valid until the frame it was allocated in has completed on the gpu.
+struct GDxUploadAllocation
+{
+	BYTE* CpuAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+
+	// Offset into GDxUploadRingBuffer::Resource(), for apis taking a resource and an offset.
+	UINT64 Offset = 0;
+	UINT64 Size = 0;
+};
+
+// Persistently mapped upload heap buffer handing out per frame data linearly, shared by every frame in flight.
+// Allocations of a frame are recycled once the fence value signaled after the frame has completed, so the
+// buffer only has to hold the data of the frames actually in flight. Not thread safe, allocate on one thread
+// and fill the allocations from as many as needed.
+class GDxUploadRingBuffer
+{
+
+public:
+
+	GDxUploadRingBuffer(ID3D12Device* device, UINT64 capacity);
+	GDxUploadRingBuffer(const GDxUploadRingBuffer& rhs) = delete;
+	GDxUploadRingBuffer& operator=(const GDxUploadRingBuffer& rhs) = delete;
+	~GDxUploadRingBuffer();
+
+	ID3D12Resource* Resource()const;
+
+	// Throws if the ring is out of space.
+	GDxUploadAllocation Allocate(UINT64 size, UINT64 alignment);
+
+	// Returns an empty allocation, with a null CpuAddress, instead of throwing if the ring is out of space.
+	GDxUploadAllocation TryAllocate(UINT64 size, UINT64 alignment);
+
+	// Constant buffer data, aligned and padded to 256 bytes.
+	template<typename T>
+	GDxUploadAllocation AllocateConstants(const T& data)
+	{
+		auto allocation = Allocate(GDxUtil::CalcConstantBufferByteSize(sizeof(T)), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		memcpy(allocation.CpuAddress, &data, sizeof(T));
+		return allocation;
+	}
+
+	// Tightly packed elements, e.g. of a structured buffer, to be filled by the caller.
+	template<typename T>
+	GDxUploadAllocation AllocateArray(UINT elementCount)
+	{
+		return Allocate((UINT64)sizeof(T) * elementCount, alignof(T) > 16 ? alignof(T) : 16);
+	}
+
+	template<typename T>
+	GDxUploadAllocation TryAllocateArray(UINT elementCount)
+	{
+		return TryAllocate((UINT64)sizeof(T) * elementCount, alignof(T) > 16 ? alignof(T) : 16);
+	}
+
+	// Closes the allocations of the frame, fenceValue is signaled once the gpu is done with them.
+	void FinishFrame(UINT64 fenceValue);
+
+	void ReleaseCompletedFrames(UINT64 completedFenceValue);
+
+	UINT64 GetUsedSize();
+
+private:
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
+	BYTE* mMappedData = nullptr;
+
+	GRiRingAllocator mAllocator;
+
+};
+
@@ -1,15 +1,34 @@
 #include "stdafx.h"
 #include "GDxVertexIndexBuffer.h"
+#include "GDxQuantizationTable.h"
 
 
-GDxVertexIndexBuffer::GDxVertexIndexBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices)
+GDxVertexIndexBuffer::GDxVertexIndexBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum, bool bCompressVertices)
 {
-	VertexByteStride = sizeof(GRiVertex);
-	IndexFormat = DXGI_FORMAT_R32_UINT;
-	VertexBufferByteSize = (UINT)vertices.size() * sizeof(GRiVertex);
-	IndexBufferByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
-	VertexCount = (UINT)vertices.size();
-	IndexCount = (UINT)indices.size();
+	bCompressedVertices = bCompressVertices;
+	if (bCompressedVertices)
+	{
+		Quantization = GRiVertexCompressor::ComputeQuantization(vertices, vertexNum);
+		QuantizationIndex = GDxQuantizationTable::GetInstance().Add(Quantization);
+	}
+
+	VertexByteStride = bCompressedVertices ? sizeof(GRiCompressedVertex) : sizeof(GRiVertex);
+
+	std::uint32_t maxIndex = 0;
+	for (UINT i = 0; i < indexNum; i++)
+		maxIndex = max(maxIndex, indices[i]);
+	IndexFormat = maxIndex <= 0xFFFF ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	IndexByteStride = IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+
+	VertexBufferByteSize = vertexNum * VertexByteStride;
+	IndexBufferByteSize = indexNum * IndexByteStride;
+	VertexCount = vertexNum;
+	IndexCount = indexNum;
 }
 
+GDxVertexIndexBuffer::~GDxVertexIndexBuffer()
+{
+	if (QuantizationIndex != 0)
+		GDxQuantizationTable::GetInstance().Remove(QuantizationIndex);
+}
 
@@ -8,20 +8,32 @@ class GDxVertexIndexBuffer
 {
 public:
 	GDxVertexIndexBuffer() = delete;
-	virtual ~GDxVertexIndexBuffer() {}
+	virtual ~GDxVertexIndexBuffer();
 
-	GDxVertexIndexBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices);
+	GDxVertexIndexBuffer(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum, bool bCompressVertices = false);
 
-	virtual void Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiVertex> vertices, std::vector<uint32_t> indices) = 0;
+	virtual void Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum) = 0;
 
 	// Data about the buffers.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
 	UINT VertexCount = 0;
+	// R16_UINT if every index fits, they are relative to the base vertex of their submesh.
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R32_UINT;
+	UINT IndexByteStride = 0;
 	UINT IndexBufferByteSize = 0;
 	UINT IndexCount = 0;
 
+	// The gpu copy of the vertices is GRiCompressedVertex, the vertex shader dequantizes the positions with Quantization.
+	bool bCompressedVertices = false;
+	GRiVertexQuantization Quantization;
+	// Entry of Quantization in GDxQuantizationTable, 0 for uncompressed vertices.
+	UINT QuantizationIndex = 0;
+
+	// Location of the geometry in the buffers the views point to, non zero if the buffers are shared.
+	UINT BaseVertexLocation = 0;
+	UINT StartIndexLocation = 0;
+
 	virtual D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const = 0;
 
 	virtual D3D12_INDEX_BUFFER_VIEW IndexBufferView() const = 0;
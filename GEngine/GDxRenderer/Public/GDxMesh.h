@@ -15,6 +15,9 @@ public:
 
 	void Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, std::vector<GRiMeshData> meshData);
 
+	// Uploads the geometry straight from the mapped file, the bounds are the cooked ones.
+	GDxMesh(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, GRiCookedMesh& cookedMesh, bool bCompressVertices = false);
+
 	std::shared_ptr<GDxVertexIndexBuffer> mVIBuffer;
 
 };
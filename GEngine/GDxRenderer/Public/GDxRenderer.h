@@ -19,6 +19,40 @@
 #include "GDxUav.h"
 #include "../Shaders/ShaderDefinition.h"
 #include "GDxReadbackBuffer.h"
+#include "GDxUploadRingBuffer.h"
+
+struct GDxDrawPacket;
+
+// Command groups of the G-Buffer pass. Draws outside the geometry pools can't share the bound buffers and are recorded directly.
+// Every vertex format has a pool and pipeline states of its own, pooled draws with 16 bit indices bind the pool's index
+// buffer with the other format.
+enum class IndirectPipeline : int
+{
+	GBuffer = 0,
+	GBufferInstanced,
+	DirectGBuffer,
+	DirectGBufferInstanced,
+	CompressedGBuffer,
+	CompressedGBufferInstanced,
+	DirectCompressedGBuffer,
+	DirectCompressedGBufferInstanced,
+	ShortIndexGBuffer,
+	ShortIndexGBufferInstanced,
+	ShortIndexCompressedGBuffer,
+	ShortIndexCompressedGBufferInstanced,
+	Count
+};
+
+// Counters of one recording of sorted draws.
+struct GDxSortedDrawStats
+{
+	int Draws = 0;
+	int StateChanges = 0;
+	int InstancedDraws = 0;
+	int Instances = 0;
+	int IndirectCommands = 0;
+	int ExecuteIndirects = 0;
+};
 
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
@@ -34,8 +68,71 @@ using namespace DirectX::PackedVector;
 
 #define SKY_CUBEMAP_SIZE 1024
 
+// Upload memory for the transient data of every frame in flight, e.g. instance data and indirect commands.
+#define UPLOAD_RING_SIZE (32 << 20)
+
+// Load the fbx meshes of the project from cooked mesh files, cooking the ones that are missing or out of date.
+#define USE_COOKED_MESHES 1
+
+// Upload the cooked meshes as 20 byte GRiCompressedVertex instead of 44 byte GRiVertex, requires USE_COOKED_MESHES.
+// Only saves video memory, the system memory copy stays GRiVertex for the cpu side consumers.
+// The draws look the dequantization up in GDxQuantizationTable, the object constants and instance data don't grow.
+#define USE_COMPRESSED_VERTICES 1
+
 #define USE_MASKED_DEPTH_BUFFER 1
 
+// Frustum cull with the spatial index instead of testing every deferred object.
+#define USE_SPATIAL_INDEX_CULLING 1
+
+// Sort the visible deferred submesh draws by key and skip redundant state changes while recording them.
+#define USE_SORTED_DRAWS 1
+
+// Merge sorted draws sharing geometry and material into instanced draws, requires USE_SORTED_DRAWS.
+#define USE_AUTO_INSTANCING 1
+
+// Smaller groups of identical draws are drawn one by one.
+#define AUTO_INSTANCING_MIN_INSTANCE_NUM 2
+
+// Cull the meshlets of the sorted draws left out of instance batches against the frustum, their normal cones and the
+// masked depth buffer, and draw only the index ranges left, requires USE_SORTED_DRAWS.
+#define USE_MESHLET_CULLING 1
+
+// Write the sorted draws into an indirect argument buffer and submit them with one ExecuteIndirect per pipeline state,
+// requires USE_SORTED_DRAWS.
+#define USE_INDIRECT_DRAWS 1
+
+// Record the G-Buffer draws into several command lists on the renderer thread pool, requires USE_SORTED_DRAWS. With
+// USE_INDIRECT_DRAWS every list gets a slice of the indirect commands and submits it with its own ExecuteIndirect
+// calls, otherwise a slice of the sorted draws. The defaults exercise the indirect commands recorded in parallel.
+#define USE_PARALLEL_GBUFFER_RECORDING 1
+
+// Fewer draws per worker list aren't worth a list of their own.
+#define PARALLEL_RECORDING_MIN_DRAW_NUM 256
+
+// Composite the mesh SDFs into a camera-centred global clipmap on the renderer thread pool and upload the recomposited
+// bricks, so every screen space shadow ray marches one volume instead of every sdf object.
+#define USE_SDF_CLIPMAP 1
+
+// should be the same with ScreenSpaceShadowPS.hlsl
+#define SDF_CLIPMAP_LEVEL_NUM 4
+#define SDF_CLIPMAP_RESOLUTION 64
+#define SDF_CLIPMAP_BRICK_SIZE 8
+#define SDF_CLIPMAP_VOXEL_SIZE 4.0f
+#define SDF_CLIPMAP_TRUNCATION_VOXELS 4.0f
+
+// Bricks left over are uploaded in the following frames, the shadow rays march the sdf objects until all arrived.
+#define SDF_CLIPMAP_MAX_UPLOAD_BRICK_NUM 1024
+
+// Cull the sdf objects every shadow ray has to march against per light space tile, unused with USE_SDF_CLIPMAP.
+#define USE_SDF_TILE_CULLING 1
+
+// Find the lights of every cluster row through a light bvh instead of testing all of them, requires
+// USE_CPU_LIGHT_CLUSTERING.
+#define USE_LIGHT_BVH 1
+
+// Drop the lights whose volumes are hidden in the masked depth buffer of the frame, requires USE_MASKED_DEPTH_BUFFER.
+#define USE_LIGHT_OCCLUSION_CULLING 1
+
 // should be the same with TiledDeferredCS.hlsl
 //#define DEFER_TILE_SIZE_X 16
 //#define DEFER_TILE_SIZE_Y 16
@@ -67,6 +164,42 @@ struct MeshSdfDescriptor
 	int Resolution;
 };
 
+// should be the same with cbSDF in ScreenSpaceShadowPS.hlsl
+struct SdfTileConstants
+{
+	UINT SceneObjectNum = 0;
+	UINT TileNum = 0;
+	DirectX::XMFLOAT2 Origin = { 0.0f, 0.0f };
+	DirectX::XMFLOAT3 AxisU = { 1.0f, 0.0f, 0.0f };
+	float InvTileSize = 1.0f;
+	DirectX::XMFLOAT3 AxisV = { 0.0f, 1.0f, 0.0f };
+	UINT Enabled = 0;
+};
+
+struct SdfClipmapLevelConstants
+{
+	// Window minimum corner in voxels.
+	DirectX::XMINT3 Origin = { 0, 0, 0 };
+	float VoxelSize = 1.0f;
+};
+
+struct SdfClipmapConstants
+{
+	SdfClipmapLevelConstants Levels[SDF_CLIPMAP_LEVEL_NUM];
+	UINT Resolution = 0;
+	UINT BrickSize = 0;
+	UINT LevelNum = 0;
+	UINT Enabled = 0;
+};
+
+// Run of bricks uploaded with one copy, the bricks are contiguous in the upload ring and in the clipmap buffer.
+struct SdfClipmapBrickCopy
+{
+	UINT64 SrcOffset = 0;
+	UINT64 DstOffset = 0;
+	UINT64 Size = 0;
+};
+
 // 8x TAA
 static const double Halton_2[8] =
 {
@@ -135,22 +268,36 @@ protected:
 
 	void UpdateObjectCBs(const GGiGameTimer* gt);
 	void UpdateMaterialBuffer(const GGiGameTimer* gt);
+	void UpdateQuantizationBuffer(const GGiGameTimer* gt);
 	void UpdateSdfDescriptorBuffer(const GGiGameTimer* gt);
+	void UpdateSceneObjectSdfDescriptor(UINT sdfSlot);
 	void UpdateShadowTransform(const GGiGameTimer* gt);
 	void UpdateMainPassCB(const GGiGameTimer* gt);
 	void UpdateSkyPassCB(const GGiGameTimer* gt);
 	void UpdateLightCB(const GGiGameTimer* gt);
+	void UpdateLightClusters(const GGiGameTimer* gt);
+	void UpdateSdfTileLists(const GGiGameTimer* gt);
+	void UpdateSdfClipmapBricks(const GGiGameTimer* gt);
+	void UpdateSceneTransforms(const GGiGameTimer* gt);
+	void UpdateSceneBvh(const GGiGameTimer* gt);
 	void CullSceneObjects(const GGiGameTimer* gt);
+	void SortVisibleDraws(const GGiGameTimer* gt);
+	void BatchInstances(const GGiGameTimer* gt);
+	void CullMeshlets(const GGiGameTimer* gt);
+	void BuildIndirectDraws(const GGiGameTimer* gt);
 
 	void InitializeGpuProfiler();
 	void BuildRootSignature();
 	void BuildDescriptorHeaps();
 	void BuildPSOs();
+	void BuildCommandSignatures();
 	void BuildFrameResources();
 
 	void CubemapPreIntegration();
 
 	void BuildMeshSDF();
+	void BuildDefaultLights();
+	void BuildMeshBvh(GRiMesh* mesh);
 
 	//void SaveBakedCubemap(std::wstring workDir, std::wstring CubemapPath);
 
@@ -163,6 +310,17 @@ protected:
 
 	void DrawSceneObjects(ID3D12GraphicsCommandList* cmdList, const RenderLayer layer, bool bSetObjCb, bool bSetSubmeshCb, bool bCheckCullState = false);
 	void DrawSceneObject(ID3D12GraphicsCommandList* cmdList, GRiSceneObject* sObject, bool bSetObjCb, bool bSetSubmeshCb, bool bCheckCullState = false);
+	void DrawSortedSceneObjects(ID3D12GraphicsCommandList* cmdList, bool bSetObjCb, bool bSetSubmeshCb);
+	void DrawIndirectSceneObjects(ID3D12GraphicsCommandList* cmdList);
+	// Commands [firstCommand, firstCommand + commandNum) of the argument buffer, one ExecuteIndirect per pipeline range
+	// they overlap.
+	void DrawIndirectSceneObjectRange(ID3D12GraphicsCommandList* cmdList, UINT firstCommand, UINT commandNum, GDxSortedDrawStats& stats);
+	// Items are the single sorted draws followed by the instance batches.
+	UINT GetSortedDrawItemNum();
+	void DrawSortedSceneObjectRange(ID3D12GraphicsCommandList* cmdList, UINT firstItem, UINT itemNum, bool bSetObjCb, bool bSetSubmeshCb, GDxSortedDrawStats& stats);
+	void SetGBufferPassState(ID3D12GraphicsCommandList* cmdList);
+	// Returns false without recording anything if there are too few draws to split.
+	bool RecordGBufferDrawsInParallel();
 
 protected:
 
@@ -195,6 +353,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCommandQueue;
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mCommandList;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> mWorkerCommandLists;
 
 	static const int SwapChainBufferCount = 2;
 	int mCurrBackBuffer = 0;
@@ -222,6 +381,21 @@ protected:
 protected:
 
 	std::vector<std::unique_ptr<GDxFrameResource>> mFrameResources;
+	std::unique_ptr<GDxUploadRingBuffer> mUploadRing;
+
+	// Transient data of the current frame in the upload ring.
+	GDxUploadAllocation mInstanceAllocation;
+	// GDxQuantizationTable as of this frame.
+	GDxUploadAllocation mQuantizationAllocation;
+	GDxUploadAllocation mIndirectCommandAllocation;
+	// Per-tile (offset, count) pairs and the sdf object indices they point to.
+	GDxUploadAllocation mSdfTileRangeAllocation;
+	GDxUploadAllocation mSdfTileObjectIndexAllocation;
+	// Per-cluster (offset, count) pairs and the point light indices they point to.
+	GDxUploadAllocation mClusterLightRangeAllocation;
+	GDxUploadAllocation mClusterLightIndexAllocation;
+	// Reported once until the index list fits again.
+	bool bClusterLightIndexOverflow = false;
 	GDxFrameResource* mCurrFrameResource = nullptr;
 	int mCurrFrameResourceIndex = 0;
 
@@ -236,6 +410,7 @@ protected:
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 	std::unordered_map<std::string, ComPtr<ID3D12RootSignature>> mRootSignatures;
+	std::unordered_map<std::string, ComPtr<ID3D12CommandSignature>> mCommandSignatures;
 
 	GDxImgui* pImgui = nullptr;
 
@@ -268,6 +443,82 @@ protected:
 	int numFrustumCulled = 0;
 	int numOcclusionCulled = 0;
 
+	// Dense scene store indices whose world transform and cached bounds were recomputed this frame.
+	std::vector<UINT> mDirtyBoundsIndices;
+
+	// Scene objects whose constants were written to the current frame resource this frame.
+	std::vector<GRiSceneObject*> mUpdatedSceneObjects;
+
+	// Part [begin, end) of the visible point light list missing from the light cb of every frame resource.
+	UINT mPointLightUploadBegin[NUM_FRAME_RESOURCES] = { 0 };
+	UINT mPointLightUploadEnd[NUM_FRAME_RESOURCES] = { 0 };
+
+	// Frame resources whose light cb doesn't have the current directional lights yet.
+	int mDirLightFramesDirty = 0;
+
+	// Deferred objects that passed frustum culling this frame.
+	std::vector<GRiSceneObject*> mFrustumVisibleSceneObjects;
+
+	// Visible deferred objects and the index of their first draw in the sorted draw arrays.
+	std::vector<GRiSceneObject*> mSortedDrawObjects;
+	std::vector<UINT> mSortedDrawObjectOffsets;
+
+	// Submesh draws of the visible deferred objects, recorded in the order of mSortedDrawOrder.
+	std::vector<const GDxDrawPacket*> mSortedDrawPackets;
+	std::vector<UINT64> mSortedDrawKeys;
+	std::vector<UINT> mSortedDrawOrder;
+	// Scene store entry the transforms of each draw come from.
+	std::vector<UINT> mSortedDrawDenseIndices;
+
+	GRiRadixSort mDrawSorter;
+
+	// Batch key of every draw, in sorted order.
+	std::vector<UINT64> mInstanceBatchKeys;
+	GRiInstanceBatcher mInstanceBatcher;
+
+	// Meshlet culler draw of every single draw item, -1 for draws without meshlets, which are drawn whole.
+	GRiMeshletCuller mMeshletCuller;
+	std::vector<UINT> mSingleMeshletDraws;
+	// First indirect command of every single draw item, it gets one per visible index range.
+	std::vector<UINT> mSingleCommandOffsets;
+
+	// Single draws, split into their visible index ranges with USE_MESHLET_CULLING, then instance batches, and the
+	// packet each of them was made from.
+	std::vector<GRiIndirectDraw> mIndirectDraws;
+	std::vector<const GDxDrawPacket*> mIndirectDrawPackets;
+	GRiIndirectArgumentBuilder mIndirectArgumentBuilder;
+	// False if this frame had more draws than the argument buffer holds.
+	bool bIndirectDrawsBuilt = false;
+
+	// Records slices of the indirect commands, or of the sorted G-Buffer draws without them, into the worker
+	// command lists.
+	class GBufferListRecorder : public GRiCommandListRecorder
+	{
+	public:
+		GDxRenderer* pRenderer = nullptr;
+
+		virtual void BeginList(UINT listIndex) override;
+		virtual void RecordItems(UINT listIndex, UINT firstItem, UINT itemNum) override;
+		virtual void EndList(UINT listIndex) override;
+	};
+
+	GRiCommandListScheduler mGBufferListScheduler;
+	GBufferListRecorder mGBufferListRecorder;
+	GDxSortedDrawStats mWorkerDrawStats[MAX_RECORDING_LIST_NUM];
+
+	int numDraws = 0;
+	int numStateChanges = 0;
+	// Binds the unsorted per object recording would have issued on top of numStateChanges.
+	int numStateChangesSaved = 0;
+	int numInstancedDraws = 0;
+	// Draws merged into the instanced draws.
+	int numInstances = 0;
+	int numIndirectCommands = 0;
+	int numExecuteIndirects = 0;
+	int numRecordingLists = 1;
+	int numMeshletCulledTriangles = 0;
+	int numMeshletVisibleTriangles = 0;
+
 	UINT mTaaHistoryIndex = 0;
 
 	CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv;
@@ -288,6 +539,40 @@ protected:
 
 	UINT mSceneObjectSdfNum = 0;
 
+	// Deferred scene objects with a sdf in slot order, and the slot of every deferred scene object (-1 without a sdf).
+	// The slots are only reassigned when the layers are synced or an object switches to or from a mesh with a sdf.
+	std::vector<GRiSceneObject*> mSdfSceneObjects;
+	std::unordered_map<GRiSceneObject*, int> mSceneObjectSdfSlots;
+	UINT mSdfSlotLayerVersion = (UINT)-1;
+
+	// Frame resources still missing the whole descriptor list since the slots were reassigned.
+	int mSdfDescriptorFramesDirty = 0;
+
+	std::unique_ptr<GRiSdfClipmap> mSdfClipmap;
+
+	// Distances of every clipmap level in brick slot order, BrickSize^3 floats per brick.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mSdfClipmapBuffer;
+	D3D12_RESOURCE_STATES mSdfClipmapBufferState = D3D12_RESOURCE_STATE_COPY_DEST;
+
+	// Recomposited bricks not uploaded yet, flagged by their index in the clipmap buffer to skip duplicates.
+	std::vector<GRiSdfClipmapBrick> mSdfClipmapPendingBricks;
+	std::vector<UINT8> mSdfClipmapBrickPending;
+
+	// Copies recorded before the screen space shadow pass of this frame.
+	std::vector<SdfClipmapBrickCopy> mSdfClipmapBrickCopies;
+	GDxUploadAllocation mSdfClipmapBrickAllocation;
+
+	SdfClipmapConstants mSdfClipmapConstants;
+
+	// World bounds of the sdf volume of every entry in mSceneObjectSdfDescriptors.
+	std::vector<GRiBoundingBox> mSceneObjectSdfBounds;
+
+	std::unique_ptr<GRiSdfTileCuller> mSdfTileCuller;
+
+	std::unique_ptr<GRiClusteredLightAssigner> mLightClusterer;
+
+	SdfTileConstants mSdfTileConstants;
+
 	DirectX::BoundingSphere mSceneBounds;
 
 	float mLightNearZ = 0.0f;
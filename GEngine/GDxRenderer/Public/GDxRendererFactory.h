@@ -27,6 +27,8 @@ public:
 
 	virtual GRiMesh* CreateMesh(std::vector<GRiMeshData> meshData) override;
 
+	virtual GRiMesh* CreateMesh(GRiCookedMesh& cookedMesh) override;
+
 	virtual GRiGeometryGenerator* CreateGeometryGenerator() override;
 
 	virtual GRiSceneObject* CreateSceneObject() override;
@@ -2,6 +2,41 @@
 #include "GDxPreInclude.h"
 
 
+// Everything needed to record the draw of one submesh, resolved ahead of time.
+struct GDxDrawPacket
+{
+	D3D12_VERTEX_BUFFER_VIEW VertexBufferView;
+	D3D12_INDEX_BUFFER_VIEW IndexBufferView;
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveTopology;
+
+	// Dequantization of the vertex positions, null if the vertices aren't compressed.
+	const GRiVertexQuantization* Quantization;
+	// Entry of the dequantization in GDxQuantizationTable, 0 for uncompressed vertices.
+	UINT QuantizationIndex;
+
+	// The object constant buffer address is ObjIndex slots into the current frame resource's buffer.
+	UINT ObjIndex;
+
+	// Override material if there is one.
+	UINT MaterialIndex;
+
+	UINT MeshId;
+
+	// Position of the submesh in the mesh's submesh table.
+	UINT SubmeshIndex;
+
+	UINT IndexCount;
+	UINT StartIndexLocation;
+	INT BaseVertexLocation;
+
+	// Meshlets of the submesh, null if the mesh has none. Their index ranges are relative to the mesh, MeshletIndexOffset
+	// moves them into the shared index buffer.
+	GRiMeshletSet* Meshlets;
+	UINT FirstMeshlet;
+	UINT MeshletNum;
+	UINT MeshletIndexOffset;
+};
+
 class GDxSceneObject : public GRiSceneObject
 {
 
@@ -13,10 +48,22 @@ public:
 
 	void SetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topo);
 
+	// One packet per submesh, rebuilt only after the mesh, its materials or the override materials changed.
+	const std::vector<GDxDrawPacket>& GetDrawPackets();
+
 private:
 
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
+	std::vector<GDxDrawPacket> mDrawPackets;
+
+	// State the packets were built from.
+	GRiMesh* pDrawPacketMesh = nullptr;
+	UINT mDrawPacketMeshVersion = 0;
+	UINT mDrawPacketVersion = (UINT)-1;
+
+	void BuildDrawPackets();
+
 };
 
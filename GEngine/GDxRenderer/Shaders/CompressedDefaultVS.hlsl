@@ -0,0 +1,5 @@
+
+// DefaultVS.hlsl for the vertices of GDxInputLayout::CompressedLayout.
+#define COMPRESSED_VERTICES 1
+
+#include "DefaultVS.hlsl"
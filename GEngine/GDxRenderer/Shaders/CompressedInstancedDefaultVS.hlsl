@@ -0,0 +1,5 @@
+
+// InstancedDefaultVS.hlsl for the vertices of GDxInputLayout::CompressedLayout.
+#define COMPRESSED_VERTICES 1
+
+#include "InstancedDefaultVS.hlsl"
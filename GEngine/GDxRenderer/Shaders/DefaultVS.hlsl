@@ -2,6 +2,7 @@
 #include "Material.hlsli"
 #include "ObjectCB.hlsli"
 #include "MainPassCB.hlsli"
+#include "VertexCompression.hlsli"
 //#include "HaltonSequence.hlsli"
 
 struct Light
@@ -14,6 +15,16 @@ struct Light
 	float SpotPower;    // spot light only
 };
 
+// Compressed vertices are decoded to the same values, see GDxInputLayout::CompressedLayout.
+#if COMPRESSED_VERTICES
+struct VertexInput
+{
+	float4 pos		: POSITION;
+	float2 uv		: TEXCOORD;
+	float2 normal	: NORMAL;
+	float2 tangent	: TANGENT;
+};
+#else
 struct VertexInput
 {
 	float3 pos		: POSITION;
@@ -21,13 +32,15 @@ struct VertexInput
 	float3 normal	: NORMAL;
 	float3 tangent	: TANGENT;
 };
+#endif
 
 struct VertexOutput
 {
 	float4	pos			: SV_POSITION;
 	float2	uv			: TEXCOORD;
 	float3	normal		: NORMAL;
-	float3	tangent		: TANGENT;
+	// w is the tangent sign.
+	float4	tangent		: TANGENT;
 	//float3 worldPos	: POSITION0;
 	float4	curPos		: POSITION0;
 	float4	prevPos		: POSITION1;
@@ -73,20 +86,34 @@ VertexOutput main(VertexInput input)
 
 	MaterialData matData = gMaterialData[gMaterialIndex];
 
+#if COMPRESSED_VERTICES
+	MeshQuantization quantization = gMeshQuantizations[gQuantizationIndex];
+	float3 pos = DecodePosition(input.pos, quantization.PositionScale, quantization.PositionOffset);
+	float3 normal = OctDecode(input.normal);
+	float3 tangent = OctDecode(input.tangent);
+	float tangentSign = DecodeTangentSign(input.pos);
+#else
+	float3 pos = input.pos;
+	float3 normal = input.normal;
+	float3 tangent = input.tangent;
+	// GRiVertex has no tangent sign.
+	float tangentSign = 1.0f;
+#endif
+
 	//float4x4 jitteredViewProj = GetJitteredViewProj();
 
-	float4 worldPos = mul(float4(input.pos, 1.0f), gWorld);
-	float4 prevWorldPos = mul(float4(input.pos, 1.0f), gPrevWorld);
+	float4 worldPos = mul(float4(pos, 1.0f), gWorld);
+	float4 prevWorldPos = mul(float4(pos, 1.0f), gPrevWorld);
 	output.curPos = mul(worldPos, gUnjitteredViewProj);
 	output.prevPos = mul(prevWorldPos, gPrevViewProj);
 	float4 texC = float4(input.uv, 0.0f, 1.0f);
 	output.pos = mul(worldPos, gViewProj);
 	output.uv = mul(texC, matData.MatTransform).xy;
-	output.normal = normalize(mul(input.normal, (float3x3)gInvTransWorld));
-	output.tangent = normalize(mul(input.tangent, (float3x3)gInvTransWorld));
+	output.normal = normalize(mul(normal, (float3x3)gInvTransWorld));
+	output.tangent = float4(normalize(mul(tangent, (float3x3)gInvTransWorld)), tangentSign);
 	//output.worldPos = mul(float4(input.pos, 1.0f), gWorld).xyz;
 	output.linearZ = LinearZ(output.pos);
-	output.shadowPos = mul(float4(input.pos, 1.0f), gShadowTransform);
+	output.shadowPos = mul(float4(pos, 1.0f), gShadowTransform);
 	//output.ssaoPos = mul(worldPos, gViewProjTex);
 	return output;
 }
\ No newline at end of file
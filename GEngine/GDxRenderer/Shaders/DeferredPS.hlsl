@@ -7,7 +7,8 @@ struct VertexOutput
 	float4	pos			: SV_POSITION;
 	float2	uv			: TEXCOORD;
 	float3	normal		: NORMAL;
-	float3	tangent		: TANGENT;
+	// w is the tangent sign.
+	float4	tangent		: TANGENT;
 	//float3 worldPos	: POSITION0;
 	float4	curPos		: POSITION0;
 	float4	prevPos		: POSITION1;
@@ -27,12 +28,12 @@ struct PixelOutput
 Texture2D gTextureMaps[MAX_TEXTURE_NUM] : register(t0);
 SamplerState Sampler	   : register(s0);
 
-float3 calculateNormalFromMap(float3 normalFromTexture, float3 normal, float3 tangent)
+float3 calculateNormalFromMap(float3 normalFromTexture, float3 normal, float4 tangent)
 {
 	float3 unpackedNormal = normalFromTexture * 2.0f - 1.0f;
 	float3 N = normal;
-	float3 T = normalize(tangent - N * dot(tangent, N));
-	float3 B = cross(N, T);
+	float3 T = normalize(tangent.xyz - N * dot(tangent.xyz, N));
+	float3 B = cross(N, T) * tangent.w;
 	float3x3 TBN = float3x3(T, B, N);
 	return normalize(mul(unpackedNormal, TBN));
 }
@@ -1,67 +1,99 @@
-struct VertexInput
+
+#include "Material.hlsli"
+#include "MainPassCB.hlsli"
+#include "VertexCompression.hlsli"
+
+// should be the same with InstanceData in GDxFrameResource.h
+struct InstanceData
 {
-	float3 pos			: POSITION;
-	float2 uv			: TEXCOORD;
-	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
-	float4x4 instancedWorld	: WORLD_INSTANCE; //The instanced world position
+	float4x4 World;
+	float4x4 PrevWorld;
+	float4x4 InvTransWorld;
 };
 
-struct VertexOutput
+// Instances of every batch of the frame, a batch starts at gInstanceOffset.
+StructuredBuffer<InstanceData> gInstanceData : register(t1, space1);
+
+// Compressed vertices are decoded to the same values, see GDxInputLayout::CompressedLayout.
+#if COMPRESSED_VERTICES
+struct VertexInput
 {
-	float4 pos			: SV_POSITION;
-	float2 uv			: TEXCOORD;
-	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
-	float3 worldPos		: POSITION;
-	float linearZ		: LINEARZ;
-	float4 shadowPos	: SHADOWPOS;
+	float4 pos		: POSITION;
+	float2 uv		: TEXCOORD;
+	float2 normal	: NORMAL;
+	float2 tangent	: TANGENT;
 };
-
-cbuffer objectCB : register(b0)
+#else
+struct VertexInput
 {
-	float4x4 worldViewProjection;
-	float4x4 world;
-	float4x4 view;
-	float4x4 projection;
-	float4x4 shadowView;
-	float4x4 shadowProjection;
+	float3 pos		: POSITION;
+	float2 uv		: TEXCOORD;
+	float3 normal	: NORMAL;
+	float3 tangent	: TANGENT;
 };
+#endif
 
-cbuffer PerFrame : register(b1)
+// should be the same with DefaultVS.hlsl, both feed DeferredPS.hlsl
+struct VertexOutput
 {
-	float nearZ;
-	float farZ;
-	float2 lightPerspectiveValues;
+	float4	pos			: SV_POSITION;
+	float2	uv			: TEXCOORD;
+	float3	normal		: NORMAL;
+	// w is the tangent sign.
+	float4	tangent		: TANGENT;
+	float4	curPos		: POSITION0;
+	float4	prevPos		: POSITION1;
+	float	linearZ		: LINEARZ;
+	float4	shadowPos	: SHADOWPOS;
 };
 
-float2 ProjectionConstants(float nearZ, float farZ)
+float2 ProjectionConstants(float gNearZ, float gFarZ)
 {
 	float2 projectionConstants;
-	projectionConstants.x = farZ / (farZ - nearZ);
-	projectionConstants.y = (-farZ * nearZ) / (farZ - nearZ);
+	projectionConstants.x = gFarZ / (gFarZ - gNearZ);
+	projectionConstants.y = (-gFarZ * gNearZ) / (gFarZ - gNearZ);
 	return projectionConstants;
 }
 
 float LinearZ(float4 outPosition)
 {
-	float2 projectionConstants = ProjectionConstants(nearZ, farZ);
+	float2 projectionConstants = ProjectionConstants(gNearZ, gFarZ);
 	float depth = outPosition.z / outPosition.w;
 	float linearZ = projectionConstants.y / (depth - projectionConstants.x);
 	return linearZ;
 }
 
-VertexOutput main(VertexInput input)
+VertexOutput main(VertexInput input, uint instanceID : SV_InstanceID)
 {
 	VertexOutput output;
-	float4x4 shadowVP = mul(mul(input.instancedWorld, shadowView), shadowProjection);
-	matrix instancedWorldViewProj = mul(mul(input.instancedWorld, view), projection);
-	output.pos = mul(float4(input.pos, 1.0f), instancedWorldViewProj);
-	output.uv = input.uv;
-	output.normal = normalize(mul(input.normal, (float3x3)input.instancedWorld));
-	output.tangent = normalize(mul(input.tangent, (float3x3)input.instancedWorld));
-	output.worldPos = mul(float4(input.pos, 1.0f), input.instancedWorld).xyz;
+
+	MaterialData matData = gMaterialData[gMaterialIndex];
+	InstanceData instData = gInstanceData[gInstanceOffset + instanceID];
+
+#if COMPRESSED_VERTICES
+	MeshQuantization quantization = gMeshQuantizations[gQuantizationIndex];
+	float3 pos = DecodePosition(input.pos, quantization.PositionScale, quantization.PositionOffset);
+	float3 normal = OctDecode(input.normal);
+	float3 tangent = OctDecode(input.tangent);
+	float tangentSign = DecodeTangentSign(input.pos);
+#else
+	float3 pos = input.pos;
+	float3 normal = input.normal;
+	float3 tangent = input.tangent;
+	// GRiVertex has no tangent sign.
+	float tangentSign = 1.0f;
+#endif
+
+	float4 worldPos = mul(float4(pos, 1.0f), instData.World);
+	float4 prevWorldPos = mul(float4(pos, 1.0f), instData.PrevWorld);
+	output.curPos = mul(worldPos, gUnjitteredViewProj);
+	output.prevPos = mul(prevWorldPos, gPrevViewProj);
+	float4 texC = float4(input.uv, 0.0f, 1.0f);
+	output.pos = mul(worldPos, gViewProj);
+	output.uv = mul(texC, matData.MatTransform).xy;
+	output.normal = normalize(mul(normal, (float3x3)instData.InvTransWorld));
+	output.tangent = float4(normalize(mul(tangent, (float3x3)instData.InvTransWorld)), tangentSign);
 	output.linearZ = LinearZ(output.pos);
-	output.shadowPos = mul(float4(input.pos, 1.0f), shadowVP);
+	output.shadowPos = mul(float4(pos, 1.0f), gShadowTransform);
 	return output;
-}
\ No newline at end of file
+}
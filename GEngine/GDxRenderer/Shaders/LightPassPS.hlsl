@@ -27,6 +27,12 @@
 
 StructuredBuffer<LightList> gLightList : register(t0);
 
+#if USE_CPU_LIGHT_CLUSTERING
+// (offset, count) per cluster and the point light indices they point to.
+StructuredBuffer<uint2> gClusterLightRanges		: register(t0, space1);
+StructuredBuffer<uint> gClusterLightIndices		: register(t1, space1);
+#endif
+
 //G-Buffer
 Texture2D gAlbedoTexture			: register(t1);
 Texture2D gNormalTexture			: register(t2);
@@ -117,12 +123,18 @@ float4 main(VertexToPixel pIn) : SV_TARGET
 	gridId = (offsetY * ceil(gRenderTargetSize.x / CLUSTER_SIZE_X) + offsetX) * CLUSTER_NUM_Z + clusterZ;
 #endif
 
+#if USE_CBDR && USE_CPU_LIGHT_CLUSTERING
+	uint2 clusterLightRange = gClusterLightRanges[gridId];
+	uint numPointLight = clusterLightRange.y;
+	uint numSpotlight = 0;
+#else
 	uint numPointLight = gLightList[gridId].NumPointLights;
 	uint numSpotlight = gLightList[gridId].NumSpotlights;
 	if (numPointLight > MAX_GRID_POINT_LIGHT_NUM)
 		numPointLight = MAX_GRID_POINT_LIGHT_NUM;
 	if (numSpotlight > MAX_GRID_SPOTLIGHT_NUM)
 		numSpotlight = MAX_GRID_SPOTLIGHT_NUM;
+#endif
 
 #if VISUALIZE_GRID_LIGHT_NUM
 	float lightNum = float(numPointLight + numSpotlight) / 30.0f;
@@ -151,11 +163,16 @@ float4 main(VertexToPixel pIn) : SV_TARGET
 	// Point light.
 	for (i = 0; i < numPointLight; i++)
 	{
+#if USE_CPU_LIGHT_CLUSTERING
+		uint lightIndex = gClusterLightIndices[clusterLightRange.x + i];
+#else
+		uint lightIndex = gLightList[gridId].PointLightIndices[i];
+#endif
 		shadowAmount = 1.f;
-		float atten = Attenuate(pointLight[gLightList[gridId].PointLightIndices[i]].Position, pointLight[gLightList[gridId].PointLightIndices[i]].Range, worldPos);
-		float lightIntensity = pointLight[gLightList[gridId].PointLightIndices[i]].Intensity * atten;
-		float3 toLight = normalize(pointLight[gLightList[gridId].PointLightIndices[i]].Position - worldPos);
-		float3 lightColor = pointLight[gLightList[gridId].PointLightIndices[i]].Color.rgb;
+		float atten = Attenuate(pointLight[lightIndex].Position, pointLight[lightIndex].Range, worldPos);
+		float lightIntensity = pointLight[lightIndex].Intensity * atten;
+		float3 toLight = normalize(pointLight[lightIndex].Position - worldPos);
+		float3 lightColor = pointLight[lightIndex].Color.rgb;
 
 		finalColor = finalColor + DirectPBR(lightIntensity, lightColor, toLight, normalize(normal), worldPos, cameraPosition, roughness, metal, albedo, shadowAmount);
 	}
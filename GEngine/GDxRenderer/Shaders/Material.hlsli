@@ -15,6 +15,10 @@
 cbuffer cbPerSubmesh : register(b0, space1)
 {
 	uint gMaterialIndex;
+	// First instance of the batch in the instance buffer, instanced draws only.
+	uint gInstanceOffset;
+	// Entry of the mesh in gMeshQuantizations, compressed vertices only.
+	uint gQuantizationIndex;
 	//uint gObjPad0;
 	//uint gObjPad1;
 	//uint gObjPad2;
@@ -12,6 +12,9 @@
 
 #define CONE_COTANGENT 8.0f
 
+// should be the same with GDxRenderer.h
+#define SDF_CLIPMAP_LEVEL_NUM 4
+
 struct VertexToPixel
 {
 	float4 position		: SV_POSITION;
@@ -38,6 +41,14 @@ StructuredBuffer<SceneObjectSdfDescriptor> gSceneObjectSdfDescriptors : register
 
 Texture2D gDepthBuffer				: register(t2);
 
+// (offset, count) into gSdfTileObjectIndices for every light space tile.
+StructuredBuffer<uint2> gSdfTileRanges : register(t3);
+StructuredBuffer<uint> gSdfTileObjectIndices : register(t4);
+
+// Global distance clipmap, BrickSize^3 distances per brick with x fastest. Bricks are stored in toroidal slot order,
+// level after level.
+StructuredBuffer<float> gSdfClipmap : register(t5);
+
 Texture3D gSdfTextures[MAX_SCENE_OBJECT_NUM] : register(t0, space1);
 
 SamplerState			basicSampler	: register(s0);
@@ -46,9 +57,28 @@ SamplerComparisonState	shadowSampler	: register(s1);
 cbuffer cbSDF : register(b0)
 {
 	uint gSceneObjectNum;
-	//uint gPad0;
-	//uint gPad1;
-	//uint gPad2;
+	uint gSdfTileNum;
+	float2 gSdfTileOrigin;
+	float3 gSdfTileAxisU;
+	float gSdfTileInvTileSize;
+	float3 gSdfTileAxisV;
+	uint gSdfTileEnabled;
+};
+
+struct SdfClipmapLevel
+{
+	// Window minimum corner in voxels.
+	int3 Origin;
+	float VoxelSize;
+};
+
+cbuffer cbSdfClipmap : register(b2)
+{
+	SdfClipmapLevel gSdfClipmapLevels[SDF_CLIPMAP_LEVEL_NUM];
+	uint gSdfClipmapResolution;
+	uint gSdfClipmapBrickSize;
+	uint gSdfClipmapLevelNum;
+	uint gSdfClipmapEnabled;
 };
 
 float3 ReconstructWorldPos(float2 uv, float depth)
@@ -60,6 +90,62 @@ float3 ReconstructWorldPos(float2 uv, float depth)
 	return mul(viewPos, gInvView).xyz;
 }
 
+float LoadClipmapVoxel(uint level, int3 voxel)
+{
+	int res = (int)gSdfClipmapResolution;
+	uint brickSize = gSdfClipmapBrickSize;
+	uint brickNum = gSdfClipmapResolution / brickSize;
+
+	uint3 wrapped = (uint3)(((voxel % res) + res) % res);
+	uint3 brick = wrapped / brickSize;
+	uint3 local = wrapped % brickSize;
+
+	uint brickIndex = level * brickNum * brickNum * brickNum + (brick.z * brickNum + brick.y) * brickNum + brick.x;
+	return gSdfClipmap[(brickIndex * brickSize + local.z) * brickSize * brickSize + local.y * brickSize + local.x];
+}
+
+// Trilinear distance in the finest level holding all eight voxels around the position, false outside the clipmap.
+bool SampleClipmap(float3 pos, out float dist)
+{
+	dist = 0.0f;
+	for (uint level = 0; level < gSdfClipmapLevelNum; level++)
+	{
+		float3 voxelPos = pos / gSdfClipmapLevels[level].VoxelSize - 0.5f;
+		int3 v0 = (int3)floor(voxelPos);
+		int3 windowMin = gSdfClipmapLevels[level].Origin;
+		int3 windowMax = windowMin + (int)gSdfClipmapResolution - 1;
+		if (any(v0 < windowMin) || any(v0 + 1 > windowMax))
+			continue;
+
+		float3 f = voxelPos - (float3)v0;
+		float c00 = lerp(LoadClipmapVoxel(level, v0 + int3(0, 0, 0)), LoadClipmapVoxel(level, v0 + int3(1, 0, 0)), f.x);
+		float c10 = lerp(LoadClipmapVoxel(level, v0 + int3(0, 1, 0)), LoadClipmapVoxel(level, v0 + int3(1, 1, 0)), f.x);
+		float c01 = lerp(LoadClipmapVoxel(level, v0 + int3(0, 0, 1)), LoadClipmapVoxel(level, v0 + int3(1, 0, 1)), f.x);
+		float c11 = lerp(LoadClipmapVoxel(level, v0 + int3(0, 1, 1)), LoadClipmapVoxel(level, v0 + int3(1, 1, 1)), f.x);
+		dist = lerp(lerp(c00, c10, f.y), lerp(c01, c11, f.y), f.z);
+		return true;
+	}
+	return false;
+}
+
+// One march through the merged distance field of every object, the ray ends where it leaves the clipmap.
+float TraceClipmap(float3 origin, float3 dir)
+{
+	float shadow = 1.0f;
+	float totalDis = 0.0f;
+	for (int step = 0; step < MAX_STEP && totalDis < MAX_DISTANCE; step++)
+	{
+		float dist;
+		if (!SampleClipmap(origin + dir * totalDis, dist))
+			break;
+
+		dist = clamp(dist, MIN_STEP_LENGTH, dist + 1);
+		totalDis += dist;
+		shadow = min(shadow, saturate(CONE_COTANGENT * dist / totalDis));
+	}
+	return shadow;
+}
+
 float main(VertexToPixel pIn) : SV_TARGET
 {
 
@@ -67,9 +153,33 @@ float main(VertexToPixel pIn) : SV_TARGET
 	float3 origin = ReconstructWorldPos(pIn.uv, depthBuffer);
 	float3 dir = -normalize(gMainDirectionalLightDir.xyz) * STEP_LENGTH;
 
+	if (gSdfClipmapEnabled)
+		return TraceClipmap(origin, -normalize(gMainDirectionalLightDir.xyz));
+
+	// Only objects overlapping the tile the origin projects to can be hit by the ray.
+	uint objOffset = 0;
+	uint objNum = gSceneObjectNum;
+	if (gSdfTileEnabled)
+	{
+		float2 tileCoord = (float2(dot(origin, gSdfTileAxisU), dot(origin, gSdfTileAxisV)) - gSdfTileOrigin) * gSdfTileInvTileSize;
+		int2 tile = (int2)floor(tileCoord);
+		if (any(tile < 0) || any(tile >= (int)gSdfTileNum))
+		{
+			objNum = 0;
+		}
+		else
+		{
+			uint2 range = gSdfTileRanges[tile.y * gSdfTileNum + tile.x];
+			objOffset = range.x;
+			objNum = range.y;
+		}
+	}
+
 	float shadow = 1.0f;
-	for (int i = 0; i < gSceneObjectNum; i++)
+	for (uint objInd = 0; objInd < objNum; objInd++)
 	{
+		uint i = gSdfTileEnabled ? gSdfTileObjectIndices[objOffset + objInd] : objInd;
+
 		int sdfInd = gSceneObjectSdfDescriptors[i].SdfIndex;
 
 		float3 objOrigin = mul(float4(origin, 1.0f), gSceneObjectSdfDescriptors[i].objInvWorld).xyz;
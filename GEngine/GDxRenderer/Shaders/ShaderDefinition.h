@@ -74,6 +74,10 @@ static const float DepthSlicing_16[17] = {
 	5000.0f, 50000.0f
 };
 
+// Assign the point lights to the clusters on the cpu instead of in ClusteredDeferredCS. The lists have no fixed
+// capacity, the light pass reads them as (offset, count) pairs into one index buffer.
+#define USE_CPU_LIGHT_CLUSTERING 0
+
 
 //----------------------------------------------------------------------------------------------------------
 // Light
@@ -81,6 +85,22 @@ static const float DepthSlicing_16[17] = {
 #define MAX_GRID_POINT_LIGHT_NUM 80
 #define MAX_GRID_SPOTLIGHT_NUM 20
 
+
+//----------------------------------------------------------------------------------------------------------
+// Instancing
+//----------------------------------------------------------------------------------------------------------
+// Capacity of the per frame instance buffer, draws beyond it are issued without instancing.
+#define MAX_INSTANCE_NUM 8192
+
+
+//----------------------------------------------------------------------------------------------------------
+// SDF shadow
+//----------------------------------------------------------------------------------------------------------
+// Tiles along each axis of the light space grid the sdf objects are culled against.
+#define SDF_TILE_NUM 64
+
+#define SDF_TILE_MAX_INDEX_NUM (SDF_TILE_NUM * SDF_TILE_NUM * 32)
+
  
 
 
@@ -0,0 +1,41 @@
+
+#ifndef _VERTEXCOMPRESSION_HLSLI
+#define _VERTEXCOMPRESSION_HLSLI
+
+
+
+// Decoding of the compressed vertex layout, should be the same with GRiVertexCompressor::Decode.
+
+// should be the same with MeshQuantizationData in GDxFrameResource.h
+struct MeshQuantization
+{
+	float4 PositionScale;
+	float4 PositionOffset;
+};
+
+// Dequantization of every mesh with compressed vertices, see GDxQuantizationTable.
+StructuredBuffer<MeshQuantization> gMeshQuantizations : register(t2, space1);
+
+// The input assembler already expanded the unorm position to [0, 1].
+float3 DecodePosition(float4 position, float4 positionScale, float4 positionOffset)
+{
+	return positionOffset.xyz + positionScale.xyz * position.xyz;
+}
+
+// The unorm w of the position is 0 for a tangent sign of -1 and 1 for +1.
+float DecodeTangentSign(float4 position)
+{
+	return position.w * 2.0f - 1.0f;
+}
+
+// The snorm components are already in [-1, 1].
+float3 OctDecode(float2 oct)
+{
+	float3 v = float3(oct, 1.0f - abs(oct.x) - abs(oct.y));
+	float t = max(-v.z, 0.0f);
+	v.x += v.x >= 0.0f ? -t : t;
+	v.y += v.y >= 0.0f ? -t : t;
+	return normalize(v);
+}
+
+#endif 
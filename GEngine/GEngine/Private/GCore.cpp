@@ -668,9 +668,13 @@ void GCore::LoadMeshes()
 	std::vector<std::wstring> files = std::move(GetAllFilesInFolder(L"Content", true, format));
 	for (auto file : files)
 	{
+#if USE_COOKED_MESHES
+		geo = LoadCookedMesh(file);
+#else
 		meshData.clear();
 		mRenderer->GetFilmboxManager()->ImportFbxFile_Mesh(WorkDirectory + file, meshData);
 		geo = pRendererFactory->CreateMesh(meshData);
+#endif
 		for (auto& subMesh : geo->Submeshes)
 		{
 			subMesh.second.SetMaterial(mMaterials[L"Default"].get());
@@ -710,6 +714,46 @@ void GCore::LoadMeshes()
 	}
 }
 
+GRiMesh* GCore::LoadCookedMesh(std::wstring file)
+{
+	// Cooked files are named after the hash of their source, so an edited source is simply cooked again.
+	std::wstring cookedDirectory = WorkDirectory + L"Cooked\\";
+	UINT64 sourceHash = GRiMeshCooker::HashFile(WorkDirectory + file);
+	std::wstring cookedPath = GRiMeshCooker::GetCookedPath(cookedDirectory, sourceHash);
+
+	GRiCookedMesh cookedMesh;
+	if (!cookedMesh.Open(cookedPath, sourceHash))
+	{
+		std::vector<GRiMeshData> meshData;
+		mRenderer->GetFilmboxManager()->ImportFbxFile_Mesh(WorkDirectory + file, meshData);
+
+		CreateDirectoryW(cookedDirectory.c_str(), nullptr);
+		GRiMeshCooker::Cook(cookedPath, sourceHash, meshData, true, true, true, nullptr, nullptr);
+		if (!cookedMesh.Open(cookedPath, sourceHash))
+			ThrowGGiException(L"Failed to cook \"" + file + L"\".");
+	}
+
+	GRiMesh* geo = pRendererFactory->CreateMesh(cookedMesh);
+	geo->CookedFile = cookedPath;
+	geo->SetBvh(cookedMesh.CreateBvh());
+	if (cookedMesh.HasMeshlets())
+	{
+		auto meshlets = std::make_shared<GRiMeshletSet>();
+		meshlets->Init(cookedMesh.GetMeshlets(), cookedMesh.GetMeshletNum());
+		geo->SetMeshlets(meshlets);
+	}
+	if (cookedMesh.HasSdf())
+	{
+		int sdfRes = cookedMesh.GetSdfResolution();
+		std::vector<float> sdf(cookedMesh.GetSdf(), cookedMesh.GetSdf() + sdfRes * sdfRes * sdfRes);
+		geo->SetSdfResolution(sdfRes);
+		geo->SetSdfExtent(cookedMesh.GetSdfExtent());
+		geo->InitializeSdf(sdf);
+	}
+
+	return geo;
+}
+
 void GCore::LoadSceneObjects()
 {
 	mSceneObjectIndex = 0;
@@ -1182,6 +1226,33 @@ void GCore::SetSceneObjectTransform(wchar_t* objName, float* trans)
 	mSceneObjects[sObjectName]->SetScale(trans[6], trans[7], trans[8]);
 }
 
+void GCore::SetSceneObjectParent(wchar_t* objName, wchar_t* parentName)
+{
+	std::wstring sObjectName(objName);
+	std::wstring sParentName(parentName);
+	if (mSceneObjects.find(sObjectName) == mSceneObjects.end())
+	{
+		return;
+	}
+
+	GRiSceneObject* parent = nullptr;
+	if (mSceneObjects.find(sParentName) != mSceneObjects.end())
+	{
+		parent = mSceneObjects[sParentName].get();
+	}
+	mSceneObjects[sObjectName]->SetParent(parent);
+}
+
+const wchar_t* GCore::GetSceneObjectParentName(wchar_t* objName)
+{
+	std::wstring sObjectName(objName);
+	if (mSceneObjects.find(sObjectName) == mSceneObjects.end() || mSceneObjects[sObjectName]->GetParent() == nullptr)
+	{
+		return L"None";
+	}
+	return mSceneObjects[sObjectName]->GetParent()->UniqueName.c_str();
+}
+
 bool GCore::GetTextureSrgb(wchar_t* txtName)
 {
 	std::wstring textureName(txtName);
@@ -1580,6 +1651,7 @@ void GCore::SetMeshSubmeshMaterialUniqueName(wchar_t* meshName, wchar_t* submesh
 		return;
 
 	mMeshes[strMeshName]->Submeshes[strSubmeshName].SetMaterial(mMaterials[strMatName].get());
+	mMeshes[strMeshName]->MaterialVersion++;
 }
 
 const wchar_t* GCore::GetSceneObjectOverrideMaterial(wchar_t* soName, wchar_t* submeshName)
@@ -47,6 +47,11 @@ public:
 
 	void SetSceneObjectTransform(wchar_t* objName, float* trans);
 
+	// An empty or unknown parent name detaches the object. The transform stays relative to the parent.
+	void SetSceneObjectParent(wchar_t* objName, wchar_t* parentName);
+
+	const wchar_t* GetSceneObjectParentName(wchar_t* objName);
+
 	void SetWorkDirectory(wchar_t* dir);
 
 	void SetProjectName(wchar_t* projName);
@@ -181,6 +186,7 @@ private:
 	void LoadTextures();
 	void LoadMaterials();
 	void LoadMeshes();
+	GRiMesh* LoadCookedMesh(std::wstring file);
 	void LoadSceneObjects();
 	void LoadCameras();
 
@@ -47,6 +47,16 @@ void __stdcall SetSceneObjectTransform(wchar_t* objName, float* trans)
 	GCore::GetCore().SetSceneObjectTransform(objName, trans);
 }
 
+void __stdcall SetSceneObjectParent(wchar_t* objName, wchar_t* parentName)
+{
+	GCore::GetCore().SetSceneObjectParent(objName, parentName);
+}
+
+const wchar_t* __stdcall GetSceneObjectParentName(wchar_t* objName)
+{
+	return GCore::GetCore().GetSceneObjectParentName(objName);
+}
+
 bool __stdcall GetTextureSrgb(wchar_t* txtName)
 {
 	return GCore::GetCore().GetTextureSrgb(txtName);
@@ -48,6 +48,16 @@ extern "C"
 	__declspec(dllexport) void __stdcall SetSceneObjectTransform(wchar_t* objName, float* trans);
 }
 
+extern "C"
+{
+	__declspec(dllexport) void __stdcall SetSceneObjectParent(wchar_t* objName, wchar_t* parentName);
+}
+
+extern "C"
+{
+	__declspec(dllexport) const wchar_t* __stdcall GetSceneObjectParentName(wchar_t* objName);
+}
+
 extern "C"
 {
 	__declspec(dllexport) bool __stdcall GetTextureSrgb(wchar_t* txtName);
@@ -11,6 +11,7 @@
 #include "Public/GRiMeshData.h"
 #include "Public/GRiSubmesh.h"
 #include "Public/GRiMesh.h"
+#include "Public/GRiSceneStore.h"
 #include "Public/GRiSceneObject.h"
 #include "Public/GRiGeometryGenerator.h"
 #include "Public/GRiFilmboxManager.h"
@@ -25,6 +26,27 @@
 #include "Public/GRiOcclusionCullingRasterizer.h"
 #include "Public/GRiKdTree.h"
 #include "Public/GRiRay.h"
+#include "Public/GRiSdfClipmap.h"
+#include "Public/GRiSdfTileCuller.h"
+#include "Public/GRiBvh.h"
+#include "Public/GRiDynamicAabbTree.h"
+#include "Public/GRiDrawKey.h"
+#include "Public/GRiRadixSort.h"
+#include "Public/GRiInstanceBatcher.h"
+#include "Public/GRiTlsfAllocator.h"
+#include "Public/GRiIndirectArgumentBuilder.h"
+#include "Public/GRiCommandListScheduler.h"
+#include "Public/GRiRingAllocator.h"
+#include "Public/GRiDirtyList.h"
+#include "Public/GRiLightManager.h"
+#include "Public/GRiLightBvh.h"
+#include "Public/GRiClusteredLightAssigner.h"
+#include "Public/GRiMeshOptimizer.h"
+#include "Public/GRiMeshCooker.h"
+#include "Public/GRiCompressedVertex.h"
+#include "Public/GRiMeshlet.h"
+#include "Public/GRiMeshletBuilder.h"
+#include "Public/GRiMeshletCuller.h"
 
 #define MAX_TEXTURE_NUM 1024
 #define MAX_MATERIAL_NUM 1024
@@ -0,0 +1,751 @@
+#include "stdafx.h"
+#include "GRiBvh.h"
+#include "GRiSceneObject.h"
+
+#define BVH_BIN_NUM 12
+#define BVH_STACK_SIZE 128
+#define BVH_SAH_MAX_DEPTH 64
+#define BVH_MESH_LEAF_PRIMS 4
+#define BVH_SCENE_LEAF_PRIMS 2
+
+// Rebuild the top level tree once refitting has made it this much more expensive than a fresh build.
+#define BVH_SCENE_REBUILD_RATIO 2.0f
+
+
+static inline float HalfSurfaceArea(const float* bMin, const float* bMax)
+{
+	float dx = bMax[0] - bMin[0];
+	float dy = bMax[1] - bMin[1];
+	float dz = bMax[2] - bMin[2];
+	return dx * dy + dx * dz + dy * dz;
+}
+
+void GRiBvh::Build(const std::vector<float>& boundMin, const std::vector<float>& boundMax, int maxLeafPrims)
+{
+	int primNum = (int)boundMin.size() / 3;
+
+	mNodes.clear();
+	mPrimitiveIndices.resize(primNum);
+	for (auto i = 0; i < primNum; i++)
+		mPrimitiveIndices[i] = i;
+
+	if (primNum == 0)
+		return;
+
+	std::vector<float> centroids(primNum * 3);
+	for (auto i = 0; i < primNum * 3; i++)
+		centroids[i] = (boundMin[i] + boundMax[i]) * 0.5f;
+
+	mNodes.reserve(primNum * 2);
+	BuildNode(boundMin, boundMax, centroids, 0, primNum, max(maxLeafPrims, 1), 0);
+}
+
+void GRiBvh::Load(const GRiBvhNode* nodes, int nodeNum, const UINT* primitiveIndices, int primitiveNum)
+{
+	mNodes.assign(nodes, nodes + nodeNum);
+	mPrimitiveIndices.assign(primitiveIndices, primitiveIndices + primitiveNum);
+}
+
+int GRiBvh::BuildNode(const std::vector<float>& boundMin, const std::vector<float>& boundMax, std::vector<float>& centroids, int start, int end, int maxLeafPrims, int depth)
+{
+	int nodeIndex = (int)mNodes.size();
+	mNodes.push_back(GRiBvhNode());
+
+	GRiBvhNode node;
+	float cMin[3], cMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		node.BoundMin[k] = cMin[k] = GGiEngineUtil::Infinity;
+		node.BoundMax[k] = cMax[k] = -GGiEngineUtil::Infinity;
+	}
+	for (auto i = start; i < end; i++)
+	{
+		UINT p = mPrimitiveIndices[i];
+		for (auto k = 0; k < 3; k++)
+		{
+			node.BoundMin[k] = min(node.BoundMin[k], boundMin[p * 3 + k]);
+			node.BoundMax[k] = max(node.BoundMax[k], boundMax[p * 3 + k]);
+			cMin[k] = min(cMin[k], centroids[p * 3 + k]);
+			cMax[k] = max(cMax[k], centroids[p * 3 + k]);
+		}
+	}
+
+	int count = end - start;
+	int axis = 0;
+	for (auto k = 1; k < 3; k++)
+	{
+		if (cMax[k] - cMin[k] > cMax[axis] - cMin[axis])
+			axis = k;
+	}
+
+	if (count <= maxLeafPrims || cMax[axis] <= cMin[axis])
+	{
+		if (count > maxLeafPrims)
+		{
+			// Coincident centroids, split in the middle of the range to keep the leaves small.
+			int mid = (start + end) / 2;
+			node.Count = 0;
+			mNodes[nodeIndex] = node;
+			BuildNode(boundMin, boundMax, centroids, start, mid, maxLeafPrims, depth + 1);
+			mNodes[nodeIndex].Offset = BuildNode(boundMin, boundMax, centroids, mid, end, maxLeafPrims, depth + 1);
+			return nodeIndex;
+		}
+
+		node.Offset = start;
+		node.Count = count;
+		mNodes[nodeIndex] = node;
+		return nodeIndex;
+	}
+
+	// Bin the centroids along the widest axis and pick the split with the lowest surface area heuristic.
+	int binCount[BVH_BIN_NUM] = { 0 };
+	float binMin[BVH_BIN_NUM][3], binMax[BVH_BIN_NUM][3];
+	for (auto b = 0; b < BVH_BIN_NUM; b++)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			binMin[b][k] = GGiEngineUtil::Infinity;
+			binMax[b][k] = -GGiEngineUtil::Infinity;
+		}
+	}
+
+	float binScale = BVH_BIN_NUM / (cMax[axis] - cMin[axis]);
+	auto binOf = [&](UINT p)
+	{
+		int b = (int)((centroids[p * 3 + axis] - cMin[axis]) * binScale);
+		return b < 0 ? 0 : (b >= BVH_BIN_NUM ? BVH_BIN_NUM - 1 : b);
+	};
+
+	for (auto i = start; i < end; i++)
+	{
+		UINT p = mPrimitiveIndices[i];
+		int b = binOf(p);
+		binCount[b]++;
+		for (auto k = 0; k < 3; k++)
+		{
+			binMin[b][k] = min(binMin[b][k], boundMin[p * 3 + k]);
+			binMax[b][k] = max(binMax[b][k], boundMax[p * 3 + k]);
+		}
+	}
+
+	// Sweep from the right to get the cost of every right hand side.
+	float rightArea[BVH_BIN_NUM];
+	int rightCount[BVH_BIN_NUM];
+	float accMin[3], accMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		accMin[k] = GGiEngineUtil::Infinity;
+		accMax[k] = -GGiEngineUtil::Infinity;
+	}
+	int accCount = 0;
+	for (auto b = BVH_BIN_NUM - 1; b > 0; b--)
+	{
+		accCount += binCount[b];
+		for (auto k = 0; k < 3; k++)
+		{
+			accMin[k] = min(accMin[k], binMin[b][k]);
+			accMax[k] = max(accMax[k], binMax[b][k]);
+		}
+		rightCount[b] = accCount;
+		rightArea[b] = accCount > 0 ? HalfSurfaceArea(accMin, accMax) : 0.0f;
+	}
+
+	float bestCost = GGiEngineUtil::Infinity;
+	int bestSplit = -1;
+	for (auto k = 0; k < 3; k++)
+	{
+		accMin[k] = GGiEngineUtil::Infinity;
+		accMax[k] = -GGiEngineUtil::Infinity;
+	}
+	accCount = 0;
+
+	// Past the depth limit only median splits are taken, which bounds the traversal stack.
+	for (auto b = 0; b < BVH_BIN_NUM - 1 && depth < BVH_SAH_MAX_DEPTH; b++)
+	{
+		accCount += binCount[b];
+		for (auto k = 0; k < 3; k++)
+		{
+			accMin[k] = min(accMin[k], binMin[b][k]);
+			accMax[k] = max(accMax[k], binMax[b][k]);
+		}
+		if (accCount == 0 || rightCount[b + 1] == 0)
+			continue;
+
+		float cost = accCount * HalfSurfaceArea(accMin, accMax) + rightCount[b + 1] * rightArea[b + 1];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestSplit = b;
+		}
+	}
+
+	int mid;
+	if (bestSplit >= 0)
+	{
+		auto it = std::partition(mPrimitiveIndices.begin() + start, mPrimitiveIndices.begin() + end,
+			[&](UINT p) { return binOf(p) <= bestSplit; });
+		mid = (int)(it - mPrimitiveIndices.begin());
+	}
+	else
+	{
+		mid = (start + end) / 2;
+		std::nth_element(mPrimitiveIndices.begin() + start, mPrimitiveIndices.begin() + mid, mPrimitiveIndices.begin() + end,
+			[&](UINT a, UINT b) { return centroids[a * 3 + axis] < centroids[b * 3 + axis]; });
+	}
+
+	node.Count = 0;
+	mNodes[nodeIndex] = node;
+	BuildNode(boundMin, boundMax, centroids, start, mid, maxLeafPrims, depth + 1);
+	mNodes[nodeIndex].Offset = BuildNode(boundMin, boundMax, centroids, mid, end, maxLeafPrims, depth + 1);
+	return nodeIndex;
+}
+
+void GRiBvh::Refit(const std::vector<float>& boundMin, const std::vector<float>& boundMax)
+{
+	// Children always follow their parent, so a reverse sweep visits them first.
+	for (auto i = (int)mNodes.size() - 1; i >= 0; i--)
+	{
+		auto& node = mNodes[i];
+		if (node.Count > 0)
+		{
+			for (auto k = 0; k < 3; k++)
+			{
+				node.BoundMin[k] = GGiEngineUtil::Infinity;
+				node.BoundMax[k] = -GGiEngineUtil::Infinity;
+			}
+			for (auto j = node.Offset; j < node.Offset + node.Count; j++)
+			{
+				UINT p = mPrimitiveIndices[j];
+				for (auto k = 0; k < 3; k++)
+				{
+					node.BoundMin[k] = min(node.BoundMin[k], boundMin[p * 3 + k]);
+					node.BoundMax[k] = max(node.BoundMax[k], boundMax[p * 3 + k]);
+				}
+			}
+		}
+		else
+		{
+			auto& left = mNodes[i + 1];
+			auto& right = mNodes[node.Offset];
+			for (auto k = 0; k < 3; k++)
+			{
+				node.BoundMin[k] = min(left.BoundMin[k], right.BoundMin[k]);
+				node.BoundMax[k] = max(left.BoundMax[k], right.BoundMax[k]);
+			}
+		}
+	}
+}
+
+float GRiBvh::GetCost()
+{
+	if (mNodes.size() == 0)
+		return 0.0f;
+
+	float rootArea = HalfSurfaceArea(mNodes[0].BoundMin, mNodes[0].BoundMax);
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float area = 0.0f;
+	for (auto& node : mNodes)
+	{
+		if (node.Count == 0)
+			area += HalfSurfaceArea(node.BoundMin, node.BoundMax);
+	}
+	return area / rootArea;
+}
+
+const std::vector<GRiBvhNode>& GRiBvh::GetNodes()
+{
+	return mNodes;
+}
+
+const std::vector<UINT>& GRiBvh::GetPrimitiveIndices()
+{
+	return mPrimitiveIndices;
+}
+
+bool GRiBvh::IntersectBound(const GRiBvhNode& node, const float* origin, const float* invDir, float tMax, float& tNear)
+{
+	float t0 = 0.0f, t1 = tMax;
+	for (auto k = 0; k < 3; k++)
+	{
+		float tA = (node.BoundMin[k] - origin[k]) * invDir[k];
+		float tB = (node.BoundMax[k] - origin[k]) * invDir[k];
+		if (tA > tB)
+			std::swap(tA, tB);
+
+		// Keep the test conservative against rounding, same as GRiBoundingBox::Intersect().
+		tB *= 1 + 2 * GGiEngineUtil::gamma(3);
+		t0 = tA > t0 ? tA : t0;
+		t1 = tB < t1 ? tB : t1;
+		if (t0 > t1)
+			return false;
+	}
+	tNear = t0;
+	return true;
+}
+
+static inline void ComputeInvDir(const float* dir, float* invDir)
+{
+	for (auto k = 0; k < 3; k++)
+		invDir[k] = dir[k] != 0.0f ? 1.0f / dir[k] : GGiEngineUtil::Infinity;
+}
+
+// Pushes the children hit by the ray, the nearer one last so that it is visited first and tMax shrinks early.
+static inline void PushChildren(const std::vector<GRiBvhNode>& nodes, int nodeIndex, const float* origin, const float* invDir, float tMax, int* stack, int& stackSize)
+{
+	int first = nodeIndex + 1;
+	int second = nodes[nodeIndex].Offset;
+	float tFirst, tSecond;
+	bool bFirst = GRiBvh::IntersectBound(nodes[first], origin, invDir, tMax, tFirst);
+	bool bSecond = GRiBvh::IntersectBound(nodes[second], origin, invDir, tMax, tSecond);
+	if (bFirst && bSecond)
+	{
+		if (tSecond < tFirst)
+			std::swap(first, second);
+		stack[stackSize++] = second;
+		stack[stackSize++] = first;
+	}
+	else if (bFirst)
+	{
+		stack[stackSize++] = first;
+	}
+	else if (bSecond)
+	{
+		stack[stackSize++] = second;
+	}
+}
+
+void GRiMeshBvh::Build(std::vector<float> positions, std::vector<UINT> indices)
+{
+	mPositions = std::move(positions);
+	mIndices = std::move(indices);
+
+	int triNum = (int)mIndices.size() / 3;
+	std::vector<float> boundMin(triNum * 3), boundMax(triNum * 3);
+	for (auto t = 0; t < triNum; t++)
+	{
+		const float* v0 = &mPositions[mIndices[t * 3 + 0] * 3];
+		const float* v1 = &mPositions[mIndices[t * 3 + 1] * 3];
+		const float* v2 = &mPositions[mIndices[t * 3 + 2] * 3];
+		for (auto k = 0; k < 3; k++)
+		{
+			boundMin[t * 3 + k] = min(min(v0[k], v1[k]), v2[k]);
+			boundMax[t * 3 + k] = max(max(v0[k], v1[k]), v2[k]);
+		}
+	}
+
+	mBvh.Build(boundMin, boundMax, BVH_MESH_LEAF_PRIMS);
+}
+
+void GRiMeshBvh::Load(std::vector<float> positions, std::vector<UINT> indices, const GRiBvhNode* nodes, int nodeNum, const UINT* primitiveIndices, int primitiveNum)
+{
+	mPositions = std::move(positions);
+	mIndices = std::move(indices);
+
+	mBvh.Load(nodes, nodeNum, primitiveIndices, primitiveNum);
+}
+
+bool GRiMeshBvh::IntersectTriangle(UINT tri, const float* origin, const float* dir, float tMax, float& t)
+{
+	// Moller-Trumbore, two sided.
+	const float* v0 = &mPositions[mIndices[tri * 3 + 0] * 3];
+	const float* v1 = &mPositions[mIndices[tri * 3 + 1] * 3];
+	const float* v2 = &mPositions[mIndices[tri * 3 + 2] * 3];
+
+	float e1[3] = { v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2] };
+	float e2[3] = { v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2] };
+	float p[3] = {
+		dir[1] * e2[2] - dir[2] * e2[1],
+		dir[2] * e2[0] - dir[0] * e2[2],
+		dir[0] * e2[1] - dir[1] * e2[0]
+	};
+	float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+	if (fabsf(det) < 1e-12f)
+		return false;
+
+	float invDet = 1.0f / det;
+	float s[3] = { origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2] };
+	float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+	if (u < 0.0f || u > 1.0f)
+		return false;
+
+	float q[3] = {
+		s[1] * e1[2] - s[2] * e1[1],
+		s[2] * e1[0] - s[0] * e1[2],
+		s[0] * e1[1] - s[1] * e1[0]
+	};
+	float v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * invDet;
+	if (v < 0.0f || u + v > 1.0f)
+		return false;
+
+	float tt = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+	if (tt < 0.0f || tt > tMax)
+		return false;
+
+	t = tt;
+	return true;
+}
+
+bool GRiMeshBvh::Intersect(const GRiRay& ray, float& tHit, UINT& triangleIndex)
+{
+	auto& nodes = mBvh.GetNodes();
+	auto& prims = mBvh.GetPrimitiveIndices();
+	if (nodes.size() == 0)
+		return false;
+
+	float invDir[3];
+	ComputeInvDir(ray.Direction, invDir);
+
+	float tMax = ray.tMax;
+	bool bHit = false;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		auto& node = nodes[nodeIndex];
+
+		float tNear;
+		if (!GRiBvh::IntersectBound(node, ray.Origin, invDir, tMax, tNear))
+			continue;
+
+		if (node.Count > 0)
+		{
+			for (auto i = node.Offset; i < node.Offset + node.Count; i++)
+			{
+				float t;
+				if (IntersectTriangle(prims[i], ray.Origin, ray.Direction, tMax, t))
+				{
+					tMax = t;
+					triangleIndex = prims[i];
+					bHit = true;
+				}
+			}
+		}
+		else
+		{
+			PushChildren(nodes, nodeIndex, ray.Origin, invDir, tMax, stack, stackSize);
+		}
+	}
+
+	if (bHit)
+		tHit = tMax;
+	return bHit;
+}
+
+GRiBoundingBox GRiMeshBvh::GetBounds()
+{
+	GRiBoundingBox bounds;
+	auto& nodes = mBvh.GetNodes();
+	for (auto k = 0; k < 3; k++)
+	{
+		if (nodes.size() == 0)
+		{
+			bounds.Center[k] = 0.0f;
+			bounds.Extents[k] = 0.0f;
+		}
+		else
+		{
+			bounds.Center[k] = (nodes[0].BoundMin[k] + nodes[0].BoundMax[k]) * 0.5f;
+			bounds.Extents[k] = (nodes[0].BoundMax[k] - nodes[0].BoundMin[k]) * 0.5f;
+		}
+	}
+	return bounds;
+}
+
+int GRiMeshBvh::GetTriangleNum()
+{
+	return (int)mIndices.size() / 3;
+}
+
+const std::vector<GRiBvhNode>& GRiMeshBvh::GetNodes()
+{
+	return mBvh.GetNodes();
+}
+
+const std::vector<UINT>& GRiMeshBvh::GetPrimitiveIndices()
+{
+	return mBvh.GetPrimitiveIndices();
+}
+
+void GRiSceneBvh::Update(const std::vector<GRiSceneObject*>& sceneObjects)
+{
+	std::vector<GRiSceneBvhInstance> instances;
+	instances.reserve(sceneObjects.size());
+
+	bool bRebuild = false;
+	bool bMoved = false;
+	for (auto so : sceneObjects)
+	{
+		auto mesh = so->GetMesh();
+		if (mesh == nullptr || mesh->GetBvh() == nullptr)
+			continue;
+
+		if (so->IsTransformDirty())
+			so->UpdateTransform();
+
+		GRiSceneBvhInstance inst;
+		inst.SceneObject = so;
+		inst.MeshBvh = mesh->GetBvh().get();
+
+		GGiFloat4x4 world = so->GetTransform();
+		for (auto i = 0; i < 4; i++)
+		{
+			for (auto j = 0; j < 4; j++)
+			{
+				inst.World[i][j] = world.GetElement(i, j);
+			}
+		}
+
+		// Reuse the previous instance while nothing changed, the object order is stable between frames.
+		size_t slot = instances.size();
+		if (slot < mInstances.size() &&
+			mInstances[slot].SceneObject == inst.SceneObject &&
+			mInstances[slot].MeshBvh == inst.MeshBvh)
+		{
+			if (memcmp(mInstances[slot].World, inst.World, sizeof(inst.World)) == 0)
+			{
+				instances.push_back(mInstances[slot]);
+				continue;
+			}
+			bMoved = true;
+		}
+		else
+		{
+			bRebuild = true;
+		}
+
+		auto inv = world.GetInverse();
+		for (auto i = 0; i < 4; i++)
+		{
+			for (auto j = 0; j < 4; j++)
+			{
+				inst.InvWorld[i][j] = inv.GetElement(i, j);
+			}
+		}
+
+		auto localBounds = inst.MeshBvh->GetBounds();
+		for (auto k = 0; k < 3; k++)
+		{
+			float center = inst.World[3][k];
+			float extent = 0.0f;
+			for (auto i = 0; i < 3; i++)
+			{
+				center += localBounds.Center[i] * inst.World[i][k];
+				extent += localBounds.Extents[i] * fabsf(inst.World[i][k]);
+			}
+			inst.BoundMin[k] = center - extent;
+			inst.BoundMax[k] = center + extent;
+		}
+
+		instances.push_back(inst);
+	}
+
+	if (instances.size() != mInstances.size())
+		bRebuild = true;
+
+	mInstances.swap(instances);
+
+	if (!bRebuild && !bMoved)
+		return;
+
+	mBoundMin.resize(mInstances.size() * 3);
+	mBoundMax.resize(mInstances.size() * 3);
+	for (size_t i = 0; i < mInstances.size(); i++)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			mBoundMin[i * 3 + k] = mInstances[i].BoundMin[k];
+			mBoundMax[i * 3 + k] = mInstances[i].BoundMax[k];
+		}
+	}
+
+	if (!bRebuild)
+	{
+		mBvh.Refit(mBoundMin, mBoundMax);
+		if (mBvh.GetCost() <= mBuildCost * BVH_SCENE_REBUILD_RATIO)
+			return;
+	}
+
+	mBvh.Build(mBoundMin, mBoundMax, BVH_SCENE_LEAF_PRIMS);
+	mBuildCost = mBvh.GetCost();
+}
+
+bool GRiSceneBvh::IntersectInstance(const GRiSceneBvhInstance& inst, const GRiRay& ray, float tMax, GRiRayHit& hit)
+{
+	// Keep the local direction unnormalized so that the hit distance stays in units of the world ray.
+	GRiRay localRay;
+	for (auto k = 0; k < 3; k++)
+	{
+		localRay.Origin[k] = inst.InvWorld[3][k];
+		localRay.Direction[k] = 0.0f;
+		for (auto i = 0; i < 3; i++)
+		{
+			localRay.Origin[k] += ray.Origin[i] * inst.InvWorld[i][k];
+			localRay.Direction[k] += ray.Direction[i] * inst.InvWorld[i][k];
+		}
+	}
+	localRay.tMax = tMax;
+
+	float t;
+	UINT tri;
+	if (!inst.MeshBvh->Intersect(localRay, t, tri))
+		return false;
+
+	hit.SceneObject = inst.SceneObject;
+	hit.Distance = t;
+	hit.TriangleIndex = tri;
+	for (auto k = 0; k < 3; k++)
+		hit.Position[k] = ray.Origin[k] + ray.Direction[k] * t;
+	return true;
+}
+
+bool GRiSceneBvh::Raycast(const GRiRay& ray, GRiRayHit& hit)
+{
+	auto& nodes = mBvh.GetNodes();
+	auto& prims = mBvh.GetPrimitiveIndices();
+	if (nodes.size() == 0)
+		return false;
+
+	float invDir[3];
+	ComputeInvDir(ray.Direction, invDir);
+
+	float tMax = ray.tMax;
+	bool bHit = false;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		auto& node = nodes[nodeIndex];
+
+		float tNear;
+		if (!GRiBvh::IntersectBound(node, ray.Origin, invDir, tMax, tNear))
+			continue;
+
+		if (node.Count > 0)
+		{
+			for (auto i = node.Offset; i < node.Offset + node.Count; i++)
+			{
+				if (IntersectInstance(mInstances[prims[i]], ray, tMax, hit))
+				{
+					tMax = hit.Distance;
+					bHit = true;
+				}
+			}
+		}
+		else
+		{
+			PushChildren(nodes, nodeIndex, ray.Origin, invDir, tMax, stack, stackSize);
+		}
+	}
+
+	return bHit;
+}
+
+std::vector<GRiRayHit> GRiSceneBvh::RaycastAll(const GRiRay& ray)
+{
+	std::vector<GRiRayHit> hits;
+
+	auto& nodes = mBvh.GetNodes();
+	auto& prims = mBvh.GetPrimitiveIndices();
+	if (nodes.size() == 0)
+		return hits;
+
+	float invDir[3];
+	ComputeInvDir(ray.Direction, invDir);
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		auto& node = nodes[nodeIndex];
+
+		float tNear;
+		if (!GRiBvh::IntersectBound(node, ray.Origin, invDir, ray.tMax, tNear))
+			continue;
+
+		if (node.Count > 0)
+		{
+			for (auto i = node.Offset; i < node.Offset + node.Count; i++)
+			{
+				GRiRayHit hit;
+				if (IntersectInstance(mInstances[prims[i]], ray, ray.tMax, hit))
+					hits.push_back(hit);
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.Offset;
+			stack[stackSize++] = nodeIndex + 1;
+		}
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const GRiRayHit& a, const GRiRayHit& b) { return a.Distance < b.Distance; });
+	return hits;
+}
+
+std::vector<GRiSceneObject*> GRiSceneBvh::Overlap(const GRiBoundingBox& box)
+{
+	std::vector<GRiSceneObject*> ret;
+
+	auto& nodes = mBvh.GetNodes();
+	auto& prims = mBvh.GetPrimitiveIndices();
+	if (nodes.size() == 0)
+		return ret;
+
+	float bMin[3], bMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		bMin[k] = box.BoundMin(k);
+		bMax[k] = box.BoundMax(k);
+	}
+
+	auto overlaps = [&](const float* nMin, const float* nMax)
+	{
+		return nMin[0] <= bMax[0] && nMax[0] >= bMin[0] &&
+			nMin[1] <= bMax[1] && nMax[1] >= bMin[1] &&
+			nMin[2] <= bMax[2] && nMax[2] >= bMin[2];
+	};
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		auto& node = nodes[nodeIndex];
+		if (!overlaps(node.BoundMin, node.BoundMax))
+			continue;
+
+		if (node.Count > 0)
+		{
+			for (auto i = node.Offset; i < node.Offset + node.Count; i++)
+			{
+				auto& inst = mInstances[prims[i]];
+				if (overlaps(inst.BoundMin, inst.BoundMax))
+					ret.push_back(inst.SceneObject);
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.Offset;
+			stack[stackSize++] = nodeIndex + 1;
+		}
+	}
+
+	return ret;
+}
+
+int GRiSceneBvh::GetInstanceNum()
+{
+	return (int)mInstances.size();
+}
+
@@ -0,0 +1,524 @@
+#include "stdafx.h"
+#include "GRiClusteredLightAssigner.h"
+
+#include <chrono>
+
+// Relative slack of the world space bvh query, the lights it returns are tested again in view space.
+#define LIGHT_CLUSTER_BVH_EPSILON 1e-5f
+
+
+void GRiClusteredLightAssigner::Init(UINT tileSizeX, UINT tileSizeY, const float* sliceDepths, UINT sliceNum)
+{
+	if (tileSizeX == 0 || tileSizeY == 0 || sliceNum == 0)
+		ThrowGGiException("Invalid light cluster size.");
+
+	mTileSizeX = tileSizeX;
+	mTileSizeY = tileSizeY;
+	mSliceNum = sliceNum;
+	mSliceDepths.assign(sliceDepths, sliceDepths + sliceNum + 1);
+
+	mTileNumX = 0;
+	mTileNumY = 0;
+	mSlices.clear();
+	mSlices.resize(mSliceNum);
+	mClusterRanges.clear();
+	mLightIndices.clear();
+	mStats = GRiClusteredLightStats();
+}
+
+void GRiClusteredLightAssigner::SetLightBvhEnabled(bool bEnabled)
+{
+	bUseLightBvh = bEnabled;
+}
+
+void GRiClusteredLightAssigner::Assign(GGiThreadPool* tp, UINT width, UINT height, GGiFloat4x4 view, float projScaleX, float projScaleY, const GRiPointLight* lights, UINT lightNum)
+{
+	if (mSliceNum == 0)
+		ThrowGGiException("Light cluster assigner is not initialized.");
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	BuildPlanes(width, height, projScaleX, projScaleY);
+
+	// Move the lights to view space.
+	mLightNum = lightNum;
+	UINT paddedNum = (mLightNum + 3) & ~3;
+	mLightX.resize(paddedNum);
+	mLightY.resize(paddedNum);
+	mLightZ.resize(paddedNum);
+	mLightRadius.resize(paddedNum);
+
+	for (auto i = 0; i < 4; i++)
+	{
+		for (auto j = 0; j < 3; j++)
+			mView[i][j] = view.GetElement(i, j);
+	}
+	for (auto i = 0u; i < mLightNum; i++)
+	{
+		auto& p = lights[i].Position;
+		mLightX[i] = p[0] * mView[0][0] + p[1] * mView[1][0] + p[2] * mView[2][0] + mView[3][0];
+		mLightY[i] = p[0] * mView[0][1] + p[1] * mView[1][1] + p[2] * mView[2][1] + mView[3][1];
+		mLightZ[i] = p[0] * mView[0][2] + p[1] * mView[1][2] + p[2] * mView[2][2] + mView[3][2];
+		mLightRadius[i] = lights[i].Range;
+	}
+	for (auto i = mLightNum; i < paddedNum; i++)
+	{
+		mLightX[i] = 0.0f;
+		mLightY[i] = 0.0f;
+		mLightZ[i] = 0.0f;
+		mLightRadius[i] = -GGiEngineUtil::Infinity;
+	}
+
+	float bvhUpdateTime = 0.0f;
+	if (bUseLightBvh)
+	{
+		auto bvhStartTime = std::chrono::high_resolution_clock::now();
+		mLightBvh.Update(tp, lights, lightNum);
+		auto bvhEndTime = std::chrono::high_resolution_clock::now();
+		bvhUpdateTime = std::chrono::duration<float, std::milli>(bvhEndTime - bvhStartTime).count();
+	}
+
+	// One task per slice, or per tile row with the bvh.
+	UINT taskNum = bUseLightBvh ? mTileNumY : mSliceNum;
+	mRows.resize(bUseLightBvh ? mTileNumY : 0);
+	auto assignTask = [&](UINT i)
+	{
+		if (bUseLightBvh)
+			AssignTileRow(i);
+		else
+			AssignSlice(i);
+	};
+	if (tp == nullptr)
+	{
+		for (auto i = 0u; i < taskNum; i++)
+			assignTask(i);
+	}
+	else
+	{
+		for (auto i = 0u; i < taskNum; i++)
+		{
+			tp->Enqueue([&, i]
+			{
+				assignTask(i);
+			}
+			);
+		}
+		tp->Flush();
+	}
+
+	UINT tileNum = mTileNumX * mTileNumY;
+	UINT clusterNum = tileNum * mSliceNum;
+	mClusterRanges.resize(clusterNum * 2);
+
+	UINT offset = 0;
+	if (bUseLightBvh)
+	{
+		// The rows are in cluster order already.
+		UINT rowClusterNum = mTileNumX * mSliceNum;
+		for (auto ty = 0u; ty < mTileNumY; ty++)
+		{
+			auto& row = mRows[ty];
+			for (auto c = 0u; c < rowClusterNum; c++)
+			{
+				UINT cluster = ty * rowClusterNum + c;
+				mClusterRanges[cluster * 2] = offset + row.ClusterRanges[c * 2];
+				mClusterRanges[cluster * 2 + 1] = row.ClusterRanges[c * 2 + 1];
+			}
+			offset += (UINT)row.Indices.size();
+		}
+
+		mLightIndices.resize(offset);
+		for (auto ty = 0u; ty < mTileNumY; ty++)
+		{
+			auto& row = mRows[ty];
+			if (row.Indices.size() > 0)
+				memcpy(&mLightIndices[mClusterRanges[ty * rowClusterNum * 2]], row.Indices.data(), row.Indices.size() * sizeof(UINT));
+		}
+	}
+	else
+	{
+		// Interleave the slice lists into cluster order.
+		for (auto t = 0u; t < tileNum; t++)
+		{
+			for (auto s = 0u; s < mSliceNum; s++)
+			{
+				UINT cluster = t * mSliceNum + s;
+				UINT count = mSlices[s].TileRanges[t * 2 + 1];
+				mClusterRanges[cluster * 2] = offset;
+				mClusterRanges[cluster * 2 + 1] = count;
+				offset += count;
+			}
+		}
+
+		mLightIndices.resize(offset);
+		for (auto t = 0u; t < tileNum; t++)
+		{
+			for (auto s = 0u; s < mSliceNum; s++)
+			{
+				UINT cluster = t * mSliceNum + s;
+				UINT count = mClusterRanges[cluster * 2 + 1];
+				if (count > 0)
+					memcpy(&mLightIndices[mClusterRanges[cluster * 2]], &mSlices[s].Indices[mSlices[s].TileRanges[t * 2]], count * sizeof(UINT));
+			}
+		}
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	mStats = GRiClusteredLightStats();
+	for (auto c = 0u; c < clusterNum; c++)
+	{
+		UINT count = mClusterRanges[c * 2 + 1];
+		if (count > 0)
+			mStats.NonEmptyClusterNum++;
+		mStats.MaxClusterLightNum = max(mStats.MaxClusterLightNum, count);
+	}
+	mStats.LightNum = mLightNum;
+	mStats.ClusterNum = clusterNum;
+	mStats.TotalIndexNum = offset;
+	mStats.AssignTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	mStats.BvhUpdateTime = bvhUpdateTime;
+}
+
+UINT GRiClusteredLightAssigner::GetTileNumX()
+{
+	return mTileNumX;
+}
+
+UINT GRiClusteredLightAssigner::GetTileNumY()
+{
+	return mTileNumY;
+}
+
+UINT GRiClusteredLightAssigner::GetClusterNum()
+{
+	return mTileNumX * mTileNumY * mSliceNum;
+}
+
+const std::vector<UINT>& GRiClusteredLightAssigner::GetClusterRanges()
+{
+	return mClusterRanges;
+}
+
+const std::vector<UINT>& GRiClusteredLightAssigner::GetLightIndices()
+{
+	return mLightIndices;
+}
+
+GRiClusteredLightStats GRiClusteredLightAssigner::GetStats()
+{
+	return mStats;
+}
+
+void GRiClusteredLightAssigner::BuildPlanes(UINT width, UINT height, float projScaleX, float projScaleY)
+{
+	mTileNumX = (width + mTileSizeX - 1) / mTileSizeX;
+	mTileNumY = (height + mTileSizeY - 1) / mTileSizeY;
+
+	// Same derivation as ClusteredDeferredCS, which doesn't round the tile number up here.
+	float tileNumX = (float)width / (float)mTileSizeX;
+	float tileNumY = (float)height / (float)mTileSizeY;
+
+	auto normalize = [](float* plane)
+	{
+		float invLen = 1.0f / sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		for (auto k = 0; k < 3; k++)
+			plane[k] *= invLen;
+	};
+
+	mColumnPlanes.resize(mTileNumX * 6);
+	for (auto x = 0u; x < mTileNumX; x++)
+	{
+		float offset = (float)x * 2.0f + 1.0f - tileNumX;
+		float* plane = &mColumnPlanes[x * 6];
+		plane[0] = projScaleX * tileNumX;
+		plane[1] = 0.0f;
+		plane[2] = 1.0f - offset;
+		plane[3] = -projScaleX * tileNumX;
+		plane[4] = 0.0f;
+		plane[5] = 1.0f + offset;
+		normalize(plane);
+		normalize(plane + 3);
+	}
+
+	mRowPlanes.resize(mTileNumY * 6);
+	for (auto y = 0u; y < mTileNumY; y++)
+	{
+		float offset = (float)y * 2.0f + 1.0f - tileNumY;
+		float* plane = &mRowPlanes[y * 6];
+		plane[0] = 0.0f;
+		plane[1] = projScaleY * tileNumY;
+		plane[2] = 1.0f + offset;
+		plane[3] = 0.0f;
+		plane[4] = -projScaleY * tileNumY;
+		plane[5] = 1.0f - offset;
+		normalize(plane);
+		normalize(plane + 3);
+	}
+}
+
+void GRiClusteredLightAssigner::AssignSlice(UINT slice)
+{
+	auto& s = mSlices[slice];
+
+	// Gather the lights overlapping the depth range of the slice.
+	s.Candidates.clear();
+	s.CandidateX.clear();
+	s.CandidateY.clear();
+	s.CandidateZ.clear();
+	s.CandidateRadius.clear();
+
+	__m128 sliceNear = _mm_set1_ps(mSliceDepths[slice]);
+	__m128 sliceFar = _mm_set1_ps(mSliceDepths[slice + 1]);
+	for (auto i = 0u; i < (UINT)mLightZ.size(); i += 4)
+	{
+		__m128 z = _mm_loadu_ps(&mLightZ[i]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&mLightRadius[i]));
+		__m128 inside = _mm_and_ps(
+			_mm_cmpge_ps(_mm_sub_ps(z, sliceNear), negRadius),
+			_mm_cmpge_ps(_mm_sub_ps(sliceFar, z), negRadius));
+
+		int mask = _mm_movemask_ps(inside);
+		for (auto k = 0; k < 4; k++)
+		{
+			if ((mask & (1 << k)) == 0)
+				continue;
+			s.Candidates.push_back(i + k);
+			s.CandidateX.push_back(mLightX[i + k]);
+			s.CandidateY.push_back(mLightY[i + k]);
+			s.CandidateZ.push_back(mLightZ[i + k]);
+			s.CandidateRadius.push_back(mLightRadius[i + k]);
+		}
+	}
+	while (s.CandidateRadius.size() % 4 != 0)
+	{
+		s.Candidates.push_back(0);
+		s.CandidateX.push_back(0.0f);
+		s.CandidateY.push_back(0.0f);
+		s.CandidateZ.push_back(0.0f);
+		s.CandidateRadius.push_back(-GGiEngineUtil::Infinity);
+	}
+
+	UINT groupNum = (UINT)s.CandidateRadius.size() / 4;
+	s.RowMasks.resize(groupNum);
+	s.TileRanges.assign(mTileNumX * mTileNumY * 2, 0);
+	s.Indices.clear();
+
+	auto inside = [](const float* plane, __m128 x, __m128 y, __m128 z, __m128 negRadius)
+	{
+		__m128 dist = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x), _mm_mul_ps(_mm_set1_ps(plane[1]), y)),
+			_mm_mul_ps(_mm_set1_ps(plane[2]), z));
+		return _mm_cmpge_ps(dist, negRadius);
+	};
+
+	for (auto ty = 0u; ty < mTileNumY; ty++)
+	{
+		// Lights between the bottom and top planes of the row.
+		const float* rowPlanes = &mRowPlanes[ty * 6];
+		bool bRowEmpty = true;
+		for (auto g = 0u; g < groupNum; g++)
+		{
+			__m128 x = _mm_loadu_ps(&s.CandidateX[g * 4]);
+			__m128 y = _mm_loadu_ps(&s.CandidateY[g * 4]);
+			__m128 z = _mm_loadu_ps(&s.CandidateZ[g * 4]);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&s.CandidateRadius[g * 4]));
+			s.RowMasks[g] = _mm_movemask_ps(_mm_and_ps(
+				inside(rowPlanes, x, y, z, negRadius),
+				inside(rowPlanes + 3, x, y, z, negRadius)));
+			if (s.RowMasks[g] != 0)
+				bRowEmpty = false;
+		}
+
+		for (auto tx = 0u; tx < mTileNumX; tx++)
+		{
+			UINT tile = ty * mTileNumX + tx;
+			s.TileRanges[tile * 2] = (UINT)s.Indices.size();
+			if (bRowEmpty)
+				continue;
+
+			const float* columnPlanes = &mColumnPlanes[tx * 6];
+			for (auto g = 0u; g < groupNum; g++)
+			{
+				if (s.RowMasks[g] == 0)
+					continue;
+
+				__m128 x = _mm_loadu_ps(&s.CandidateX[g * 4]);
+				__m128 y = _mm_loadu_ps(&s.CandidateY[g * 4]);
+				__m128 z = _mm_loadu_ps(&s.CandidateZ[g * 4]);
+				__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&s.CandidateRadius[g * 4]));
+				int mask = s.RowMasks[g] & _mm_movemask_ps(_mm_and_ps(
+					inside(columnPlanes, x, y, z, negRadius),
+					inside(columnPlanes + 3, x, y, z, negRadius)));
+
+				for (auto k = 0; k < 4; k++)
+				{
+					if (mask & (1 << k))
+						s.Indices.push_back(s.Candidates[g * 4 + k]);
+				}
+			}
+			s.TileRanges[tile * 2 + 1] = (UINT)s.Indices.size() - s.TileRanges[tile * 2];
+		}
+	}
+}
+
+void GRiClusteredLightAssigner::AssignTileRow(UINT tileY)
+{
+	auto& row = mRows[tileY];
+	row.ClusterRanges.assign(mTileNumX * mSliceNum * 2, 0);
+	row.Indices.clear();
+	row.SliceCounts.resize(mSliceNum);
+	row.CandidateMask.assign((mLightNum + 31) / 32, 0);
+
+	// World space plane of the view space plane (n, d), view space positions are world positions times mView.
+	auto toWorld = [&](const float* n, float d, float* plane)
+	{
+		for (auto i = 0; i < 3; i++)
+			plane[i] = mView[i][0] * n[0] + mView[i][1] * n[1] + mView[i][2] * n[2];
+		plane[3] = d + mView[3][0] * n[0] + mView[3][1] * n[1] + mView[3][2] * n[2];
+	};
+
+	// The frustum of the row between the first and the last slice.
+	const float* rowPlanes = &mRowPlanes[tileY * 6];
+	const float front[3] = { 0.0f, 0.0f, 1.0f };
+	const float back[3] = { 0.0f, 0.0f, -1.0f };
+	float planes[4][4];
+	toWorld(rowPlanes, 0.0f, planes[0]);
+	toWorld(rowPlanes + 3, 0.0f, planes[1]);
+	toWorld(front, -mSliceDepths[0], planes[2]);
+	toWorld(back, mSliceDepths[mSliceNum], planes[3]);
+
+	row.Candidates.clear();
+	mLightBvh.Query(planes, 4, LIGHT_CLUSTER_BVH_EPSILON, row.Candidates);
+
+	// Put the candidates back into light order through a bit mask, so every list comes out sorted.
+	std::vector<UINT> queried;
+	queried.swap(row.Candidates);
+	for (auto i : queried)
+		row.CandidateMask[i / 32] |= 1u << (i % 32);
+
+	// Repeat the tests of the row in view space, with the same expressions as the brute force path.
+	row.CandidateX.clear();
+	row.CandidateY.clear();
+	row.CandidateZ.clear();
+	row.CandidateRadius.clear();
+	row.FirstSlices.clear();
+	row.LastSlices.clear();
+	for (auto w = 0u; w < (UINT)row.CandidateMask.size(); w++)
+	{
+		unsigned long mask = row.CandidateMask[w];
+		while (mask)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			mask &= mask - 1;
+
+			UINT i = w * 32 + bit;
+			float x = mLightX[i];
+			float y = mLightY[i];
+			float z = mLightZ[i];
+			float negRadius = 0.0f - mLightRadius[i];
+			if ((rowPlanes[0] * x + rowPlanes[1] * y) + rowPlanes[2] * z < negRadius ||
+				(rowPlanes[3] * x + rowPlanes[4] * y) + rowPlanes[5] * z < negRadius)
+				continue;
+
+			// The slices a sphere overlaps are contiguous: the far test only passes from the first one on and the
+			// near test only up to the last one.
+			UINT first = 0;
+			UINT end = mSliceNum;
+			while (first < end)
+			{
+				UINT mid = (first + end) / 2;
+				if (mSliceDepths[mid + 1] - z >= negRadius)
+					end = mid;
+				else
+					first = mid + 1;
+			}
+			UINT last = first;
+			end = mSliceNum;
+			while (last < end)
+			{
+				UINT mid = (last + end) / 2;
+				if (z - mSliceDepths[mid] >= negRadius)
+					last = mid + 1;
+				else
+					end = mid;
+			}
+			if (last <= first)
+				continue;
+
+			row.Candidates.push_back(i);
+			row.CandidateX.push_back(x);
+			row.CandidateY.push_back(y);
+			row.CandidateZ.push_back(z);
+			row.CandidateRadius.push_back(mLightRadius[i]);
+			row.FirstSlices.push_back(first);
+			row.LastSlices.push_back(last - 1);
+		}
+		row.CandidateMask[w] = 0;
+	}
+	while (row.CandidateRadius.size() % 4 != 0)
+	{
+		row.CandidateX.push_back(0.0f);
+		row.CandidateY.push_back(0.0f);
+		row.CandidateZ.push_back(0.0f);
+		row.CandidateRadius.push_back(-GGiEngineUtil::Infinity);
+	}
+
+	auto inside = [](const float* plane, __m128 x, __m128 y, __m128 z, __m128 negRadius)
+	{
+		__m128 dist = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x), _mm_mul_ps(_mm_set1_ps(plane[1]), y)),
+			_mm_mul_ps(_mm_set1_ps(plane[2]), z));
+		return _mm_cmpge_ps(dist, negRadius);
+	};
+
+	UINT groupNum = (UINT)row.CandidateRadius.size() / 4;
+	for (auto tx = 0u; tx < mTileNumX; tx++)
+	{
+		const float* columnPlanes = &mColumnPlanes[tx * 6];
+
+		row.TileCandidates.clear();
+		std::fill(row.SliceCounts.begin(), row.SliceCounts.end(), 0);
+		for (auto g = 0u; g < groupNum; g++)
+		{
+			__m128 x = _mm_loadu_ps(&row.CandidateX[g * 4]);
+			__m128 y = _mm_loadu_ps(&row.CandidateY[g * 4]);
+			__m128 z = _mm_loadu_ps(&row.CandidateZ[g * 4]);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&row.CandidateRadius[g * 4]));
+			int mask = _mm_movemask_ps(_mm_and_ps(
+				inside(columnPlanes, x, y, z, negRadius),
+				inside(columnPlanes + 3, x, y, z, negRadius)));
+			while (mask)
+			{
+				unsigned long bit;
+				_BitScanForward(&bit, mask);
+				mask &= mask - 1;
+
+				UINT c = g * 4 + bit;
+				row.TileCandidates.push_back(c);
+				for (auto s = row.FirstSlices[c]; s <= row.LastSlices[c]; s++)
+					row.SliceCounts[s]++;
+			}
+		}
+
+		UINT* ranges = &row.ClusterRanges[tx * mSliceNum * 2];
+		UINT offset = (UINT)row.Indices.size();
+		for (auto s = 0u; s < mSliceNum; s++)
+		{
+			ranges[s * 2] = offset;
+			ranges[s * 2 + 1] = row.SliceCounts[s];
+			offset += row.SliceCounts[s];
+			row.SliceCounts[s] = ranges[s * 2];
+		}
+
+		// Scatter in light order, so every list stays sorted.
+		row.Indices.resize(offset);
+		for (auto c : row.TileCandidates)
+		{
+			for (auto s = row.FirstSlices[c]; s <= row.LastSlices[c]; s++)
+				row.Indices[row.SliceCounts[s]++] = row.Candidates[c];
+		}
+	}
+}
+
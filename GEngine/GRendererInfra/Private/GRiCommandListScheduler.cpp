@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "GRiCommandListScheduler.h"
+
+
+void GRiCommandListScheduler::Schedule(UINT itemNum, UINT maxListNum, UINT minItemNum)
+{
+	mChunks.clear();
+	if (itemNum == 0 || maxListNum == 0)
+		return;
+
+	if (minItemNum == 0)
+		minItemNum = 1;
+
+	UINT listNum = itemNum / minItemNum;
+	if (listNum > maxListNum)
+		listNum = maxListNum;
+	if (listNum == 0)
+		listNum = 1;
+
+	// The first lists take one more item each until the remainder is used up.
+	UINT baseItemNum = itemNum / listNum;
+	UINT remainder = itemNum % listNum;
+	UINT firstItem = 0;
+	for (auto i = 0u; i < listNum; i++)
+	{
+		GRiCommandListChunk chunk;
+		chunk.FirstItem = firstItem;
+		chunk.ItemNum = baseItemNum + (i < remainder ? 1 : 0);
+		mChunks.push_back(chunk);
+		firstItem += chunk.ItemNum;
+	}
+}
+
+const std::vector<GRiCommandListChunk>& GRiCommandListScheduler::GetChunks()
+{
+	return mChunks;
+}
+
+UINT GRiCommandListScheduler::GetListNum()
+{
+	return (UINT)mChunks.size();
+}
+
+void GRiCommandListScheduler::Record(GGiThreadPool* tp, GRiCommandListRecorder* recorder)
+{
+	auto recordList = [&](UINT listIndex)
+	{
+		recorder->BeginList(listIndex);
+		recorder->RecordItems(listIndex, mChunks[listIndex].FirstItem, mChunks[listIndex].ItemNum);
+		recorder->EndList(listIndex);
+	};
+
+	if (tp == nullptr || mChunks.size() < 2)
+	{
+		for (auto i = 0u; i < mChunks.size(); i++)
+			recordList(i);
+		return;
+	}
+
+	for (auto i = 0u; i < mChunks.size(); i++)
+	{
+		tp->Enqueue([&, i]
+		{
+			recordList(i);
+		}
+		);
+	}
+	tp->Flush();
+}
@@ -0,0 +1,245 @@
+#include "stdafx.h"
+#include "GRiCompressedVertex.h"
+
+
+GRiVertexQuantization GRiVertexCompressor::ComputeQuantization(const GRiVertex* vertices, UINT vertexNum)
+{
+	GRiVertexQuantization quantization;
+	if (vertexNum == 0)
+		return quantization;
+
+	float vMin[3] = { vertices[0].Position[0], vertices[0].Position[1], vertices[0].Position[2] };
+	float vMax[3] = { vertices[0].Position[0], vertices[0].Position[1], vertices[0].Position[2] };
+	for (UINT i = 1; i < vertexNum; i++)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			vMin[k] = min(vMin[k], vertices[i].Position[k]);
+			vMax[k] = max(vMax[k], vertices[i].Position[k]);
+		}
+	}
+
+	for (auto k = 0; k < 3; k++)
+	{
+		quantization.Offset[k] = vMin[k];
+		quantization.Scale[k] = vMax[k] - vMin[k];
+	}
+
+	return quantization;
+}
+
+void GRiVertexCompressor::Encode(const GRiVertex* vertices, UINT vertexNum, const GRiVertexQuantization& quantization, GRiCompressedVertex* outVertices, const float* tangentSigns)
+{
+	for (UINT i = 0; i < vertexNum; i++)
+	{
+		auto& v = vertices[i];
+		auto& out = outVertices[i];
+
+		for (auto k = 0; k < 3; k++)
+		{
+			float unorm = 0.0f;
+			if (quantization.Scale[k] > 0.0f)
+				unorm = (v.Position[k] - quantization.Offset[k]) / quantization.Scale[k];
+			unorm = min(max(unorm, 0.0f), 1.0f);
+			out.Position[k] = (UINT16)(unorm * 65535.0f + 0.5f);
+		}
+		out.Position[3] = (tangentSigns != nullptr && tangentSigns[i] < 0.0f) ? 0 : 65535;
+
+		out.UV[0] = FloatToHalf(v.UV[0]);
+		out.UV[1] = FloatToHalf(v.UV[1]);
+
+		EncodeOctahedral(v.Normal, out.Normal);
+		EncodeOctahedral(v.TangentU, out.TangentU);
+	}
+}
+
+void GRiVertexCompressor::Decode(const GRiCompressedVertex* vertices, UINT vertexNum, const GRiVertexQuantization& quantization, GRiVertex* outVertices, float* outTangentSigns)
+{
+	for (UINT i = 0; i < vertexNum; i++)
+	{
+		auto& v = vertices[i];
+		auto& out = outVertices[i];
+
+		for (auto k = 0; k < 3; k++)
+			out.Position[k] = quantization.Offset[k] + quantization.Scale[k] * ((float)v.Position[k] / 65535.0f);
+		if (outTangentSigns != nullptr)
+			outTangentSigns[i] = ((float)v.Position[3] / 65535.0f) * 2.0f - 1.0f;
+
+		out.UV[0] = HalfToFloat(v.UV[0]);
+		out.UV[1] = HalfToFloat(v.UV[1]);
+
+		DecodeOctahedral(v.Normal, out.Normal);
+		DecodeOctahedral(v.TangentU, out.TangentU);
+	}
+}
+
+UINT16 GRiVertexCompressor::FloatToHalf(float value)
+{
+	UINT32 bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	UINT32 sign = (bits >> 16) & 0x8000;
+	UINT32 exponent = (bits >> 23) & 0xFF;
+	UINT32 mantissa = bits & 0x7FFFFF;
+
+	// Infinity and NaN.
+	if (exponent == 0xFF)
+		return (UINT16)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+
+	int halfExponent = (int)exponent - 127 + 15;
+	if (halfExponent >= 0x1F)
+		return (UINT16)(sign | 0x7C00);
+
+	// Round to nearest even, a carry out of the mantissa correctly bumps the exponent.
+	if (halfExponent <= 0)
+	{
+		if (halfExponent < -10)
+			return (UINT16)sign;
+
+		mantissa |= 0x800000;
+		UINT32 shift = (UINT32)(14 - halfExponent);
+		UINT32 half = mantissa >> shift;
+		UINT32 remainder = mantissa & ((1u << shift) - 1);
+		UINT32 halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return (UINT16)(sign | half);
+	}
+
+	UINT32 half = ((UINT32)halfExponent << 10) | (mantissa >> 13);
+	UINT32 remainder = mantissa & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return (UINT16)(sign | half);
+}
+
+float GRiVertexCompressor::HalfToFloat(UINT16 value)
+{
+	UINT32 sign = (UINT32)(value & 0x8000) << 16;
+	UINT32 exponent = (value >> 10) & 0x1F;
+	UINT32 mantissa = value & 0x3FF;
+
+	UINT32 bits;
+	if (exponent == 0)
+	{
+		// Zero and subnormals.
+		float subnormal = ldexpf((float)mantissa, -24);
+		return sign != 0 ? -subnormal : subnormal;
+	}
+	else if (exponent == 0x1F)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+void GRiVertexCompressor::EncodeOctahedral(const float* vector, INT16* outOctahedral)
+{
+	// Degenerate vectors, like the tangents at the poles of a sphere, are stored as +z.
+	float length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+	if (!(length > 0.0f))
+	{
+		outOctahedral[0] = 0;
+		outOctahedral[1] = 0;
+		return;
+	}
+	float n[3] = { vector[0] / length, vector[1] / length, vector[2] / length };
+
+	// Project onto the octahedron and fold the lower half over the diagonals.
+	float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	float x = n[0] / l1;
+	float y = n[1] / l1;
+	if (n[2] < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	// Of the four snorm values around the mapped point keep the one that decodes closest to the vector.
+	float baseX = floorf(x * 32767.0f);
+	float baseY = floorf(y * 32767.0f);
+	float bestDot = -2.0f;
+	for (auto dy = 0; dy < 2; dy++)
+	{
+		for (auto dx = 0; dx < 2; dx++)
+		{
+			INT16 candidate[2] = {
+				(INT16)min(max(baseX + dx, -32767.0f), 32767.0f),
+				(INT16)min(max(baseY + dy, -32767.0f), 32767.0f)
+			};
+			float decoded[3];
+			DecodeOctahedral(candidate, decoded);
+			float dot = decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2];
+			if (dot > bestDot)
+			{
+				bestDot = dot;
+				outOctahedral[0] = candidate[0];
+				outOctahedral[1] = candidate[1];
+			}
+		}
+	}
+}
+
+void GRiVertexCompressor::DecodeOctahedral(const INT16* octahedral, float* outVector)
+{
+	float x = max((float)octahedral[0] / 32767.0f, -1.0f);
+	float y = max((float)octahedral[1] / 32767.0f, -1.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	float t = max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf(x * x + y * y + z * z);
+	outVector[0] = x / length;
+	outVector[1] = y / length;
+	outVector[2] = z / length;
+}
+
+GRiVertexCompressionError GRiVertexCompressor::MeasureError(const GRiVertex* vertices, UINT vertexNum)
+{
+	GRiVertexCompressionError error;
+
+	auto quantization = ComputeQuantization(vertices, vertexNum);
+	std::vector<GRiCompressedVertex> compressed(vertexNum);
+	std::vector<GRiVertex> decoded(vertexNum);
+	Encode(vertices, vertexNum, quantization, compressed.data());
+	Decode(compressed.data(), vertexNum, quantization, decoded.data());
+
+	// atan2 of the cross and dot products, acos of a float dot can't resolve angles below about 0.02 degrees.
+	auto angle = [](const float* a, const float* b)
+	{
+		float length = sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+		if (!(length > 0.0f))
+			return 0.0f;
+		float cross[3] = {
+			a[1] * b[2] - a[2] * b[1],
+			a[2] * b[0] - a[0] * b[2],
+			a[0] * b[1] - a[1] * b[0]
+		};
+		float sine = sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+		float cosine = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		return atan2f(sine, cosine) * 180.0f / GGiEngineUtil::PI;
+	};
+
+	for (UINT i = 0; i < vertexNum; i++)
+	{
+		for (auto k = 0; k < 3; k++)
+			error.Position = max(error.Position, fabsf(decoded[i].Position[k] - vertices[i].Position[k]));
+		for (auto k = 0; k < 2; k++)
+			error.UV = max(error.UV, fabsf(decoded[i].UV[k] - vertices[i].UV[k]));
+		error.Normal = max(error.Normal, angle(vertices[i].Normal, decoded[i].Normal));
+		error.TangentU = max(error.TangentU, angle(vertices[i].TangentU, decoded[i].TangentU));
+	}
+
+	return error;
+}
@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "GRiDrawKey.h"
+
+
+UINT64 GRiDrawKey::Encode(UINT layer, UINT pso, UINT mesh, UINT material, UINT depth)
+{
+	return ((UINT64)(layer & ((1u << LayerBits) - 1)) << LayerShift) |
+		((UINT64)(pso & ((1u << PsoBits) - 1)) << PsoShift) |
+		((UINT64)(mesh & ((1u << MeshBits) - 1)) << MeshShift) |
+		((UINT64)(material & ((1u << MaterialBits) - 1)) << MaterialShift) |
+		((UINT64)(depth & ((1u << DepthBits) - 1)) << DepthShift);
+}
+
+UINT GRiDrawKey::QuantizeDepth(float viewDepth, float nearZ, float farZ)
+{
+	if (farZ <= nearZ)
+		return 0;
+
+	float t = (viewDepth - nearZ) / (farZ - nearZ);
+	if (t <= 0.0f)
+		return 0;
+	if (t >= 1.0f)
+		return (1u << DepthBits) - 1;
+	return (UINT)(t * (float)((1u << DepthBits) - 1));
+}
+
+UINT GRiDrawKey::GetLayer(UINT64 key)
+{
+	return (UINT)(key >> LayerShift) & ((1u << LayerBits) - 1);
+}
+
+UINT GRiDrawKey::GetPso(UINT64 key)
+{
+	return (UINT)(key >> PsoShift) & ((1u << PsoBits) - 1);
+}
+
+UINT GRiDrawKey::GetMesh(UINT64 key)
+{
+	return (UINT)(key >> MeshShift) & ((1u << MeshBits) - 1);
+}
+
+UINT GRiDrawKey::GetMaterial(UINT64 key)
+{
+	return (UINT)(key >> MaterialShift) & ((1u << MaterialBits) - 1);
+}
+
+UINT GRiDrawKey::GetDepth(UINT64 key)
+{
+	return (UINT)(key >> DepthShift) & ((1u << DepthBits) - 1);
+}
@@ -0,0 +1,621 @@
+#include "stdafx.h"
+#include "GRiDynamicAabbTree.h"
+
+// Leaves are fattened by this fraction of their extents plus a fixed margin.
+#define AABB_TREE_FAT_RATIO 0.1f
+#define AABB_TREE_FAT_MARGIN 1.0f
+
+
+static inline float HalfSurfaceArea(const float* bMin, const float* bMax)
+{
+	float dx = bMax[0] - bMin[0];
+	float dy = bMax[1] - bMin[1];
+	float dz = bMax[2] - bMin[2];
+	return dx * dy + dx * dz + dy * dz;
+}
+
+static inline float UnionArea(const GRiDynamicAabbTreeNode& a, const GRiDynamicAabbTreeNode& b)
+{
+	float bMin[3], bMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		bMin[k] = min(a.BoundMin[k], b.BoundMin[k]);
+		bMax[k] = max(a.BoundMax[k], b.BoundMax[k]);
+	}
+	return HalfSurfaceArea(bMin, bMax);
+}
+
+static inline void UnionBounds(GRiDynamicAabbTreeNode& out, const GRiDynamicAabbTreeNode& a, const GRiDynamicAabbTreeNode& b)
+{
+	for (auto k = 0; k < 3; k++)
+	{
+		out.BoundMin[k] = min(a.BoundMin[k], b.BoundMin[k]);
+		out.BoundMax[k] = max(a.BoundMax[k], b.BoundMax[k]);
+	}
+}
+
+GRiDynamicAabbTree::GRiDynamicAabbTree()
+{
+	mNodes.reserve(64);
+}
+
+int GRiDynamicAabbTree::AllocateNode()
+{
+	if (mFreeList == -1)
+	{
+		mNodes.push_back(GRiDynamicAabbTreeNode());
+		mNodes.back().Height = 0;
+		return (int)mNodes.size() - 1;
+	}
+
+	int nodeId = mFreeList;
+	mFreeList = mNodes[nodeId].Parent;
+	mNodes[nodeId] = GRiDynamicAabbTreeNode();
+	mNodes[nodeId].Height = 0;
+	return nodeId;
+}
+
+void GRiDynamicAabbTree::FreeNode(int nodeId)
+{
+	mNodes[nodeId].Parent = mFreeList;
+	mNodes[nodeId].Height = -1;
+	mNodes[nodeId].SceneObject = nullptr;
+	mFreeList = nodeId;
+}
+
+int GRiDynamicAabbTree::CreateProxy(const GRiBoundingBox& bounds, GRiSceneObject* sceneObject)
+{
+	int proxyId = AllocateNode();
+
+	auto& node = mNodes[proxyId];
+	for (auto k = 0; k < 3; k++)
+	{
+		float margin = bounds.Extents[k] * AABB_TREE_FAT_RATIO + AABB_TREE_FAT_MARGIN;
+		node.BoundMin[k] = bounds.Center[k] - bounds.Extents[k] - margin;
+		node.BoundMax[k] = bounds.Center[k] + bounds.Extents[k] + margin;
+	}
+	node.SceneObject = sceneObject;
+	node.Height = 0;
+
+	InsertLeaf(proxyId);
+	mProxyNum++;
+
+	return proxyId;
+}
+
+void GRiDynamicAabbTree::DestroyProxy(int proxyId)
+{
+	if (proxyId < 0 || proxyId >= (int)mNodes.size() || !mNodes[proxyId].IsLeaf() || mNodes[proxyId].Height != 0)
+		ThrowGGiException("Invalid dynamic aabb tree proxy.");
+
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+	mProxyNum--;
+}
+
+bool GRiDynamicAabbTree::MoveProxy(int proxyId, const GRiBoundingBox& bounds)
+{
+	if (proxyId < 0 || proxyId >= (int)mNodes.size() || !mNodes[proxyId].IsLeaf() || mNodes[proxyId].Height != 0)
+		ThrowGGiException("Invalid dynamic aabb tree proxy.");
+
+	auto& node = mNodes[proxyId];
+	bool bContained = true;
+	for (auto k = 0; k < 3; k++)
+	{
+		if (bounds.Center[k] - bounds.Extents[k] < node.BoundMin[k] ||
+			bounds.Center[k] + bounds.Extents[k] > node.BoundMax[k])
+		{
+			bContained = false;
+			break;
+		}
+	}
+	if (bContained)
+		return false;
+
+	RemoveLeaf(proxyId);
+
+	for (auto k = 0; k < 3; k++)
+	{
+		float margin = bounds.Extents[k] * AABB_TREE_FAT_RATIO + AABB_TREE_FAT_MARGIN;
+		mNodes[proxyId].BoundMin[k] = bounds.Center[k] - bounds.Extents[k] - margin;
+		mNodes[proxyId].BoundMax[k] = bounds.Center[k] + bounds.Extents[k] + margin;
+	}
+
+	InsertLeaf(proxyId);
+	return true;
+}
+
+GRiSceneObject* GRiDynamicAabbTree::GetSceneObject(int proxyId)
+{
+	return mNodes[proxyId].SceneObject;
+}
+
+void GRiDynamicAabbTree::GetFatBounds(int proxyId, float* boundMin, float* boundMax)
+{
+	for (auto k = 0; k < 3; k++)
+	{
+		boundMin[k] = mNodes[proxyId].BoundMin[k];
+		boundMax[k] = mNodes[proxyId].BoundMax[k];
+	}
+}
+
+void GRiDynamicAabbTree::InsertLeaf(int leaf)
+{
+	if (mRoot == -1)
+	{
+		mRoot = leaf;
+		mNodes[mRoot].Parent = -1;
+		return;
+	}
+
+	// Descend toward the sibling with the lowest surface area cost.
+	int index = mRoot;
+	while (!mNodes[index].IsLeaf())
+	{
+		int child1 = mNodes[index].Child1;
+		int child2 = mNodes[index].Child2;
+
+		float area = HalfSurfaceArea(mNodes[index].BoundMin, mNodes[index].BoundMax);
+		float combinedArea = UnionArea(mNodes[index], mNodes[leaf]);
+
+		// Cost of creating a new parent for this node and the new leaf.
+		float cost = 2.0f * combinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree.
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = UnionArea(mNodes[child1], mNodes[leaf]) + inheritanceCost;
+		if (!mNodes[child1].IsLeaf())
+			cost1 -= HalfSurfaceArea(mNodes[child1].BoundMin, mNodes[child1].BoundMax);
+
+		float cost2 = UnionArea(mNodes[child2], mNodes[leaf]) + inheritanceCost;
+		if (!mNodes[child2].IsLeaf())
+			cost2 -= HalfSurfaceArea(mNodes[child2].BoundMin, mNodes[child2].BoundMax);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+
+	// Create a new parent.
+	int oldParent = mNodes[sibling].Parent;
+	int newParent = AllocateNode();
+	mNodes[newParent].Parent = oldParent;
+	mNodes[newParent].SceneObject = nullptr;
+	UnionBounds(mNodes[newParent], mNodes[leaf], mNodes[sibling]);
+	mNodes[newParent].Height = mNodes[sibling].Height + 1;
+
+	if (oldParent != -1)
+	{
+		if (mNodes[oldParent].Child1 == sibling)
+			mNodes[oldParent].Child1 = newParent;
+		else
+			mNodes[oldParent].Child2 = newParent;
+	}
+	else
+	{
+		mRoot = newParent;
+	}
+	mNodes[newParent].Child1 = sibling;
+	mNodes[newParent].Child2 = leaf;
+	mNodes[sibling].Parent = newParent;
+	mNodes[leaf].Parent = newParent;
+
+	// Walk back up the tree fixing heights and bounds.
+	index = mNodes[leaf].Parent;
+	while (index != -1)
+	{
+		index = Balance(index);
+		UpdateNode(index);
+		index = mNodes[index].Parent;
+	}
+}
+
+void GRiDynamicAabbTree::RemoveLeaf(int leaf)
+{
+	if (leaf == mRoot)
+	{
+		mRoot = -1;
+		return;
+	}
+
+	int parent = mNodes[leaf].Parent;
+	int grandParent = mNodes[parent].Parent;
+	int sibling = mNodes[parent].Child1 == leaf ? mNodes[parent].Child2 : mNodes[parent].Child1;
+
+	if (grandParent != -1)
+	{
+		// Destroy the parent and connect the sibling to the grand parent.
+		if (mNodes[grandParent].Child1 == parent)
+			mNodes[grandParent].Child1 = sibling;
+		else
+			mNodes[grandParent].Child2 = sibling;
+		mNodes[sibling].Parent = grandParent;
+		FreeNode(parent);
+
+		int index = grandParent;
+		while (index != -1)
+		{
+			index = Balance(index);
+			UpdateNode(index);
+			index = mNodes[index].Parent;
+		}
+	}
+	else
+	{
+		mRoot = sibling;
+		mNodes[sibling].Parent = -1;
+		FreeNode(parent);
+	}
+}
+
+void GRiDynamicAabbTree::UpdateNode(int nodeId)
+{
+	auto& node = mNodes[nodeId];
+	auto& child1 = mNodes[node.Child1];
+	auto& child2 = mNodes[node.Child2];
+	node.Height = 1 + max(child1.Height, child2.Height);
+	UnionBounds(node, child1, child2);
+}
+
+// Performs a left or right rotation if node A is imbalanced, returns the new root of the subtree.
+int GRiDynamicAabbTree::Balance(int iA)
+{
+	auto& A = mNodes[iA];
+	if (A.IsLeaf() || A.Height < 2)
+		return iA;
+
+	int iB = A.Child1;
+	int iC = A.Child2;
+	auto& B = mNodes[iB];
+	auto& C = mNodes[iC];
+
+	int balance = C.Height - B.Height;
+
+	// Rotate C up.
+	if (balance > 1)
+	{
+		int iF = C.Child1;
+		int iG = C.Child2;
+		auto& F = mNodes[iF];
+		auto& G = mNodes[iG];
+
+		// Swap A and C.
+		C.Child1 = iA;
+		C.Parent = A.Parent;
+		A.Parent = iC;
+
+		// A's old parent should point to C.
+		if (C.Parent != -1)
+		{
+			if (mNodes[C.Parent].Child1 == iA)
+				mNodes[C.Parent].Child1 = iC;
+			else
+				mNodes[C.Parent].Child2 = iC;
+		}
+		else
+		{
+			mRoot = iC;
+		}
+
+		// Rotate.
+		if (F.Height > G.Height)
+		{
+			C.Child2 = iF;
+			A.Child2 = iG;
+			G.Parent = iA;
+			UnionBounds(A, B, G);
+			UnionBounds(C, A, F);
+			A.Height = 1 + max(B.Height, G.Height);
+			C.Height = 1 + max(A.Height, F.Height);
+		}
+		else
+		{
+			C.Child2 = iG;
+			A.Child2 = iF;
+			F.Parent = iA;
+			UnionBounds(A, B, F);
+			UnionBounds(C, A, G);
+			A.Height = 1 + max(B.Height, F.Height);
+			C.Height = 1 + max(A.Height, G.Height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up.
+	if (balance < -1)
+	{
+		int iD = B.Child1;
+		int iE = B.Child2;
+		auto& D = mNodes[iD];
+		auto& E = mNodes[iE];
+
+		// Swap A and B.
+		B.Child1 = iA;
+		B.Parent = A.Parent;
+		A.Parent = iB;
+
+		// A's old parent should point to B.
+		if (B.Parent != -1)
+		{
+			if (mNodes[B.Parent].Child1 == iA)
+				mNodes[B.Parent].Child1 = iB;
+			else
+				mNodes[B.Parent].Child2 = iB;
+		}
+		else
+		{
+			mRoot = iB;
+		}
+
+		// Rotate.
+		if (D.Height > E.Height)
+		{
+			B.Child2 = iD;
+			A.Child1 = iE;
+			E.Parent = iA;
+			UnionBounds(A, C, E);
+			UnionBounds(B, A, D);
+			A.Height = 1 + max(C.Height, E.Height);
+			B.Height = 1 + max(A.Height, D.Height);
+		}
+		else
+		{
+			B.Child2 = iE;
+			A.Child1 = iD;
+			D.Parent = iA;
+			UnionBounds(A, C, D);
+			UnionBounds(B, A, E);
+			A.Height = 1 + max(C.Height, D.Height);
+			B.Height = 1 + max(A.Height, E.Height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+void GRiDynamicAabbTree::QueryBox(const GRiBoundingBox& box, std::vector<GRiSceneObject*>& result)
+{
+	if (mRoot == -1)
+		return;
+
+	float bMin[3], bMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		bMin[k] = box.BoundMin(k);
+		bMax[k] = box.BoundMax(k);
+	}
+
+	std::vector<int> stack;
+	stack.push_back(mRoot);
+	while (!stack.empty())
+	{
+		int nodeId = stack.back();
+		stack.pop_back();
+
+		auto& node = mNodes[nodeId];
+		if (node.BoundMin[0] > bMax[0] || node.BoundMax[0] < bMin[0] ||
+			node.BoundMin[1] > bMax[1] || node.BoundMax[1] < bMin[1] ||
+			node.BoundMin[2] > bMax[2] || node.BoundMax[2] < bMin[2])
+			continue;
+
+		if (node.IsLeaf())
+		{
+			result.push_back(node.SceneObject);
+		}
+		else
+		{
+			stack.push_back(node.Child1);
+			stack.push_back(node.Child2);
+		}
+	}
+}
+
+void GRiDynamicAabbTree::QuerySphere(const float* center, float radius, std::vector<GRiSceneObject*>& result)
+{
+	if (mRoot == -1)
+		return;
+
+	float radiusSq = radius * radius;
+
+	std::vector<int> stack;
+	stack.push_back(mRoot);
+	while (!stack.empty())
+	{
+		int nodeId = stack.back();
+		stack.pop_back();
+
+		auto& node = mNodes[nodeId];
+		float distSq = 0.0f;
+		for (auto k = 0; k < 3; k++)
+		{
+			float d = max(max(node.BoundMin[k] - center[k], center[k] - node.BoundMax[k]), 0.0f);
+			distSq += d * d;
+		}
+		if (distSq > radiusSq)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			result.push_back(node.SceneObject);
+		}
+		else
+		{
+			stack.push_back(node.Child1);
+			stack.push_back(node.Child2);
+		}
+	}
+}
+
+void GRiDynamicAabbTree::GatherSubtree(int nodeId, std::vector<GRiSceneObject*>& result, std::vector<int>& stack)
+{
+	size_t base = stack.size();
+	stack.push_back(nodeId);
+	while (stack.size() > base)
+	{
+		int id = stack.back();
+		stack.pop_back();
+		if (mNodes[id].IsLeaf())
+		{
+			result.push_back(mNodes[id].SceneObject);
+		}
+		else
+		{
+			stack.push_back(mNodes[id].Child1);
+			stack.push_back(mNodes[id].Child2);
+		}
+	}
+}
+
+void GRiDynamicAabbTree::QueryFrustum(const float planes[6][4], std::vector<GRiSceneObject*>& result)
+{
+	if (mRoot == -1)
+		return;
+
+	// (node, mask of planes the node may still cross)
+	std::vector<std::pair<int, int>> stack;
+	std::vector<int> gatherStack;
+	stack.push_back(std::make_pair(mRoot, 0x3F));
+	while (!stack.empty())
+	{
+		int nodeId = stack.back().first;
+		int mask = stack.back().second;
+		stack.pop_back();
+
+		auto& node = mNodes[nodeId];
+		bool bOutside = false;
+		for (auto p = 0; p < 6; p++)
+		{
+			if ((mask & (1 << p)) == 0)
+				continue;
+
+			// Nearest and farthest corners along the plane normal.
+			float dMax = planes[p][3];
+			float dMin = planes[p][3];
+			for (auto k = 0; k < 3; k++)
+			{
+				float a = planes[p][k] * node.BoundMin[k];
+				float b = planes[p][k] * node.BoundMax[k];
+				dMax += max(a, b);
+				dMin += min(a, b);
+			}
+			if (dMax < 0.0f)
+			{
+				bOutside = true;
+				break;
+			}
+			if (dMin >= 0.0f)
+				mask &= ~(1 << p);
+		}
+		if (bOutside)
+			continue;
+
+		if (mask == 0)
+		{
+			GatherSubtree(nodeId, result, gatherStack);
+		}
+		else if (node.IsLeaf())
+		{
+			result.push_back(node.SceneObject);
+		}
+		else
+		{
+			stack.push_back(std::make_pair(node.Child1, mask));
+			stack.push_back(std::make_pair(node.Child2, mask));
+		}
+	}
+}
+
+void GRiDynamicAabbTree::ExtractFrustumPlanes(GGiFloat4x4 viewProj, float planes[6][4])
+{
+	// With row vectors clip = p * M, so every plane is a combination of the matrix columns.
+	float col[4][4];
+	for (auto i = 0; i < 4; i++)
+	{
+		for (auto j = 0; j < 4; j++)
+		{
+			col[j][i] = viewProj.GetElement(i, j);
+		}
+	}
+
+	for (auto k = 0; k < 4; k++)
+	{
+		planes[0][k] = col[3][k] + col[0][k]; // left
+		planes[1][k] = col[3][k] - col[0][k]; // right
+		planes[2][k] = col[3][k] + col[1][k]; // bottom
+		planes[3][k] = col[3][k] - col[1][k]; // top
+		planes[4][k] = col[2][k];             // near
+		planes[5][k] = col[3][k] - col[2][k]; // far
+	}
+
+	for (auto p = 0; p < 6; p++)
+	{
+		float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		if (len > 0.0f)
+		{
+			for (auto k = 0; k < 4; k++)
+				planes[p][k] /= len;
+		}
+	}
+}
+
+int GRiDynamicAabbTree::GetProxyNum()
+{
+	return mProxyNum;
+}
+
+int GRiDynamicAabbTree::GetHeight()
+{
+	return mRoot == -1 ? 0 : mNodes[mRoot].Height;
+}
+
+bool GRiDynamicAabbTree::Validate()
+{
+	if (mRoot == -1)
+		return mProxyNum == 0;
+	if (mNodes[mRoot].Parent != -1)
+		return false;
+
+	int leafNum = 0;
+	std::vector<int> stack;
+	stack.push_back(mRoot);
+	while (!stack.empty())
+	{
+		int nodeId = stack.back();
+		stack.pop_back();
+
+		auto& node = mNodes[nodeId];
+		if (node.IsLeaf())
+		{
+			if (node.Height != 0 || node.Child2 != -1)
+				return false;
+			leafNum++;
+			continue;
+		}
+
+		auto& child1 = mNodes[node.Child1];
+		auto& child2 = mNodes[node.Child2];
+		if (child1.Parent != nodeId || child2.Parent != nodeId)
+			return false;
+		if (node.Height != 1 + max(child1.Height, child2.Height))
+			return false;
+		for (auto k = 0; k < 3; k++)
+		{
+			if (node.BoundMin[k] > min(child1.BoundMin[k], child2.BoundMin[k]) ||
+				node.BoundMax[k] < max(child1.BoundMax[k], child2.BoundMax[k]))
+				return false;
+		}
+
+		stack.push_back(node.Child1);
+		stack.push_back(node.Child2);
+	}
+
+	return leafNum == mProxyNum;
+}
+
@@ -66,6 +66,10 @@ bool GRiFilmboxManager::ImportFbxFile_Mesh(std::wstring FileName, std::vector<GR
 	if (!ImportNode_Mesh(root, outMeshDataList))
 		return false;
 
+	// Triangles are imported with three vertices of their own, weld them into an indexed mesh per submesh.
+	for (auto& meshData : outMeshDataList)
+		meshData.WeldVertices();
+
 	return true;
 }
 
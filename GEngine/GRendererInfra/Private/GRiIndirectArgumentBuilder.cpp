@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "GRiIndirectArgumentBuilder.h"
+
+
+void GRiIndirectArgumentBuilder::SetLayout(const GRiIndirectCommandLayout& layout)
+{
+	if (layout.DrawArgumentsOffset + sizeof(GRiDrawIndexedArguments) > layout.Stride)
+		ThrowGGiException("Indirect draw arguments exceed the command stride.");
+	if (layout.RootConstantNum > _countof(GRiIndirectDraw::RootConstants))
+		ThrowGGiException("Too many indirect root constants.");
+
+	mLayout = layout;
+}
+
+void GRiIndirectArgumentBuilder::Build(GGiThreadPool* tp, const std::vector<GRiIndirectDraw>& draws, UINT pipelineNum, void* dst, UINT maxCommandNum)
+{
+	UINT num = (UINT)draws.size();
+	if (num > maxCommandNum)
+		ThrowGGiException("Indirect argument buffer overflow.");
+
+	mRanges.clear();
+	mCommandDraws.resize(num);
+	if (num == 0)
+		return;
+
+	UINT chunkNum = 1;
+	if (tp != nullptr && num >= ParallelThreshold)
+		chunkNum = (UINT)tp->GetThreadNum();
+	UINT32 step = num / chunkNum + 1;
+
+	mHistograms.assign(chunkNum * pipelineNum, 0);
+
+	auto countChunk = [&](UINT chunk)
+	{
+		UINT* histogram = mHistograms.data() + chunk * pipelineNum;
+		for (auto j = chunk * step; j < (chunk + 1) * step && j < num; j++)
+		{
+			if (draws[j].PipelineIndex >= pipelineNum)
+				ThrowGGiException("Indirect draw pipeline out of range.");
+			histogram[draws[j].PipelineIndex]++;
+		}
+	};
+
+	if (chunkNum == 1)
+	{
+		countChunk(0);
+	}
+	else
+	{
+		for (auto i = 0u; i < chunkNum; i++)
+		{
+			tp->Enqueue([&, i]
+			{
+				countChunk(i);
+			}
+			);
+		}
+		tp->Flush();
+	}
+
+	// Turn the counters into command offsets, chunk by chunk within each pipeline to keep the submission order.
+	UINT offset = 0;
+	for (auto pipeline = 0u; pipeline < pipelineNum; pipeline++)
+	{
+		GRiIndirectCommandRange range;
+		range.PipelineIndex = pipeline;
+		range.FirstCommand = offset;
+		for (auto i = 0u; i < chunkNum; i++)
+		{
+			UINT count = mHistograms[i * pipelineNum + pipeline];
+			mHistograms[i * pipelineNum + pipeline] = offset;
+			offset += count;
+		}
+		range.CommandNum = offset - range.FirstCommand;
+		if (range.CommandNum > 0)
+			mRanges.push_back(range);
+	}
+
+	UINT8* commands = reinterpret_cast<UINT8*>(dst);
+
+	auto writeChunk = [&](UINT chunk)
+	{
+		UINT* offsets = mHistograms.data() + chunk * pipelineNum;
+		for (auto j = chunk * step; j < (chunk + 1) * step && j < num; j++)
+		{
+			UINT command = offsets[draws[j].PipelineIndex]++;
+			WriteCommand(commands + (size_t)command * mLayout.Stride, draws[j]);
+			mCommandDraws[command] = j;
+		}
+	};
+
+	if (chunkNum == 1)
+	{
+		writeChunk(0);
+	}
+	else
+	{
+		for (auto i = 0u; i < chunkNum; i++)
+		{
+			tp->Enqueue([&, i]
+			{
+				writeChunk(i);
+			}
+			);
+		}
+		tp->Flush();
+	}
+}
+
+const std::vector<GRiIndirectCommandRange>& GRiIndirectArgumentBuilder::GetRanges()
+{
+	return mRanges;
+}
+
+const std::vector<UINT>& GRiIndirectArgumentBuilder::GetCommandDraws()
+{
+	return mCommandDraws;
+}
+
+void GRiIndirectArgumentBuilder::WriteCommand(UINT8* command, const GRiIndirectDraw& draw)
+{
+	if (mLayout.ConstantBufferOffset != GRiIndirectCommandLayout::InvalidOffset)
+		memcpy(command + mLayout.ConstantBufferOffset, &draw.ConstantBufferAddress, sizeof(UINT64));
+
+	if (mLayout.RootConstantOffset != GRiIndirectCommandLayout::InvalidOffset)
+		memcpy(command + mLayout.RootConstantOffset, draw.RootConstants, sizeof(UINT) * mLayout.RootConstantNum);
+
+	memcpy(command + mLayout.DrawArgumentsOffset, &draw.DrawArguments, sizeof(GRiDrawIndexedArguments));
+}
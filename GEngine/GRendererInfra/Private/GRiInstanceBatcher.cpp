@@ -0,0 +1,73 @@
+#include "stdafx.h"
+#include "GRiInstanceBatcher.h"
+
+
+UINT64 GRiInstanceBatcher::MakeBatchKey(UINT topology, UINT mesh, UINT submesh, UINT material)
+{
+	return ((UINT64)(topology & 0xff) << 56) |
+		((UINT64)(mesh & 0xffff) << 40) |
+		((UINT64)(submesh & 0xffffff) << 16) |
+		(UINT64)(material & 0xffff);
+}
+
+void GRiInstanceBatcher::Build(GGiThreadPool* tp, const std::vector<UINT64>& keys, UINT minInstanceNum, UINT maxInstanceNum)
+{
+	mBatches.clear();
+	mInstanceItems.clear();
+	mSingleItems.clear();
+
+	UINT num = (UINT)keys.size();
+
+	mSortedKeys.assign(keys.begin(), keys.end());
+	mSortedItems.resize(num);
+	for (auto i = 0u; i < num; i++)
+		mSortedItems[i] = i;
+
+	// The sort is stable, draws of a key stay in submission order.
+	mSorter.Sort(tp, mSortedKeys, mSortedItems);
+
+	std::vector<UINT> singleItems;
+	UINT runStart = 0;
+	while (runStart < num)
+	{
+		UINT runEnd = runStart + 1;
+		while (runEnd < num && mSortedKeys[runEnd] == mSortedKeys[runStart])
+			runEnd++;
+
+		UINT runNum = runEnd - runStart;
+		if (runNum >= minInstanceNum && (UINT)mInstanceItems.size() + runNum <= maxInstanceNum)
+		{
+			GRiInstanceBatch batch;
+			batch.Key = mSortedKeys[runStart];
+			batch.FirstInstance = (UINT)mInstanceItems.size();
+			batch.InstanceNum = runNum;
+			mBatches.push_back(batch);
+			mInstanceItems.insert(mInstanceItems.end(), mSortedItems.begin() + runStart, mSortedItems.begin() + runEnd);
+		}
+		else
+		{
+			singleItems.insert(singleItems.end(), mSortedItems.begin() + runStart, mSortedItems.begin() + runEnd);
+		}
+
+		runStart = runEnd;
+	}
+
+	// Back to submission order, so that single draws keep whatever order the caller sorted them in.
+	std::sort(singleItems.begin(), singleItems.end());
+	mSingleItems.swap(singleItems);
+}
+
+const std::vector<GRiInstanceBatch>& GRiInstanceBatcher::GetBatches()
+{
+	return mBatches;
+}
+
+const std::vector<UINT>& GRiInstanceBatcher::GetInstanceItems()
+{
+	return mInstanceItems;
+}
+
+const std::vector<UINT>& GRiInstanceBatcher::GetSingleItems()
+{
+	return mSingleItems;
+}
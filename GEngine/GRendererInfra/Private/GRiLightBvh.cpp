@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "GRiLightBvh.h"
+
+#define LIGHT_BVH_LEAF_PRIMS 4
+#define LIGHT_BVH_STACK_SIZE 128
+
+// Rebuild once refitting has made the tree this much more expensive than a fresh build.
+#define LIGHT_BVH_REBUILD_RATIO 1.5f
+
+
+void GRiLightBvh::Update(GGiThreadPool* tp, const GRiPointLight* lights, UINT lightNum)
+{
+	bool bRebuild = lightNum != mLightNum || mBvh.GetNodes().size() == 0;
+	mLightNum = lightNum;
+
+	mBoundMin.resize(lightNum * 3);
+	mBoundMax.resize(lightNum * 3);
+
+	auto computeBounds = [&](UINT begin, UINT end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			for (auto k = 0; k < 3; k++)
+			{
+				mBoundMin[i * 3 + k] = lights[i].Position[k] - lights[i].Range;
+				mBoundMax[i * 3 + k] = lights[i].Position[k] + lights[i].Range;
+			}
+		}
+	};
+
+	if (tp == nullptr)
+	{
+		computeBounds(0, lightNum);
+	}
+	else
+	{
+		UINT threadNum = (UINT)tp->GetThreadNum();
+		UINT step = lightNum > 100 ? lightNum / threadNum + 1 : 100;
+		for (auto i = 0u; i < lightNum; i += step)
+		{
+			tp->Enqueue([&, i]
+			{
+				computeBounds(i, min(i + step, lightNum));
+			}
+			);
+		}
+		tp->Flush();
+	}
+
+	bRebuilt = false;
+	if (!bRebuild)
+	{
+		mBvh.Refit(mBoundMin, mBoundMax);
+		if (mBvh.GetCost() <= mBuildCost * LIGHT_BVH_REBUILD_RATIO)
+			return;
+	}
+
+	mBvh.Build(mBoundMin, mBoundMax, LIGHT_BVH_LEAF_PRIMS);
+	mBuildCost = mBvh.GetCost();
+	bRebuilt = true;
+}
+
+void GRiLightBvh::Query(const float planes[][4], int planeNum, float epsilon, std::vector<UINT>& result)
+{
+	auto& nodes = mBvh.GetNodes();
+	if (nodes.size() == 0)
+		return;
+
+	// (node, mask of planes the node may still cross)
+	int stack[LIGHT_BVH_STACK_SIZE];
+	int maskStack[LIGHT_BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize] = 0;
+	maskStack[stackSize++] = (1 << planeNum) - 1;
+
+	auto& primIndices = mBvh.GetPrimitiveIndices();
+	while (stackSize > 0)
+	{
+		stackSize--;
+		int nodeIndex = stack[stackSize];
+		int mask = maskStack[stackSize];
+
+		auto& node = nodes[nodeIndex];
+		bool bOutside = false;
+		for (auto p = 0; p < planeNum; p++)
+		{
+			if ((mask & (1 << p)) == 0)
+				continue;
+
+			// Nearest and farthest corners along the plane normal.
+			float dMax = planes[p][3];
+			float dMin = planes[p][3];
+			float margin = fabsf(planes[p][3]);
+			for (auto k = 0; k < 3; k++)
+			{
+				float a = planes[p][k] * node.BoundMin[k];
+				float b = planes[p][k] * node.BoundMax[k];
+				dMax += max(a, b);
+				dMin += min(a, b);
+				margin += max(fabsf(a), fabsf(b));
+			}
+			margin *= epsilon;
+			if (dMax < -margin)
+			{
+				bOutside = true;
+				break;
+			}
+			if (dMin >= margin)
+				mask &= ~(1 << p);
+		}
+		if (bOutside)
+			continue;
+
+		if (mask == 0)
+		{
+			GatherSubtree(nodeIndex, result);
+			continue;
+		}
+
+		if (node.Count > 0)
+		{
+			for (auto i = node.Offset; i < node.Offset + node.Count; i++)
+				result.push_back(primIndices[i]);
+			continue;
+		}
+
+		if (stackSize + 2 > LIGHT_BVH_STACK_SIZE)
+		{
+			// Deeper than the stack, don't cull the rest of this subtree.
+			GatherSubtree(nodeIndex, result);
+			continue;
+		}
+
+		stack[stackSize] = node.Offset;
+		maskStack[stackSize++] = mask;
+		stack[stackSize] = nodeIndex + 1;
+		maskStack[stackSize++] = mask;
+	}
+}
+
+UINT GRiLightBvh::GetLightNum()
+{
+	return mLightNum;
+}
+
+bool GRiLightBvh::WasRebuilt()
+{
+	return bRebuilt;
+}
+
+void GRiLightBvh::GatherSubtree(int nodeIndex, std::vector<UINT>& result)
+{
+	auto& nodes = mBvh.GetNodes();
+	auto& primIndices = mBvh.GetPrimitiveIndices();
+
+	// Nodes are stored depth-first, so the primitives of a subtree are contiguous, from its leftmost to its
+	// rightmost leaf.
+	int first = nodeIndex;
+	while (nodes[first].Count == 0)
+		first = first + 1;
+	int last = nodeIndex;
+	while (nodes[last].Count == 0)
+		last = nodes[last].Offset;
+
+	for (auto i = nodes[first].Offset; i < nodes[last].Offset + nodes[last].Count; i++)
+		result.push_back(primIndices[i]);
+}
+
@@ -0,0 +1,442 @@
+#include "stdafx.h"
+#include "GRiLightManager.h"
+#include "GRiOcclusionCullingRasterizer.h"
+
+#include <chrono>
+
+
+GRiLightHandle GRiLightManager::AddPointLight(const GRiPointLight& light)
+{
+	GRiLightHandle handle;
+	handle.Index = AllocateSlot(GRiLightType::Point);
+	handle.Generation = mSlots[handle.Index].Generation;
+	SetPointLight(handle, light);
+	return handle;
+}
+
+GRiLightHandle GRiLightManager::AddSpotlight(const GRiSpotlight& light)
+{
+	GRiLightHandle handle;
+	handle.Index = AllocateSlot(GRiLightType::Spot);
+	handle.Generation = mSlots[handle.Index].Generation;
+	SetSpotlight(handle, light);
+	return handle;
+}
+
+GRiLightHandle GRiLightManager::AddDirectionalLight(const GRiDirectionalLight& light)
+{
+	GRiLightHandle handle;
+	handle.Index = AllocateSlot(GRiLightType::Directional);
+	handle.Generation = mSlots[handle.Index].Generation;
+	SetDirectionalLight(handle, light);
+	return handle;
+}
+
+void GRiLightManager::SetPointLight(GRiLightHandle handle, const GRiPointLight& light)
+{
+	auto& slot = GetSlot(handle, GRiLightType::Point);
+	slot.Point = light;
+	SetBound(handle.Index, light.Position[0], light.Position[1], light.Position[2], light.Range);
+
+	auto& box = mVolumeBounds[handle.Index];
+	for (auto k = 0; k < 3; k++)
+	{
+		box.Center[k] = light.Position[k];
+		box.Extents[k] = light.Range;
+	}
+	MarkChanged(handle.Index);
+}
+
+void GRiLightManager::SetSpotlight(GRiLightHandle handle, const GRiSpotlight& light)
+{
+	auto& slot = GetSlot(handle, GRiLightType::Spot);
+	slot.Spot = light;
+
+	float dir[3] = { light.Direction[0], light.Direction[1], light.Direction[2] };
+	float len = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+	if (len <= 0.0f)
+		ThrowGGiException("Invalid spotlight direction.");
+
+	// Smallest sphere around the cone. Wide cones are bounded by their cap, narrow ones by the apex and the rim.
+	float cosAngle = cosf(light.SpotlightAngle);
+	float sinAngle = sinf(light.SpotlightAngle);
+	float centerDist, radius;
+	if (cosAngle < 0.70710678f)
+	{
+		centerDist = light.Range * cosAngle;
+		radius = light.Range * sinAngle;
+	}
+	else
+	{
+		centerDist = light.Range / (2.0f * cosAngle);
+		radius = centerDist;
+	}
+	SetBound(handle.Index,
+		light.Position[0] + dir[0] / len * centerDist,
+		light.Position[1] + dir[1] / len * centerDist,
+		light.Position[2] + dir[2] / len * centerDist,
+		radius);
+
+	// Box around the apex, the rim of the cap and, on every axis the cone opens towards, the cap itself.
+	float boxMin[3], boxMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		float d = dir[k] / len;
+		if (cosAngle <= 0.0f)
+		{
+			boxMin[k] = light.Position[k] - light.Range;
+			boxMax[k] = light.Position[k] + light.Range;
+			continue;
+		}
+
+		float rimCenter = light.Position[k] + d * light.Range * cosAngle;
+		float rimExtent = light.Range * sinAngle * sqrtf(max(0.0f, 1.0f - d * d));
+		boxMin[k] = min(light.Position[k], rimCenter - rimExtent);
+		boxMax[k] = max(light.Position[k], rimCenter + rimExtent);
+		if (d >= cosAngle)
+			boxMax[k] = light.Position[k] + light.Range;
+		if (-d >= cosAngle)
+			boxMin[k] = light.Position[k] - light.Range;
+	}
+	auto& box = mVolumeBounds[handle.Index];
+	for (auto k = 0; k < 3; k++)
+	{
+		box.Center[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+		box.Extents[k] = (boxMax[k] - boxMin[k]) * 0.5f;
+	}
+	MarkChanged(handle.Index);
+}
+
+void GRiLightManager::SetDirectionalLight(GRiLightHandle handle, const GRiDirectionalLight& light)
+{
+	auto& slot = GetSlot(handle, GRiLightType::Directional);
+	slot.Directional = light;
+	bDirectionalLightsDirty = true;
+}
+
+void GRiLightManager::Remove(GRiLightHandle handle)
+{
+	if (!IsValid(handle))
+		ThrowGGiException("Invalid light handle.");
+
+	auto& slot = mSlots[handle.Index];
+	if (slot.Type == GRiLightType::Directional)
+		bDirectionalLightsDirty = true;
+
+	slot.bAlive = false;
+	slot.Generation++;
+	SetBound(handle.Index, 0.0f, 0.0f, 0.0f, -GGiEngineUtil::Infinity);
+	mFreeSlots.push_back(handle.Index);
+}
+
+bool GRiLightManager::IsValid(GRiLightHandle handle)
+{
+	return handle.Index < mSlots.size() && mSlots[handle.Index].bAlive && mSlots[handle.Index].Generation == handle.Generation;
+}
+
+GRiLightType GRiLightManager::GetType(GRiLightHandle handle)
+{
+	if (!IsValid(handle))
+		ThrowGGiException("Invalid light handle.");
+
+	return mSlots[handle.Index].Type;
+}
+
+UINT GRiLightManager::GetLightNum()
+{
+	return (UINT)(mSlots.size() - mFreeSlots.size());
+}
+
+void GRiLightManager::Cull(GGiThreadPool* tp, const float planes[6][4], __m128* occlusionViewProj)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	memcpy(mPlanes, planes, sizeof(mPlanes));
+
+	// One task per range of 4-light groups, every task keeps its visible slots in order.
+	UINT groupNum = (UINT)mBoundX.size() / 4;
+	UINT32 step;
+	if (tp != nullptr && groupNum > 100)
+		step = (UINT32)(groupNum / tp->GetThreadNum()) + 1;
+	else
+		step = groupNum > 100 ? groupNum : 100;
+	UINT taskNum = (groupNum + step - 1) / step;
+	mTaskVisibleSlots.resize(taskNum);
+
+	if (tp == nullptr || taskNum < 2)
+	{
+		for (auto t = 0u; t < taskNum; t++)
+			CullGroups(t * step, min(step, groupNum - t * step), mTaskVisibleSlots[t]);
+	}
+	else
+	{
+		for (auto t = 0u; t < taskNum; t++)
+		{
+			tp->Enqueue([&, t]
+			{
+				CullGroups(t * step, min(step, groupNum - t * step), mTaskVisibleSlots[t]);
+			}
+			);
+		}
+		tp->Flush();
+	}
+
+	// Drop the hidden lights before compacting, so the changed ranges only see the lights that stay.
+	UINT occludedNum = 0;
+	mOcclusionSlots.clear();
+	mOcclusionBounds.clear();
+	if (occlusionViewProj != nullptr)
+	{
+		for (auto t = 0u; t < taskNum; t++)
+		{
+			for (auto s : mTaskVisibleSlots[t])
+			{
+				mOcclusionSlots.push_back(s);
+				mOcclusionBounds.push_back(mVolumeBounds[s]);
+			}
+		}
+
+		if (mOcclusionVisibleCapacity < mOcclusionSlots.size())
+		{
+			mOcclusionVisibleCapacity = (UINT)mOcclusionSlots.size() * 2;
+			mOcclusionVisible.reset(new bool[mOcclusionVisibleCapacity]);
+		}
+
+		GRiOcclusionCullingRasterizer::GetInstance().RectTestBoundsMaskedMT(tp, mOcclusionBounds.data(), (int)mOcclusionBounds.size(), occlusionViewProj, mOcclusionVisible.get());
+
+		UINT i = 0;
+		for (auto t = 0u; t < taskNum; t++)
+		{
+			UINT num = 0;
+			for (auto s : mTaskVisibleSlots[t])
+			{
+				if (mOcclusionVisible[i++])
+					mTaskVisibleSlots[t][num++] = s;
+			}
+			occludedNum += (UINT)mTaskVisibleSlots[t].size() - num;
+			mTaskVisibleSlots[t].resize(num);
+		}
+	}
+
+	// Compact.
+	mPrevVisiblePointSlots.swap(mVisiblePointSlots);
+	mPrevVisibleSpotSlots.swap(mVisibleSpotSlots);
+	mVisiblePointSlots.clear();
+	mVisibleSpotSlots.clear();
+	mVisiblePointLights.clear();
+	mVisibleSpotlights.clear();
+	for (auto t = 0u; t < taskNum; t++)
+	{
+		for (auto s : mTaskVisibleSlots[t])
+		{
+			if (mSlots[s].Type == GRiLightType::Point)
+			{
+				mVisiblePointSlots.push_back(s);
+				mVisiblePointLights.push_back(mSlots[s].Point);
+			}
+			else
+			{
+				mVisibleSpotSlots.push_back(s);
+				mVisibleSpotlights.push_back(mSlots[s].Spot);
+			}
+		}
+	}
+
+	mChangedPointLightRange = FindChangedRange(mPrevVisiblePointSlots, mVisiblePointSlots);
+	mChangedSpotlightRange = FindChangedRange(mPrevVisibleSpotSlots, mVisibleSpotSlots);
+
+	for (auto s : mChangedSlots)
+		mSlots[s].bChanged = false;
+	mChangedSlots.clear();
+
+	bDirectionalLightsChanged = bDirectionalLightsDirty;
+	if (bDirectionalLightsDirty)
+	{
+		mDirectionalLights.clear();
+		for (auto& slot : mSlots)
+		{
+			if (slot.bAlive && slot.Type == GRiLightType::Directional)
+				mDirectionalLights.push_back(slot.Directional);
+		}
+		bDirectionalLightsDirty = false;
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	mStats = GRiLightCullingStats();
+	mStats.LightNum = GetLightNum() - (UINT)mDirectionalLights.size();
+	mStats.VisibleNum = (UINT)(mVisiblePointSlots.size() + mVisibleSpotSlots.size());
+	mStats.OccludedNum = occludedNum;
+	mStats.ChangedNum = mChangedPointLightRange.Num + mChangedSpotlightRange.Num;
+	mStats.CullTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+const std::vector<GRiPointLight>& GRiLightManager::GetVisiblePointLights()
+{
+	return mVisiblePointLights;
+}
+
+const std::vector<GRiSpotlight>& GRiLightManager::GetVisibleSpotlights()
+{
+	return mVisibleSpotlights;
+}
+
+const std::vector<GRiDirectionalLight>& GRiLightManager::GetDirectionalLights()
+{
+	return mDirectionalLights;
+}
+
+GRiLightRange GRiLightManager::GetChangedPointLightRange()
+{
+	return mChangedPointLightRange;
+}
+
+GRiLightRange GRiLightManager::GetChangedSpotlightRange()
+{
+	return mChangedSpotlightRange;
+}
+
+bool GRiLightManager::HaveDirectionalLightsChanged()
+{
+	return bDirectionalLightsChanged;
+}
+
+const std::vector<GRiBoundingBox>& GRiLightManager::GetOcclusionBounds()
+{
+	return mOcclusionBounds;
+}
+
+const bool* GRiLightManager::GetOcclusionResults()
+{
+	return mOcclusionVisible.get();
+}
+
+GRiLightCullingStats GRiLightManager::GetStats()
+{
+	return mStats;
+}
+
+UINT GRiLightManager::AllocateSlot(GRiLightType type)
+{
+	UINT index;
+	if (mFreeSlots.size() > 0)
+	{
+		index = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		index = (UINT)mSlots.size();
+		mSlots.push_back(GRiLightSlot());
+		mVolumeBounds.push_back(GRiBoundingBox());
+
+		// Keep the bounds padded for the 4-wide test.
+		if (mSlots.size() > mBoundX.size())
+		{
+			for (auto k = 0; k < 4; k++)
+			{
+				mBoundX.push_back(0.0f);
+				mBoundY.push_back(0.0f);
+				mBoundZ.push_back(0.0f);
+				mBoundRadius.push_back(-GGiEngineUtil::Infinity);
+			}
+		}
+	}
+
+	auto& slot = mSlots[index];
+	slot.Type = type;
+	slot.bAlive = true;
+	return index;
+}
+
+GRiLightManager::GRiLightSlot& GRiLightManager::GetSlot(GRiLightHandle handle, GRiLightType type)
+{
+	if (!IsValid(handle))
+		ThrowGGiException("Invalid light handle.");
+	if (mSlots[handle.Index].Type != type)
+		ThrowGGiException("Light type mismatch.");
+
+	return mSlots[handle.Index];
+}
+
+void GRiLightManager::MarkChanged(UINT slot)
+{
+	if (mSlots[slot].bChanged)
+		return;
+
+	mSlots[slot].bChanged = true;
+	mChangedSlots.push_back(slot);
+}
+
+void GRiLightManager::SetBound(UINT slot, float x, float y, float z, float radius)
+{
+	mBoundX[slot] = x;
+	mBoundY[slot] = y;
+	mBoundZ[slot] = z;
+	mBoundRadius[slot] = radius;
+}
+
+void GRiLightManager::CullGroups(UINT firstGroup, UINT groupNum, std::vector<UINT>& visibleSlots)
+{
+	visibleSlots.clear();
+
+	__m128 planes[6][4];
+	for (auto p = 0; p < 6; p++)
+	{
+		for (auto k = 0; k < 4; k++)
+			planes[p][k] = _mm_set1_ps(mPlanes[p][k]);
+	}
+
+	for (auto g = firstGroup; g < firstGroup + groupNum; g++)
+	{
+		UINT i = g * 4;
+		__m128 x = _mm_loadu_ps(&mBoundX[i]);
+		__m128 y = _mm_loadu_ps(&mBoundY[i]);
+		__m128 z = _mm_loadu_ps(&mBoundZ[i]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&mBoundRadius[i]));
+
+		// Visible unless entirely behind one of the planes.
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (auto p = 0; p < 6; p++)
+		{
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		while (mask != 0)
+		{
+			int k = 0;
+			while ((mask & (1 << k)) == 0)
+				k++;
+			mask &= ~(1 << k);
+			visibleSlots.push_back(i + k);
+		}
+	}
+}
+
+GRiLightRange GRiLightManager::FindChangedRange(const std::vector<UINT>& prevSlots, const std::vector<UINT>& slots)
+{
+	auto isChanged = [&](UINT i)
+	{
+		return i >= prevSlots.size() || prevSlots[i] != slots[i] || mSlots[slots[i]].bChanged;
+	};
+
+	GRiLightRange range;
+	UINT first = 0;
+	while (first < slots.size() && !isChanged(first))
+		first++;
+	if (first == slots.size())
+		return range;
+
+	UINT last = (UINT)slots.size() - 1;
+	while (last > first && !isChanged(last))
+		last--;
+
+	range.First = first;
+	range.Num = last - first + 1;
+	return range;
+}
+
@@ -4,11 +4,13 @@
 
 GRiMaterial::GRiMaterial()
 {
+	MarkDirty();
 }
 
 
 GRiMaterial::~GRiMaterial()
 {
+	GetDirtyList().Remove(&mDirtyListSlot);
 }
 
 
@@ -41,6 +43,13 @@ float GRiMaterial::GetScaleY()
 void GRiMaterial::MarkDirty()
 {
 	NumFramesDirty = NUM_FRAME_RESOURCES;
+	GetDirtyList().Add(this, &mDirtyListSlot);
+}
+
+GRiDirtyList<GRiMaterial>& GRiMaterial::GetDirtyList()
+{
+	static GRiDirtyList<GRiMaterial> *instance = new GRiDirtyList<GRiMaterial>();
+	return *instance;
 }
 
 size_t GRiMaterial::GetTextureNum()
@@ -2,12 +2,13 @@
 #include "GRiMesh.h"
 
 
-/*
 GRiMesh::GRiMesh()
 {
+	static UINT nextMeshId = 0;
+	MeshId = nextMeshId++;
 }
 
-
+/*
 GRiMesh::~GRiMesh()
 {
 }
@@ -50,6 +51,16 @@ void GRiMesh::SetSdfResolution(int res)
 	SdfResolution = res;
 }
 
+float GRiMesh::GetSdfExtent()
+{
+	return SdfExtent;
+}
+
+void GRiMesh::SetSdfExtent(float extent)
+{
+	SdfExtent = extent;
+}
+
 std::shared_ptr<std::vector<float>> GRiMesh::GetSdf()
 {
 	return SignedDistanceField;
@@ -60,6 +71,25 @@ void GRiMesh::InitializeSdf(std::vector<float>& sdf)
 	SignedDistanceField = std::make_shared<std::vector<float>>(sdf);
 }
 
+std::shared_ptr<GRiMeshBvh> GRiMesh::GetBvh()
+{
+	return mBvh;
+}
+
+void GRiMesh::SetBvh(std::shared_ptr<GRiMeshBvh> bvh)
+{
+	mBvh = bvh;
+}
+
+std::shared_ptr<GRiMeshletSet> GRiMesh::GetMeshlets()
+{
+	return mMeshlets;
+}
+
+void GRiMesh::SetMeshlets(std::shared_ptr<GRiMeshletSet> meshlets)
+{
+	mMeshlets = meshlets;
+}
 
 
 
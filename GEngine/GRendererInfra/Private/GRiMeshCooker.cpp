@@ -0,0 +1,528 @@
+#include "stdafx.h"
+#include "GRiMeshCooker.h"
+
+#define COOKED_MESH_ALIGNMENT 16
+
+#define COOKED_MESH_HASH_CHUNK_SIZE (1 << 20)
+
+
+static inline UINT64 AlignCookedOffset(UINT64 offset)
+{
+	return (offset + COOKED_MESH_ALIGNMENT - 1) & ~(UINT64)(COOKED_MESH_ALIGNMENT - 1);
+}
+
+// Closes the temporary file and moves it over the cooked file, so that a crash or a failed write never leaves a
+// partially written cooked file behind.
+static void ReplaceCookedFile(std::ofstream& file, const std::wstring& tempPath, const std::wstring& path)
+{
+	file.close();
+	if (file.fail())
+	{
+		DeleteFileW(tempPath.c_str());
+		ThrowGGiException(L"Failed to write \"" + tempPath + L"\".");
+	}
+
+	if (!MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileW(tempPath.c_str());
+		ThrowGGiException(L"Can't replace \"" + path + L"\".");
+	}
+}
+
+GRiCookedMesh::~GRiCookedMesh()
+{
+	Close();
+}
+
+bool GRiCookedMesh::Open(const std::wstring& path, UINT64 sourceHash)
+{
+	Close();
+
+	mFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mFile, &fileSize) || (UINT64)fileSize.QuadPart < sizeof(GRiCookedMeshHeader))
+	{
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = (const BYTE*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mHeader = (const GRiCookedMeshHeader*)mData;
+	auto& h = *mHeader;
+	auto fits = [&](UINT64 offset, UINT64 byteSize)
+	{
+		return offset % COOKED_MESH_ALIGNMENT == 0 && offset <= h.FileSize && byteSize <= h.FileSize - offset;
+	};
+	bool bValid =
+		h.Magic == COOKED_MESH_MAGIC &&
+		h.Version == COOKED_MESH_VERSION &&
+		h.SourceHash == sourceHash &&
+		h.VertexStride == sizeof(GRiVertex) &&
+		h.FileSize <= (UINT64)fileSize.QuadPart &&
+		fits(h.SubmeshOffset, (UINT64)h.SubmeshNum * sizeof(GRiCookedSubmesh)) &&
+		fits(h.VertexOffset, (UINT64)h.VertexNum * sizeof(GRiVertex)) &&
+		fits(h.IndexOffset, (UINT64)h.IndexNum * sizeof(UINT32)) &&
+		fits(h.MeshletOffset, (UINT64)h.MeshletNum * sizeof(GRiMeshlet)) &&
+		fits(h.BvhNodeOffset, (UINT64)h.BvhNodeNum * sizeof(GRiBvhNode)) &&
+		fits(h.BvhPrimitiveOffset, (UINT64)h.BvhPrimitiveNum * sizeof(UINT32)) &&
+		fits(h.SdfOffset, (UINT64)h.SdfResolution * h.SdfResolution * h.SdfResolution * sizeof(float));
+	if (bValid)
+	{
+		for (auto i = 0u; i < h.SubmeshNum && bValid; i++)
+		{
+			auto& submesh = GetSubmesh(i);
+			bValid = (UINT64)submesh.StartIndexLocation + submesh.IndexCount <= h.IndexNum &&
+				(UINT64)submesh.FirstMeshlet + submesh.MeshletNum <= h.MeshletNum &&
+				fits(h.NameOffset, ((UINT64)submesh.NameOffset + submesh.NameLength) * sizeof(UINT16));
+		}
+		for (auto i = 0u; i < h.MeshletNum && bValid; i++)
+		{
+			auto& meshlet = GetMeshlets()[i];
+			bValid = (UINT64)meshlet.StartIndexLocation + meshlet.IndexCount <= h.IndexNum;
+		}
+
+		// The indices and the bvh are read without any checks later, so a file referencing data out of range is
+		// rejected here and cooked again.
+		UINT64 triangleNum = 0;
+		for (auto i = 0u; i < h.SubmeshNum && bValid; i++)
+		{
+			auto& submesh = GetSubmesh(i);
+			auto indices = GetIndices() + submesh.StartIndexLocation;
+			bValid = submesh.BaseVertexLocation >= 0;
+			for (auto j = 0u; j < submesh.IndexCount && bValid; j++)
+				bValid = (UINT64)indices[j] + (UINT64)submesh.BaseVertexLocation < h.VertexNum;
+			triangleNum += submesh.IndexCount / 3;
+		}
+
+		// Depth first layout, the first child of an interior node directly follows it.
+		auto nodes = (const GRiBvhNode*)(mData + h.BvhNodeOffset);
+		for (auto i = 0u; i < h.BvhNodeNum && bValid; i++)
+		{
+			auto& node = nodes[i];
+			if (node.Count == 0)
+				bValid = node.Offset > (INT64)i + 1 && (UINT64)node.Offset < h.BvhNodeNum;
+			else
+				bValid = node.Count > 0 && node.Offset >= 0 && (UINT64)node.Offset + (UINT64)node.Count <= h.BvhPrimitiveNum;
+		}
+		auto primitives = (const UINT32*)(mData + h.BvhPrimitiveOffset);
+		for (auto i = 0u; i < h.BvhPrimitiveNum && bValid; i++)
+			bValid = primitives[i] < triangleNum;
+	}
+	if (!bValid)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void GRiCookedMesh::Close()
+{
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mData = nullptr;
+	mHeader = nullptr;
+	mMapping = nullptr;
+	mFile = INVALID_HANDLE_VALUE;
+}
+
+UINT GRiCookedMesh::GetSubmeshNum()
+{
+	return mHeader->SubmeshNum;
+}
+
+const GRiCookedSubmesh& GRiCookedMesh::GetSubmesh(UINT index)
+{
+	return ((const GRiCookedSubmesh*)(mData + mHeader->SubmeshOffset))[index];
+}
+
+std::wstring GRiCookedMesh::GetSubmeshName(UINT index)
+{
+	auto& submesh = GetSubmesh(index);
+	auto name = (const UINT16*)(mData + mHeader->NameOffset) + submesh.NameOffset;
+
+	std::wstring ret(submesh.NameLength, L' ');
+	for (auto i = 0u; i < submesh.NameLength; i++)
+		ret[i] = (wchar_t)name[i];
+	return ret;
+}
+
+const GRiVertex* GRiCookedMesh::GetVertices()
+{
+	return (const GRiVertex*)(mData + mHeader->VertexOffset);
+}
+
+UINT GRiCookedMesh::GetVertexNum()
+{
+	return mHeader->VertexNum;
+}
+
+const UINT32* GRiCookedMesh::GetIndices()
+{
+	return (const UINT32*)(mData + mHeader->IndexOffset);
+}
+
+UINT GRiCookedMesh::GetIndexNum()
+{
+	return mHeader->IndexNum;
+}
+
+GRiBoundingBox GRiCookedMesh::GetBounds()
+{
+	GRiBoundingBox bounds;
+	for (auto k = 0; k < 3; k++)
+	{
+		bounds.Center[k] = mHeader->BoundsCenter[k];
+		bounds.Extents[k] = mHeader->BoundsExtents[k];
+	}
+	return bounds;
+}
+
+bool GRiCookedMesh::HasMeshlets()
+{
+	return mHeader->MeshletNum > 0;
+}
+
+const GRiMeshlet* GRiCookedMesh::GetMeshlets()
+{
+	return (const GRiMeshlet*)(mData + mHeader->MeshletOffset);
+}
+
+UINT GRiCookedMesh::GetMeshletNum()
+{
+	return mHeader->MeshletNum;
+}
+
+bool GRiCookedMesh::HasBvh()
+{
+	return mHeader->BvhNodeNum > 0;
+}
+
+std::shared_ptr<GRiMeshBvh> GRiCookedMesh::CreateBvh()
+{
+	if (!HasBvh())
+		return nullptr;
+
+	std::vector<float> positions;
+	std::vector<UINT> triangleIndices;
+	GRiMeshCooker::GetTriangles(GetVertices(), GetVertexNum(), GetIndices(), &GetSubmesh(0), GetSubmeshNum(), positions, triangleIndices);
+
+	auto bvh = std::make_shared<GRiMeshBvh>();
+	bvh->Load(std::move(positions), std::move(triangleIndices),
+		(const GRiBvhNode*)(mData + mHeader->BvhNodeOffset), (int)mHeader->BvhNodeNum,
+		(const UINT*)(mData + mHeader->BvhPrimitiveOffset), (int)mHeader->BvhPrimitiveNum);
+	return bvh;
+}
+
+bool GRiCookedMesh::HasSdf()
+{
+	return mHeader->SdfResolution > 0;
+}
+
+int GRiCookedMesh::GetSdfResolution()
+{
+	return mHeader->SdfResolution;
+}
+
+float GRiCookedMesh::GetSdfExtent()
+{
+	return mHeader->SdfExtent;
+}
+
+const float* GRiCookedMesh::GetSdf()
+{
+	return (const float*)(mData + mHeader->SdfOffset);
+}
+
+UINT64 GRiMeshCooker::HashFile(const std::wstring& path)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+		ThrowGGiException(L"Can't read \"" + path + L"\".");
+
+	// FNV-1a over 8 byte words, the tail is zero padded.
+	UINT64 hash = 14695981039346656037ull;
+	std::vector<UINT64> chunk(COOKED_MESH_HASH_CHUNK_SIZE / sizeof(UINT64));
+	while (file)
+	{
+		file.read((char*)chunk.data(), COOKED_MESH_HASH_CHUNK_SIZE);
+		auto byteNum = (size_t)file.gcount();
+		if (byteNum == 0)
+			break;
+
+		auto wordNum = (byteNum + sizeof(UINT64) - 1) / sizeof(UINT64);
+		memset((char*)chunk.data() + byteNum, 0, wordNum * sizeof(UINT64) - byteNum);
+		for (auto i = 0u; i < wordNum; i++)
+		{
+			hash ^= chunk[i];
+			hash *= 1099511628211ull;
+		}
+		hash ^= byteNum;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+std::wstring GRiMeshCooker::GetCookedPath(const std::wstring& cookedDirectory, UINT64 sourceHash)
+{
+	wchar_t name[17];
+	swprintf(name, 17, L"%016llx", (unsigned long long)sourceHash);
+	return cookedDirectory + name + COOKED_MESH_EXTENSION;
+}
+
+void GRiMeshCooker::Cook(const std::wstring& path, UINT64 sourceHash, const std::vector<GRiMeshData>& sourceMeshData, bool bOptimize, bool bBuildMeshlets, bool bBuildBvh,
+	std::vector<GRiMeshOptimizationStats>* optimizationStats, std::vector<GRiMeshletBuildStats>* meshletStats)
+{
+	// Submeshes are independent, so every one is optimized and split into meshlets on a worker thread of its own.
+	std::vector<GRiMeshData> processedMeshData;
+	std::vector<GRiMeshOptimizationStats> stats;
+	std::vector<GRiMeshletBuildStats> buildStats;
+	std::vector<std::vector<GRiMeshlet>> submeshMeshlets(sourceMeshData.size());
+	bool bProcess = bOptimize || bBuildMeshlets;
+	if (bProcess)
+	{
+		processedMeshData = sourceMeshData;
+		if (bOptimize)
+			stats.resize(processedMeshData.size());
+		if (bBuildMeshlets)
+			buildStats.resize(processedMeshData.size());
+
+		auto process = [&](UINT i)
+		{
+			if (bOptimize)
+				stats[i] = GRiMeshOptimizer::Optimize(processedMeshData[i]);
+			if (bBuildMeshlets)
+				buildStats[i] = GRiMeshletBuilder::Build(processedMeshData[i], submeshMeshlets[i]);
+		};
+
+		auto threadNum = (size_t)min((UINT)std::thread::hardware_concurrency(), (UINT)processedMeshData.size());
+		if (threadNum > 1)
+		{
+			GGiThreadPool tp(threadNum);
+			for (auto i = 0u; i < processedMeshData.size(); i++)
+			{
+				tp.Enqueue([&, i]
+				{
+					process(i);
+				});
+			}
+			tp.Flush();
+		}
+		else
+		{
+			for (auto i = 0u; i < processedMeshData.size(); i++)
+				process(i);
+		}
+	}
+	if (optimizationStats != nullptr)
+		*optimizationStats = stats;
+	if (meshletStats != nullptr)
+		*meshletStats = buildStats;
+	auto& meshData = bProcess ? processedMeshData : sourceMeshData;
+
+	GRiCookedMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = COOKED_MESH_MAGIC;
+	header.Version = COOKED_MESH_VERSION;
+	header.SourceHash = sourceHash;
+	header.SubmeshNum = (UINT32)meshData.size();
+	header.VertexStride = sizeof(GRiVertex);
+
+	// Same submesh layout as GDxMesh::Create(). Meshlet ranges move from the submesh to the mesh index buffer.
+	std::vector<GRiCookedSubmesh> submeshes(meshData.size());
+	std::vector<UINT16> names;
+	std::vector<GRiMeshlet> meshlets;
+	for (auto i = 0u; i < meshData.size(); i++)
+	{
+		auto& submesh = submeshes[i];
+		submesh.IndexCount = (UINT32)meshData[i].Indices.size();
+		submesh.StartIndexLocation = header.IndexNum;
+		submesh.BaseVertexLocation = (INT32)header.VertexNum;
+		submesh.NameOffset = (UINT32)names.size();
+		submesh.NameLength = (UINT32)meshData[i].SubmeshName.size();
+		for (auto c : meshData[i].SubmeshName)
+			names.push_back((UINT16)c);
+		submesh.FirstMeshlet = (UINT32)meshlets.size();
+		submesh.MeshletNum = (UINT32)submeshMeshlets[i].size();
+		for (auto meshlet : submeshMeshlets[i])
+		{
+			meshlet.StartIndexLocation += submesh.StartIndexLocation;
+			meshlets.push_back(meshlet);
+		}
+
+		header.VertexNum += (UINT32)meshData[i].Vertices.size();
+		header.IndexNum += (UINT32)meshData[i].Indices.size();
+	}
+	header.MeshletNum = (UINT32)meshlets.size();
+
+	// Same bounds as GDxMesh::Create(), they always contain the origin.
+	float vMin[3] = { 0.0f, 0.0f, 0.0f };
+	float vMax[3] = { 0.0f, 0.0f, 0.0f };
+	for (auto& data : meshData)
+	{
+		for (auto& v : data.Vertices)
+		{
+			for (auto k = 0; k < 3; k++)
+			{
+				vMin[k] = min(vMin[k], v.Position[k]);
+				vMax[k] = max(vMax[k], v.Position[k]);
+			}
+		}
+	}
+	for (auto k = 0; k < 3; k++)
+	{
+		header.BoundsCenter[k] = (vMax[k] + vMin[k]) / 2;
+		header.BoundsExtents[k] = (vMax[k] - vMin[k]) / 2;
+	}
+
+	GRiMeshBvh bvh;
+	if (bBuildBvh && header.IndexNum > 0)
+	{
+		std::vector<GRiVertex> vertices;
+		std::vector<UINT32> indices;
+		vertices.reserve(header.VertexNum);
+		indices.reserve(header.IndexNum);
+		for (auto& data : meshData)
+		{
+			vertices.insert(vertices.end(), data.Vertices.begin(), data.Vertices.end());
+			indices.insert(indices.end(), data.Indices.begin(), data.Indices.end());
+		}
+
+		std::vector<float> positions;
+		std::vector<UINT> triangleIndices;
+		GetTriangles(vertices.data(), header.VertexNum, indices.data(), submeshes.data(), header.SubmeshNum, positions, triangleIndices);
+		bvh.Build(std::move(positions), std::move(triangleIndices));
+
+		header.BvhNodeNum = (UINT32)bvh.GetNodes().size();
+		header.BvhPrimitiveNum = (UINT32)bvh.GetPrimitiveIndices().size();
+	}
+
+	UINT64 offset = sizeof(GRiCookedMeshHeader);
+	auto place = [&](UINT64& sectionOffset, UINT64 byteSize)
+	{
+		offset = AlignCookedOffset(offset);
+		sectionOffset = offset;
+		offset += byteSize;
+	};
+	place(header.SubmeshOffset, (UINT64)header.SubmeshNum * sizeof(GRiCookedSubmesh));
+	place(header.NameOffset, (UINT64)names.size() * sizeof(UINT16));
+	place(header.VertexOffset, (UINT64)header.VertexNum * sizeof(GRiVertex));
+	place(header.IndexOffset, (UINT64)header.IndexNum * sizeof(UINT32));
+	place(header.MeshletOffset, (UINT64)header.MeshletNum * sizeof(GRiMeshlet));
+	place(header.BvhNodeOffset, (UINT64)header.BvhNodeNum * sizeof(GRiBvhNode));
+	place(header.BvhPrimitiveOffset, (UINT64)header.BvhPrimitiveNum * sizeof(UINT32));
+	place(header.SdfOffset, 0);
+	header.FileSize = offset;
+
+	std::wstring tempPath = path + L".tmp";
+	std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		ThrowGGiException(L"Can't write \"" + tempPath + L"\".");
+
+	auto write = [&](UINT64 sectionOffset, const void* data, UINT64 byteSize)
+	{
+		static const char padding[COOKED_MESH_ALIGNMENT] = { 0 };
+		file.write(padding, (std::streamsize)(sectionOffset - (UINT64)file.tellp()));
+		file.write((const char*)data, (std::streamsize)byteSize);
+	};
+	write(0, &header, sizeof(header));
+	write(header.SubmeshOffset, submeshes.data(), (UINT64)header.SubmeshNum * sizeof(GRiCookedSubmesh));
+	write(header.NameOffset, names.data(), (UINT64)names.size() * sizeof(UINT16));
+	for (auto i = 0u; i < meshData.size(); i++)
+	{
+		UINT64 vertexOffset = header.VertexOffset + (UINT64)submeshes[i].BaseVertexLocation * sizeof(GRiVertex);
+		write(vertexOffset, meshData[i].Vertices.data(), (UINT64)meshData[i].Vertices.size() * sizeof(GRiVertex));
+	}
+	for (auto i = 0u; i < meshData.size(); i++)
+	{
+		UINT64 indexOffset = header.IndexOffset + (UINT64)submeshes[i].StartIndexLocation * sizeof(UINT32);
+		write(indexOffset, meshData[i].Indices.data(), (UINT64)meshData[i].Indices.size() * sizeof(UINT32));
+	}
+	write(header.MeshletOffset, meshlets.data(), (UINT64)header.MeshletNum * sizeof(GRiMeshlet));
+	if (header.BvhNodeNum > 0)
+	{
+		write(header.BvhNodeOffset, bvh.GetNodes().data(), (UINT64)header.BvhNodeNum * sizeof(GRiBvhNode));
+		write(header.BvhPrimitiveOffset, bvh.GetPrimitiveIndices().data(), (UINT64)header.BvhPrimitiveNum * sizeof(UINT32));
+	}
+	write(header.SdfOffset, nullptr, 0);
+
+	ReplaceCookedFile(file, tempPath, path);
+}
+
+void GRiMeshCooker::WriteSdf(const std::wstring& path, int resolution, float extent, const float* sdf)
+{
+	std::ifstream source(path, std::ios::in | std::ios::binary);
+	if (!source.is_open())
+		ThrowGGiException(L"Can't open \"" + path + L"\".");
+
+	GRiCookedMeshHeader header;
+	source.read((char*)&header, sizeof(header));
+	if (!source.good() || header.Magic != COOKED_MESH_MAGIC || header.Version != COOKED_MESH_VERSION || header.SdfOffset < sizeof(header))
+		ThrowGGiException(L"\"" + path + L"\" isn't a cooked mesh of this version.");
+
+	// The sdf is the last section, everything before it is copied and the old one is dropped.
+	std::vector<char> sections((size_t)(header.SdfOffset - sizeof(header)));
+	source.read(sections.data(), (std::streamsize)sections.size());
+	if (!source.good())
+		ThrowGGiException(L"\"" + path + L"\" is truncated.");
+	source.close();
+
+	UINT64 byteSize = (UINT64)resolution * resolution * resolution * sizeof(float);
+	header.SdfResolution = resolution;
+	header.SdfExtent = extent;
+	header.FileSize = header.SdfOffset + byteSize;
+
+	std::wstring tempPath = path + L".tmp";
+	std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		ThrowGGiException(L"Can't write \"" + tempPath + L"\".");
+
+	file.write((const char*)&header, sizeof(header));
+	file.write(sections.data(), (std::streamsize)sections.size());
+	file.write((const char*)sdf, (std::streamsize)byteSize);
+
+	ReplaceCookedFile(file, tempPath, path);
+}
+
+void GRiMeshCooker::GetTriangles(const GRiVertex* vertices, UINT vertexNum, const UINT32* indices, const GRiCookedSubmesh* submeshes, UINT submeshNum, std::vector<float>& positions, std::vector<UINT>& triangleIndices)
+{
+	positions.resize(vertexNum * 3);
+	for (auto i = 0u; i < vertexNum; i++)
+	{
+		positions[i * 3 + 0] = vertices[i].Position[0];
+		positions[i * 3 + 1] = vertices[i].Position[1];
+		positions[i * 3 + 2] = vertices[i].Position[2];
+	}
+
+	triangleIndices.clear();
+	for (auto s = 0u; s < submeshNum; s++)
+	{
+		auto& submesh = submeshes[s];
+		for (auto i = 0u; i < submesh.IndexCount; i++)
+			triangleIndices.push_back(indices[submesh.StartIndexLocation + i] + submesh.BaseVertexLocation);
+	}
+}
+
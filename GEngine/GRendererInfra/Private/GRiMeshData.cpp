@@ -10,3 +10,155 @@ GRiMeshData::GRiMeshData()
 GRiMeshData::~GRiMeshData()
 {
 }
+
+UINT GRiMeshData::WeldVertices(float epsilon)
+{
+	// The attributes and the tangent sign.
+	static const int attributeNum = sizeof(GRiVertex) / sizeof(float);
+	static const int keySize = attributeNum + 1;
+
+	UINT vertexNum = (UINT)Vertices.size();
+
+	// Nothing is touched if the indices are broken.
+	for (auto index : Indices)
+	{
+		if (index >= vertexNum)
+			ThrowGGiException("Mesh index out of range when welding vertices.");
+	}
+
+	if (vertexNum == 0)
+		return 0;
+
+	std::vector<float> tangentSigns(vertexNum);
+	ComputeTangentSigns(Vertices.data(), vertexNum, Indices.data(), (UINT)Indices.size(), tangentSigns.data());
+
+	// Every vertex is reduced to one integer per float, the bit pattern for exact welding or the grid cell.
+	std::vector<INT32> keys((size_t)vertexNum * keySize);
+	for (UINT i = 0; i < vertexNum; i++)
+	{
+		auto attributes = (const float*)&Vertices[i];
+		auto key = &keys[(size_t)i * keySize];
+		for (int k = 0; k < attributeNum; k++)
+		{
+			// -0 and 0 are the same vertex.
+			float value = attributes[k] + 0.0f;
+			if (epsilon > 0.0f)
+			{
+				double cell = floor((double)value / epsilon + 0.5);
+				cell = max(min(cell, 2147483647.0), -2147483648.0);
+				key[k] = (INT32)cell;
+			}
+			else
+			{
+				memcpy(&key[k], &value, sizeof(float));
+			}
+		}
+		key[attributeNum] = (INT32)tangentSigns[i];
+	}
+
+	// Open addressing table of welded vertex indices, at most half full.
+	UINT tableSize = 1;
+	while (tableSize < vertexNum * 2)
+		tableSize <<= 1;
+	std::vector<UINT> table(tableSize, UINT_MAX);
+
+	std::vector<UINT> remap(vertexNum);
+	UINT weldedNum = 0;
+	for (UINT i = 0; i < vertexNum; i++)
+	{
+		auto key = &keys[(size_t)i * keySize];
+
+		// FNV-1a over the key.
+		UINT64 hash = 14695981039346656037ull;
+		for (int k = 0; k < keySize; k++)
+		{
+			hash ^= (UINT32)key[k];
+			hash *= 1099511628211ull;
+		}
+
+		UINT slot = (UINT)(hash ^ (hash >> 32)) & (tableSize - 1);
+		while (true)
+		{
+			UINT welded = table[slot];
+			if (welded == UINT_MAX)
+			{
+				// Welded vertices are compacted in place, so the key of welded vertex j is still at j.
+				table[slot] = weldedNum;
+				if (weldedNum != i)
+				{
+					Vertices[weldedNum] = Vertices[i];
+					memcpy(&keys[(size_t)weldedNum * keySize], key, keySize * sizeof(INT32));
+				}
+				remap[i] = weldedNum++;
+				break;
+			}
+			if (memcmp(&keys[(size_t)welded * keySize], key, keySize * sizeof(INT32)) == 0)
+			{
+				remap[i] = welded;
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+
+	for (auto& index : Indices)
+		index = remap[index];
+
+	Vertices.resize(weldedNum);
+	Vertices.shrink_to_fit();
+
+	return vertexNum - weldedNum;
+}
+
+void GRiMeshData::ComputeTangentSigns(const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum, float* outSigns)
+{
+	for (UINT i = 0; i < indexNum; i++)
+	{
+		if (indices[i] >= vertexNum)
+			ThrowGGiException("Mesh index out of range when computing tangent signs.");
+	}
+
+	// Triangles voting for +1 minus the ones voting for -1.
+	std::vector<int> votes(vertexNum, 0);
+	for (UINT t = 0; t + 2 < indexNum; t += 3)
+	{
+		auto& v0 = vertices[indices[t]];
+		auto& v1 = vertices[indices[t + 1]];
+		auto& v2 = vertices[indices[t + 2]];
+
+		float du1 = v1.UV[0] - v0.UV[0];
+		float dv1 = v1.UV[1] - v0.UV[1];
+		float du2 = v2.UV[0] - v0.UV[0];
+		float dv2 = v2.UV[1] - v0.UV[1];
+		float det = du1 * dv2 - du2 * dv1;
+		if (det == 0.0f)
+			continue;
+
+		// Direction of increasing v on the triangle, the 1 / det of the usual bitangent only matters for its sign.
+		float bitangent[3];
+		for (auto k = 0; k < 3; k++)
+		{
+			float dp1 = v1.Position[k] - v0.Position[k];
+			float dp2 = v2.Position[k] - v0.Position[k];
+			bitangent[k] = (dp2 * du1 - dp1 * du2) * (det > 0.0f ? 1.0f : -1.0f);
+		}
+
+		for (auto c = 0; c < 3; c++)
+		{
+			auto& v = vertices[indices[t + c]];
+			float frameBitangent[3] = {
+				v.Normal[1] * v.TangentU[2] - v.Normal[2] * v.TangentU[1],
+				v.Normal[2] * v.TangentU[0] - v.Normal[0] * v.TangentU[2],
+				v.Normal[0] * v.TangentU[1] - v.Normal[1] * v.TangentU[0]
+			};
+			float dot = frameBitangent[0] * bitangent[0] + frameBitangent[1] * bitangent[1] + frameBitangent[2] * bitangent[2];
+			if (dot > 0.0f)
+				votes[indices[t + c]]++;
+			else if (dot < 0.0f)
+				votes[indices[t + c]]--;
+		}
+	}
+
+	for (UINT i = 0; i < vertexNum; i++)
+		outSigns[i] = votes[i] < 0 ? -1.0f : 1.0f;
+}
@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include "GRiMeshOptimizer.h"
+
+
+GRiMeshOptimizationStats GRiMeshOptimizer::Optimize(GRiMeshData& meshData, float overdrawThreshold)
+{
+	GRiMeshOptimizationStats stats;
+	stats.TriangleNum = (UINT)(meshData.Indices.size() / 3);
+
+	UINT vertexNum = (UINT)meshData.Vertices.size();
+	stats.ACMRBefore = ComputeACMR(meshData.Indices, vertexNum);
+	stats.ATVRBefore = ComputeATVR(meshData.Indices, vertexNum);
+
+	std::vector<UINT> clusterStarts;
+	OptimizeVertexCache(meshData.Indices, vertexNum, &clusterStarts);
+	stats.ClusterNum = OptimizeOverdraw(meshData.Indices, meshData.Vertices, clusterStarts, overdrawThreshold);
+	OptimizeVertexFetch(meshData);
+
+	vertexNum = (UINT)meshData.Vertices.size();
+	stats.VertexNum = vertexNum;
+	stats.ACMRAfter = ComputeACMR(meshData.Indices, vertexNum);
+	stats.ATVRAfter = ComputeATVR(meshData.Indices, vertexNum);
+
+	return stats;
+}
+
+void GRiMeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, UINT vertexNum, std::vector<UINT>* clusterStarts)
+{
+	static const UINT cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+
+	UINT triNum = (UINT)(indices.size() / 3);
+	if (clusterStarts != nullptr)
+		clusterStarts->clear();
+	if (triNum == 0)
+		return;
+
+	// Triangles around every vertex, and the number of them not emitted yet.
+	std::vector<UINT> liveCount(vertexNum, 0);
+	for (UINT i = 0; i < triNum * 3; i++)
+	{
+		if (indices[i] >= vertexNum)
+			ThrowGGiException("Mesh index out of range when optimizing.");
+		liveCount[indices[i]]++;
+	}
+	std::vector<UINT> adjacencyOffsets(vertexNum + 1, 0);
+	for (UINT v = 0; v < vertexNum; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveCount[v];
+	std::vector<UINT> adjacency(triNum * 3);
+	std::vector<UINT> adjacencyCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (UINT i = 0; i < triNum * 3; i++)
+		adjacency[adjacencyCursor[indices[i]]++] = i / 3;
+
+	std::vector<UINT> cacheTime(vertexNum, 0);
+	std::vector<bool> emitted(triNum, false);
+	std::vector<UINT> deadEnd;
+	deadEnd.reserve(triNum * 3);
+	std::vector<UINT> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triNum * 3);
+
+	UINT time = cacheSize + 1;
+	UINT cursor = 0;
+	while (liveCount[cursor] == 0)
+		cursor++;
+	int fanning = (int)cursor;
+
+	if (clusterStarts != nullptr)
+		clusterStarts->push_back(0);
+
+	while (fanning >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex.
+		candidates.clear();
+		for (UINT a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+		{
+			UINT tri = adjacency[a];
+			if (emitted[tri])
+				continue;
+			emitted[tri] = true;
+
+			for (UINT k = 0; k < 3; k++)
+			{
+				UINT v = indices[tri * 3 + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveCount[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+		}
+
+		// Next fanning vertex: the oldest candidate that stays in the cache while its triangles are emitted.
+		int next = -1;
+		int bestPriority = -1;
+		for (auto v : candidates)
+		{
+			if (liveCount[v] == 0)
+				continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize)
+				priority = (int)(time - cacheTime[v]);
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = (int)v;
+			}
+		}
+
+		if (next < 0)
+		{
+			// Dead end, go back to a recently used vertex or scan for one with triangles left.
+			while (!deadEnd.empty())
+			{
+				UINT v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveCount[v] > 0)
+				{
+					next = (int)v;
+					break;
+				}
+			}
+			while (next < 0 && cursor < vertexNum)
+			{
+				if (liveCount[cursor] > 0)
+					next = (int)cursor;
+				else
+					cursor++;
+			}
+
+			if (next >= 0 && clusterStarts != nullptr && time - cacheTime[next] > cacheSize)
+				clusterStarts->push_back((UINT)(output.size() / 3));
+		}
+
+		fanning = next;
+	}
+
+	indices.swap(output);
+}
+
+UINT GRiMeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<GRiVertex>& vertices, const std::vector<UINT>& clusterStarts, float threshold)
+{
+	static const UINT cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+
+	UINT triNum = (UINT)(indices.size() / 3);
+	if (triNum == 0)
+		return 0;
+
+	// Soft boundaries: split every hard cluster where the ACMR of the part so far, starting with an empty cache,
+	// gets within the threshold of the ACMR of the whole hard cluster. Restarting the cache there costs little.
+	std::vector<UINT> cacheTime(vertices.size(), 0);
+	UINT time = 0;
+	std::vector<UINT> starts;
+	for (size_t c = 0; c < clusterStarts.size(); c++)
+	{
+		UINT start = clusterStarts[c];
+		UINT end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triNum;
+
+		UINT clusterMisses = SimulateCache(indices.data(), start, end, cacheTime, time);
+		float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+		starts.push_back(start);
+		UINT runningMisses = 0;
+		UINT runningTriangles = 0;
+		time += cacheSize + 1;
+		for (UINT t = start; t < end; t++)
+		{
+			for (UINT k = 0; k < 3; k++)
+			{
+				UINT v = indices[t * 3 + k];
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+					runningMisses++;
+				}
+			}
+			runningTriangles++;
+
+			if (t + 1 < end && (float)runningMisses <= clusterThreshold * (float)runningTriangles)
+			{
+				starts.push_back(t + 1);
+				runningMisses = 0;
+				runningTriangles = 0;
+				time += cacheSize + 1;
+			}
+		}
+	}
+
+	// Area weighted centroid and normal of every cluster.
+	UINT clusterNum = (UINT)starts.size();
+	std::vector<float> centroids(clusterNum * 3, 0.0f);
+	std::vector<float> normals(clusterNum * 3, 0.0f);
+	std::vector<float> areas(clusterNum, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (UINT c = 0; c < clusterNum; c++)
+	{
+		UINT end = c + 1 < clusterNum ? starts[c + 1] : triNum;
+		for (UINT t = starts[c]; t < end; t++)
+		{
+			auto p0 = vertices[indices[t * 3 + 0]].Position;
+			auto p1 = vertices[indices[t * 3 + 1]].Position;
+			auto p2 = vertices[indices[t * 3 + 2]].Position;
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0]
+			};
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (UINT k = 0; k < 3; k++)
+			{
+				centroids[c * 3 + k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+				normals[c * 3 + k] += n[k];
+			}
+			areas[c] += area;
+		}
+
+		for (UINT k = 0; k < 3; k++)
+			meshCentroid[k] += centroids[c * 3 + k];
+		meshArea += areas[c];
+	}
+	for (UINT k = 0; k < 3; k++)
+		meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+
+	// Clusters facing away from the center are the likely occluders of the rest from any direction.
+	std::vector<float> sortKeys(clusterNum);
+	for (UINT c = 0; c < clusterNum; c++)
+	{
+		float* n = &normals[c * 3];
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float key = 0.0f;
+		if (areas[c] > 0.0f && length > 0.0f)
+		{
+			for (UINT k = 0; k < 3; k++)
+				key += (centroids[c * 3 + k] / areas[c] - meshCentroid[k]) * n[k] / length;
+		}
+		sortKeys[c] = key;
+	}
+
+	std::vector<UINT> order(clusterNum);
+	for (UINT c = 0; c < clusterNum; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (auto c : order)
+	{
+		UINT end = c + 1 < clusterNum ? starts[c + 1] : triNum;
+		output.insert(output.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+	}
+	indices.swap(output);
+
+	return clusterNum;
+}
+
+void GRiMeshOptimizer::OptimizeVertexFetch(GRiMeshData& meshData)
+{
+	std::vector<UINT> remap(meshData.Vertices.size(), UINT_MAX);
+	std::vector<GRiVertex> vertices;
+	vertices.reserve(meshData.Vertices.size());
+
+	for (auto& index : meshData.Indices)
+	{
+		if (index >= meshData.Vertices.size())
+			ThrowGGiException("Mesh index out of range when optimizing.");
+		if (remap[index] == UINT_MAX)
+		{
+			remap[index] = (UINT)vertices.size();
+			vertices.push_back(meshData.Vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	meshData.Vertices.swap(vertices);
+}
+
+float GRiMeshOptimizer::ComputeACMR(const std::vector<uint32_t>& indices, UINT vertexNum)
+{
+	UINT triNum = (UINT)(indices.size() / 3);
+	if (triNum == 0)
+		return 0.0f;
+
+	std::vector<UINT> cacheTime(vertexNum, 0);
+	UINT time = 0;
+	return (float)SimulateCache(indices.data(), 0, triNum, cacheTime, time) / (float)triNum;
+}
+
+float GRiMeshOptimizer::ComputeATVR(const std::vector<uint32_t>& indices, UINT vertexNum)
+{
+	UINT triNum = (UINT)(indices.size() / 3);
+
+	std::vector<bool> referenced(vertexNum, false);
+	UINT referencedNum = 0;
+	for (UINT i = 0; i < triNum * 3; i++)
+	{
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			referencedNum++;
+		}
+	}
+	if (referencedNum == 0)
+		return 0.0f;
+
+	std::vector<UINT> cacheTime(vertexNum, 0);
+	UINT time = 0;
+	return (float)SimulateCache(indices.data(), 0, triNum, cacheTime, time) / (float)referencedNum;
+}
+
+UINT GRiMeshOptimizer::SimulateCache(const uint32_t* indices, UINT startTriangle, UINT endTriangle, std::vector<UINT>& cacheTime, UINT& time)
+{
+	static const UINT cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+
+	// A vertex is cached while fewer than cacheSize vertices were transformed after it.
+	time += cacheSize + 1;
+
+	UINT misses = 0;
+	for (UINT t = startTriangle; t < endTriangle; t++)
+	{
+		for (UINT k = 0; k < 3; k++)
+		{
+			UINT v = indices[t * 3 + k];
+			if (time - cacheTime[v] > cacheSize)
+			{
+				cacheTime[v] = time++;
+				misses++;
+			}
+		}
+	}
+
+	return misses;
+}
@@ -0,0 +1,50 @@
+#include "stdafx.h"
+#include "GRiMeshlet.h"
+
+
+void GRiMeshletSet::Init(const GRiMeshlet* meshlets, UINT meshletNum)
+{
+	mMeshlets.assign(meshlets, meshlets + meshletNum);
+
+	mTriangleNum = 0;
+	for (auto& meshlet : mMeshlets)
+		mTriangleNum += meshlet.IndexCount / 3;
+
+	UINT paddedNum = (meshletNum + 3) & ~3u;
+	mCenterX.assign(paddedNum, 0.0f);
+	mCenterY.assign(paddedNum, 0.0f);
+	mCenterZ.assign(paddedNum, 0.0f);
+	mRadius.assign(paddedNum, -GGiEngineUtil::Infinity);
+	mConeAxisX.assign(paddedNum, 0.0f);
+	mConeAxisY.assign(paddedNum, 0.0f);
+	mConeAxisZ.assign(paddedNum, 1.0f);
+	mConeCutoff.assign(paddedNum, 1.0f);
+	for (auto i = 0u; i < meshletNum; i++)
+	{
+		auto& meshlet = mMeshlets[i];
+		mCenterX[i] = meshlet.Center[0];
+		mCenterY[i] = meshlet.Center[1];
+		mCenterZ[i] = meshlet.Center[2];
+		mRadius[i] = meshlet.Radius;
+		mConeAxisX[i] = meshlet.ConeAxis[0];
+		mConeAxisY[i] = meshlet.ConeAxis[1];
+		mConeAxisZ[i] = meshlet.ConeAxis[2];
+		mConeCutoff[i] = meshlet.ConeCutoff;
+	}
+}
+
+UINT GRiMeshletSet::GetMeshletNum()
+{
+	return (UINT)mMeshlets.size();
+}
+
+const GRiMeshlet* GRiMeshletSet::GetMeshlets()
+{
+	return mMeshlets.data();
+}
+
+UINT GRiMeshletSet::GetTriangleNum()
+{
+	return mTriangleNum;
+}
+
@@ -0,0 +1,399 @@
+#include "stdafx.h"
+#include "GRiMeshletBuilder.h"
+#include "GRiMeshOptimizer.h"
+
+// Normal cones wider than about 84 degrees hardly ever cull, they are stored as never culling.
+#define MESHLET_MIN_CONE_DOT 0.1f
+
+// Taken off the smallest normal dot product, so that rounding can't make a cone too narrow.
+#define MESHLET_CONE_EPSILON 1e-3f
+
+
+static inline float Dot3(const float* a, const float* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Unit normal of the triangle, zero if it is degenerate.
+static inline void TriangleNormal(const float* p0, const float* p1, const float* p2, float* normal)
+{
+	float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+	float length = sqrtf(Dot3(normal, normal));
+	if (length > 0.0f)
+	{
+		for (auto k = 0; k < 3; k++)
+			normal[k] /= length;
+	}
+	else
+	{
+		normal[0] = normal[1] = normal[2] = 0.0f;
+	}
+}
+
+GRiMeshletBuildStats GRiMeshletBuilder::Build(GRiMeshData& meshData, std::vector<GRiMeshlet>& meshlets, UINT maxVertexNum, UINT maxTriangleNum, float coneWeight)
+{
+	GRiMeshletBuildStats stats;
+	meshlets.clear();
+
+	auto& vertices = meshData.Vertices;
+	auto& indices = meshData.Indices;
+	UINT vertexNum = (UINT)vertices.size();
+	UINT triangleNum = (UINT)indices.size() / 3;
+	if (triangleNum == 0)
+		return stats;
+
+	// Triangles around every vertex.
+	std::vector<UINT> adjacencyOffsets(vertexNum + 1, 0);
+	for (auto i = 0u; i < triangleNum * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (auto v = 0u; v < vertexNum; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	std::vector<UINT> adjacency(triangleNum * 3);
+	{
+		std::vector<UINT> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (auto i = 0u; i < triangleNum * 3; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<float> normals(triangleNum * 3);
+	std::vector<float> centroids(triangleNum * 3);
+	float edgeLengthSum = 0.0f;
+	for (auto t = 0u; t < triangleNum; t++)
+	{
+		const float* p0 = vertices[indices[t * 3 + 0]].Position;
+		const float* p1 = vertices[indices[t * 3 + 1]].Position;
+		const float* p2 = vertices[indices[t * 3 + 2]].Position;
+		TriangleNormal(p0, p1, p2, &normals[t * 3]);
+		for (auto k = 0; k < 3; k++)
+			centroids[t * 3 + k] = (p0[k] + p1[k] + p2[k]) / 3.0f;
+		float e[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		edgeLengthSum += sqrtf(Dot3(e, e));
+	}
+	float averageEdgeLength = edgeLengthSum / triangleNum;
+
+	// Triangles by the cell of a uniform grid their centroid is in, cells are at least two triangles wide.
+	float gridMin[3] = { GGiEngineUtil::Infinity, GGiEngineUtil::Infinity, GGiEngineUtil::Infinity };
+	float gridMax[3] = { -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity };
+	for (auto t = 0u; t < triangleNum; t++)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			gridMin[k] = min(gridMin[k], centroids[t * 3 + k]);
+			gridMax[k] = max(gridMax[k], centroids[t * 3 + k]);
+		}
+	}
+	float maxExtent = max(max(gridMax[0] - gridMin[0], gridMax[1] - gridMin[1]), gridMax[2] - gridMin[2]);
+	float cellSize = max(max(2.0f * averageEdgeLength, maxExtent / MESHLET_GRID_MAX_CELL_NUM), 1e-20f);
+	int gridDims[3];
+	for (auto k = 0; k < 3; k++)
+		gridDims[k] = min((int)((gridMax[k] - gridMin[k]) / cellSize), MESHLET_GRID_MAX_CELL_NUM) + 1;
+	auto cellOf = [&](UINT t)
+	{
+		int cell[3];
+		for (auto k = 0; k < 3; k++)
+			cell[k] = min((int)((centroids[t * 3 + k] - gridMin[k]) / cellSize), gridDims[k] - 1);
+		return (UINT)((cell[2] * gridDims[1] + cell[1]) * gridDims[0] + cell[0]);
+	};
+	std::vector<UINT> cellOffsets(gridDims[0] * gridDims[1] * gridDims[2] + 1, 0);
+	for (auto t = 0u; t < triangleNum; t++)
+		cellOffsets[cellOf(t) + 1]++;
+	for (size_t c = 1; c < cellOffsets.size(); c++)
+		cellOffsets[c] += cellOffsets[c - 1];
+	std::vector<UINT> cellTriangles(triangleNum);
+	{
+		std::vector<UINT> fill(cellOffsets.begin(), cellOffsets.end() - 1);
+		for (auto t = 0u; t < triangleNum; t++)
+			cellTriangles[fill[cellOf(t)]++] = t;
+	}
+
+	std::vector<bool> bUsed(triangleNum, false);
+	// Meshlet a vertex was last added to and a triangle was last made a candidate of, plus one.
+	std::vector<UINT> vertexMeshlet(vertexNum, 0);
+	std::vector<UINT> candidateMeshlet(triangleNum, 0);
+	std::vector<UINT> candidates;
+
+	// Triangles in meshlet order and the first one of every meshlet.
+	std::vector<UINT> meshletTriangles;
+	std::vector<UINT> meshletStarts;
+	meshletTriangles.reserve(triangleNum);
+
+	UINT nextSeed = 0;
+	while (true)
+	{
+		while (nextSeed < triangleNum && bUsed[nextSeed])
+			nextSeed++;
+		if (nextSeed == triangleNum)
+			break;
+
+		UINT meshletId = (UINT)meshletStarts.size() + 1;
+		meshletStarts.push_back((UINT)meshletTriangles.size());
+		UINT meshletVertexNum = 0;
+		UINT meshletTriangleNum = 0;
+		float centroidSum[3] = { 0.0f, 0.0f, 0.0f };
+		float normalSum[3] = { 0.0f, 0.0f, 0.0f };
+		float vMin[3] = { GGiEngineUtil::Infinity, GGiEngineUtil::Infinity, GGiEngineUtil::Infinity };
+		float vMax[3] = { -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity };
+		candidates.clear();
+
+		auto addTriangle = [&](UINT t)
+		{
+			bUsed[t] = true;
+			meshletTriangles.push_back(t);
+			meshletTriangleNum++;
+			for (auto k = 0; k < 3; k++)
+			{
+				centroidSum[k] += centroids[t * 3 + k];
+				normalSum[k] += normals[t * 3 + k];
+			}
+
+			for (auto c = 0; c < 3; c++)
+			{
+				UINT v = indices[t * 3 + c];
+				if (vertexMeshlet[v] == meshletId)
+					continue;
+
+				vertexMeshlet[v] = meshletId;
+				meshletVertexNum++;
+				for (auto k = 0; k < 3; k++)
+				{
+					vMin[k] = min(vMin[k], vertices[v].Position[k]);
+					vMax[k] = max(vMax[k], vertices[v].Position[k]);
+				}
+
+				for (auto a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+				{
+					UINT neighbour = adjacency[a];
+					if (!bUsed[neighbour] && candidateMeshlet[neighbour] != meshletId)
+					{
+						candidateMeshlet[neighbour] = meshletId;
+						candidates.push_back(neighbour);
+					}
+				}
+			}
+		};
+
+		auto newVertexNum = [&](UINT t)
+		{
+			UINT num = 0;
+			for (auto c = 0; c < 3; c++)
+			{
+				if (vertexMeshlet[indices[t * 3 + c]] != meshletId)
+					num++;
+			}
+			return num;
+		};
+
+		addTriangle(nextSeed);
+
+		while (meshletTriangleNum < maxTriangleNum)
+		{
+			float center[3];
+			for (auto k = 0; k < 3; k++)
+				center[k] = centroidSum[k] / meshletTriangleNum;
+			float axis[3] = { normalSum[0], normalSum[1], normalSum[2] };
+			float axisLength = sqrtf(Dot3(axis, axis));
+			for (auto k = 0; k < 3; k++)
+				axis[k] = axisLength > 0.0f ? axis[k] / axisLength : 0.0f;
+
+			auto score = [&](UINT t)
+			{
+				float d[3] = { centroids[t * 3 + 0] - center[0], centroids[t * 3 + 1] - center[1], centroids[t * 3 + 2] - center[2] };
+				return Dot3(d, d) * (1.0f + coneWeight * (1.0f - Dot3(&normals[t * 3], axis)));
+			};
+
+			UINT best = (UINT)-1;
+			UINT bestNewNum = 4;
+			float bestScore = GGiEngineUtil::Infinity;
+			for (size_t c = 0; c < candidates.size();)
+			{
+				UINT t = candidates[c];
+				if (bUsed[t])
+				{
+					candidates[c] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				c++;
+
+				UINT newNum = newVertexNum(t);
+				if (meshletVertexNum + newNum > maxVertexNum || newNum > bestNewNum)
+					continue;
+
+				float s = score(t);
+				if (newNum < bestNewNum || s < bestScore)
+				{
+					best = t;
+					bestNewNum = newNum;
+					bestScore = s;
+				}
+			}
+
+			// Out of neighbours, take the closest unused triangle within a couple of triangles of the meshlet box.
+			// Meshes with hard edges or that weren't welded share few vertices.
+			if (best == (UINT)-1 && meshletVertexNum + 3 <= maxVertexNum)
+			{
+				int cellMin[3];
+				int cellMax[3];
+				for (auto k = 0; k < 3; k++)
+				{
+					cellMin[k] = max((int)((vMin[k] - 2.0f * averageEdgeLength - gridMin[k]) / cellSize), 0);
+					cellMax[k] = min((int)((vMax[k] + 2.0f * averageEdgeLength - gridMin[k]) / cellSize), gridDims[k] - 1);
+				}
+				for (auto z = cellMin[2]; z <= cellMax[2]; z++)
+				{
+					for (auto y = cellMin[1]; y <= cellMax[1]; y++)
+					{
+						for (auto x = cellMin[0]; x <= cellMax[0]; x++)
+						{
+							UINT cell = (z * gridDims[1] + y) * gridDims[0] + x;
+							for (auto c = cellOffsets[cell]; c < cellOffsets[cell + 1]; c++)
+							{
+								UINT t = cellTriangles[c];
+								if (bUsed[t])
+									continue;
+
+								float s = score(t);
+								if (s < bestScore)
+								{
+									best = t;
+									bestScore = s;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			if (best == (UINT)-1)
+				break;
+			addTriangle(best);
+		}
+	}
+	meshletStarts.push_back(triangleNum);
+
+	// Emit the meshlets, each one optimized for the vertex cache with vertex indices local to it.
+	std::vector<uint32_t> newIndices;
+	newIndices.reserve(indices.size());
+	std::vector<uint32_t> localIndices;
+	std::vector<UINT> localVertices;
+	std::vector<UINT> localIndexOfVertex(vertexNum, (UINT)-1);
+	UINT meshletNum = (UINT)meshletStarts.size() - 1;
+	meshlets.resize(meshletNum);
+	for (auto m = 0u; m < meshletNum; m++)
+	{
+		localIndices.clear();
+		localVertices.clear();
+		for (auto i = meshletStarts[m]; i < meshletStarts[m + 1]; i++)
+		{
+			UINT t = meshletTriangles[i];
+			for (auto c = 0; c < 3; c++)
+			{
+				UINT v = indices[t * 3 + c];
+				if (localIndexOfVertex[v] == (UINT)-1)
+				{
+					localIndexOfVertex[v] = (UINT)localVertices.size();
+					localVertices.push_back(v);
+				}
+				localIndices.push_back(localIndexOfVertex[v]);
+			}
+		}
+
+		GRiMeshOptimizer::OptimizeVertexCache(localIndices, (UINT)localVertices.size(), nullptr);
+
+		auto& meshlet = meshlets[m];
+		meshlet.StartIndexLocation = (UINT32)newIndices.size();
+		meshlet.IndexCount = (UINT32)localIndices.size();
+		for (auto i : localIndices)
+			newIndices.push_back(localVertices[i]);
+		for (auto v : localVertices)
+			localIndexOfVertex[v] = (UINT)-1;
+
+		ComputeBounds(vertices.data(), &newIndices[meshlet.StartIndexLocation], meshlet.IndexCount, meshlet);
+
+		stats.AverageVertexNum += (float)localVertices.size();
+		if (meshlet.ConeCutoff < 1.0f)
+			stats.ConeNum++;
+	}
+
+	indices.swap(newIndices);
+	GRiMeshOptimizer::OptimizeVertexFetch(meshData);
+
+	stats.MeshletNum = meshletNum;
+	stats.TriangleNum = triangleNum;
+	stats.AverageTriangleNum = (float)triangleNum / meshletNum;
+	stats.AverageVertexNum /= meshletNum;
+
+	return stats;
+}
+
+void GRiMeshletBuilder::ComputeBounds(const GRiVertex* vertices, const uint32_t* indices, UINT indexNum, GRiMeshlet& meshlet)
+{
+	float vMin[3] = { GGiEngineUtil::Infinity, GGiEngineUtil::Infinity, GGiEngineUtil::Infinity };
+	float vMax[3] = { -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity };
+	for (auto i = 0u; i < indexNum; i++)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			vMin[k] = min(vMin[k], vertices[indices[i]].Position[k]);
+			vMax[k] = max(vMax[k], vertices[indices[i]].Position[k]);
+		}
+	}
+	for (auto k = 0; k < 3; k++)
+	{
+		meshlet.BoundsCenter[k] = (vMax[k] + vMin[k]) / 2;
+		meshlet.BoundsExtents[k] = (vMax[k] - vMin[k]) / 2;
+		meshlet.Center[k] = meshlet.BoundsCenter[k];
+	}
+
+	// The sphere is centered on the box, its radius reaches the farthest vertex.
+	float radiusSq = 0.0f;
+	for (auto i = 0u; i < indexNum; i++)
+	{
+		float d[3];
+		for (auto k = 0; k < 3; k++)
+			d[k] = vertices[indices[i]].Position[k] - meshlet.Center[k];
+		radiusSq = max(radiusSq, Dot3(d, d));
+	}
+	meshlet.Radius = sqrtf(radiusSq);
+
+	// The cone axis is the average of the triangle normals, the cutoff is the sine of the widest angle to it.
+	std::vector<float> normals(indexNum);
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	for (auto i = 0u; i + 2 < indexNum; i += 3)
+	{
+		TriangleNormal(vertices[indices[i]].Position, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position, &normals[i]);
+		for (auto k = 0; k < 3; k++)
+			axis[k] += normals[i + k];
+	}
+
+	meshlet.ConeAxis[0] = 0.0f;
+	meshlet.ConeAxis[1] = 0.0f;
+	meshlet.ConeAxis[2] = 1.0f;
+	meshlet.ConeCutoff = 1.0f;
+
+	float axisLength = sqrtf(Dot3(axis, axis));
+	if (!(axisLength > 0.0f))
+		return;
+	for (auto k = 0; k < 3; k++)
+		axis[k] /= axisLength;
+
+	// Degenerate triangles are never drawn, they don't widen the cone.
+	float minDot = 1.0f;
+	for (auto i = 0u; i + 2 < indexNum; i += 3)
+	{
+		if (Dot3(&normals[i], &normals[i]) > 0.0f)
+			minDot = min(minDot, Dot3(&normals[i], axis));
+	}
+	minDot -= MESHLET_CONE_EPSILON;
+	if (minDot <= MESHLET_MIN_CONE_DOT)
+		return;
+
+	for (auto k = 0; k < 3; k++)
+		meshlet.ConeAxis[k] = axis[k];
+	meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
@@ -0,0 +1,292 @@
+#include "stdafx.h"
+#include "GRiMeshletCuller.h"
+#include "GRiOcclusionCullingRasterizer.h"
+
+// Fewer draws per task aren't worth a task of their own.
+#define MESHLET_CULLING_MIN_TASK_DRAW_NUM 16
+
+
+void GRiMeshletCuller::Reset()
+{
+	mDraws.clear();
+}
+
+UINT GRiMeshletCuller::AddDraw(GRiMeshletSet* meshlets, UINT firstMeshlet, UINT meshletNum, const float* world, UINT indexOffset)
+{
+	GRiMeshletDraw draw;
+	draw.Meshlets = meshlets;
+	draw.FirstMeshlet = firstMeshlet;
+	draw.MeshletNum = meshletNum;
+	memcpy(draw.World, world, sizeof(draw.World));
+	draw.IndexOffset = indexOffset;
+	draw.TriangleNum = 0;
+	for (auto i = firstMeshlet; i < firstMeshlet + meshletNum; i++)
+		draw.TriangleNum += meshlets->mMeshlets[i].IndexCount / 3;
+
+	mDraws.push_back(draw);
+	return (UINT)mDraws.size() - 1;
+}
+
+UINT GRiMeshletCuller::GetDrawNum()
+{
+	return (UINT)mDraws.size();
+}
+
+void GRiMeshletCuller::Cull(GGiThreadPool* tp, const float planes[6][4], const float* cameraPosition, __m128* occlusionViewProj)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	memcpy(mPlanes, planes, sizeof(mPlanes));
+	memcpy(mCameraPosition, cameraPosition, sizeof(mCameraPosition));
+
+	UINT drawNum = (UINT)mDraws.size();
+	if (mDrawMeshlets.size() < drawNum)
+	{
+		mDrawMeshlets.resize(drawNum);
+		mDrawRanges.resize(drawNum);
+	}
+	mFrustumCulledTriangleNums.resize(drawNum);
+	mBackfaceCulledTriangleNums.resize(drawNum);
+
+	UINT32 step;
+	if (tp != nullptr && drawNum > MESHLET_CULLING_MIN_TASK_DRAW_NUM)
+		step = max((UINT32)(drawNum / tp->GetThreadNum()) + 1, (UINT32)MESHLET_CULLING_MIN_TASK_DRAW_NUM);
+	else
+		step = max(drawNum, 1u);
+	if (tp == nullptr || step >= drawNum)
+	{
+		for (auto d = 0u; d < drawNum; d++)
+			CullDraw(d);
+	}
+	else
+	{
+		for (auto i = 0u; i < drawNum; i += step)
+		{
+			tp->Enqueue([&, i]
+			{
+				for (auto d = i; d < i + step && d < drawNum; d++)
+					CullDraw(d);
+			}
+			);
+		}
+		tp->Flush();
+	}
+
+	// Test the boxes of every meshlet left at once, they are spread over the screen as much as objects are.
+	UINT occlusionNum = 0;
+	mOcclusionBounds.clear();
+	if (occlusionViewProj != nullptr)
+	{
+		for (auto d = 0u; d < drawNum; d++)
+		{
+			auto& draw = mDraws[d];
+			auto meshlets = draw.Meshlets->GetMeshlets();
+			for (auto m : mDrawMeshlets[d])
+			{
+				auto& meshlet = meshlets[m];
+				GRiBoundingBox box;
+				for (auto k = 0; k < 3; k++)
+				{
+					box.Center[k] = draw.World[3][k];
+					box.Extents[k] = 0.0f;
+					for (auto j = 0; j < 3; j++)
+					{
+						box.Center[k] += meshlet.BoundsCenter[j] * draw.World[j][k];
+						box.Extents[k] += meshlet.BoundsExtents[j] * fabsf(draw.World[j][k]);
+					}
+				}
+				mOcclusionBounds.push_back(box);
+			}
+		}
+		occlusionNum = (UINT)mOcclusionBounds.size();
+
+		if (mOcclusionVisibleCapacity < occlusionNum)
+		{
+			mOcclusionVisibleCapacity = occlusionNum * 2;
+			mOcclusionVisible.reset(new bool[mOcclusionVisibleCapacity]);
+		}
+
+		GRiOcclusionCullingRasterizer::GetInstance().RectTestBoundsMaskedMT(tp, mOcclusionBounds.data(), (int)occlusionNum, occlusionViewProj, mOcclusionVisible.get());
+	}
+
+	// Merge the meshlets left into ranges, meshlets of a submesh are contiguous in the index buffer.
+	mStats = GRiMeshletCullingStats();
+	mStats.DrawNum = drawNum;
+	UINT occlusionIndex = 0;
+	for (auto d = 0u; d < drawNum; d++)
+	{
+		auto& draw = mDraws[d];
+		auto meshlets = draw.Meshlets->GetMeshlets();
+		auto& ranges = mDrawRanges[d];
+		ranges.clear();
+		for (auto m : mDrawMeshlets[d])
+		{
+			auto& meshlet = meshlets[m];
+			if (occlusionNum > 0 && !mOcclusionVisible[occlusionIndex++])
+			{
+				mStats.OccludedTriangleNum += meshlet.IndexCount / 3;
+				continue;
+			}
+
+			UINT start = meshlet.StartIndexLocation + draw.IndexOffset;
+			if (ranges.size() > 0 && ranges[ranges.size() - 2] + ranges.back() == start)
+			{
+				ranges.back() += meshlet.IndexCount;
+			}
+			else
+			{
+				ranges.push_back(start);
+				ranges.push_back(meshlet.IndexCount);
+			}
+			mStats.VisibleMeshletNum++;
+			mStats.VisibleTriangleNum += meshlet.IndexCount / 3;
+		}
+
+		mStats.MeshletNum += draw.MeshletNum;
+		mStats.TriangleNum += draw.TriangleNum;
+		mStats.FrustumCulledTriangleNum += mFrustumCulledTriangleNums[d];
+		mStats.BackfaceCulledTriangleNum += mBackfaceCulledTriangleNums[d];
+		mStats.RangeNum += (UINT)ranges.size() / 2;
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	mStats.CullTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+UINT GRiMeshletCuller::GetRangeNum(UINT draw)
+{
+	return (UINT)mDrawRanges[draw].size() / 2;
+}
+
+const UINT* GRiMeshletCuller::GetRanges(UINT draw)
+{
+	return mDrawRanges[draw].data();
+}
+
+GRiMeshletCullingStats GRiMeshletCuller::GetStats()
+{
+	return mStats;
+}
+
+void GRiMeshletCuller::CullDraw(UINT d)
+{
+	auto& draw = mDraws[d];
+	auto set = draw.Meshlets;
+	auto& visible = mDrawMeshlets[d];
+	visible.clear();
+
+	float localPlanes[6][4];
+	float localCamera[3];
+	bool bCone = TransformView(draw, localPlanes, localCamera);
+
+	__m128 planes[6][4];
+	for (auto p = 0; p < 6; p++)
+	{
+		for (auto k = 0; k < 4; k++)
+			planes[p][k] = _mm_set1_ps(localPlanes[p][k]);
+	}
+	__m128 cameraX = _mm_set1_ps(localCamera[0]);
+	__m128 cameraY = _mm_set1_ps(localCamera[1]);
+	__m128 cameraZ = _mm_set1_ps(localCamera[2]);
+
+	UINT frustumCulledTriangleNum = 0;
+	UINT backfaceCulledTriangleNum = 0;
+	UINT begin = draw.FirstMeshlet;
+	UINT end = draw.FirstMeshlet + draw.MeshletNum;
+
+	// Groups of 4 from the aligned one containing the first meshlet, lanes outside of the draw are skipped.
+	for (auto g = begin & ~3u; g < end; g += 4)
+	{
+		__m128 x = _mm_loadu_ps(&set->mCenterX[g]);
+		__m128 y = _mm_loadu_ps(&set->mCenterY[g]);
+		__m128 z = _mm_loadu_ps(&set->mCenterZ[g]);
+		__m128 radius = _mm_loadu_ps(&set->mRadius[g]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+		// Inside unless entirely behind one of the planes.
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (auto p = 0; p < 6; p++)
+		{
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+		}
+		int insideMask = _mm_movemask_ps(inside);
+
+		// Every triangle faces away if dot(center - camera, axis) >= cutoff * |center - camera| + radius.
+		int backfaceMask = 0;
+		if (bCone)
+		{
+			__m128 dx = _mm_sub_ps(x, cameraX);
+			__m128 dy = _mm_sub_ps(y, cameraY);
+			__m128 dz = _mm_sub_ps(z, cameraZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 axisDot = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&set->mConeAxisX[g])), _mm_mul_ps(dy, _mm_loadu_ps(&set->mConeAxisY[g]))),
+				_mm_mul_ps(dz, _mm_loadu_ps(&set->mConeAxisZ[g])));
+			__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&set->mConeCutoff[g]), length), radius);
+			backfaceMask = _mm_movemask_ps(_mm_cmpge_ps(axisDot, limit));
+		}
+
+		for (auto lane = 0u; lane < 4; lane++)
+		{
+			UINT i = g + lane;
+			if (i < begin || i >= end)
+				continue;
+
+			UINT triangleNum = set->mMeshlets[i].IndexCount / 3;
+			if ((insideMask & (1 << lane)) == 0)
+				frustumCulledTriangleNum += triangleNum;
+			else if ((backfaceMask & (1 << lane)) != 0)
+				backfaceCulledTriangleNum += triangleNum;
+			else
+				visible.push_back(i);
+		}
+	}
+
+	mFrustumCulledTriangleNums[d] = frustumCulledTriangleNum;
+	mBackfaceCulledTriangleNums[d] = backfaceCulledTriangleNum;
+}
+
+bool GRiMeshletCuller::TransformView(const GRiMeshletDraw& draw, float localPlanes[6][4], float* localCamera)
+{
+	auto& w = draw.World;
+
+	// With row vectors a world plane P becomes W * P in mesh space.
+	for (auto p = 0; p < 6; p++)
+	{
+		for (auto i = 0; i < 4; i++)
+			localPlanes[p][i] = w[i][0] * mPlanes[p][0] + w[i][1] * mPlanes[p][1] + w[i][2] * mPlanes[p][2] + w[i][3] * mPlanes[p][3];
+
+		float length = sqrtf(localPlanes[p][0] * localPlanes[p][0] + localPlanes[p][1] * localPlanes[p][1] + localPlanes[p][2] * localPlanes[p][2]);
+		if (length > 0.0f)
+		{
+			for (auto k = 0; k < 4; k++)
+				localPlanes[p][k] /= length;
+		}
+	}
+
+	// Camera through the inverse of the upper 3x3, by its adjugate.
+	float det =
+		w[0][0] * (w[1][1] * w[2][2] - w[1][2] * w[2][1]) -
+		w[0][1] * (w[1][0] * w[2][2] - w[1][2] * w[2][0]) +
+		w[0][2] * (w[1][0] * w[2][1] - w[1][1] * w[2][0]);
+	if (!(det > 0.0f))
+	{
+		localCamera[0] = localCamera[1] = localCamera[2] = 0.0f;
+		return false;
+	}
+
+	float inv[3][3] = {
+		{ (w[1][1] * w[2][2] - w[1][2] * w[2][1]) / det, (w[0][2] * w[2][1] - w[0][1] * w[2][2]) / det, (w[0][1] * w[1][2] - w[0][2] * w[1][1]) / det },
+		{ (w[1][2] * w[2][0] - w[1][0] * w[2][2]) / det, (w[0][0] * w[2][2] - w[0][2] * w[2][0]) / det, (w[0][2] * w[1][0] - w[0][0] * w[1][2]) / det },
+		{ (w[1][0] * w[2][1] - w[1][1] * w[2][0]) / det, (w[0][1] * w[2][0] - w[0][0] * w[2][1]) / det, (w[0][0] * w[1][1] - w[0][1] * w[1][0]) / det }
+	};
+	float relative[3] = { mCameraPosition[0] - w[3][0], mCameraPosition[1] - w[3][1], mCameraPosition[2] - w[3][2] };
+	for (auto k = 0; k < 3; k++)
+		localCamera[k] = relative[0] * inv[0][k] + relative[1] * inv[1][k] + relative[2] * inv[2][k];
+
+	return true;
+}
+
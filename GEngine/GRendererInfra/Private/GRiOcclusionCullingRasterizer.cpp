@@ -955,6 +955,87 @@ bool GRiOcclusionCullingRasterizer::RectTestBBoxMasked(GRiBoundingBox& box, __m1
 		maxZ = max(maxZ, vertices[i][2]);
 	}
 
+	return RectTestMasked(minX, maxX, minY, maxY, maxZ);
+}
+
+void GRiOcclusionCullingRasterizer::RectTestBoundsMaskedMT(GGiThreadPool* tp, const GRiBoundingBox* boxes, int boxNum, __m128* viewProj, bool* visible)
+{
+	float viewProjF[4][4];
+	for (auto i = 0; i < 4; i++)
+		_mm_storeu_ps(viewProjF[i], viewProj[i]);
+
+	auto testBounds = [&](int begin, int end)
+	{
+		float rect[4], maxZ;
+		for (auto i = begin; i < end; i++)
+		{
+			if (!ProjectBounds(boxes[i], viewProjF, rect, maxZ))
+				visible[i] = true;
+			else
+				visible[i] = RectTestMasked(rect[0], rect[1], rect[2], rect[3], maxZ);
+		}
+	};
+
+	if (tp == nullptr)
+	{
+		testBounds(0, boxNum);
+		return;
+	}
+
+	int step;
+	if (boxNum > 100)
+		step = boxNum / (int)tp->GetThreadNum() + 1;
+	else
+		step = 100;
+	for (auto i = 0; i < boxNum; i += step)
+	{
+		tp->Enqueue([&, i]
+		{
+			testBounds(i, min(i + step, boxNum));
+		}
+		);
+	}
+	tp->Flush();
+}
+
+bool GRiOcclusionCullingRasterizer::ProjectBounds(const GRiBoundingBox& box, const float viewProj[4][4], float rect[4], float& maxZ)
+{
+	rect[0] = (float)mBufferWidth;
+	rect[1] = 0.0f;
+	rect[2] = (float)mBufferHeight;
+	rect[3] = 0.0f;
+	maxZ = 0.0f;
+
+	for (auto i = 0; i < 8; i++)
+	{
+		float corner[3] = {
+			box.Center[0] + ((i & 1) ? box.Extents[0] : -box.Extents[0]),
+			box.Center[1] + ((i & 2) ? box.Extents[1] : -box.Extents[1]),
+			box.Center[2] + ((i & 4) ? box.Extents[2] : -box.Extents[2])
+		};
+
+		float clip[4];
+		for (auto j = 0; j < 4; j++)
+			clip[j] = corner[0] * viewProj[0][j] + corner[1] * viewProj[1][j] + corner[2] * viewProj[2][j] + viewProj[3][j];
+
+		// The projected rectangle is meaningless for boxes reaching in front of the near plane.
+		if (clip[3] < mZLowerBound)
+			return false;
+
+		float x = (clip[0] / clip[3] + 1) * 0.5f * mBufferWidth;
+		float y = (-clip[1] / clip[3] + 1) * 0.5f * mBufferHeight;
+		rect[0] = min(rect[0], x);
+		rect[1] = max(rect[1], x);
+		rect[2] = min(rect[2], y);
+		rect[3] = max(rect[3], y);
+		maxZ = max(maxZ, clip[2] / clip[3]);
+	}
+
+	return true;
+}
+
+bool GRiOcclusionCullingRasterizer::RectTestMasked(float minX, float maxX, float minY, float maxY, float maxZ)
+{
 	static const __m128i SIMD_TILE_PAD = _mm_setr_epi32(0, 32, 0, 4);
 	static const __m128i SIMD_TILE_PAD_MASK = _mm_setr_epi32(~(32 - 1), ~(32 - 1), ~(4 - 1), ~(4 - 1));
 	static const __m128i SIMD_SUB_TILE_PAD = _mm_setr_epi32(0, 8, 0, 4);
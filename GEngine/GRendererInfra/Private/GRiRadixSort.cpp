@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "GRiRadixSort.h"
+
+
+void GRiRadixSort::Sort(GGiThreadPool* tp, std::vector<UINT64>& keys, std::vector<UINT>& values)
+{
+	if (keys.size() != values.size())
+		ThrowGGiException("Radix sort key and value counts don't match.");
+
+	mLastPassNum = 0;
+
+	UINT num = (UINT)keys.size();
+	if (num < 2)
+		return;
+
+	UINT chunkNum = 1;
+	if (tp != nullptr && num >= ParallelThreshold)
+		chunkNum = (UINT)tp->GetThreadNum();
+	UINT32 step = num / chunkNum + 1;
+
+	mTempKeys.resize(num);
+	mTempValues.resize(num);
+	mHistograms.resize(chunkNum * RadixSize);
+
+	UINT64* srcKeys = keys.data();
+	UINT* srcValues = values.data();
+	UINT64* dstKeys = mTempKeys.data();
+	UINT* dstValues = mTempValues.data();
+
+	for (UINT pass = 0; pass < PassNum; pass++)
+	{
+		UINT shift = pass * RadixBits;
+
+		std::fill(mHistograms.begin(), mHistograms.end(), 0);
+
+		auto countChunk = [&](UINT chunk)
+		{
+			UINT* histogram = mHistograms.data() + chunk * RadixSize;
+			for (auto j = chunk * step; j < (chunk + 1) * step && j < num; j++)
+				histogram[(srcKeys[j] >> shift) & (RadixSize - 1)]++;
+		};
+
+		if (chunkNum == 1)
+		{
+			countChunk(0);
+		}
+		else
+		{
+			for (auto i = 0u; i < chunkNum; i++)
+			{
+				tp->Enqueue([&, i]
+				{
+					countChunk(i);
+				}
+				);
+			}
+			tp->Flush();
+		}
+
+		// Every key falls into the same bucket, the pass wouldn't move anything.
+		UINT firstDigit = (UINT)((srcKeys[0] >> shift) & (RadixSize - 1));
+		UINT firstDigitCount = 0;
+		for (auto i = 0u; i < chunkNum; i++)
+			firstDigitCount += mHistograms[i * RadixSize + firstDigit];
+		if (firstDigitCount == num)
+			continue;
+
+		// Turn the counters into scatter offsets, chunk by chunk within each digit to keep the sort stable.
+		UINT offset = 0;
+		for (auto digit = 0u; digit < RadixSize; digit++)
+		{
+			for (auto i = 0u; i < chunkNum; i++)
+			{
+				UINT count = mHistograms[i * RadixSize + digit];
+				mHistograms[i * RadixSize + digit] = offset;
+				offset += count;
+			}
+		}
+
+		auto scatterChunk = [&](UINT chunk)
+		{
+			UINT* offsets = mHistograms.data() + chunk * RadixSize;
+			for (auto j = chunk * step; j < (chunk + 1) * step && j < num; j++)
+			{
+				UINT dst = offsets[(srcKeys[j] >> shift) & (RadixSize - 1)]++;
+				dstKeys[dst] = srcKeys[j];
+				dstValues[dst] = srcValues[j];
+			}
+		};
+
+		if (chunkNum == 1)
+		{
+			scatterChunk(0);
+		}
+		else
+		{
+			for (auto i = 0u; i < chunkNum; i++)
+			{
+				tp->Enqueue([&, i]
+				{
+					scatterChunk(i);
+				}
+				);
+			}
+			tp->Flush();
+		}
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+		mLastPassNum++;
+	}
+
+	// The result ended up in the temporary arrays, hand them over instead of copying back.
+	if (srcKeys != keys.data())
+	{
+		keys.swap(mTempKeys);
+		values.swap(mTempValues);
+	}
+}
+
+UINT GRiRadixSort::GetLastPassNum()
+{
+	return mLastPassNum;
+}
@@ -4,6 +4,9 @@
 
 GRiRenderer::GRiRenderer()
 {
+	mSceneBvh = std::make_unique<GRiSceneBvh>();
+	mSpatialIndex = std::make_unique<GRiDynamicAabbTree>();
+	mLightManager = std::make_unique<GRiLightManager>();
 }
 
 
@@ -121,6 +124,17 @@ void GRiRenderer::SyncSceneObjects(std::unordered_map<std::wstring, std::unique_
 			pSceneObjectLayer[layer].push_back(pSObj);
 		}
 	}
+	mSceneObjectLayerVersion++;
+
+	// Only deferred objects are culled, keep them and nothing else in the spatial index.
+	std::unordered_set<GRiSceneObject*> deferred(pSceneObjectLayer[(int)RenderLayer::Deferred].begin(), pSceneObjectLayer[(int)RenderLayer::Deferred].end());
+	for (auto& so : pSceneObjects)
+	{
+		if (deferred.find(so.second) != deferred.end())
+			so.second->SetSpatialIndex(mSpatialIndex.get());
+		else
+			so.second->SetSpatialIndex(nullptr);
+	}
 }
 
 void GRiRenderer::SyncCameras(std::vector<GRiCamera*> mCameras)
@@ -160,5 +174,27 @@ int GRiRenderer::GetClientHeight()
 	return mClientHeight;
 }
 
+bool GRiRenderer::Raycast(const GRiRay& ray, GRiRayHit& hit)
+{
+	return mSceneBvh->Raycast(ray, hit);
+}
 
+std::vector<GRiRayHit> GRiRenderer::RaycastAll(const GRiRay& ray)
+{
+	return mSceneBvh->RaycastAll(ray);
+}
 
+std::vector<GRiSceneObject*> GRiRenderer::Overlap(const GRiBoundingBox& box)
+{
+	return mSceneBvh->Overlap(box);
+}
+
+GRiDynamicAabbTree* GRiRenderer::GetSpatialIndex()
+{
+	return mSpatialIndex.get();
+}
+
+GRiLightManager* GRiRenderer::GetLightManager()
+{
+	return mLightManager.get();
+}
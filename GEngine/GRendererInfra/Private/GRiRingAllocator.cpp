@@ -0,0 +1,104 @@
+#include "stdafx.h"
+#include "GRiRingAllocator.h"
+
+
+void GRiRingAllocator::Init(UINT64 capacity)
+{
+	mCapacity = capacity;
+	mHead = 0;
+	mTail = 0;
+	mUsedSize = 0;
+	mCurrentFrameSize = 0;
+	mFrames.clear();
+}
+
+UINT64 GRiRingAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+		ThrowGGiException("Ring allocation alignment is not a power of two.");
+
+	if (size == 0)
+		size = 1;
+	if (size > mCapacity)
+		return InvalidOffset;
+
+	// Nothing in flight, start over at the beginning to keep the whole ring contiguous.
+	if (mUsedSize == 0)
+	{
+		mHead = 0;
+		mTail = 0;
+	}
+
+	UINT64 offset = (mHead + alignment - 1) & ~(alignment - 1);
+	UINT64 padding;
+
+	if (mUsedSize == 0 || mHead > mTail)
+	{
+		// Free space is [head, capacity) and [0, tail).
+		if (offset + size <= mCapacity)
+		{
+			padding = offset - mHead;
+		}
+		else if (size <= mTail)
+		{
+			// Skip the tail of the ring, offset 0 is aligned to anything.
+			padding = mCapacity - mHead;
+			offset = 0;
+		}
+		else
+		{
+			return InvalidOffset;
+		}
+	}
+	else
+	{
+		// Free space is [head, tail), none if the ring is full.
+		if (mHead == mTail || offset + size > mTail)
+			return InvalidOffset;
+		padding = offset - mHead;
+	}
+
+	mUsedSize += padding + size;
+	mCurrentFrameSize += padding + size;
+	mHead = offset + size;
+	if (mHead == mCapacity)
+		mHead = 0;
+
+	return offset;
+}
+
+void GRiRingAllocator::FinishFrame(UINT64 fenceValue)
+{
+	GRiRingFrame frame;
+	frame.FenceValue = fenceValue;
+	frame.Size = mCurrentFrameSize;
+	mFrames.push_back(frame);
+
+	mCurrentFrameSize = 0;
+}
+
+void GRiRingAllocator::ReleaseCompletedFrames(UINT64 completedFenceValue)
+{
+	while (mFrames.size() > 0 && mFrames.front().FenceValue <= completedFenceValue)
+	{
+		// Frames were carved from the ring in order, so the oldest one starts at the tail.
+		mTail = (mTail + mFrames.front().Size) % mCapacity;
+		mUsedSize -= mFrames.front().Size;
+		mFrames.pop_front();
+	}
+}
+
+UINT64 GRiRingAllocator::GetCapacity()
+{
+	return mCapacity;
+}
+
+UINT64 GRiRingAllocator::GetUsedSize()
+{
+	return mUsedSize;
+}
+
+UINT GRiRingAllocator::GetFrameNum()
+{
+	return (UINT)mFrames.size();
+}
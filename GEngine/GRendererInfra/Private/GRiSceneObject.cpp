@@ -1,66 +1,91 @@
 #include "stdafx.h"
 #include "GRiSceneObject.h"
+#include "GRiDynamicAabbTree.h"
 
 
-/*
 GRiSceneObject::GRiSceneObject()
 {
+	mHandle = GRiSceneStore::GetInstance().Create(this);
+	MarkDirty();
 }
 
-
 GRiSceneObject::~GRiSceneObject()
 {
+	SetSpatialIndex(nullptr);
+	GetDirtyList().Remove(&mDirtyListSlot);
+	GRiSceneStore::GetInstance().Destroy(mHandle);
 }
-*/
 
 void GRiSceneObject::MarkDirty()
 {
 	NumFramesDirty = NUM_FRAME_RESOURCES;
+	GetDirtyList().Add(this, &mDirtyListSlot);
+}
+
+GRiDirtyList<GRiSceneObject>& GRiSceneObject::GetDirtyList()
+{
+	static GRiDirtyList<GRiSceneObject> *instance = new GRiDirtyList<GRiSceneObject>();
+	return *instance;
 }
 
 std::vector<float> GRiSceneObject::GetLocation()
 {
-	std::vector<float> ret = { Location[0], Location[1], Location[2] };
+	float* v = GRiSceneStore::GetInstance().GetLocations() + GetDenseIndex() * 3;
+	std::vector<float> ret = { v[0], v[1], v[2] };
 	return ret;
 }
 
 std::vector<float> GRiSceneObject::GetRotation()
 {
-	std::vector<float> ret = { Rotation[0], Rotation[1], Rotation[2] };
+	float* v = GRiSceneStore::GetInstance().GetRotations() + GetDenseIndex() * 3;
+	std::vector<float> ret = { v[0], v[1], v[2] };
 	return ret;
 }
 
 std::vector<float> GRiSceneObject::GetScale()
 {
-	std::vector<float> ret = { Scale[0], Scale[1], Scale[2] };
+	float* v = GRiSceneStore::GetInstance().GetScales() + GetDenseIndex() * 3;
+	std::vector<float> ret = { v[0], v[1], v[2] };
 	return ret;
 }
 
 void GRiSceneObject::SetLocation(float x, float y, float z)
 {
-	Location[0] = x;
-	Location[1] = y;
-	Location[2] = z;
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	float* v = store.GetLocations() + dense * 3;
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	store.GetFlags()[dense] |= SceneFlagTransformDirty;
+	store.MarkBoundsDirty(dense);
 	MarkDirty();
-	bTransformDirty = true;
 }
 
 void GRiSceneObject::SetRotation(float pitch, float yaw, float roll)
 {
-	Rotation[0] = pitch;
-	Rotation[1] = yaw;
-	Rotation[2] = roll;
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	float* v = store.GetRotations() + dense * 3;
+	v[0] = pitch;
+	v[1] = yaw;
+	v[2] = roll;
+	store.GetFlags()[dense] |= SceneFlagTransformDirty;
+	store.MarkBoundsDirty(dense);
 	MarkDirty();
-	bTransformDirty = true;
 }
 
 void GRiSceneObject::SetScale(float x, float y, float z)
 {
-	Scale[0] = x;
-	Scale[1] = y;
-	Scale[2] = z;
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	float* v = store.GetScales() + dense * 3;
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	store.GetFlags()[dense] |= SceneFlagTransformDirty;
+	store.MarkBoundsDirty(dense);
 	MarkDirty();
-	bTransformDirty = true;
 }
 
 void GRiSceneObject::SetTexTransform(GGiFloat4x4 texTrans)
@@ -79,7 +104,18 @@ GGiFloat4x4 GRiSceneObject::GetTexTransform()
 void GRiSceneObject::SetMesh(GRiMesh* mesh)
 {
 	Mesh = mesh;
+	mDrawStateVersion++;
 	MarkDirty();
+
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	float* localBounds = store.GetLocalBounds() + dense * 6;
+	for (auto k = 0; k < 3; k++)
+	{
+		localBounds[k] = mesh != nullptr ? mesh->bounds.Center[k] : 0.0f;
+		localBounds[k + 3] = mesh != nullptr ? mesh->bounds.Extents[k] : 0.0f;
+	}
+	store.MarkBoundsDirty(dense);
 }
 
 GRiMesh* GRiSceneObject::GetMesh()
@@ -95,6 +131,7 @@ void GRiSceneObject::SetOverrideMaterial(std::wstring submeshName, GRiMaterial*
 		pOverrideMaterial.erase(submeshName);
 	else
 		pOverrideMaterial[submeshName] = mat;
+	mDrawStateVersion++;
 	MarkDirty();
 	//}
 }
@@ -123,12 +160,14 @@ std::map<std::wstring, std::wstring> GRiSceneObject::GetOverrideMaterialNames()
 void GRiSceneObject::ClearOverrideMaterials()
 {
 	pOverrideMaterial.clear();
+	mDrawStateVersion++;
 	MarkDirty();
 }
 
 void GRiSceneObject::SetObjIndex(UINT ind)
 {
 	ObjIndex = ind;
+	mDrawStateVersion++;
 	MarkDirty();
 }
 
@@ -139,16 +178,23 @@ UINT GRiSceneObject::GetObjIndex()
 
 GGiFloat4x4 GRiSceneObject::GetTransform()
 {
-	if (bTransformDirty)
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	if (store.GetFlags()[dense] & SceneFlagTransformDirty)
 		ThrowGGiException("Trying to read dirty transform data. Please make sure UpdateTransform() is called before access transform data.");
 
 	//return mTransform.get();
-	return mTransform;
+	return store.GetWorlds()[dense];
+}
+
+void GRiSceneObject::SetTransform(GGiFloat4x4 trans)
+{
+	GRiSceneStore::GetInstance().SetLocal(GetDenseIndex(), trans);
 }
 
 GGiFloat4x4 GRiSceneObject::GetPrevTransform()
 {
-	return prevTransform;
+	return GRiSceneStore::GetInstance().GetPrevWorlds()[GetDenseIndex()];
 }
 
 /*
@@ -164,14 +210,16 @@ void GRiSceneObject::SetPrevTransform(GGiFloat4x4 trans)
 
 void GRiSceneObject::SetPrevTransform(GGiFloat4x4 trans)
 {
-	prevTransform = trans;
+	GRiSceneStore::GetInstance().GetPrevWorlds()[GetDenseIndex()] = trans;
 
 	MarkDirty();
 }
 
 void GRiSceneObject::ResetPrevTransform()
 {
-	prevTransform = mTransform;
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	store.GetPrevWorlds()[dense] = store.GetWorlds()[dense];
 	//std::shared_ptr<GGiFloat4x4> temp(GetTransform());
 	//prevTransform = temp;
 
@@ -180,19 +228,171 @@ void GRiSceneObject::ResetPrevTransform()
 
 CullState GRiSceneObject::GetCullState()
 {
-	return mCullState;
+	return (CullState)GRiSceneStore::GetInstance().GetCullStates()[GetDenseIndex()];
 }
 
 void GRiSceneObject::SetCullState(CullState cullState)
 {
-	mCullState = cullState;
+	GRiSceneStore::GetInstance().GetCullStates()[GetDenseIndex()] = (UINT8)cullState;
 	//there's no need to mark dirty.
 }
 
 bool GRiSceneObject::IsTransformDirty()
 {
-	return bTransformDirty;
+	return (GRiSceneStore::GetInstance().GetFlags()[GetDenseIndex()] & SceneFlagTransformDirty) != 0;
+}
+
+UINT GRiSceneObject::GetDrawStateVersion()
+{
+	return mDrawStateVersion;
+}
+
+GRiSceneHandle GRiSceneObject::GetHandle()
+{
+	return mHandle;
+}
+
+void GRiSceneObject::SetParent(GRiSceneObject* parent)
+{
+	auto& store = GRiSceneStore::GetInstance();
+	GRiSceneHandle parentHandle = parent != nullptr ? parent->GetHandle() : GRiSceneHandle();
+	if (store.GetParent(mHandle).Index == parentHandle.Index)
+		return;
+
+	// Keep the world transform, local = world * inverse(parentWorld).
+	UINT dense = GetDenseIndex();
+	if (store.GetFlags()[dense] & (SceneFlagTransformDirty | SceneFlagBoundsDirty))
+		store.RefreshEntry(dense);
+	GGiFloat4x4 local = store.GetWorlds()[dense];
+	if (parent != nullptr)
+	{
+		UINT parentDense = parent->GetDenseIndex();
+		if (store.GetFlags()[parentDense] & (SceneFlagTransformDirty | SceneFlagBoundsDirty))
+			store.RefreshEntry(parentDense);
+		GGiFloat4x4 invParentWorld = store.GetWorlds()[parentDense].GetInverse();
+		local = local * invParentWorld;
+	}
+
+	store.SetParent(mHandle, parentHandle);
+
+	float location[3], rotation[3], scale[3];
+	DecomposeTransform(local, location, rotation, scale);
+	SetLocation(location[0], location[1], location[2]);
+	SetRotation(rotation[0], rotation[1], rotation[2]);
+	SetScale(scale[0], scale[1], scale[2]);
+}
+
+GRiSceneObject* GRiSceneObject::GetParent()
+{
+	auto& store = GRiSceneStore::GetInstance();
+	GRiSceneHandle parent = store.GetParent(mHandle);
+	if (!store.IsValid(parent))
+		return nullptr;
+	return store.GetOwners()[store.GetDenseIndex(parent)];
+}
+
+std::vector<GRiSceneObject*> GRiSceneObject::GetChildren()
+{
+	auto& store = GRiSceneStore::GetInstance();
+	std::vector<GRiSceneObject*> ret;
+	for (auto child : store.GetChildren(mHandle))
+	{
+		ret.push_back(store.GetOwners()[store.GetDenseIndex(child)]);
+	}
+	return ret;
+}
+
+GRiBoundingBox GRiSceneObject::GetWorldBounds()
+{
+	auto& store = GRiSceneStore::GetInstance();
+	UINT dense = GetDenseIndex();
+	if (store.GetFlags()[dense] & SceneFlagBoundsDirty)
+		store.RefreshEntry(dense);
+
+	float* boundMin = store.GetWorldBoundMins() + dense * 3;
+	float* boundMax = store.GetWorldBoundMaxs() + dense * 3;
+
+	GRiBoundingBox bounds;
+	for (auto k = 0; k < 3; k++)
+	{
+		bounds.Center[k] = (boundMin[k] + boundMax[k]) * 0.5f;
+		bounds.Extents[k] = (boundMax[k] - boundMin[k]) * 0.5f;
+	}
+	return bounds;
+}
+
+void GRiSceneObject::SetSpatialIndex(GRiDynamicAabbTree* spatialIndex)
+{
+	if (pSpatialIndex == spatialIndex)
+		return;
+
+	if (pSpatialIndex != nullptr && mSpatialProxy != -1)
+		pSpatialIndex->DestroyProxy(mSpatialProxy);
+	mSpatialProxy = -1;
+
+	pSpatialIndex = spatialIndex;
+	UpdateSpatialProxy();
 }
 
+GRiDynamicAabbTree* GRiSceneObject::GetSpatialIndex()
+{
+	return pSpatialIndex;
+}
+
+void GRiSceneObject::UpdateSpatialProxy()
+{
+	if (pSpatialIndex == nullptr || Mesh == nullptr)
+		return;
 
+	GRiBoundingBox bounds = GetWorldBounds();
 
+	if (mSpatialProxy == -1)
+		mSpatialProxy = pSpatialIndex->CreateProxy(bounds, this);
+	else
+		pSpatialIndex->MoveProxy(mSpatialProxy, bounds);
+}
+
+void GRiSceneObject::DecomposeTransform(GGiFloat4x4 trans, float* location, float* rotation, float* scale)
+{
+	// Rows 0-2 are the rotated axes scaled by scale, row 3 the location.
+	float axes[3][3];
+	for (auto i = 0; i < 3; i++)
+	{
+		scale[i] = sqrtf(trans.GetElement(i, 0) * trans.GetElement(i, 0) +
+			trans.GetElement(i, 1) * trans.GetElement(i, 1) +
+			trans.GetElement(i, 2) * trans.GetElement(i, 2));
+		for (auto k = 0; k < 3; k++)
+			axes[i][k] = scale[i] > 0.0f ? trans.GetElement(i, k) / scale[i] : (i == k ? 1.0f : 0.0f);
+		location[i] = trans.GetElement(3, i);
+	}
+
+	// A mirrored transform goes into the x scale.
+	float det = axes[0][0] * (axes[1][1] * axes[2][2] - axes[1][2] * axes[2][1]) -
+		axes[0][1] * (axes[1][0] * axes[2][2] - axes[1][2] * axes[2][0]) +
+		axes[0][2] * (axes[1][0] * axes[2][1] - axes[1][1] * axes[2][0]);
+	if (det < 0.0f)
+	{
+		scale[0] = -scale[0];
+		for (auto k = 0; k < 3; k++)
+			axes[0][k] = -axes[0][k];
+	}
+
+	// Inverse of the roll, pitch, yaw rotation built by UpdateTransform(), row 2 is (cos(p)sin(y), -sin(p), cos(p)cos(y)).
+	float pitch = asinf(min(max(-axes[2][1], -1.0f), 1.0f));
+	float yaw, roll;
+	if (fabsf(axes[2][1]) < 0.9999f)
+	{
+		yaw = atan2f(axes[2][0], axes[2][2]);
+		roll = atan2f(axes[0][1], axes[1][1]);
+	}
+	else
+	{
+		// Gimbal lock, only the sum of yaw and roll is defined.
+		yaw = atan2f(-axes[0][2], axes[0][0]);
+		roll = 0.0f;
+	}
+
+	rotation[0] = pitch * 180.0f / GGiEngineUtil::PI;
+	rotation[1] = yaw * 180.0f / GGiEngineUtil::PI;
+	rotation[2] = roll * 180.0f / GGiEngineUtil::PI;
+}
@@ -0,0 +1,565 @@
+#include "stdafx.h"
+#include "GRiSceneStore.h"
+#include "GRiSceneObject.h"
+
+
+GRiSceneStore& GRiSceneStore::GetInstance()
+{
+	static GRiSceneStore *instance = new GRiSceneStore();
+	return *instance;
+}
+
+GRiSceneHandle GRiSceneStore::Create(GRiSceneObject* owner)
+{
+	GRiSceneHandle handle;
+	if (mFreeSlots.size() > 0)
+	{
+		handle.Index = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		handle.Index = (UINT)mSlotDenseIndex.size();
+		mSlotDenseIndex.push_back(0);
+		mSlotGeneration.push_back(0);
+		mSlotParent.push_back((UINT)-1);
+		mSlotLevel.push_back(0);
+		mSlotChildren.push_back(std::vector<UINT>());
+	}
+	handle.Generation = mSlotGeneration[handle.Index];
+	mSlotParent[handle.Index] = (UINT)-1;
+	mSlotLevel[handle.Index] = 0;
+	mSlotChildren[handle.Index].clear();
+
+	GRiSceneEntry entry;
+	for (auto k = 0; k < 3; k++)
+	{
+		entry.Location[k] = 0.0f;
+		entry.Rotation[k] = 0.0f;
+		entry.Scale[k] = 1.0f;
+		entry.WorldBoundMin[k] = 0.0f;
+		entry.WorldBoundMax[k] = 0.0f;
+	}
+	for (auto k = 0; k < 4; k++)
+	{
+		entry.WorldSphere[k] = 0.0f;
+	}
+	for (auto k = 0; k < 6; k++)
+	{
+		entry.LocalBounds[k] = 0.0f;
+	}
+	entry.Local = GGiFloat4x4::Identity();
+	entry.World = GGiFloat4x4::Identity();
+	entry.PrevWorld = GGiFloat4x4::Identity();
+	entry.CullState = 0;
+	entry.Flags = SceneFlagTransformDirty;
+	entry.Owner = owner;
+	entry.Slot = handle.Index;
+
+	UINT dense = InsertEntry(0, entry);
+
+	MarkBoundsDirty(dense);
+
+	return handle;
+}
+
+void GRiSceneStore::Destroy(GRiSceneHandle handle)
+{
+	if (!IsValid(handle))
+		ThrowGGiException("Invalid scene store handle.");
+
+	UINT slot = handle.Index;
+
+	GRiSceneHandle parent = GetParent(handle);
+	auto children = GetChildren(handle);
+	for (auto child : children)
+	{
+		SetParent(child, parent);
+	}
+
+	if (mSlotParent[slot] != (UINT)-1)
+	{
+		auto& siblings = mSlotChildren[mSlotParent[slot]];
+		siblings.erase(std::find(siblings.begin(), siblings.end(), slot));
+		mSlotParent[slot] = (UINT)-1;
+	}
+
+	RemoveEntry(mSlotDenseIndex[slot], mSlotLevel[slot]);
+
+	mSlotGeneration[slot]++;
+	mFreeSlots.push_back(slot);
+}
+
+bool GRiSceneStore::IsValid(GRiSceneHandle handle)
+{
+	return handle.Index < mSlotGeneration.size() && mSlotGeneration[handle.Index] == handle.Generation;
+}
+
+UINT GRiSceneStore::GetObjectNum()
+{
+	return (UINT)mDenseSlot.size();
+}
+
+void GRiSceneStore::SetParent(GRiSceneHandle handle, GRiSceneHandle parent)
+{
+	if (!IsValid(handle))
+		ThrowGGiException("Invalid scene store handle.");
+
+	UINT slot = handle.Index;
+	UINT parentSlot = (UINT)-1;
+	if (parent.Index != (UINT)-1)
+	{
+		if (!IsValid(parent))
+			ThrowGGiException("Invalid scene store parent handle.");
+
+		parentSlot = parent.Index;
+		for (UINT ancestor = parentSlot; ancestor != (UINT)-1; ancestor = mSlotParent[ancestor])
+		{
+			if (ancestor == slot)
+				ThrowGGiException("Scene object can't be attached to itself or to one of its descendants.");
+		}
+	}
+
+	if (mSlotParent[slot] == parentSlot)
+		return;
+
+	if (mSlotParent[slot] != (UINT)-1)
+	{
+		auto& siblings = mSlotChildren[mSlotParent[slot]];
+		siblings.erase(std::find(siblings.begin(), siblings.end(), slot));
+	}
+	mSlotParent[slot] = parentSlot;
+	if (parentSlot != (UINT)-1)
+		mSlotChildren[parentSlot].push_back(slot);
+
+	UpdateLevels(slot);
+
+	MarkBoundsDirty(mSlotDenseIndex[slot]);
+}
+
+GRiSceneHandle GRiSceneStore::GetParent(GRiSceneHandle handle)
+{
+	GRiSceneHandle parent;
+	UINT parentSlot = mSlotParent[handle.Index];
+	if (parentSlot != (UINT)-1)
+	{
+		parent.Index = parentSlot;
+		parent.Generation = mSlotGeneration[parentSlot];
+	}
+	return parent;
+}
+
+std::vector<GRiSceneHandle> GRiSceneStore::GetChildren(GRiSceneHandle handle)
+{
+	std::vector<GRiSceneHandle> children;
+	for (auto childSlot : mSlotChildren[handle.Index])
+	{
+		GRiSceneHandle child;
+		child.Index = childSlot;
+		child.Generation = mSlotGeneration[childSlot];
+		children.push_back(child);
+	}
+	return children;
+}
+
+UINT GRiSceneStore::GetLevel(GRiSceneHandle handle)
+{
+	return mSlotLevel[handle.Index];
+}
+
+UINT GRiSceneStore::GetLevelNum()
+{
+	return (UINT)mLevelStarts.size() - 1;
+}
+
+UINT GRiSceneStore::GetLevelStart(UINT level)
+{
+	return mLevelStarts[level];
+}
+
+void GRiSceneStore::MarkBoundsDirty(UINT denseIndex)
+{
+	mFlags[denseIndex] |= SceneFlagBoundsDirty;
+	if (mFlags[denseIndex] & SceneFlagBoundsQueued)
+		return;
+
+	mFlags[denseIndex] |= SceneFlagBoundsQueued;
+	mBoundsDirtySlots.push_back(mDenseSlot[denseIndex]);
+}
+
+void GRiSceneStore::BeginWorldUpdate()
+{
+	for (auto& dirtyLevel : mDirtyLevels)
+	{
+		dirtyLevel.clear();
+	}
+	mDirtyLevels.resize(GetLevelNum());
+
+	for (auto slot : mBoundsDirtySlots)
+	{
+		// The slot may have been destroyed, or destroyed and requeued by a new entry, since it was queued.
+		UINT dense = mSlotDenseIndex[slot];
+		if (dense >= mDenseSlot.size() || mDenseSlot[dense] != slot || !(mFlags[dense] & SceneFlagBoundsQueued))
+			continue;
+
+		// Entries refreshed on demand since they were queued still have to pass the change on to their children.
+		mFlags[dense] &= ~SceneFlagBoundsQueued;
+		mFlags[dense] |= SceneFlagWorldPending;
+		mDirtyLevels[mSlotLevel[slot]].push_back(dense);
+	}
+	mBoundsDirtySlots.clear();
+}
+
+const std::vector<UINT>& GRiSceneStore::GatherDirtyLevel(UINT level)
+{
+	if (level >= mDirtyLevels.size())
+		mDirtyLevels.resize(level + 1);
+
+	if (level > 0)
+	{
+		for (auto dense : mDirtyLevels[level - 1])
+		{
+			for (auto childSlot : mSlotChildren[mDenseSlot[dense]])
+			{
+				UINT childDense = mSlotDenseIndex[childSlot];
+				if (mFlags[childDense] & SceneFlagWorldPending)
+					continue;
+
+				mFlags[childDense] |= SceneFlagWorldPending | SceneFlagBoundsDirty;
+				mDirtyLevels[level].push_back(childDense);
+			}
+		}
+	}
+
+	return mDirtyLevels[level];
+}
+
+void GRiSceneStore::UpdateWorlds(const UINT* denseIndices, UINT num)
+{
+	for (UINT n = 0; n < num; n++)
+	{
+		UINT dense = denseIndices[n];
+
+		// Cleared first so that SetLocal() doesn't queue the entry again.
+		if (mFlags[dense] & SceneFlagTransformDirty)
+		{
+			mFlags[dense] &= ~SceneFlagTransformDirty;
+			mOwners[dense]->UpdateTransform();
+		}
+		else
+		{
+			UpdateWorld(dense);
+		}
+
+		UpdateBounds(dense);
+
+		mFlags[dense] &= ~(SceneFlagBoundsDirty | SceneFlagWorldPending);
+	}
+}
+
+void GRiSceneStore::RefreshEntry(UINT denseIndex)
+{
+	UINT parentSlot = mSlotParent[mDenseSlot[denseIndex]];
+	if (parentSlot != (UINT)-1)
+	{
+		UINT parentDense = mSlotDenseIndex[parentSlot];
+		if (mFlags[parentDense] & (SceneFlagTransformDirty | SceneFlagBoundsDirty))
+			RefreshEntry(parentDense);
+	}
+
+	// The entry stays queued, so the next world update still reaches its children.
+	if (mFlags[denseIndex] & SceneFlagTransformDirty)
+	{
+		mFlags[denseIndex] &= ~SceneFlagTransformDirty;
+		mOwners[denseIndex]->UpdateTransform();
+	}
+	else
+	{
+		UpdateWorld(denseIndex);
+	}
+
+	UpdateBounds(denseIndex);
+
+	mFlags[denseIndex] &= ~SceneFlagBoundsDirty;
+}
+
+void GRiSceneStore::SetLocal(UINT denseIndex, GGiFloat4x4 local)
+{
+	mLocals[denseIndex] = local;
+	UpdateWorld(denseIndex);
+
+	// Re-evaluating a clean transform doesn't invalidate the cached bounds.
+	if (mFlags[denseIndex] & SceneFlagTransformDirty)
+	{
+		mFlags[denseIndex] &= ~SceneFlagTransformDirty;
+		MarkBoundsDirty(denseIndex);
+	}
+}
+
+void GRiSceneStore::UpdateWorld(UINT denseIndex)
+{
+	UINT parentSlot = mSlotParent[mDenseSlot[denseIndex]];
+	if (parentSlot == (UINT)-1)
+	{
+		mWorlds[denseIndex] = mLocals[denseIndex];
+		return;
+	}
+
+	GGiFloat4x4 local = mLocals[denseIndex];
+	GGiFloat4x4 parentWorld = mWorlds[mSlotDenseIndex[parentSlot]];
+	mWorlds[denseIndex] = local * parentWorld;
+}
+
+void GRiSceneStore::UpdateBounds(UINT denseIndex)
+{
+	GGiFloat4x4& world = mWorlds[denseIndex];
+	float* localCenter = &mLocalBounds[denseIndex * 6];
+	float* localExtents = &mLocalBounds[denseIndex * 6 + 3];
+	float* sphere = &mWorldSpheres[denseIndex * 4];
+
+	float maxScaleSq = 0.0f;
+	for (auto i = 0; i < 3; i++)
+	{
+		float scaleSq = 0.0f;
+		for (auto k = 0; k < 3; k++)
+		{
+			scaleSq += world.GetElement(i, k) * world.GetElement(i, k);
+		}
+		maxScaleSq = max(maxScaleSq, scaleSq);
+	}
+
+	for (auto k = 0; k < 3; k++)
+	{
+		float center = world.GetElement(3, k);
+		float extent = 0.0f;
+		for (auto i = 0; i < 3; i++)
+		{
+			center += localCenter[i] * world.GetElement(i, k);
+			extent += localExtents[i] * fabsf(world.GetElement(i, k));
+		}
+		mWorldBoundMins[denseIndex * 3 + k] = center - extent;
+		mWorldBoundMaxs[denseIndex * 3 + k] = center + extent;
+		sphere[k] = center;
+	}
+	sphere[3] = sqrtf((localExtents[0] * localExtents[0] + localExtents[1] * localExtents[1] + localExtents[2] * localExtents[2]) * maxScaleSq);
+}
+
+void GRiSceneStore::LoadEntry(UINT denseIndex, GRiSceneEntry& entry)
+{
+	for (auto k = 0; k < 3; k++)
+	{
+		entry.Location[k] = mLocations[denseIndex * 3 + k];
+		entry.Rotation[k] = mRotations[denseIndex * 3 + k];
+		entry.Scale[k] = mScales[denseIndex * 3 + k];
+		entry.WorldBoundMin[k] = mWorldBoundMins[denseIndex * 3 + k];
+		entry.WorldBoundMax[k] = mWorldBoundMaxs[denseIndex * 3 + k];
+	}
+	for (auto k = 0; k < 4; k++)
+	{
+		entry.WorldSphere[k] = mWorldSpheres[denseIndex * 4 + k];
+	}
+	for (auto k = 0; k < 6; k++)
+	{
+		entry.LocalBounds[k] = mLocalBounds[denseIndex * 6 + k];
+	}
+	entry.Local = mLocals[denseIndex];
+	entry.World = mWorlds[denseIndex];
+	entry.PrevWorld = mPrevWorlds[denseIndex];
+	entry.CullState = mCullStates[denseIndex];
+	entry.Flags = mFlags[denseIndex];
+	entry.Owner = mOwners[denseIndex];
+	entry.Slot = mDenseSlot[denseIndex];
+}
+
+void GRiSceneStore::StoreEntry(UINT denseIndex, const GRiSceneEntry& entry)
+{
+	for (auto k = 0; k < 3; k++)
+	{
+		mLocations[denseIndex * 3 + k] = entry.Location[k];
+		mRotations[denseIndex * 3 + k] = entry.Rotation[k];
+		mScales[denseIndex * 3 + k] = entry.Scale[k];
+		mWorldBoundMins[denseIndex * 3 + k] = entry.WorldBoundMin[k];
+		mWorldBoundMaxs[denseIndex * 3 + k] = entry.WorldBoundMax[k];
+	}
+	for (auto k = 0; k < 4; k++)
+	{
+		mWorldSpheres[denseIndex * 4 + k] = entry.WorldSphere[k];
+	}
+	for (auto k = 0; k < 6; k++)
+	{
+		mLocalBounds[denseIndex * 6 + k] = entry.LocalBounds[k];
+	}
+	mLocals[denseIndex] = entry.Local;
+	mWorlds[denseIndex] = entry.World;
+	mPrevWorlds[denseIndex] = entry.PrevWorld;
+	mCullStates[denseIndex] = entry.CullState;
+	mFlags[denseIndex] = entry.Flags;
+	mOwners[denseIndex] = entry.Owner;
+	mDenseSlot[denseIndex] = entry.Slot;
+	mSlotDenseIndex[entry.Slot] = denseIndex;
+}
+
+void GRiSceneStore::ResizeEntries(UINT num)
+{
+	mDenseSlot.resize(num);
+	mLocations.resize(num * 3);
+	mRotations.resize(num * 3);
+	mScales.resize(num * 3);
+	mLocals.resize(num);
+	mWorlds.resize(num);
+	mPrevWorlds.resize(num);
+	mWorldBoundMins.resize(num * 3);
+	mWorldBoundMaxs.resize(num * 3);
+	mWorldSpheres.resize(num * 4);
+	mLocalBounds.resize(num * 6);
+	mCullStates.resize(num);
+	mFlags.resize(num);
+	mOwners.resize(num);
+}
+
+UINT GRiSceneStore::InsertEntry(UINT level, const GRiSceneEntry& entry)
+{
+	while (GetLevelNum() < level + 1)
+	{
+		mLevelStarts.push_back(mLevelStarts.back());
+	}
+
+	UINT levelNum = GetLevelNum();
+	UINT hole = mLevelStarts[levelNum];
+	ResizeEntries(hole + 1);
+	mLevelStarts[levelNum]++;
+
+	// Rotate every higher level by moving its first entry into the hole after its last one.
+	GRiSceneEntry moved;
+	for (UINT l = levelNum - 1; l > level; l--)
+	{
+		if (mLevelStarts[l] != hole)
+		{
+			LoadEntry(mLevelStarts[l], moved);
+			StoreEntry(hole, moved);
+		}
+		hole = mLevelStarts[l];
+		mLevelStarts[l]++;
+	}
+
+	StoreEntry(hole, entry);
+	return hole;
+}
+
+void GRiSceneStore::RemoveEntry(UINT denseIndex, UINT level)
+{
+	UINT levelNum = GetLevelNum();
+	UINT hole = denseIndex;
+
+	// Fill the hole with the last entry of the level, which moves the hole in front of the next level.
+	GRiSceneEntry moved;
+	for (UINT l = level; l < levelNum; l++)
+	{
+		UINT last = mLevelStarts[l + 1] - 1;
+		if (last != hole)
+		{
+			LoadEntry(last, moved);
+			StoreEntry(hole, moved);
+		}
+		hole = last;
+		mLevelStarts[l + 1]--;
+	}
+
+	ResizeEntries(mLevelStarts[levelNum]);
+
+	while (mLevelStarts.size() > 2 && mLevelStarts[mLevelStarts.size() - 2] == mLevelStarts.back())
+	{
+		mLevelStarts.pop_back();
+	}
+}
+
+void GRiSceneStore::UpdateLevels(UINT slot)
+{
+	// Breadth-first, so parents are relocated before their children.
+	std::vector<UINT> queue = { slot };
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		UINT current = queue[i];
+		UINT parentSlot = mSlotParent[current];
+		UINT level = parentSlot == (UINT)-1 ? 0 : mSlotLevel[parentSlot] + 1;
+		if (level == mSlotLevel[current])
+			continue;
+
+		GRiSceneEntry entry;
+		LoadEntry(mSlotDenseIndex[current], entry);
+		RemoveEntry(mSlotDenseIndex[current], mSlotLevel[current]);
+		mSlotLevel[current] = level;
+		InsertEntry(level, entry);
+
+		for (auto child : mSlotChildren[current])
+		{
+			queue.push_back(child);
+		}
+	}
+}
+
+float* GRiSceneStore::GetLocations()
+{
+	return mLocations.data();
+}
+
+float* GRiSceneStore::GetRotations()
+{
+	return mRotations.data();
+}
+
+float* GRiSceneStore::GetScales()
+{
+	return mScales.data();
+}
+
+GGiFloat4x4* GRiSceneStore::GetLocals()
+{
+	return mLocals.data();
+}
+
+GGiFloat4x4* GRiSceneStore::GetWorlds()
+{
+	return mWorlds.data();
+}
+
+GGiFloat4x4* GRiSceneStore::GetPrevWorlds()
+{
+	return mPrevWorlds.data();
+}
+
+float* GRiSceneStore::GetWorldBoundMins()
+{
+	return mWorldBoundMins.data();
+}
+
+float* GRiSceneStore::GetWorldBoundMaxs()
+{
+	return mWorldBoundMaxs.data();
+}
+
+float* GRiSceneStore::GetWorldSpheres()
+{
+	return mWorldSpheres.data();
+}
+
+float* GRiSceneStore::GetLocalBounds()
+{
+	return mLocalBounds.data();
+}
+
+UINT8* GRiSceneStore::GetCullStates()
+{
+	return mCullStates.data();
+}
+
+UINT8* GRiSceneStore::GetFlags()
+{
+	return mFlags.data();
+}
+
+GRiSceneObject** GRiSceneStore::GetOwners()
+{
+	return mOwners.data();
+}
+
@@ -0,0 +1,556 @@
+#include "stdafx.h"
+#include "GRiSdfClipmap.h"
+
+#include <chrono>
+
+
+void GRiSdfClipmap::Init(int levelNum, int resolution, int brickSize, float finestVoxelSize, float truncationVoxels)
+{
+	if (levelNum <= 0 || resolution <= 0 || brickSize <= 0 || finestVoxelSize <= 0.0f || truncationVoxels <= 0.0f)
+		ThrowGGiException("Invalid sdf clipmap parameters.");
+	if (resolution % brickSize != 0)
+		ThrowGGiException("Sdf clipmap resolution must be a multiple of the brick size.");
+
+	mLevelNum = levelNum;
+	mResolution = resolution;
+	mBrickSize = brickSize;
+	mBrickNum = resolution / brickSize;
+
+	mLevels.clear();
+	mLevels.resize(mLevelNum);
+	float voxelSize = finestVoxelSize;
+	for (auto i = 0; i < mLevelNum; i++)
+	{
+		mLevels[i].VoxelSize = voxelSize;
+		mLevels[i].TruncationDistance = truncationVoxels * voxelSize;
+		mLevels[i].Distance = std::vector<float>(mResolution * mResolution * mResolution, mLevels[i].TruncationDistance);
+		mLevels[i].BrickDirty = std::vector<UINT8>(mBrickNum * mBrickNum * mBrickNum, 1);
+		voxelSize *= 2.0f;
+	}
+
+	mObjects.clear();
+	mUpdatedBricks.clear();
+	mStats = GRiSdfClipmapStats();
+
+	bInitialized = true;
+	bOriginValid = false;
+}
+
+void GRiSdfClipmap::SetObject(UINT id, GRiMesh* mesh, GGiFloat4x4 world)
+{
+	if (mesh == nullptr ||
+		mesh->GetSdf() == nullptr ||
+		mesh->GetSdf()->size() == 0 ||
+		mesh->GetSdfExtent() <= 0.0f)
+	{
+		RemoveObject(id);
+		return;
+	}
+
+	auto it = mObjects.find(id);
+	if (it != mObjects.end())
+	{
+		auto& obj = it->second;
+		if (obj.Mesh == mesh && obj.Sdf == mesh->GetSdf())
+		{
+			bool bSame = true;
+			for (auto r = 0; r < 4; r++)
+			{
+				if (_mm_movemask_ps(_mm_cmpeq_ps(obj.World.GetRow(r), world.GetRow(r))) != 0xF)
+				{
+					bSame = false;
+					break;
+				}
+			}
+			if (bSame)
+				return;
+		}
+
+		// Invalidate the region the object is leaving.
+		MarkRegionDirty(obj.BoundMin, obj.BoundMax);
+	}
+
+	GRiSdfClipmapObject obj;
+	obj.Mesh = mesh;
+	obj.Sdf = mesh->GetSdf();
+	obj.SdfResolution = mesh->GetSdfResolution();
+	obj.SdfExtent = mesh->GetSdfExtent();
+	obj.World = world;
+
+	if (obj.SdfResolution < 2 || (int)obj.Sdf->size() != obj.SdfResolution * obj.SdfResolution * obj.SdfResolution)
+		ThrowGGiException("Mesh sdf size does not match its resolution.");
+
+	auto inv = world.GetInverse();
+	for (auto i = 0; i < 4; i++)
+	{
+		for (auto j = 0; j < 4; j++)
+		{
+			obj.InvWorld[i][j] = inv.GetElement(i, j);
+		}
+	}
+
+	obj.MinScale = GGiEngineUtil::Infinity;
+	for (auto i = 0; i < 3; i++)
+	{
+		float len = sqrtf(world.GetElement(i, 0) * world.GetElement(i, 0) +
+			world.GetElement(i, 1) * world.GetElement(i, 1) +
+			world.GetElement(i, 2) * world.GetElement(i, 2));
+		obj.MinScale = min(obj.MinScale, len);
+	}
+
+	// Transform the corners of the sdf volume to get its world bounds.
+	float halfExtent = 0.5f * obj.SdfExtent;
+	for (auto k = 0; k < 3; k++)
+	{
+		obj.BoundMin[k] = GGiEngineUtil::Infinity;
+		obj.BoundMax[k] = -GGiEngineUtil::Infinity;
+	}
+	for (auto c = 0; c < 8; c++)
+	{
+		float corner[3] = {
+			(c & 1) ? halfExtent : -halfExtent,
+			(c & 2) ? halfExtent : -halfExtent,
+			(c & 4) ? halfExtent : -halfExtent
+		};
+		for (auto k = 0; k < 3; k++)
+		{
+			float w = corner[0] * world.GetElement(0, k) +
+				corner[1] * world.GetElement(1, k) +
+				corner[2] * world.GetElement(2, k) +
+				world.GetElement(3, k);
+			obj.BoundMin[k] = min(obj.BoundMin[k], w);
+			obj.BoundMax[k] = max(obj.BoundMax[k], w);
+		}
+	}
+
+	mObjects[id] = obj;
+
+	MarkRegionDirty(obj.BoundMin, obj.BoundMax);
+}
+
+void GRiSdfClipmap::RemoveObject(UINT id)
+{
+	auto it = mObjects.find(id);
+	if (it == mObjects.end())
+		return;
+
+	MarkRegionDirty(it->second.BoundMin, it->second.BoundMax);
+	mObjects.erase(it);
+}
+
+bool GRiSdfClipmap::HasObject(UINT id)
+{
+	return mObjects.find(id) != mObjects.end();
+}
+
+std::vector<UINT> GRiSdfClipmap::GetObjectIds()
+{
+	std::vector<UINT> ret;
+	ret.reserve(mObjects.size());
+	for (auto& obj : mObjects)
+		ret.push_back(obj.first);
+	return ret;
+}
+
+void GRiSdfClipmap::Update(GGiThreadPool* tp, float cameraX, float cameraY, float cameraZ)
+{
+	if (!bInitialized)
+		ThrowGGiException("Sdf clipmap is not initialized.");
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	float cameraPos[3] = { cameraX, cameraY, cameraZ };
+
+	// Keep the camera in the center brick of every level.
+	for (auto l = 0; l < mLevelNum; l++)
+	{
+		float brickWorldSize = mLevels[l].VoxelSize * mBrickSize;
+		int newOrigin[3];
+		for (auto k = 0; k < 3; k++)
+			newOrigin[k] = (int)floorf(cameraPos[k] / brickWorldSize) - mBrickNum / 2;
+
+		if (!bOriginValid)
+		{
+			for (auto k = 0; k < 3; k++)
+				mLevels[l].Origin[k] = newOrigin[k];
+			std::fill(mLevels[l].BrickDirty.begin(), mLevels[l].BrickDirty.end(), (UINT8)1);
+		}
+		else if (newOrigin[0] != mLevels[l].Origin[0] ||
+			newOrigin[1] != mLevels[l].Origin[1] ||
+			newOrigin[2] != mLevels[l].Origin[2])
+		{
+			RecenterLevel(l, newOrigin);
+		}
+	}
+	bOriginValid = true;
+
+	mUpdatedBricks.clear();
+	for (auto l = 0; l < mLevelNum; l++)
+	{
+		auto& level = mLevels[l];
+		for (auto bz = level.Origin[2]; bz < level.Origin[2] + mBrickNum; bz++)
+		{
+			for (auto by = level.Origin[1]; by < level.Origin[1] + mBrickNum; by++)
+			{
+				for (auto bx = level.Origin[0]; bx < level.Origin[0] + mBrickNum; bx++)
+				{
+					auto slot = BrickSlot(bx, by, bz);
+					if (level.BrickDirty[slot])
+					{
+						GRiSdfClipmapBrick brick;
+						brick.Level = l;
+						brick.Brick[0] = bx;
+						brick.Brick[1] = by;
+						brick.Brick[2] = bz;
+						mUpdatedBricks.push_back(brick);
+						level.BrickDirty[slot] = 0;
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<GRiSdfClipmapObject*> objects;
+	objects.reserve(mObjects.size());
+	for (auto& obj : mObjects)
+		objects.push_back(&obj.second);
+
+	if (tp == nullptr)
+	{
+		for (auto& brick : mUpdatedBricks)
+			CompositeBrick(brick, objects);
+	}
+	else
+	{
+		UINT32 step = 1;
+		if (mUpdatedBricks.size() > tp->GetThreadNum())
+			step = (UINT32)(mUpdatedBricks.size() / tp->GetThreadNum()) + 1;
+
+		for (auto i = 0u; i < mUpdatedBricks.size(); i += step)
+		{
+			tp->Enqueue([&, i]
+			{
+				for (auto j = i; j < i + step && j < mUpdatedBricks.size(); j++)
+				{
+					CompositeBrick(mUpdatedBricks[j], objects);
+				}
+			});
+		}
+
+		tp->Flush();
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	mStats.ObjectNum = (int)mObjects.size();
+	mStats.DirtyBrickNum = (int)mUpdatedBricks.size();
+	mStats.CompositedVoxelNum = mStats.DirtyBrickNum * mBrickSize * mBrickSize * mBrickSize;
+	mStats.UpdateTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+const std::vector<GRiSdfClipmapBrick>& GRiSdfClipmap::GetUpdatedBricks()
+{
+	return mUpdatedBricks;
+}
+
+int GRiSdfClipmap::GetBrickSlot(const GRiSdfClipmapBrick& brick)
+{
+	return BrickSlot(brick.Brick[0], brick.Brick[1], brick.Brick[2]);
+}
+
+void GRiSdfClipmap::CopyBrick(const GRiSdfClipmapBrick& brick, float* dst)
+{
+	auto& level = mLevels[brick.Level];
+	int v0[3] = { brick.Brick[0] * mBrickSize, brick.Brick[1] * mBrickSize, brick.Brick[2] * mBrickSize };
+
+	// Rows of a brick are contiguous in the toroidal volume as well, the window wraps at brick boundaries.
+	for (auto vz = v0[2]; vz < v0[2] + mBrickSize; vz++)
+	{
+		for (auto vy = v0[1]; vy < v0[1] + mBrickSize; vy++)
+		{
+			memcpy(dst, &level.Distance[VoxelSlot(v0[0], vy, vz)], sizeof(float) * mBrickSize);
+			dst += mBrickSize;
+		}
+	}
+}
+
+GRiSdfClipmapStats GRiSdfClipmap::GetStats()
+{
+	return mStats;
+}
+
+int GRiSdfClipmap::GetLevelNum()
+{
+	return mLevelNum;
+}
+
+int GRiSdfClipmap::GetResolution()
+{
+	return mResolution;
+}
+
+int GRiSdfClipmap::GetBrickSize()
+{
+	return mBrickSize;
+}
+
+const GRiSdfClipmapLevel& GRiSdfClipmap::GetLevel(int level)
+{
+	if (level < 0 || level >= mLevelNum)
+		ThrowGGiException("Sdf clipmap level index out of range.");
+
+	return mLevels[level];
+}
+
+float GRiSdfClipmap::Sample(float x, float y, float z)
+{
+	if (!bOriginValid)
+		ThrowGGiException("Sdf clipmap has not been updated yet.");
+
+	float pos[3] = { x, y, z };
+	for (auto l = 0; l < mLevelNum; l++)
+	{
+		auto& level = mLevels[l];
+		int v[3];
+		bool bInside = true;
+		for (auto k = 0; k < 3; k++)
+		{
+			v[k] = (int)floorf(pos[k] / level.VoxelSize);
+			if (v[k] < level.Origin[k] * mBrickSize || v[k] >= (level.Origin[k] + mBrickNum) * mBrickSize)
+			{
+				bInside = false;
+				break;
+			}
+		}
+		if (bInside)
+			return level.Distance[VoxelSlot(v[0], v[1], v[2])];
+	}
+
+	return mLevels[mLevelNum - 1].TruncationDistance;
+}
+
+float GRiSdfClipmap::ComputeReferenceDistance(int level, int vx, int vy, int vz)
+{
+	auto& lv = mLevels[level];
+	float x = ((float)vx + 0.5f) * lv.VoxelSize;
+	float y = ((float)vy + 0.5f) * lv.VoxelSize;
+	float z = ((float)vz + 0.5f) * lv.VoxelSize;
+
+	float dist = lv.TruncationDistance;
+	for (auto& obj : mObjects)
+		dist = min(dist, SampleObject(obj.second, x, y, z));
+
+	return dist;
+}
+
+float GRiSdfClipmap::ValidateAgainstReference(GGiThreadPool* tp)
+{
+	if (!bOriginValid)
+		ThrowGGiException("Sdf clipmap has not been updated yet.");
+
+	// One task per z slice of every level.
+	int taskNum = mLevelNum * mResolution;
+	std::vector<float> maxError(taskNum, 0.0f);
+
+	auto validateSlice = [&](int task)
+	{
+		int l = task / mResolution;
+		auto& level = mLevels[l];
+		int vz = level.Origin[2] * mBrickSize + task % mResolution;
+		for (auto vy = level.Origin[1] * mBrickSize; vy < (level.Origin[1] + mBrickNum) * mBrickSize; vy++)
+		{
+			for (auto vx = level.Origin[0] * mBrickSize; vx < (level.Origin[0] + mBrickNum) * mBrickSize; vx++)
+			{
+				float err = fabsf(level.Distance[VoxelSlot(vx, vy, vz)] - ComputeReferenceDistance(l, vx, vy, vz));
+				if (err > maxError[task])
+					maxError[task] = err;
+			}
+		}
+	};
+
+	if (tp == nullptr)
+	{
+		for (auto t = 0; t < taskNum; t++)
+			validateSlice(t);
+	}
+	else
+	{
+		for (auto t = 0; t < taskNum; t++)
+			tp->Enqueue([&, t] { validateSlice(t); });
+		tp->Flush();
+	}
+
+	float ret = 0.0f;
+	for (auto err : maxError)
+		ret = max(ret, err);
+
+	return ret;
+}
+
+void GRiSdfClipmap::MarkRegionDirty(const float* boundMin, const float* boundMax)
+{
+	// Every brick is rebuilt on the first update anyway.
+	if (!bOriginValid)
+		return;
+
+	for (auto l = 0; l < mLevelNum; l++)
+	{
+		auto& level = mLevels[l];
+		float brickWorldSize = level.VoxelSize * mBrickSize;
+
+		int lo[3], hi[3];
+		bool bOverlap = true;
+		for (auto k = 0; k < 3; k++)
+		{
+			lo[k] = (int)floorf((boundMin[k] - level.TruncationDistance) / brickWorldSize);
+			hi[k] = (int)floorf((boundMax[k] + level.TruncationDistance) / brickWorldSize);
+			lo[k] = max(lo[k], level.Origin[k]);
+			hi[k] = min(hi[k], level.Origin[k] + mBrickNum - 1);
+			if (lo[k] > hi[k])
+			{
+				bOverlap = false;
+				break;
+			}
+		}
+		if (!bOverlap)
+			continue;
+
+		for (auto bz = lo[2]; bz <= hi[2]; bz++)
+		{
+			for (auto by = lo[1]; by <= hi[1]; by++)
+			{
+				for (auto bx = lo[0]; bx <= hi[0]; bx++)
+				{
+					level.BrickDirty[BrickSlot(bx, by, bz)] = 1;
+				}
+			}
+		}
+	}
+}
+
+void GRiSdfClipmap::RecenterLevel(int level, const int* newOrigin)
+{
+	auto& lv = mLevels[level];
+
+	// Bricks that stay inside the window keep their toroidal slot, only the entering ones are invalidated.
+	for (auto bz = newOrigin[2]; bz < newOrigin[2] + mBrickNum; bz++)
+	{
+		for (auto by = newOrigin[1]; by < newOrigin[1] + mBrickNum; by++)
+		{
+			for (auto bx = newOrigin[0]; bx < newOrigin[0] + mBrickNum; bx++)
+			{
+				if (bx < lv.Origin[0] || bx >= lv.Origin[0] + mBrickNum ||
+					by < lv.Origin[1] || by >= lv.Origin[1] + mBrickNum ||
+					bz < lv.Origin[2] || bz >= lv.Origin[2] + mBrickNum)
+				{
+					lv.BrickDirty[BrickSlot(bx, by, bz)] = 1;
+				}
+			}
+		}
+	}
+
+	for (auto k = 0; k < 3; k++)
+		lv.Origin[k] = newOrigin[k];
+}
+
+void GRiSdfClipmap::CompositeBrick(const GRiSdfClipmapBrick& brick, const std::vector<GRiSdfClipmapObject*>& objects)
+{
+	auto& level = mLevels[brick.Level];
+	float brickWorldSize = level.VoxelSize * mBrickSize;
+
+	float brickMin[3], brickMax[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		brickMin[k] = brick.Brick[k] * brickWorldSize;
+		brickMax[k] = brickMin[k] + brickWorldSize;
+	}
+
+	// Objects farther than the truncation distance can't lower any voxel of this brick.
+	std::vector<GRiSdfClipmapObject*> candidates;
+	for (auto obj : objects)
+	{
+		if (obj->BoundMin[0] - level.TruncationDistance <= brickMax[0] && obj->BoundMax[0] + level.TruncationDistance >= brickMin[0] &&
+			obj->BoundMin[1] - level.TruncationDistance <= brickMax[1] && obj->BoundMax[1] + level.TruncationDistance >= brickMin[1] &&
+			obj->BoundMin[2] - level.TruncationDistance <= brickMax[2] && obj->BoundMax[2] + level.TruncationDistance >= brickMin[2])
+		{
+			candidates.push_back(obj);
+		}
+	}
+
+	int v0[3] = { brick.Brick[0] * mBrickSize, brick.Brick[1] * mBrickSize, brick.Brick[2] * mBrickSize };
+	for (auto vz = v0[2]; vz < v0[2] + mBrickSize; vz++)
+	{
+		for (auto vy = v0[1]; vy < v0[1] + mBrickSize; vy++)
+		{
+			for (auto vx = v0[0]; vx < v0[0] + mBrickSize; vx++)
+			{
+				float x = ((float)vx + 0.5f) * level.VoxelSize;
+				float y = ((float)vy + 0.5f) * level.VoxelSize;
+				float z = ((float)vz + 0.5f) * level.VoxelSize;
+
+				float dist = level.TruncationDistance;
+				for (auto obj : candidates)
+					dist = min(dist, SampleObject(*obj, x, y, z));
+
+				level.Distance[VoxelSlot(vx, vy, vz)] = dist;
+			}
+		}
+	}
+}
+
+float GRiSdfClipmap::SampleObject(const GRiSdfClipmapObject& obj, float x, float y, float z)
+{
+	// Outside the world bounds their distance is a lower bound as well, taking the larger one keeps
+	// every object beyond the truncation distance of a voxel from affecting it.
+	float boundDist = 0.0f;
+	{
+		float dx = max(max(obj.BoundMin[0] - x, x - obj.BoundMax[0]), 0.0f);
+		float dy = max(max(obj.BoundMin[1] - y, y - obj.BoundMax[1]), 0.0f);
+		float dz = max(max(obj.BoundMin[2] - z, z - obj.BoundMax[2]), 0.0f);
+		boundDist = sqrtf(dx * dx + dy * dy + dz * dz);
+	}
+
+	float local[3];
+	for (auto k = 0; k < 3; k++)
+		local[k] = x * obj.InvWorld[0][k] + y * obj.InvWorld[1][k] + z * obj.InvWorld[2][k] + obj.InvWorld[3][k];
+
+	// Same voxel layout as GDxRenderer::BuildMeshSDF, voxel i is centered at (i - res / 2 + 0.5) * unit.
+	int res = obj.SdfResolution;
+	float unit = obj.SdfExtent / (float)res;
+	float u[3];
+	float outside = 0.0f;
+	for (auto k = 0; k < 3; k++)
+	{
+		float fu = local[k] / unit + (float)(res / 2) - 0.5f;
+		float cu = min(max(fu, 0.0f), (float)(res - 1));
+		float d = (fu - cu) * unit;
+		outside += d * d;
+		u[k] = cu;
+	}
+	outside = sqrtf(outside);
+
+	int i0[3];
+	float f[3];
+	for (auto k = 0; k < 3; k++)
+	{
+		i0[k] = min((int)u[k], res - 2);
+		f[k] = u[k] - (float)i0[k];
+	}
+
+	auto& sdf = *obj.Sdf;
+	auto at = [&](int dx, int dy, int dz)
+	{
+		return sdf[(i0[2] + dz) * res * res + (i0[1] + dy) * res + (i0[0] + dx)];
+	};
+
+	float c00 = at(0, 0, 0) * (1.0f - f[0]) + at(1, 0, 0) * f[0];
+	float c10 = at(0, 1, 0) * (1.0f - f[0]) + at(1, 1, 0) * f[0];
+	float c01 = at(0, 0, 1) * (1.0f - f[0]) + at(1, 0, 1) * f[0];
+	float c11 = at(0, 1, 1) * (1.0f - f[0]) + at(1, 1, 1) * f[0];
+	float c0 = c00 * (1.0f - f[1]) + c10 * f[1];
+	float c1 = c01 * (1.0f - f[1]) + c11 * f[1];
+	float sdfDist = (c0 * (1.0f - f[2]) + c1 * f[2] + outside) * obj.MinScale;
+
+	return boundDist > 0.0f ? max(sdfDist, boundDist) : sdfDist;
+}
+
@@ -0,0 +1,255 @@
+#include "stdafx.h"
+#include "GRiSdfTileCuller.h"
+
+#include <chrono>
+
+
+void GRiSdfTileCuller::Init(int tileNum)
+{
+	if (tileNum <= 0)
+		ThrowGGiException("Invalid sdf tile number.");
+
+	mTileNum = tileNum;
+	mGrid = GRiSdfTileGrid();
+	mGrid.TileNum = tileNum;
+
+	mRowIndices.clear();
+	mRowIndices.resize(mTileNum);
+	mTileRanges = std::vector<UINT>(mTileNum * mTileNum * 2, 0);
+	mObjectIndices.clear();
+	mObjectNum = 0;
+	mStats = GRiSdfTileCullerStats();
+}
+
+void GRiSdfTileCuller::Build(GGiThreadPool* tp, const float* lightDir, const std::vector<GRiBoundingBox>& objectBounds)
+{
+	if (mTileNum <= 0)
+		ThrowGGiException("Sdf tile culler is not initialized.");
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Build the plane basis, w points toward the light.
+	float w[3] = { -lightDir[0], -lightDir[1], -lightDir[2] };
+	float len = sqrtf(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+	if (len <= 0.0f)
+		ThrowGGiException("Invalid light direction.");
+	w[0] /= len;
+	w[1] /= len;
+	w[2] /= len;
+
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	if (fabsf(w[1]) > 0.99f)
+	{
+		up[1] = 0.0f;
+		up[2] = 1.0f;
+	}
+	float* u = mGrid.AxisU;
+	float* v = mGrid.AxisV;
+	u[0] = up[1] * w[2] - up[2] * w[1];
+	u[1] = up[2] * w[0] - up[0] * w[2];
+	u[2] = up[0] * w[1] - up[1] * w[0];
+	len = sqrtf(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+	u[0] /= len;
+	u[1] /= len;
+	u[2] /= len;
+	v[0] = w[1] * u[2] - w[2] * u[1];
+	v[1] = w[2] * u[0] - w[0] * u[2];
+	v[2] = w[0] * u[1] - w[1] * u[0];
+
+	// Project the bounds onto the plane.
+	mObjectNum = (int)objectBounds.size();
+	int paddedNum = (mObjectNum + 3) & ~3;
+	mUMin.resize(paddedNum);
+	mUMax.resize(paddedNum);
+	mVMin.resize(paddedNum);
+	mVMax.resize(paddedNum);
+
+	float gridMin[2] = { GGiEngineUtil::Infinity, GGiEngineUtil::Infinity };
+	float gridMax[2] = { -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity };
+	for (auto i = 0; i < mObjectNum; i++)
+	{
+		auto& b = objectBounds[i];
+		float cu = b.Center[0] * u[0] + b.Center[1] * u[1] + b.Center[2] * u[2];
+		float ru = b.Extents[0] * fabsf(u[0]) + b.Extents[1] * fabsf(u[1]) + b.Extents[2] * fabsf(u[2]);
+		float cv = b.Center[0] * v[0] + b.Center[1] * v[1] + b.Center[2] * v[2];
+		float rv = b.Extents[0] * fabsf(v[0]) + b.Extents[1] * fabsf(v[1]) + b.Extents[2] * fabsf(v[2]);
+		mUMin[i] = cu - ru;
+		mUMax[i] = cu + ru;
+		mVMin[i] = cv - rv;
+		mVMax[i] = cv + rv;
+		gridMin[0] = min(gridMin[0], mUMin[i]);
+		gridMax[0] = max(gridMax[0], mUMax[i]);
+		gridMin[1] = min(gridMin[1], mVMin[i]);
+		gridMax[1] = max(gridMax[1], mVMax[i]);
+	}
+	for (auto i = mObjectNum; i < paddedNum; i++)
+	{
+		mUMin[i] = GGiEngineUtil::Infinity;
+		mUMax[i] = -GGiEngineUtil::Infinity;
+		mVMin[i] = GGiEngineUtil::Infinity;
+		mVMax[i] = -GGiEngineUtil::Infinity;
+	}
+
+	// Fit square tiles around every projected object.
+	if (mObjectNum > 0)
+	{
+		mGrid.Origin[0] = gridMin[0];
+		mGrid.Origin[1] = gridMin[1];
+		mGrid.TileSize = max(gridMax[0] - gridMin[0], gridMax[1] - gridMin[1]) / (float)mTileNum;
+		if (mGrid.TileSize <= 0.0f)
+			mGrid.TileSize = 1.0f;
+	}
+
+	// One task per group of rows.
+	if (tp == nullptr)
+	{
+		for (auto r = 0; r < mTileNum; r++)
+			BuildRow(r);
+	}
+	else
+	{
+		UINT32 step = (UINT32)(mTileNum / tp->GetThreadNum()) + 1;
+		for (auto i = 0u; i < (UINT32)mTileNum; i += step)
+		{
+			tp->Enqueue([&, i]
+			{
+				for (auto r = i; r < i + step && r < (UINT32)mTileNum; r++)
+				{
+					BuildRow(r);
+				}
+			});
+		}
+		tp->Flush();
+	}
+
+	// Concatenate the row lists, offsets were written relative to their row.
+	mStats = GRiSdfTileCullerStats();
+	UINT totalNum = 0;
+	for (auto r = 0; r < mTileNum; r++)
+		totalNum += (UINT)mRowIndices[r].size();
+	mObjectIndices.resize(totalNum);
+
+	UINT rowOffset = 0;
+	for (auto r = 0; r < mTileNum; r++)
+	{
+		if (mRowIndices[r].size() > 0)
+			memcpy(&mObjectIndices[rowOffset], mRowIndices[r].data(), mRowIndices[r].size() * sizeof(UINT));
+
+		for (auto c = 0; c < mTileNum; c++)
+		{
+			auto tile = r * mTileNum + c;
+			mTileRanges[tile * 2] += rowOffset;
+
+			auto count = (int)mTileRanges[tile * 2 + 1];
+			if (count > 0)
+				mStats.NonEmptyTileNum++;
+			mStats.MaxEntryNum = max(mStats.MaxEntryNum, count);
+		}
+		rowOffset += (UINT)mRowIndices[r].size();
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	mStats.ObjectNum = mObjectNum;
+	mStats.TileNum = mTileNum * mTileNum;
+	mStats.TotalEntryNum = (int)totalNum;
+	mStats.AverageEntryNum = mStats.NonEmptyTileNum > 0 ? (float)totalNum / (float)mStats.NonEmptyTileNum : 0.0f;
+	mStats.BuildTime = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+void GRiSdfTileCuller::BuildRow(int row)
+{
+	auto& rowIndices = mRowIndices[row];
+	rowIndices.clear();
+
+	int paddedNum = (int)mUMin.size();
+
+	// Gather objects overlapping the row.
+	__m128 rowMin = _mm_set1_ps(mGrid.Origin[1] + row * mGrid.TileSize);
+	__m128 rowMax = _mm_set1_ps(mGrid.Origin[1] + (row + 1) * mGrid.TileSize);
+
+	std::vector<UINT> candidates;
+	for (auto i = 0; i < paddedNum; i += 4)
+	{
+		__m128 overlap = _mm_and_ps(
+			_mm_cmple_ps(_mm_loadu_ps(&mVMin[i]), rowMax),
+			_mm_cmpge_ps(_mm_loadu_ps(&mVMax[i]), rowMin));
+		int mask = _mm_movemask_ps(overlap);
+		while (mask)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			candidates.push_back(i + bit);
+			mask &= mask - 1;
+		}
+	}
+
+	int candNum = (int)candidates.size();
+	int paddedCandNum = (candNum + 3) & ~3;
+	std::vector<float> candUMin(paddedCandNum, GGiEngineUtil::Infinity);
+	std::vector<float> candUMax(paddedCandNum, -GGiEngineUtil::Infinity);
+	for (auto i = 0; i < candNum; i++)
+	{
+		candUMin[i] = mUMin[candidates[i]];
+		candUMax[i] = mUMax[candidates[i]];
+	}
+
+	// Test the candidates against every tile of the row.
+	for (auto c = 0; c < mTileNum; c++)
+	{
+		auto tile = row * mTileNum + c;
+		UINT offset = (UINT)rowIndices.size();
+
+		__m128 tileMin = _mm_set1_ps(mGrid.Origin[0] + c * mGrid.TileSize);
+		__m128 tileMax = _mm_set1_ps(mGrid.Origin[0] + (c + 1) * mGrid.TileSize);
+
+		for (auto i = 0; i < paddedCandNum; i += 4)
+		{
+			__m128 overlap = _mm_and_ps(
+				_mm_cmple_ps(_mm_loadu_ps(&candUMin[i]), tileMax),
+				_mm_cmpge_ps(_mm_loadu_ps(&candUMax[i]), tileMin));
+			int mask = _mm_movemask_ps(overlap);
+			while (mask)
+			{
+				unsigned long bit;
+				_BitScanForward(&bit, mask);
+				rowIndices.push_back(candidates[i + bit]);
+				mask &= mask - 1;
+			}
+		}
+
+		mTileRanges[tile * 2] = offset;
+		mTileRanges[tile * 2 + 1] = (UINT)rowIndices.size() - offset;
+	}
+}
+
+const GRiSdfTileGrid& GRiSdfTileCuller::GetGrid()
+{
+	return mGrid;
+}
+
+const std::vector<UINT>& GRiSdfTileCuller::GetTileRanges()
+{
+	return mTileRanges;
+}
+
+const std::vector<UINT>& GRiSdfTileCuller::GetObjectIndices()
+{
+	return mObjectIndices;
+}
+
+GRiSdfTileCullerStats GRiSdfTileCuller::GetStats()
+{
+	return mStats;
+}
+
+int GRiSdfTileCuller::GetTileIndex(float x, float y, float z)
+{
+	float pu = x * mGrid.AxisU[0] + y * mGrid.AxisU[1] + z * mGrid.AxisU[2];
+	float pv = x * mGrid.AxisV[0] + y * mGrid.AxisV[1] + z * mGrid.AxisV[2];
+	int c = (int)floorf((pu - mGrid.Origin[0]) / mGrid.TileSize);
+	int r = (int)floorf((pv - mGrid.Origin[1]) / mGrid.TileSize);
+	if (c < 0 || c >= mTileNum || r < 0 || r >= mTileNum)
+		return -1;
+	return r * mTileNum + c;
+}
@@ -0,0 +1,309 @@
+#include "stdafx.h"
+#include "GRiTlsfAllocator.h"
+
+
+void GRiTlsfAllocator::Init(UINT capacity)
+{
+	mCapacity = capacity;
+	mUsedSize = 0;
+	mAllocationNum = 0;
+
+	mBlocks.clear();
+	mUnusedBlocks = InvalidBlock;
+
+	mFlBitmap = 0;
+	for (auto fl = 0u; fl < FlNum; fl++)
+	{
+		mSlBitmaps[fl] = 0;
+		for (auto sl = 0u; sl < SlNum; sl++)
+			mBins[fl][sl] = InvalidBlock;
+	}
+
+	if (capacity == 0)
+		return;
+
+	// The first block always starts at offset 0, merges never release it.
+	UINT block = NewBlock();
+	mBlocks[block].Offset = 0;
+	mBlocks[block].Size = capacity;
+	InsertFree(block);
+}
+
+UINT GRiTlsfAllocator::Allocate(UINT size)
+{
+	if (size == 0)
+		size = 1;
+
+	UINT fl, sl;
+	if (!MapSearch(size, fl, sl))
+		return InvalidBlock;
+
+	UINT block = FindFree(fl, sl);
+	if (block == InvalidBlock)
+		return InvalidBlock;
+
+	RemoveFree(block);
+
+	// Return the tail to the free bins.
+	if (mBlocks[block].Size > size)
+	{
+		UINT remainder = NewBlock();
+		mBlocks[remainder].Offset = mBlocks[block].Offset + size;
+		mBlocks[remainder].Size = mBlocks[block].Size - size;
+		mBlocks[remainder].PrevPhysical = block;
+		mBlocks[remainder].NextPhysical = mBlocks[block].NextPhysical;
+		if (mBlocks[block].NextPhysical != InvalidBlock)
+			mBlocks[mBlocks[block].NextPhysical].PrevPhysical = remainder;
+		mBlocks[block].NextPhysical = remainder;
+		mBlocks[block].Size = size;
+		InsertFree(remainder);
+	}
+
+	mUsedSize += mBlocks[block].Size;
+	mAllocationNum++;
+	return block;
+}
+
+void GRiTlsfAllocator::Free(UINT block)
+{
+	if (block >= mBlocks.size() || !mBlocks[block].bUsed || mBlocks[block].bFree)
+		ThrowGGiException("Freeing an invalid tlsf block.");
+
+	mUsedSize -= mBlocks[block].Size;
+	mAllocationNum--;
+
+	UINT prev = mBlocks[block].PrevPhysical;
+	if (prev != InvalidBlock && mBlocks[prev].bFree)
+	{
+		RemoveFree(prev);
+		mBlocks[prev].Size += mBlocks[block].Size;
+		mBlocks[prev].NextPhysical = mBlocks[block].NextPhysical;
+		if (mBlocks[block].NextPhysical != InvalidBlock)
+			mBlocks[mBlocks[block].NextPhysical].PrevPhysical = prev;
+		ReleaseBlock(block);
+		block = prev;
+	}
+
+	UINT next = mBlocks[block].NextPhysical;
+	if (next != InvalidBlock && mBlocks[next].bFree)
+	{
+		RemoveFree(next);
+		mBlocks[block].Size += mBlocks[next].Size;
+		mBlocks[block].NextPhysical = mBlocks[next].NextPhysical;
+		if (mBlocks[next].NextPhysical != InvalidBlock)
+			mBlocks[mBlocks[next].NextPhysical].PrevPhysical = block;
+		ReleaseBlock(next);
+	}
+
+	InsertFree(block);
+}
+
+UINT GRiTlsfAllocator::GetOffset(UINT block)
+{
+	return mBlocks[block].Offset;
+}
+
+UINT GRiTlsfAllocator::GetSize(UINT block)
+{
+	return mBlocks[block].Size;
+}
+
+UINT GRiTlsfAllocator::GetCapacity()
+{
+	return mCapacity;
+}
+
+UINT GRiTlsfAllocator::GetUsedSize()
+{
+	return mUsedSize;
+}
+
+UINT GRiTlsfAllocator::GetAllocationNum()
+{
+	return mAllocationNum;
+}
+
+void GRiTlsfAllocator::MapInsert(UINT size, UINT& fl, UINT& sl)
+{
+	if (size < SlNum)
+	{
+		fl = 0;
+		sl = size;
+		return;
+	}
+
+	unsigned long msb;
+	_BitScanReverse(&msb, size);
+	sl = (size >> (msb - SlBits)) - SlNum;
+	fl = (UINT)msb - SlBits + 1;
+}
+
+bool GRiTlsfAllocator::MapSearch(UINT size, UINT& fl, UINT& sl)
+{
+	// Round up to the next subclass boundary, so that every block of the class found is large enough.
+	if (size >= SlNum)
+	{
+		unsigned long msb;
+		_BitScanReverse(&msb, size);
+		UINT round = (1u << (msb - SlBits)) - 1;
+		if (size > (UINT)-1 - round)
+			return false;
+		size += round;
+	}
+
+	MapInsert(size, fl, sl);
+	return true;
+}
+
+UINT GRiTlsfAllocator::NewBlock()
+{
+	UINT block;
+	if (mUnusedBlocks != InvalidBlock)
+	{
+		block = mUnusedBlocks;
+		mUnusedBlocks = mBlocks[block].NextFree;
+		mBlocks[block] = GRiTlsfBlock();
+	}
+	else
+	{
+		block = (UINT)mBlocks.size();
+		mBlocks.push_back(GRiTlsfBlock());
+	}
+	mBlocks[block].bUsed = true;
+	return block;
+}
+
+void GRiTlsfAllocator::ReleaseBlock(UINT block)
+{
+	mBlocks[block].bUsed = false;
+	mBlocks[block].bFree = false;
+	mBlocks[block].NextFree = mUnusedBlocks;
+	mUnusedBlocks = block;
+}
+
+void GRiTlsfAllocator::InsertFree(UINT block)
+{
+	UINT fl, sl;
+	MapInsert(mBlocks[block].Size, fl, sl);
+
+	UINT head = mBins[fl][sl];
+	mBlocks[block].bFree = true;
+	mBlocks[block].PrevFree = InvalidBlock;
+	mBlocks[block].NextFree = head;
+	if (head != InvalidBlock)
+		mBlocks[head].PrevFree = block;
+	mBins[fl][sl] = block;
+
+	mFlBitmap |= 1u << fl;
+	mSlBitmaps[fl] |= 1u << sl;
+}
+
+void GRiTlsfAllocator::RemoveFree(UINT block)
+{
+	UINT fl, sl;
+	MapInsert(mBlocks[block].Size, fl, sl);
+
+	UINT prev = mBlocks[block].PrevFree;
+	UINT next = mBlocks[block].NextFree;
+	if (prev != InvalidBlock)
+		mBlocks[prev].NextFree = next;
+	else
+		mBins[fl][sl] = next;
+	if (next != InvalidBlock)
+		mBlocks[next].PrevFree = prev;
+
+	if (mBins[fl][sl] == InvalidBlock)
+	{
+		mSlBitmaps[fl] &= ~(1u << sl);
+		if (mSlBitmaps[fl] == 0)
+			mFlBitmap &= ~(1u << fl);
+	}
+
+	mBlocks[block].bFree = false;
+	mBlocks[block].PrevFree = InvalidBlock;
+	mBlocks[block].NextFree = InvalidBlock;
+}
+
+UINT GRiTlsfAllocator::FindFree(UINT fl, UINT sl)
+{
+	unsigned long bit;
+
+	// A larger subclass of the same class first, then the smallest larger class.
+	UINT slMap = mSlBitmaps[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		if (fl + 1 >= FlNum)
+			return InvalidBlock;
+		UINT flMap = mFlBitmap & (~0u << (fl + 1));
+		if (flMap == 0)
+			return InvalidBlock;
+		_BitScanForward(&bit, flMap);
+		fl = (UINT)bit;
+		slMap = mSlBitmaps[fl];
+	}
+
+	_BitScanForward(&bit, slMap);
+	return mBins[fl][bit];
+}
+
+bool GRiTlsfAllocator::Validate()
+{
+	if (mCapacity == 0)
+		return mBlocks.size() == 0;
+
+	// Walk the range.
+	UINT offset = 0;
+	UINT usedSize = 0;
+	UINT allocationNum = 0;
+	UINT freeNum = 0;
+	UINT prev = InvalidBlock;
+	for (UINT block = 0; block != InvalidBlock; block = mBlocks[block].NextPhysical)
+	{
+		auto& b = mBlocks[block];
+		if (!b.bUsed || b.Size == 0 || b.Offset != offset || b.PrevPhysical != prev)
+			return false;
+		if (b.bFree)
+		{
+			if (prev != InvalidBlock && mBlocks[prev].bFree)
+				return false;
+			freeNum++;
+		}
+		else
+		{
+			usedSize += b.Size;
+			allocationNum++;
+		}
+		offset += b.Size;
+		prev = block;
+	}
+	if (offset != mCapacity || usedSize != mUsedSize || allocationNum != mAllocationNum)
+		return false;
+
+	// Walk the bins.
+	UINT binnedNum = 0;
+	for (auto fl = 0u; fl < FlNum; fl++)
+	{
+		for (auto sl = 0u; sl < SlNum; sl++)
+		{
+			bool bNonEmpty = mBins[fl][sl] != InvalidBlock;
+			if (bNonEmpty != ((mSlBitmaps[fl] & (1u << sl)) != 0))
+				return false;
+
+			UINT prevFree = InvalidBlock;
+			for (UINT block = mBins[fl][sl]; block != InvalidBlock; block = mBlocks[block].NextFree)
+			{
+				auto& b = mBlocks[block];
+				UINT blockFl, blockSl;
+				MapInsert(b.Size, blockFl, blockSl);
+				if (!b.bUsed || !b.bFree || b.PrevFree != prevFree || blockFl != fl || blockSl != sl)
+					return false;
+				binnedNum++;
+				prevFree = block;
+			}
+		}
+		if ((mSlBitmaps[fl] != 0) != ((mFlBitmap & (1u << fl)) != 0))
+			return false;
+	}
+
+	return binnedNum == freeNum;
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiBoundingBox.h"
+#include "GRiRay.h"
+
+class GRiSceneObject;
+
+
+// Nodes are stored depth-first, so the first child of an interior node directly follows it
+// and every child has a larger index than its parent.
+struct GRiBvhNode
+{
+	float BoundMin[3];
+	float BoundMax[3];
+
+	// Leaf: first entry in the primitive index array. Interior: index of the second child.
+	int Offset;
+
+	// Primitive count, 0 for interior nodes.
+	int Count;
+};
+
+// Binned SAH bounding volume hierarchy over axis aligned primitive bounds.
+class GRiBvh
+{
+
+public:
+
+	GRiBvh() = default;
+	~GRiBvh() = default;
+
+	// boundMin and boundMax hold 3 floats per primitive.
+	void Build(const std::vector<float>& boundMin, const std::vector<float>& boundMax, int maxLeafPrims);
+
+	// Adopts a tree built earlier, e.g. one loaded from a cooked mesh.
+	void Load(const GRiBvhNode* nodes, int nodeNum, const UINT* primitiveIndices, int primitiveNum);
+
+	// Recomputes node bounds bottom-up without changing the topology.
+	void Refit(const std::vector<float>& boundMin, const std::vector<float>& boundMax);
+
+	// Summed surface area of the interior nodes relative to the root, grows as refits loosen the tree.
+	float GetCost();
+
+	const std::vector<GRiBvhNode>& GetNodes();
+
+	const std::vector<UINT>& GetPrimitiveIndices();
+
+	static bool IntersectBound(const GRiBvhNode& node, const float* origin, const float* invDir, float tMax, float& tNear);
+
+private:
+
+	std::vector<GRiBvhNode> mNodes;
+
+	std::vector<UINT> mPrimitiveIndices;
+
+	int BuildNode(const std::vector<float>& boundMin, const std::vector<float>& boundMax, std::vector<float>& centroids, int start, int end, int maxLeafPrims, int depth);
+
+};
+
+// Bottom level structure over the triangles of a mesh, in mesh local space.
+class GRiMeshBvh
+{
+
+public:
+
+	GRiMeshBvh() = default;
+	GRiMeshBvh(const GRiMeshBvh& rhs) = delete;
+	GRiMeshBvh& operator=(const GRiMeshBvh& rhs) = delete;
+	~GRiMeshBvh() = default;
+
+	// positions holds 3 floats per vertex, indices holds 3 vertex indices per triangle.
+	void Build(std::vector<float> positions, std::vector<UINT> indices);
+
+	// Same as Build() with a tree built earlier over the same triangles.
+	void Load(std::vector<float> positions, std::vector<UINT> indices, const GRiBvhNode* nodes, int nodeNum, const UINT* primitiveIndices, int primitiveNum);
+
+	// Nearest hit within ray.tMax. The ray direction doesn't need to be normalized, tHit is in units of it.
+	bool Intersect(const GRiRay& ray, float& tHit, UINT& triangleIndex);
+
+	GRiBoundingBox GetBounds();
+
+	int GetTriangleNum();
+
+	const std::vector<GRiBvhNode>& GetNodes();
+
+	const std::vector<UINT>& GetPrimitiveIndices();
+
+private:
+
+	std::vector<float> mPositions;
+
+	std::vector<UINT> mIndices;
+
+	GRiBvh mBvh;
+
+	bool IntersectTriangle(UINT tri, const float* origin, const float* dir, float tMax, float& t);
+
+};
+
+struct GRiRayHit
+{
+	GRiSceneObject* SceneObject = nullptr;
+
+	// Along the query ray, in world units if its direction is normalized.
+	float Distance = 0.0f;
+
+	float Position[3] = { 0.0f, 0.0f, 0.0f };
+
+	UINT TriangleIndex = 0;
+};
+
+struct GRiSceneBvhInstance
+{
+	GRiSceneObject* SceneObject = nullptr;
+
+	GRiMeshBvh* MeshBvh = nullptr;
+
+	float World[4][4];
+	float InvWorld[4][4];
+
+	// World space bounds.
+	float BoundMin[3];
+	float BoundMax[3];
+};
+
+// Top level structure over scene objects referencing the bottom level structure of their meshes.
+// Moving objects only refits the tree, it is rebuilt when the object set changes or the refitted tree degrades.
+class GRiSceneBvh
+{
+
+public:
+
+	GRiSceneBvh() = default;
+	GRiSceneBvh(const GRiSceneBvh& rhs) = delete;
+	GRiSceneBvh& operator=(const GRiSceneBvh& rhs) = delete;
+	~GRiSceneBvh() = default;
+
+	// Objects whose mesh has no bottom level structure are skipped.
+	void Update(const std::vector<GRiSceneObject*>& sceneObjects);
+
+	// Nearest hit within ray.tMax.
+	bool Raycast(const GRiRay& ray, GRiRayHit& hit);
+
+	// Nearest hit of every object within ray.tMax, sorted by distance.
+	std::vector<GRiRayHit> RaycastAll(const GRiRay& ray);
+
+	// Objects whose world bounds overlap the box.
+	std::vector<GRiSceneObject*> Overlap(const GRiBoundingBox& box);
+
+	int GetInstanceNum();
+
+private:
+
+	std::vector<GRiSceneBvhInstance> mInstances;
+
+	std::vector<float> mBoundMin;
+	std::vector<float> mBoundMax;
+
+	GRiBvh mBvh;
+
+	// Cost of the tree when it was last built.
+	float mBuildCost = 0.0f;
+
+	bool IntersectInstance(const GRiSceneBvhInstance& inst, const GRiRay& ray, float tMax, GRiRayHit& hit);
+
+};
+
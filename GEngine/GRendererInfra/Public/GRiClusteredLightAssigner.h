@@ -0,0 +1,137 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiPointLight.h"
+#include "GRiLightBvh.h"
+
+
+struct GRiClusteredLightStats
+{
+	UINT LightNum = 0;
+	UINT ClusterNum = 0;
+	UINT NonEmptyClusterNum = 0;
+	UINT TotalIndexNum = 0;
+	UINT MaxClusterLightNum = 0;
+
+	// Milliseconds, AssignTime includes BvhUpdateTime.
+	float AssignTime = 0.0f;
+	float BvhUpdateTime = 0.0f;
+};
+
+// Cpu version of the light assignment of ClusteredDeferredCS. The screen is split into tiles of tileSizeX by
+// tileSizeY pixels and the view depth into slices, every point light is tested against the frustum of every
+// cluster with the same planes the compute shader derives from the projection matrix. Lists have no fixed
+// capacity: every cluster gets an (offset, count) pair into one packed index list. With the light bvh enabled
+// every tile row only tests the lights the bvh returns for its frustum instead of all of them.
+class GRiClusteredLightAssigner
+{
+
+public:
+
+	GRiClusteredLightAssigner() = default;
+	GRiClusteredLightAssigner(const GRiClusteredLightAssigner& rhs) = delete;
+	GRiClusteredLightAssigner& operator=(const GRiClusteredLightAssigner& rhs) = delete;
+	~GRiClusteredLightAssigner() = default;
+
+	// sliceDepths holds the sliceNum + 1 view depths bounding the slices, nearest first.
+	void Init(UINT tileSizeX, UINT tileSizeY, const float* sliceDepths, UINT sliceNum);
+
+	// The lists are the same either way. Off by default.
+	void SetLightBvhEnabled(bool bEnabled);
+
+	// projScaleX and projScaleY are _11 and _22 of the projection matrix, the light indices are indices into lights.
+	// Slices, or tile rows with the light bvh, are assigned in parallel.
+	void Assign(GGiThreadPool* tp, UINT width, UINT height, GGiFloat4x4 view, float projScaleX, float projScaleY, const GRiPointLight* lights, UINT lightNum);
+
+	UINT GetTileNumX();
+	UINT GetTileNumY();
+	UINT GetClusterNum();
+
+	// (offset, count) pairs into GetLightIndices(), indexed by (tileY * tileNumX + tileX) * sliceNum + slice like
+	// the light lists of the compute shader.
+	const std::vector<UINT>& GetClusterRanges();
+
+	const std::vector<UINT>& GetLightIndices();
+
+	GRiClusteredLightStats GetStats();
+
+private:
+
+	UINT mTileSizeX = 1;
+	UINT mTileSizeY = 1;
+	UINT mTileNumX = 0;
+	UINT mTileNumY = 0;
+	UINT mSliceNum = 0;
+
+	std::vector<float> mSliceDepths;
+
+	float mView[4][3];
+
+	// Side planes (x, y, z) in view space, the plane offsets are 0. Columns get a left and a right plane, rows a
+	// bottom and a top plane.
+	std::vector<float> mColumnPlanes;
+	std::vector<float> mRowPlanes;
+
+	// View space light spheres, padded to a multiple of 4 with negative infinite radii.
+	std::vector<float> mLightX;
+	std::vector<float> mLightY;
+	std::vector<float> mLightZ;
+	std::vector<float> mLightRadius;
+	UINT mLightNum = 0;
+
+	struct GRiClusterSlice
+	{
+		// Lights overlapping the slice depth range, gathered 4-wide.
+		std::vector<UINT> Candidates;
+		std::vector<float> CandidateX;
+		std::vector<float> CandidateY;
+		std::vector<float> CandidateZ;
+		std::vector<float> CandidateRadius;
+		std::vector<int> RowMasks;
+
+		// (offset, count) into Indices per tile, row major.
+		std::vector<UINT> TileRanges;
+		std::vector<UINT> Indices;
+	};
+
+	std::vector<GRiClusterSlice> mSlices;
+
+	struct GRiClusterRow
+	{
+		// Lights the bvh returns for the frustum of the row that pass its planes, in light order and gathered
+		// 4-wide, with the slices they overlap.
+		std::vector<UINT> Candidates;
+		std::vector<UINT> CandidateMask;
+		std::vector<float> CandidateX;
+		std::vector<float> CandidateY;
+		std::vector<float> CandidateZ;
+		std::vector<float> CandidateRadius;
+		std::vector<UINT> FirstSlices;
+		std::vector<UINT> LastSlices;
+
+		// Candidates inside the current tile.
+		std::vector<UINT> TileCandidates;
+		std::vector<UINT> SliceCounts;
+
+		// (offset, count) into Indices per cluster of the row, in cluster order.
+		std::vector<UINT> ClusterRanges;
+		std::vector<UINT> Indices;
+	};
+
+	std::vector<GRiClusterRow> mRows;
+
+	GRiLightBvh mLightBvh;
+	bool bUseLightBvh = false;
+
+	std::vector<UINT> mClusterRanges;
+	std::vector<UINT> mLightIndices;
+
+	GRiClusteredLightStats mStats;
+
+	void BuildPlanes(UINT width, UINT height, float projScaleX, float projScaleY);
+
+	void AssignSlice(UINT slice);
+
+	void AssignTileRow(UINT tileY);
+
+};
+
@@ -0,0 +1,59 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// Contiguous items of a pass recorded into one command list.
+struct GRiCommandListChunk
+{
+	UINT FirstItem = 0;
+	UINT ItemNum = 0;
+};
+
+// Command lists a pass is recorded into, implemented by the renderer around its api command lists.
+// Every list is only ever touched by one thread at a time.
+class GRiCommandListRecorder
+{
+
+public:
+
+	virtual ~GRiCommandListRecorder() = default;
+
+	// Opens the list and sets up the state of the pass.
+	virtual void BeginList(UINT listIndex) = 0;
+
+	virtual void RecordItems(UINT listIndex, UINT firstItem, UINT itemNum) = 0;
+
+	// Closes the list.
+	virtual void EndList(UINT listIndex) = 0;
+
+};
+
+// Splits the items of a pass into contiguous chunks and records every chunk into its own command list on the
+// thread pool. List i holds chunk i, so submitting the lists in index order keeps the items in order.
+class GRiCommandListScheduler
+{
+
+public:
+
+	GRiCommandListScheduler() = default;
+	GRiCommandListScheduler(const GRiCommandListScheduler& rhs) = delete;
+	GRiCommandListScheduler& operator=(const GRiCommandListScheduler& rhs) = delete;
+	~GRiCommandListScheduler() = default;
+
+	// Uses at most maxListNum lists, and only as many as give every list at least minItemNum items.
+	// Chunk sizes differ by one item at most.
+	void Schedule(UINT itemNum, UINT maxListNum, UINT minItemNum);
+
+	const std::vector<GRiCommandListChunk>& GetChunks();
+
+	UINT GetListNum();
+
+	// Records every chunk into its list, on the thread pool if there is one. Returns once every list is closed.
+	void Record(GGiThreadPool* tp, GRiCommandListRecorder* recorder);
+
+private:
+
+	std::vector<GRiCommandListChunk> mChunks;
+
+};
+
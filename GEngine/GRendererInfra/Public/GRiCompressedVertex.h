@@ -0,0 +1,64 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiVertex.h"
+
+
+// 20 byte vertex of the compressed input layout, should be the same with VertexInput in DefaultVS.hlsl:
+// R16G16B16A16_UNORM position, R16G16_FLOAT uv, R16G16_SNORM octahedral normal and tangent. Only the gpu copy is
+// compressed, the system memory copy of a mesh stays 44 byte GRiVertex.
+struct GRiCompressedVertex
+{
+	// Relative to the bounds of the mesh, see GRiVertexQuantization. w is the tangent sign, 0 for -1 and 65535 for +1,
+	// the bitangent is cross(normal, tangent) * sign.
+	UINT16 Position[4];
+
+	// Half floats.
+	UINT16 UV[2];
+
+	INT16 Normal[2];
+	INT16 TangentU[2];
+};
+
+// Decoded position = Offset + Scale * unorm position.
+struct GRiVertexQuantization
+{
+	float Offset[3] = { 0.0f, 0.0f, 0.0f };
+	float Scale[3] = { 1.0f, 1.0f, 1.0f };
+};
+
+// Largest differences between vertices and their decoded compressed versions.
+struct GRiVertexCompressionError
+{
+	float Position = 0.0f;
+	float UV = 0.0f;
+
+	// Degrees.
+	float Normal = 0.0f;
+	float TangentU = 0.0f;
+};
+
+class GRiVertexCompressor
+{
+
+public:
+
+	// Fits the quantization to the bounds of the vertices.
+	static GRiVertexQuantization ComputeQuantization(const GRiVertex* vertices, UINT vertexNum);
+
+	// tangentSigns are +1 or -1 per vertex, see GRiMeshData::ComputeTangentSigns, all +1 without them.
+	static void Encode(const GRiVertex* vertices, UINT vertexNum, const GRiVertexQuantization& quantization, GRiCompressedVertex* outVertices, const float* tangentSigns = nullptr);
+
+	// Same math as the decode in DefaultVS.hlsl.
+	static void Decode(const GRiCompressedVertex* vertices, UINT vertexNum, const GRiVertexQuantization& quantization, GRiVertex* outVertices, float* outTangentSigns = nullptr);
+
+	static UINT16 FloatToHalf(float value);
+	static float HalfToFloat(UINT16 value);
+
+	// Unit vector to the two snorm components of its octahedral mapping, rounded to the closest decodable vector.
+	static void EncodeOctahedral(const float* vector, INT16* outOctahedral);
+	static void DecodeOctahedral(const INT16* octahedral, float* outVector);
+
+	static GRiVertexCompressionError MeasureError(const GRiVertex* vertices, UINT vertexNum);
+
+};
+
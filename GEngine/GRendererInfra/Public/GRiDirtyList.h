@@ -0,0 +1,75 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// Unordered list of the items that changed and still have copies to refresh, e.g. one per frame resource.
+// Every item owns its slot in the list (-1 while not queued), so queueing, unqueueing and draining cost O(1)
+// per item and the renderer only visits what changed instead of the whole scene. Not thread safe.
+template<typename T>
+class GRiDirtyList
+{
+
+public:
+
+	GRiDirtyList() = default;
+	GRiDirtyList(const GRiDirtyList& rhs) = delete;
+	GRiDirtyList& operator=(const GRiDirtyList& rhs) = delete;
+	~GRiDirtyList() = default;
+
+	// Does nothing if the item is queued already.
+	void Add(T* item, int* slot)
+	{
+		if (*slot >= 0)
+			return;
+
+		*slot = (int)mItems.size();
+		mItems.push_back(item);
+		mSlots.push_back(slot);
+	}
+
+	// Does nothing if the item isn't queued.
+	void Remove(int* slot)
+	{
+		int index = *slot;
+		if (index < 0)
+			return;
+
+		// Move the last item into the hole.
+		int last = (int)mItems.size() - 1;
+		mItems[index] = mItems[last];
+		mSlots[index] = mSlots[last];
+		*mSlots[index] = index;
+		mItems.pop_back();
+		mSlots.pop_back();
+		*slot = -1;
+	}
+
+	// Calls update(item) once for every queued item, the ones it returns false for are unqueued. Items queued
+	// by update() itself are visited in the same pass.
+	template<typename F>
+	void Drain(F update)
+	{
+		size_t i = 0;
+		while (i < mItems.size())
+		{
+			if (update(mItems[i]))
+				i++;
+			else
+				Remove(mSlots[i]);
+		}
+	}
+
+	UINT GetNum()
+	{
+		return (UINT)mItems.size();
+	}
+
+private:
+
+	std::vector<T*> mItems;
+
+	// Points at the slot member of the item with the same index.
+	std::vector<int*> mSlots;
+
+};
+
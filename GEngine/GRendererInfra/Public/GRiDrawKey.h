@@ -0,0 +1,38 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// 64 bit sort key of a submesh draw, most significant field first:
+// layer (4 bits) | pipeline state (8 bits) | mesh (16 bits) | material (16 bits) | depth (20 bits).
+// Sorting by the key groups draws sharing a pipeline and vertex/index buffers into runs and orders every run
+// front to back. Ids wider than their field are wrapped, which only costs batching, never correctness.
+class GRiDrawKey
+{
+
+public:
+
+	static const UINT LayerBits = 4;
+	static const UINT PsoBits = 8;
+	static const UINT MeshBits = 16;
+	static const UINT MaterialBits = 16;
+	static const UINT DepthBits = 20;
+
+	static const UINT DepthShift = 0;
+	static const UINT MaterialShift = DepthShift + DepthBits;
+	static const UINT MeshShift = MaterialShift + MaterialBits;
+	static const UINT PsoShift = MeshShift + MeshBits;
+	static const UINT LayerShift = PsoShift + PsoBits;
+
+	static UINT64 Encode(UINT layer, UINT pso, UINT mesh, UINT material, UINT depth);
+
+	// Maps a view space depth in [nearZ, farZ] to the depth field, out of range depths are clamped.
+	static UINT QuantizeDepth(float viewDepth, float nearZ, float farZ);
+
+	static UINT GetLayer(UINT64 key);
+	static UINT GetPso(UINT64 key);
+	static UINT GetMesh(UINT64 key);
+	static UINT GetMaterial(UINT64 key);
+	static UINT GetDepth(UINT64 key);
+
+};
+
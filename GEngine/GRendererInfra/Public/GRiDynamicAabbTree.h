@@ -0,0 +1,99 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiBoundingBox.h"
+
+class GRiSceneObject;
+
+
+struct GRiDynamicAabbTreeNode
+{
+	// Leaves store the fattened bounds of their proxy.
+	float BoundMin[3];
+	float BoundMax[3];
+
+	GRiSceneObject* SceneObject = nullptr;
+
+	// Next free node while the node is in the free list.
+	int Parent = -1;
+
+	int Child1 = -1;
+	int Child2 = -1;
+
+	// 0 for leaves, -1 for free nodes.
+	int Height = -1;
+
+	bool IsLeaf() const
+	{
+		return Child1 == -1;
+	}
+};
+
+// Incremental bounding volume tree over scene objects, kept balanced with AVL style rotations.
+// Leaves are fattened so that small moves don't touch the tree at all.
+class GRiDynamicAabbTree
+{
+
+public:
+
+	GRiDynamicAabbTree();
+	GRiDynamicAabbTree(const GRiDynamicAabbTree& rhs) = delete;
+	GRiDynamicAabbTree& operator=(const GRiDynamicAabbTree& rhs) = delete;
+	~GRiDynamicAabbTree() = default;
+
+	// Returns the proxy id.
+	int CreateProxy(const GRiBoundingBox& bounds, GRiSceneObject* sceneObject);
+
+	void DestroyProxy(int proxyId);
+
+	// Returns true if the bounds left the fat bounds and the proxy had to be reinserted.
+	bool MoveProxy(int proxyId, const GRiBoundingBox& bounds);
+
+	GRiSceneObject* GetSceneObject(int proxyId);
+
+	// The bounds the queries test the proxy with, its last inserted bounds fattened.
+	void GetFatBounds(int proxyId, float* boundMin, float* boundMax);
+
+	void QueryBox(const GRiBoundingBox& box, std::vector<GRiSceneObject*>& result);
+
+	void QuerySphere(const float* center, float radius, std::vector<GRiSceneObject*>& result);
+
+	// A point is inside a plane (a, b, c, d) if a * x + b * y + c * z + d >= 0.
+	// Subtrees completely inside every plane are gathered without further tests.
+	void QueryFrustum(const float planes[6][4], std::vector<GRiSceneObject*>& result);
+
+	// Extracts the normalized planes of a row-vector view projection matrix with a [0, 1] depth range.
+	static void ExtractFrustumPlanes(GGiFloat4x4 viewProj, float planes[6][4]);
+
+	int GetProxyNum();
+
+	int GetHeight();
+
+	// Checks parent links, heights and that every interior node contains its children.
+	bool Validate();
+
+private:
+
+	std::vector<GRiDynamicAabbTreeNode> mNodes;
+
+	int mRoot = -1;
+
+	int mFreeList = -1;
+
+	int mProxyNum = 0;
+
+	int AllocateNode();
+
+	void FreeNode(int nodeId);
+
+	void InsertLeaf(int leaf);
+
+	void RemoveLeaf(int leaf);
+
+	int Balance(int iA);
+
+	void UpdateNode(int nodeId);
+
+	void GatherSubtree(int nodeId, std::vector<GRiSceneObject*>& result, std::vector<int>& stack);
+
+};
+
@@ -0,0 +1,90 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// Same member order as the indexed draw arguments of the graphics apis, so it can be copied over as is.
+struct GRiDrawIndexedArguments
+{
+	UINT IndexCountPerInstance = 0;
+	UINT InstanceCount = 1;
+	UINT StartIndexLocation = 0;
+	INT BaseVertexLocation = 0;
+	UINT StartInstanceLocation = 0;
+};
+
+// One draw to be written as an indirect command.
+struct GRiIndirectDraw
+{
+	// Commands are grouped by pipeline, every group is submitted separately.
+	UINT PipelineIndex = 0;
+
+	UINT64 ConstantBufferAddress = 0;
+	UINT RootConstants[4] = {};
+
+	GRiDrawIndexedArguments DrawArguments;
+};
+
+// Byte layout of one command in the argument buffer, given by the command signature of the renderer.
+struct GRiIndirectCommandLayout
+{
+	static const UINT InvalidOffset = (UINT)-1;
+
+	UINT Stride = 0;
+
+	// Offsets of the fields in a command, InvalidOffset for fields the signature doesn't have.
+	UINT ConstantBufferOffset = InvalidOffset;
+	UINT RootConstantOffset = InvalidOffset;
+	UINT RootConstantNum = 0;
+	UINT DrawArgumentsOffset = 0;
+};
+
+// Commands of one pipeline in the argument buffer.
+struct GRiIndirectCommandRange
+{
+	UINT PipelineIndex = 0;
+	UINT FirstCommand = 0;
+	UINT CommandNum = 0;
+};
+
+// Writes draws into an indirect argument buffer laid out by a command layout, grouped by pipeline so that every
+// pipeline takes a single indirect submission. Draws keep their submission order within a pipeline.
+// Only memory is written, the buffer can be a mapped upload buffer as well as plain memory.
+class GRiIndirectArgumentBuilder
+{
+
+public:
+
+	GRiIndirectArgumentBuilder() = default;
+	GRiIndirectArgumentBuilder(const GRiIndirectArgumentBuilder& rhs) = delete;
+	GRiIndirectArgumentBuilder& operator=(const GRiIndirectArgumentBuilder& rhs) = delete;
+	~GRiIndirectArgumentBuilder() = default;
+
+	void SetLayout(const GRiIndirectCommandLayout& layout);
+
+	// Writes one command per draw to dst, which has to hold maxCommandNum commands. Draws are counted and written
+	// in chunks on the thread pool if there is one and there are enough of them.
+	void Build(GGiThreadPool* tp, const std::vector<GRiIndirectDraw>& draws, UINT pipelineNum, void* dst, UINT maxCommandNum);
+
+	// Non empty pipelines in pipeline order.
+	const std::vector<GRiIndirectCommandRange>& GetRanges();
+
+	// Draw index of every command.
+	const std::vector<UINT>& GetCommandDraws();
+
+private:
+
+	// Below this many draws a single chunk is written on the calling thread.
+	static const UINT ParallelThreshold = 1024;
+
+	GRiIndirectCommandLayout mLayout;
+
+	// Pipeline counters per chunk, turned into command offsets.
+	std::vector<UINT> mHistograms;
+
+	std::vector<GRiIndirectCommandRange> mRanges;
+	std::vector<UINT> mCommandDraws;
+
+	void WriteCommand(UINT8* command, const GRiIndirectDraw& draw);
+
+};
+
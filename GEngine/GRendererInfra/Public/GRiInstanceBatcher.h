@@ -0,0 +1,57 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiRadixSort.h"
+
+
+// Draws that can be merged into one instanced draw.
+struct GRiInstanceBatch
+{
+	UINT64 Key = 0;
+
+	// Range of the batch in GetInstanceItems(), which is also its range in the packed instance data.
+	UINT FirstInstance = 0;
+	UINT InstanceNum = 0;
+};
+
+// Groups draws sharing a batch key into instance batches and lays their instances out contiguously.
+// Instances keep the order the draws were submitted in, so a depth sorted submission stays front to back
+// within every batch.
+class GRiInstanceBatcher
+{
+
+public:
+
+	GRiInstanceBatcher() = default;
+	GRiInstanceBatcher(const GRiInstanceBatcher& rhs) = delete;
+	GRiInstanceBatcher& operator=(const GRiInstanceBatcher& rhs) = delete;
+	~GRiInstanceBatcher() = default;
+
+	// Draws can only be instanced together if they share the topology, vertex and index buffers, submesh and material.
+	static UINT64 MakeBatchKey(UINT topology, UINT mesh, UINT submesh, UINT material);
+
+	// Groups the draws by key. Batches with fewer than minInstanceNum instances are left out and their draws are
+	// reported by GetSingleItems() instead. At most maxInstanceNum instances are batched, the remaining draws
+	// become single draws too.
+	void Build(GGiThreadPool* tp, const std::vector<UINT64>& keys, UINT minInstanceNum, UINT maxInstanceNum);
+
+	const std::vector<GRiInstanceBatch>& GetBatches();
+
+	// Draw indices in instance order.
+	const std::vector<UINT>& GetInstanceItems();
+
+	// Draw indices left out of every batch, in submission order.
+	const std::vector<UINT>& GetSingleItems();
+
+private:
+
+	GRiRadixSort mSorter;
+
+	std::vector<UINT64> mSortedKeys;
+	std::vector<UINT> mSortedItems;
+
+	std::vector<GRiInstanceBatch> mBatches;
+	std::vector<UINT> mInstanceItems;
+	std::vector<UINT> mSingleItems;
+
+};
+
@@ -0,0 +1,51 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiBvh.h"
+#include "GRiPointLight.h"
+
+
+// Bounding volume hierarchy over the bounding spheres of point lights in world space. Updating it every frame
+// refits the tree while the light count stays the same, and rebuilds it when the count changes or refitting has
+// loosened the tree too much.
+class GRiLightBvh
+{
+
+public:
+
+	GRiLightBvh() = default;
+	GRiLightBvh(const GRiLightBvh& rhs) = delete;
+	GRiLightBvh& operator=(const GRiLightBvh& rhs) = delete;
+	~GRiLightBvh() = default;
+
+	// Light bounds are computed in parallel.
+	void Update(GGiThreadPool* tp, const GRiPointLight* lights, UINT lightNum);
+
+	// Appends the indices of the lights whose bounds may overlap the convex volume, in no particular order. Planes
+	// point inwards. A box only counts as outside if it is behind a plane by more than epsilon times the magnitude
+	// of the plane equation terms, so callers can repeat the exact test in another space. Safe to call from
+	// several threads at once.
+	void Query(const float planes[][4], int planeNum, float epsilon, std::vector<UINT>& result);
+
+	UINT GetLightNum();
+
+	// Whether the last Update() rebuilt the tree instead of refitting it.
+	bool WasRebuilt();
+
+private:
+
+	std::vector<float> mBoundMin;
+	std::vector<float> mBoundMax;
+
+	GRiBvh mBvh;
+
+	// Cost of the tree when it was last built.
+	float mBuildCost = 0.0f;
+
+	UINT mLightNum = 0;
+
+	bool bRebuilt = false;
+
+	void GatherSubtree(int nodeIndex, std::vector<UINT>& result);
+
+};
+
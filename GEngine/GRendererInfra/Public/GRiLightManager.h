@@ -0,0 +1,176 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiPointLight.h"
+#include "GRiSpotlight.h"
+#include "GRiDirectionalLight.h"
+#include "GRiBoundingBox.h"
+
+
+enum class GRiLightType : int
+{
+	Point = 0,
+	Spot,
+	Directional
+};
+
+// Stable reference to a registered light, survives the removal of other lights.
+struct GRiLightHandle
+{
+	UINT Index = (UINT)-1;
+	UINT Generation = 0;
+};
+
+// [First, First + Num) of a visible light list.
+struct GRiLightRange
+{
+	UINT First = 0;
+	UINT Num = 0;
+};
+
+struct GRiLightCullingStats
+{
+	// Point lights and spotlights.
+	UINT LightNum = 0;
+	UINT VisibleNum = 0;
+
+	// Inside the frustum but hidden in the masked depth buffer, not part of VisibleNum.
+	UINT OccludedNum = 0;
+
+	// Entries of the visible lists that differ from the previous Cull().
+	UINT ChangedNum = 0;
+
+	// Milliseconds.
+	float CullTime = 0.0f;
+};
+
+// Registry of the lights of the scene. Point lights and spotlights are culled against the camera frustum with
+// their bounding spheres, 4 at a time, and the visible ones are compacted into dense lists in registration order,
+// so a light that neither changed nor moved in the list doesn't have to be uploaded again. Optionally the lights
+// inside the frustum are tested against the masked depth buffer of GRiOcclusionCullingRasterizer with the boxes
+// around their volumes, and the hidden ones are dropped as well.
+class GRiLightManager
+{
+
+public:
+
+	GRiLightManager() = default;
+	GRiLightManager(const GRiLightManager& rhs) = delete;
+	GRiLightManager& operator=(const GRiLightManager& rhs) = delete;
+	~GRiLightManager() = default;
+
+	GRiLightHandle AddPointLight(const GRiPointLight& light);
+
+	// SpotlightAngle is the half angle of the cone in radians.
+	GRiLightHandle AddSpotlight(const GRiSpotlight& light);
+
+	GRiLightHandle AddDirectionalLight(const GRiDirectionalLight& light);
+
+	// The handle has to refer to a light of the same type.
+	void SetPointLight(GRiLightHandle handle, const GRiPointLight& light);
+	void SetSpotlight(GRiLightHandle handle, const GRiSpotlight& light);
+	void SetDirectionalLight(GRiLightHandle handle, const GRiDirectionalLight& light);
+
+	void Remove(GRiLightHandle handle);
+
+	bool IsValid(GRiLightHandle handle);
+
+	GRiLightType GetType(GRiLightHandle handle);
+
+	UINT GetLightNum();
+
+	// Planes point inwards, e.g. from GRiDynamicAabbTree::ExtractFrustumPlanes(). With occlusionViewProj the
+	// masked depth buffer has to be generated for this view projection already.
+	void Cull(GGiThreadPool* tp, const float planes[6][4], __m128* occlusionViewProj = nullptr);
+
+	// As of the last Cull().
+	const std::vector<GRiPointLight>& GetVisiblePointLights();
+	const std::vector<GRiSpotlight>& GetVisibleSpotlights();
+
+	// Never culled.
+	const std::vector<GRiDirectionalLight>& GetDirectionalLights();
+
+	// Part of the visible lists that differs from the one of the previous Cull(). Entries past the end of the
+	// previous list count as changed, entries that were dropped from the end don't.
+	GRiLightRange GetChangedPointLightRange();
+	GRiLightRange GetChangedSpotlightRange();
+	bool HaveDirectionalLightsChanged();
+
+	GRiLightCullingStats GetStats();
+
+	// Volume boxes tested against the masked depth buffer by the last Cull(), with the results.
+	const std::vector<GRiBoundingBox>& GetOcclusionBounds();
+	const bool* GetOcclusionResults();
+
+private:
+
+	struct GRiLightSlot
+	{
+		GRiLightType Type = GRiLightType::Point;
+		UINT Generation = 0;
+		bool bAlive = false;
+		bool bChanged = false;
+
+		GRiPointLight Point;
+		GRiSpotlight Spot;
+		GRiDirectionalLight Directional;
+	};
+
+	std::vector<GRiLightSlot> mSlots;
+	std::vector<UINT> mFreeSlots;
+
+	// Slots changed since the last Cull().
+	std::vector<UINT> mChangedSlots;
+
+	// Bounding spheres by slot, padded to a multiple of 4. Directional lights and free slots get a negative
+	// infinite radius so they never pass the test.
+	std::vector<float> mBoundX;
+	std::vector<float> mBoundY;
+	std::vector<float> mBoundZ;
+	std::vector<float> mBoundRadius;
+
+	// Boxes around the light volumes by slot, tighter than the spheres for spotlights.
+	std::vector<GRiBoundingBox> mVolumeBounds;
+
+	float mPlanes[6][4];
+
+	// Visible slots of every cull task, in slot order.
+	std::vector<std::vector<UINT>> mTaskVisibleSlots;
+
+	// Slots inside the frustum and their boxes, in slot order, for the occlusion test.
+	std::vector<UINT> mOcclusionSlots;
+	std::vector<GRiBoundingBox> mOcclusionBounds;
+	std::unique_ptr<bool[]> mOcclusionVisible;
+	UINT mOcclusionVisibleCapacity = 0;
+
+	std::vector<UINT> mVisiblePointSlots;
+	std::vector<UINT> mVisibleSpotSlots;
+	std::vector<UINT> mPrevVisiblePointSlots;
+	std::vector<UINT> mPrevVisibleSpotSlots;
+
+	std::vector<GRiPointLight> mVisiblePointLights;
+	std::vector<GRiSpotlight> mVisibleSpotlights;
+	std::vector<GRiDirectionalLight> mDirectionalLights;
+
+	GRiLightRange mChangedPointLightRange;
+	GRiLightRange mChangedSpotlightRange;
+	bool bDirectionalLightsDirty = false;
+	bool bDirectionalLightsChanged = false;
+
+	GRiLightCullingStats mStats;
+
+	UINT AllocateSlot(GRiLightType type);
+
+	GRiLightSlot& GetSlot(GRiLightHandle handle, GRiLightType type);
+
+	void MarkChanged(UINT slot);
+
+	void SetBound(UINT slot, float x, float y, float z, float radius);
+
+	void OcclusionCull(GGiThreadPool* tp, __m128* viewProj);
+
+	void CullGroups(UINT firstGroup, UINT groupNum, std::vector<UINT>& visibleSlots);
+
+	GRiLightRange FindChangedRange(const std::vector<UINT>& prevSlots, const std::vector<UINT>& slots);
+
+};
+
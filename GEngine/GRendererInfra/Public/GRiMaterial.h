@@ -1,6 +1,7 @@
 #pragma once
 #include "GRiPreInclude.h"
 #include "GRiTexture.h"
+#include "GRiDirtyList.h"
 
 #define MATERIAL_MAX_TEXTURE_NUM 16
 #define MATERIAL_MAX_SCALAR_NUM 16
@@ -10,6 +11,7 @@ class GRiMaterial
 {
 public:
 	GRiMaterial();
+	GRiMaterial(const GRiMaterial& rhs) = delete;
 	~GRiMaterial();
 	  
 	// Unique material name for lookup.
@@ -35,8 +37,12 @@ public:
 
 	float GetScaleY();
 
+	// Resets NumFramesDirty and queues the material in GetDirtyList().
 	void MarkDirty();
 
+	// Materials with NumFramesDirty > 0, the renderer drains it once per frame resource.
+	static GRiDirtyList<GRiMaterial>& GetDirtyList();
+
 	size_t GetTextureNum();
 
 	size_t GetScalarNum();
@@ -77,5 +83,7 @@ protected:
 	std::vector<float> ScalarParams;
 	std::vector<GGiVector4> VectorParams;
 
+	int mDirtyListSlot = -1;
+
 };
 
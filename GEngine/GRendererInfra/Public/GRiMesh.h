@@ -2,13 +2,15 @@
 #include "GRiPreInclude.h"
 #include "GRiSubmesh.h"
 #include "GRiBoundingBox.h"
+#include "GRiBvh.h"
+#include "GRiMeshlet.h"
 
 
 class GRiMesh
 {
 public:
 
-	GRiMesh() = default;
+	GRiMesh();
 	//GRiMesh(const GRiMesh& rhs) = delete;
 	~GRiMesh() = default;
 
@@ -41,19 +43,47 @@ private:
 
 	std::unordered_map<std::wstring, GRiSubmesh> Submeshes;
 
+	// Unique per mesh instance, used to batch draws sharing vertex and index buffers.
+	UINT MeshId = 0;
+
+	// Bump after changing submesh materials so that renderer side caches built from them are refreshed.
+	UINT MaterialVersion = 0;
+
+	// Cooked mesh file the mesh was loaded from, empty for generated meshes. Data generated later, like the sdf,
+	// is stored there as well.
+	std::wstring CookedFile;
+
 	int GetSdfResolution();
 	void SetSdfResolution(int res);
 
+	// Edge length of the cubic volume the SDF covers, centered at the mesh origin.
+	float GetSdfExtent();
+	void SetSdfExtent(float extent);
+
 	std::shared_ptr<std::vector<float>> GetSdf();
 	void InitializeSdf(std::vector<float>& sdf);
 
 	int mSdfIndex = 0;
 
+	// Bottom level ray query structure, built once by the renderer from the cpu side geometry.
+	std::shared_ptr<GRiMeshBvh> GetBvh();
+	void SetBvh(std::shared_ptr<GRiMeshBvh> bvh);
+
+	// Meshlets of every submesh, null for meshes without them, which are always drawn whole.
+	std::shared_ptr<GRiMeshletSet> GetMeshlets();
+	void SetMeshlets(std::shared_ptr<GRiMeshletSet> meshlets);
+
 protected:
 
 	std::shared_ptr<std::vector<float>> SignedDistanceField;
 
 	int SdfResolution = 32;
 
+	float SdfExtent = 0.0f;
+
+	std::shared_ptr<GRiMeshBvh> mBvh;
+
+	std::shared_ptr<GRiMeshletSet> mMeshlets;
+
 };
 
@@ -0,0 +1,152 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiMeshData.h"
+#include "GRiBoundingBox.h"
+#include "GRiBvh.h"
+#include "GRiMeshOptimizer.h"
+#include "GRiMeshletBuilder.h"
+
+// "GMSH"
+#define COOKED_MESH_MAGIC 0x48534D47
+
+// Bump whenever the layout below or the data the cooker writes changes, older files are cooked again.
+#define COOKED_MESH_VERSION 4
+
+#define COOKED_MESH_EXTENSION L".gmesh"
+
+
+// Layout of a cooked mesh file: the header, the submesh table, the submesh names, then the vertex, index, meshlet,
+// bvh and sdf blobs, every one 16 byte aligned. The sdf comes last so that it can be added to a cooked file later.
+struct GRiCookedMeshHeader
+{
+	UINT32 Magic;
+	UINT32 Version;
+
+	// Hash of the source file the mesh was cooked from.
+	UINT64 SourceHash;
+
+	UINT32 SubmeshNum;
+	UINT32 VertexNum;
+	UINT32 IndexNum;
+	UINT32 VertexStride;
+
+	float BoundsCenter[3];
+	float BoundsExtents[3];
+
+	// 0 if there are no meshlets, bvh or sdf.
+	UINT32 MeshletNum;
+	UINT32 BvhNodeNum;
+	UINT32 BvhPrimitiveNum;
+	INT32 SdfResolution;
+	float SdfExtent;
+
+	// Bytes from the start of the file.
+	UINT64 SubmeshOffset;
+	UINT64 NameOffset;
+	UINT64 VertexOffset;
+	UINT64 IndexOffset;
+	UINT64 MeshletOffset;
+	UINT64 BvhNodeOffset;
+	UINT64 BvhPrimitiveOffset;
+	UINT64 SdfOffset;
+	UINT64 FileSize;
+};
+
+struct GRiCookedSubmesh
+{
+	UINT32 IndexCount;
+	UINT32 StartIndexLocation;
+	INT32 BaseVertexLocation;
+
+	// UTF-16 characters in the name table.
+	UINT32 NameOffset;
+	UINT32 NameLength;
+
+	// Meshlets of the submesh in the meshlet table, they cover its index range in order.
+	UINT32 FirstMeshlet;
+	UINT32 MeshletNum;
+};
+
+// A cooked mesh file mapped into memory. The pointers stay valid until the file is closed, so they can be handed
+// to buffer creation directly.
+class GRiCookedMesh
+{
+
+public:
+
+	GRiCookedMesh() = default;
+	GRiCookedMesh(const GRiCookedMesh& rhs) = delete;
+	GRiCookedMesh& operator=(const GRiCookedMesh& rhs) = delete;
+	~GRiCookedMesh();
+
+	// False if the file is missing, truncated, of another version, cooked from another source or if any offset,
+	// index or bvh node points out of range.
+	bool Open(const std::wstring& path, UINT64 sourceHash);
+
+	void Close();
+
+	UINT GetSubmeshNum();
+	const GRiCookedSubmesh& GetSubmesh(UINT index);
+	std::wstring GetSubmeshName(UINT index);
+
+	const GRiVertex* GetVertices();
+	UINT GetVertexNum();
+
+	const UINT32* GetIndices();
+	UINT GetIndexNum();
+
+	GRiBoundingBox GetBounds();
+
+	bool HasMeshlets();
+	const GRiMeshlet* GetMeshlets();
+	UINT GetMeshletNum();
+
+	bool HasBvh();
+
+	// Bottom level structure over the triangles in submesh order, null without a cooked bvh.
+	std::shared_ptr<GRiMeshBvh> CreateBvh();
+
+	bool HasSdf();
+	int GetSdfResolution();
+	float GetSdfExtent();
+	const float* GetSdf();
+
+private:
+
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+
+	const BYTE* mData = nullptr;
+	const GRiCookedMeshHeader* mHeader = nullptr;
+
+};
+
+// Writes meshes imported from source files into cooked mesh files, keyed by the hash of the source file.
+class GRiMeshCooker
+{
+
+public:
+
+	// Hash of the file content, throws if the file can't be read.
+	static UINT64 HashFile(const std::wstring& path);
+
+	// cookedDirectory ends with a separator.
+	static std::wstring GetCookedPath(const std::wstring& cookedDirectory, UINT64 sourceHash);
+
+	// Submeshes are stored in the order of meshData. With bOptimize every submesh is run through GRiMeshOptimizer
+	// on worker threads first, optimizationStats receives their stats if it isn't null. With bBuildMeshlets every
+	// submesh is split into meshlets by GRiMeshletBuilder after that, meshletStats receives their stats if it isn't
+	// null. With bBuildBvh the bottom level bvh is built and stored as well. The file is written next to path and
+	// moved over it once complete.
+	static void Cook(const std::wstring& path, UINT64 sourceHash, const std::vector<GRiMeshData>& meshData, bool bOptimize, bool bBuildMeshlets, bool bBuildBvh,
+		std::vector<GRiMeshOptimizationStats>* optimizationStats = nullptr, std::vector<GRiMeshletBuildStats>* meshletStats = nullptr);
+
+	// Adds the sdf to a cooked file or replaces the one it has, through a new file like Cook(). The file must not be
+	// open.
+	static void WriteSdf(const std::wstring& path, int resolution, float extent, const float* sdf);
+
+	// Vertex positions and triangle indices with the base vertices applied, in submesh order.
+	static void GetTriangles(const GRiVertex* vertices, UINT vertexNum, const UINT32* indices, const GRiCookedSubmesh* submeshes, UINT submeshNum, std::vector<float>& positions, std::vector<UINT>& triangleIndices);
+
+};
+
@@ -14,5 +14,16 @@ public:
 	std::vector<GRiVertex> Vertices;
 	std::vector<uint32_t> Indices;
 
-};
+	// Merges vertices with equal attributes and remaps the indices, the triangles keep their order and winding.
+	// With a positive epsilon every attribute is snapped to a grid of that size before comparing, otherwise
+	// vertices have to match exactly. Vertices of triangles with mirrored uvs are kept apart, so every welded vertex
+	// has one tangent sign. Returns the number of vertices removed. Throws without changing the mesh if an index is
+	// out of range.
+	UINT WeldVertices(float epsilon = 0.0f);
+
+	// Handedness of the tangent frames from the uv winding of the triangles: +1 where the v direction of the uvs
+	// follows cross(Normal, TangentU), -1 where the uvs are mirrored. A vertex takes the sign most of its triangles
+	// agree on, +1 without any triangle of uv area. Throws if an index is out of range.
+	static void ComputeTangentSigns(const GRiVertex* vertices, UINT vertexNum, const uint32_t* indices, UINT indexNum, float* outSigns);
 
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiMeshData.h"
+
+// Entries of the FIFO post-transform cache the triangle order is optimized for and measured with.
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+
+struct GRiMeshOptimizationStats
+{
+	UINT TriangleNum = 0;
+	UINT VertexNum = 0;
+
+	// Vertices transformed per triangle (ACMR) and per referenced vertex (ATVR), 0.5 and 1.0 are the ideal values.
+	float ACMRBefore = 0.0f;
+	float ACMRAfter = 0.0f;
+	float ATVRBefore = 0.0f;
+	float ATVRAfter = 0.0f;
+
+	// Clusters the triangles were sorted in for overdraw.
+	UINT ClusterNum = 0;
+};
+
+// Import time reordering of indexed meshes: triangles for the post-transform vertex cache (Tipsify), then clusters
+// of them for overdraw with a view independent sort, then vertices in the order the triangles fetch them.
+class GRiMeshOptimizer
+{
+
+public:
+
+	// Runs all three passes on one submesh and drops vertices no triangle references. A cluster ends once its
+	// ACMR gets within overdrawThreshold times the ACMR of the hard cluster it came from, larger values give
+	// more and smaller clusters and trade cache efficiency for less overdraw.
+	static GRiMeshOptimizationStats Optimize(GRiMeshData& meshData, float overdrawThreshold = 1.05f);
+
+	// Tipsify. clusterStarts, if not null, receives the first triangle of every cluster the cache had to be
+	// restarted for, beginning with 0.
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, UINT vertexNum, std::vector<UINT>* clusterStarts);
+
+	// Splits the clusters further and sorts them so that the ones facing away from the mesh center come first.
+	// Returns the number of clusters.
+	static UINT OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<GRiVertex>& vertices, const std::vector<UINT>& clusterStarts, float threshold);
+
+	// Orders the vertices by first use and drops the ones no triangle references.
+	static void OptimizeVertexFetch(GRiMeshData& meshData);
+
+	static float ComputeACMR(const std::vector<uint32_t>& indices, UINT vertexNum);
+
+	static float ComputeATVR(const std::vector<uint32_t>& indices, UINT vertexNum);
+
+private:
+
+	// Cache misses of the triangles in [startTriangle, endTriangle), starting with an empty cache.
+	static UINT SimulateCache(const uint32_t* indices, UINT startTriangle, UINT endTriangle, std::vector<UINT>& cacheTime, UINT& time);
+
+};
+
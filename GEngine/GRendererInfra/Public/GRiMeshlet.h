@@ -0,0 +1,64 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// A cluster of triangles of one submesh, stored in cooked mesh files as is.
+struct GRiMeshlet
+{
+	// Range of the index buffer of the mesh, in the same space as GRiSubmesh::StartIndexLocation.
+	UINT32 StartIndexLocation;
+	UINT32 IndexCount;
+
+	// Bounding sphere in mesh space.
+	float Center[3];
+	float Radius;
+
+	// Bounding box in mesh space, for the occlusion test.
+	float BoundsCenter[3];
+	float BoundsExtents[3];
+
+	// Normal cone. Every triangle faces away from a view point p if
+	// dot(Center - p, ConeAxis) >= ConeCutoff * length(Center - p) + Radius, a cutoff of 1 never passes.
+	float ConeAxis[3];
+	float ConeCutoff;
+};
+
+// The meshlets of a mesh, with the culling data kept as structure of arrays as well.
+class GRiMeshletSet
+{
+
+	friend class GRiMeshletCuller;
+
+public:
+
+	GRiMeshletSet() = default;
+	GRiMeshletSet(const GRiMeshletSet& rhs) = delete;
+	GRiMeshletSet& operator=(const GRiMeshletSet& rhs) = delete;
+	~GRiMeshletSet() = default;
+
+	void Init(const GRiMeshlet* meshlets, UINT meshletNum);
+
+	UINT GetMeshletNum();
+
+	const GRiMeshlet* GetMeshlets();
+
+	UINT GetTriangleNum();
+
+private:
+
+	std::vector<GRiMeshlet> mMeshlets;
+
+	UINT mTriangleNum = 0;
+
+	// Padded to a multiple of 4 with meshlets outside of every frustum.
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mRadius;
+	std::vector<float> mConeAxisX;
+	std::vector<float> mConeAxisY;
+	std::vector<float> mConeAxisZ;
+	std::vector<float> mConeCutoff;
+
+};
+
@@ -0,0 +1,43 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiMeshData.h"
+#include "GRiMeshlet.h"
+
+// Limits of a meshlet, 64 vertices fill about 124 triangles on a regular mesh.
+#define MESHLET_MAX_VERTEX_NUM 64
+#define MESHLET_MAX_TRIANGLE_NUM 124
+
+// Cells along the longest axis of the grid searched for close triangles when a meshlet runs out of neighbours.
+#define MESHLET_GRID_MAX_CELL_NUM 64
+
+
+struct GRiMeshletBuildStats
+{
+	UINT MeshletNum = 0;
+	UINT TriangleNum = 0;
+
+	float AverageTriangleNum = 0.0f;
+	float AverageVertexNum = 0.0f;
+
+	// Meshlets whose normal cone is narrow enough to ever cull them.
+	UINT ConeNum = 0;
+};
+
+// Import time split of submeshes into meshlets for cluster culling.
+class GRiMeshletBuilder
+{
+
+public:
+
+	// Grows meshlets greedily over shared vertices, preferring triangles that add the fewest vertices, then the
+	// ones closest to the meshlet and facing the same way, weighted by coneWeight. Seeds follow the current
+	// triangle order, so an optimized submesh keeps its overdraw order roughly. The triangles are reordered so that
+	// every meshlet is a contiguous index range, starting at 0, and each meshlet is optimized for the vertex cache
+	// on its own. Vertices are reordered by first use afterwards.
+	static GRiMeshletBuildStats Build(GRiMeshData& meshData, std::vector<GRiMeshlet>& meshlets, UINT maxVertexNum = MESHLET_MAX_VERTEX_NUM, UINT maxTriangleNum = MESHLET_MAX_TRIANGLE_NUM, float coneWeight = 0.5f);
+
+	// Bounds and normal cone of the triangles of indices.
+	static void ComputeBounds(const GRiVertex* vertices, const uint32_t* indices, UINT indexNum, GRiMeshlet& meshlet);
+
+};
+
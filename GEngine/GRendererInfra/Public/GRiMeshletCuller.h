@@ -0,0 +1,103 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiMeshlet.h"
+#include "GRiBoundingBox.h"
+
+
+struct GRiMeshletCullingStats
+{
+	UINT DrawNum = 0;
+	UINT MeshletNum = 0;
+	UINT TriangleNum = 0;
+
+	// Triangles of the meshlets each test dropped, a meshlet only counts for the first test dropping it.
+	UINT FrustumCulledTriangleNum = 0;
+	UINT BackfaceCulledTriangleNum = 0;
+	UINT OccludedTriangleNum = 0;
+
+	UINT VisibleMeshletNum = 0;
+	UINT VisibleTriangleNum = 0;
+
+	// Index ranges left after merging adjacent visible meshlets.
+	UINT RangeNum = 0;
+
+	// Milliseconds.
+	float CullTime = 0.0f;
+};
+
+// Culls the meshlets of the draws of visible objects, 4 at a time, against the camera frustum and their normal
+// cones. The tests run in mesh space, so the frustum planes and the camera are moved into the space of every draw
+// instead of moving its meshlets. Optionally the meshlets left are tested against the masked depth buffer of
+// GRiOcclusionCullingRasterizer with their world space boxes. The visible meshlets of every draw are emitted as index
+// ranges, with adjacent ones merged.
+class GRiMeshletCuller
+{
+
+public:
+
+	GRiMeshletCuller() = default;
+	GRiMeshletCuller(const GRiMeshletCuller& rhs) = delete;
+	GRiMeshletCuller& operator=(const GRiMeshletCuller& rhs) = delete;
+	~GRiMeshletCuller() = default;
+
+	// Removes every draw.
+	void Reset();
+
+	// Adds the meshlets [firstMeshlet, firstMeshlet + meshletNum) of a mesh drawn with the row major world matrix,
+	// which maps row vectors. indexOffset is added to the index ranges emitted for the draw. Returns the index of
+	// the draw. The meshlet set has to stay alive until the next Reset().
+	UINT AddDraw(GRiMeshletSet* meshlets, UINT firstMeshlet, UINT meshletNum, const float* world, UINT indexOffset);
+
+	UINT GetDrawNum();
+
+	// Planes point inwards, e.g. from GRiDynamicAabbTree::ExtractFrustumPlanes(). With occlusionViewProj the
+	// masked depth buffer has to be generated for this view projection already.
+	void Cull(GGiThreadPool* tp, const float planes[6][4], const float* cameraPosition, __m128* occlusionViewProj = nullptr);
+
+	// (StartIndexLocation, IndexCount) pairs of the visible meshlets of the draw as of the last Cull().
+	UINT GetRangeNum(UINT draw);
+	const UINT* GetRanges(UINT draw);
+
+	GRiMeshletCullingStats GetStats();
+
+private:
+
+	struct GRiMeshletDraw
+	{
+		GRiMeshletSet* Meshlets;
+		UINT FirstMeshlet;
+		UINT MeshletNum;
+		float World[4][4];
+		UINT IndexOffset;
+		UINT TriangleNum;
+	};
+
+	std::vector<GRiMeshletDraw> mDraws;
+
+	// Meshlets of every draw inside the frustum and facing the camera, and the ranges of the ones the occlusion
+	// test left.
+	std::vector<std::vector<UINT>> mDrawMeshlets;
+	std::vector<std::vector<UINT>> mDrawRanges;
+
+	// Per draw triangle counts of the tests.
+	std::vector<UINT> mFrustumCulledTriangleNums;
+	std::vector<UINT> mBackfaceCulledTriangleNums;
+
+	float mPlanes[6][4];
+	float mCameraPosition[3];
+
+	// World space boxes of every meshlet in mDrawMeshlets, in draw order.
+	std::vector<GRiBoundingBox> mOcclusionBounds;
+	std::unique_ptr<bool[]> mOcclusionVisible;
+	UINT mOcclusionVisibleCapacity = 0;
+
+	GRiMeshletCullingStats mStats;
+
+	void CullDraw(UINT draw);
+
+	// Frustum planes, normalized, and camera in the mesh space of the draw. False if the world matrix mirrors, the
+	// cone test doesn't hold then.
+	bool TransformView(const GRiMeshletDraw& draw, float localPlanes[6][4], float* localCamera);
+
+};
+
@@ -45,6 +45,10 @@ public:
 
 	bool RectTestBBoxMasked(GRiBoundingBox& box, __m128* worldViewProj);
 
+	// Tests boxNum world space boxes against the masked depth buffer in parallel, tp may be null. Unlike
+	// RectTestBBoxMasked() the boxes aren't expanded, and boxes reaching in front of the near plane count as visible.
+	void RectTestBoundsMaskedMT(GGiThreadPool* tp, const GRiBoundingBox* boxes, int boxNum, __m128* viewProj, bool* visible);
+
 	void GenerateMaskedBufferDebugImage(float* output);
 
 	static __m128 SSETransformCoords(__m128 *v, __m128 *m);
@@ -83,5 +87,11 @@ private:
 
 	void SSEGather(SSEVFloat4 pOut[3], int triId, const __m128 xformedPos[]);
 
+	// Screen rectangle (minX, maxX, minY, maxY) and the nearest depth of the projected box, false if the box
+	// reaches in front of the near plane.
+	bool ProjectBounds(const GRiBoundingBox& box, const float viewProj[4][4], float rect[4], float& maxZ);
+
+	bool RectTestMasked(float minX, float maxX, float minY, float maxY, float maxZ);
+
 };
 
@@ -16,6 +16,7 @@
 #include <vector>
 #include <array>
 #include <unordered_map>
+#include <unordered_set>
 #include <cstdint>
 #include <fstream>
 #include <sstream>
@@ -0,0 +1,42 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// Stable least significant digit radix sort of 64 bit keys carrying a 32 bit payload, 8 bits per pass.
+// Passes on a digit every key shares are skipped, so keys only using their low and high bits stay cheap.
+class GRiRadixSort
+{
+
+public:
+
+	GRiRadixSort() = default;
+	GRiRadixSort(const GRiRadixSort& rhs) = delete;
+	GRiRadixSort& operator=(const GRiRadixSort& rhs) = delete;
+	~GRiRadixSort() = default;
+
+	// Sorts keys ascending and reorders values along. Chunks of the arrays are counted and scattered on the
+	// thread pool if there is one and the arrays are large enough.
+	void Sort(GGiThreadPool* tp, std::vector<UINT64>& keys, std::vector<UINT>& values);
+
+	// Returns the number of digit passes the last Sort() actually ran.
+	UINT GetLastPassNum();
+
+private:
+
+	static const UINT RadixBits = 8;
+	static const UINT RadixSize = 1 << RadixBits;
+	static const UINT PassNum = 64 / RadixBits;
+
+	// Below this many keys a single chunk is sorted on the calling thread.
+	static const UINT ParallelThreshold = 4096;
+
+	std::vector<UINT64> mTempKeys;
+	std::vector<UINT> mTempValues;
+
+	// RadixSize counters per chunk.
+	std::vector<UINT> mHistograms;
+
+	UINT mLastPassNum = 0;
+
+};
+
@@ -4,6 +4,9 @@
 #include "GRiFilmboxManager.h"
 #include "GRiCamera.h"
 #include "GRiKdTree.h"
+#include "GRiBvh.h"
+#include "GRiDynamicAabbTree.h"
+#include "GRiLightManager.h"
 
 class GRiRenderer
 {
@@ -48,6 +51,17 @@ public:
 
 	virtual GRiSceneObject* SelectSceneObject(int sx, int sy) = 0;
 
+	// Scene queries against the deferred scene objects, as of the last Update().
+	bool Raycast(const GRiRay& ray, GRiRayHit& hit);
+	std::vector<GRiRayHit> RaycastAll(const GRiRay& ray);
+	std::vector<GRiSceneObject*> Overlap(const GRiBoundingBox& box);
+
+	// Spatial index over the deferred scene objects, kept up to date as they move.
+	GRiDynamicAabbTree* GetSpatialIndex();
+
+	// Lights of the scene, culled against the camera every frame.
+	GRiLightManager* GetLightManager();
+
 	std::unordered_map<std::wstring, GRiTexture*> pTextures;
 	std::unordered_map<std::wstring, GRiMaterial*> pMaterials;
 	std::unordered_map<std::wstring, GRiMesh*> pMeshes;
@@ -85,6 +99,15 @@ protected:
 
 	UINT mFrameCount = 0u;
 
+	std::unique_ptr<GRiSceneBvh> mSceneBvh;
+
+	std::unique_ptr<GRiDynamicAabbTree> mSpatialIndex;
+
+	std::unique_ptr<GRiLightManager> mLightManager;
+
+	// Changes whenever the scene object layers are synced.
+	UINT mSceneObjectLayerVersion = 0;
+
 };
 
 
@@ -6,6 +6,7 @@
 #include "GGiInclude.h"
 #include "GRiMesh.h"
 #include "GRiMeshData.h"
+#include "GRiMeshCooker.h"
 #include "GRiGeometryGenerator.h"
 #include "GRiSceneObject.h"
 #include "GRiImgui.h"
@@ -31,6 +32,9 @@ public:
 
 	virtual GRiMesh* CreateMesh(std::vector<GRiMeshData> meshData) = 0;
 
+	// The geometry is uploaded straight from the mapped file, the file can be closed afterwards.
+	virtual GRiMesh* CreateMesh(GRiCookedMesh& cookedMesh) = 0;
+
 	virtual GRiGeometryGenerator* CreateGeometryGenerator() = 0;
 
 	virtual GRiSceneObject* CreateSceneObject() = 0;
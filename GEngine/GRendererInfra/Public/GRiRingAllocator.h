@@ -0,0 +1,62 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include <deque>
+
+
+// Linear allocator over a ring [0, capacity) for data that lives for a frame, the unit is up to the caller.
+// Allocations are carved from the head, the allocations of a frame are closed with the fence value that frame
+// signals and recycled from the tail once that fence has completed. An allocation never wraps around the end,
+// the skipped tail is charged to the frame it was skipped in.
+class GRiRingAllocator
+{
+
+public:
+
+	static const UINT64 InvalidOffset = (UINT64)-1;
+
+	GRiRingAllocator() = default;
+	GRiRingAllocator(const GRiRingAllocator& rhs) = delete;
+	GRiRingAllocator& operator=(const GRiRingAllocator& rhs) = delete;
+	~GRiRingAllocator() = default;
+
+	// Drops every allocation.
+	void Init(UINT64 capacity);
+
+	// Alignment has to be a power of two. Returns InvalidOffset if the ring can't fit the allocation before
+	// more frames complete.
+	UINT64 Allocate(UINT64 size, UINT64 alignment);
+
+	// Closes the allocations made since the last call, they are recycled once the fence reaches fenceValue.
+	void FinishFrame(UINT64 fenceValue);
+
+	// Recycles every finished frame up to and including completedFenceValue.
+	void ReleaseCompletedFrames(UINT64 completedFenceValue);
+
+	UINT64 GetCapacity();
+
+	// Including alignment padding and skipped tails.
+	UINT64 GetUsedSize();
+
+	UINT GetFrameNum();
+
+private:
+
+	struct GRiRingFrame
+	{
+		UINT64 FenceValue = 0;
+		UINT64 Size = 0;
+	};
+
+	UINT64 mCapacity = 0;
+	UINT64 mHead = 0;
+	UINT64 mTail = 0;
+	UINT64 mUsedSize = 0;
+
+	// Size of the allocations since the last FinishFrame().
+	UINT64 mCurrentFrameSize = 0;
+
+	// Finished frames, oldest first.
+	std::deque<GRiRingFrame> mFrames;
+
+};
+
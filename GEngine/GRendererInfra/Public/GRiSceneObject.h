@@ -1,7 +1,10 @@
 #pragma once
 #include "GRiPreInclude.h"
 #include "GRiMesh.h"
+#include "GRiSceneStore.h"
+#include "GRiDirtyList.h"
 
+class GRiDynamicAabbTree;
 
 enum CullState
 {
@@ -10,11 +13,13 @@ enum CullState
 	OcclusionCulled
 };
 
+// Thin facade over the object's entry in GRiSceneStore, where the transform, bounds and cull state live.
 class GRiSceneObject
 {
 public:
-	GRiSceneObject() = default;
+	GRiSceneObject();
 	GRiSceneObject(const GRiSceneObject& rhs) = delete;
+	virtual ~GRiSceneObject();
 
 	// Give it a name so we can look it up by name.
 	std::wstring UniqueName;
@@ -26,8 +31,13 @@ public:
 	void SetRotation(float pitch, float yaw, float roll);
 	void SetScale(float x, float y, float z);
 
+	// Resets NumFramesDirty and queues the object in GetDirtyList().
 	void MarkDirty();
 
+	// Objects with NumFramesDirty > 0, the renderer drains it once per frame resource.
+	static GRiDirtyList<GRiSceneObject>& GetDirtyList();
+
+	// World transform.
 	GGiFloat4x4 GetTransform();
 
 	virtual void UpdateTransform() = 0;
@@ -55,6 +65,28 @@ public:
 
 	bool IsTransformDirty();
 
+	// Changes whenever the mesh, the override materials or the constant buffer index change.
+	UINT GetDrawStateVersion();
+
+	GRiSceneHandle GetHandle();
+
+	// Location, rotation and scale are relative to the parent. Children follow their parent once the
+	// renderer has propagated the change, nullptr detaches the object. Re-parenting keeps the world transform by
+	// rewriting location, rotation and scale, except for the shear a non-uniformly scaled parent would need.
+	void SetParent(GRiSceneObject* parent);
+	GRiSceneObject* GetParent();
+	std::vector<GRiSceneObject*> GetChildren();
+
+	// Cached in the scene store, only recomputed after the transform or the mesh changed.
+	GRiBoundingBox GetWorldBounds();
+
+	// Registers the object in a spatial index. The renderer moves the proxy when the cached bounds are recomputed.
+	void SetSpatialIndex(GRiDynamicAabbTree* spatialIndex);
+	GRiDynamicAabbTree* GetSpatialIndex();
+
+	// Moves the spatial index proxy to the current world bounds.
+	void UpdateSpatialProxy();
+
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify obect data we should set 
@@ -63,13 +95,18 @@ public:
 
 protected:
 
-	float Location[3] = { 0.0f, 0.0f, 0.0f };
-	float Rotation[3] = { 0.0f, 0.0f, 0.0f };
-	float Scale[3] = { 1.0f, 1.0f, 1.0f };
+	GRiSceneHandle mHandle;
+
+	inline UINT GetDenseIndex()
+	{
+		return GRiSceneStore::GetInstance().GetDenseIndex(mHandle);
+	}
 
-	GGiFloat4x4 mTransform;
+	// Called by UpdateTransform() implementations with the local transform built from location, rotation and scale.
+	void SetTransform(GGiFloat4x4 trans);
 
-	GGiFloat4x4 prevTransform;
+	// Splits a transform into location, rotation in degrees and scale, the inverse of UpdateTransform().
+	static void DecomposeTransform(GGiFloat4x4 trans, float* location, float* rotation, float* scale);
 
 	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
 	UINT ObjIndex = -1;
@@ -78,13 +115,17 @@ protected:
 
 	std::unordered_map<std::wstring, GRiMaterial*> pOverrideMaterial;
 
-	GRiMesh* Mesh;
+	GRiMesh* Mesh = nullptr;
+
+	UINT mDrawStateVersion = 0;
 
 	GGiFloat4x4 TexTransform;
 
-	CullState mCullState = Visible;
+	GRiDynamicAabbTree* pSpatialIndex = nullptr;
+
+	int mSpatialProxy = -1;
 
-	bool bTransformDirty = true;
+	int mDirtyListSlot = -1;
 
 };
 
@@ -0,0 +1,181 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+class GRiSceneObject;
+
+
+// Stable reference to a scene store entry, survives the removal of other entries.
+struct GRiSceneHandle
+{
+	UINT Index = (UINT)-1;
+	UINT Generation = 0;
+};
+
+enum GRiSceneFlag
+{
+	SceneFlagTransformDirty = 1 << 0,
+	// The world matrix and the cached bounds don't match the local transform, the parent or the local bounds anymore.
+	SceneFlagBoundsDirty = 1 << 1,
+	// The entry is in the dirty queue, keeps it from being queued twice.
+	SceneFlagBoundsQueued = 1 << 2,
+	// The entry is in a level of the current world update.
+	SceneFlagWorldPending = 1 << 3
+};
+
+// Data-oriented storage of the per scene object data touched every frame.
+// Every attribute lives in its own tightly packed array. Live entries are kept dense and sorted breadth-first
+// by hierarchy level, so that passes over the whole scene stream through memory linearly and parents always
+// precede their children.
+class GRiSceneStore
+{
+
+public:
+
+	static GRiSceneStore& GetInstance();
+
+	GRiSceneHandle Create(GRiSceneObject* owner);
+
+	// Children of the destroyed entry are attached to its parent, keeping their local transform.
+	void Destroy(GRiSceneHandle handle);
+
+	bool IsValid(GRiSceneHandle handle);
+
+	// Dense indices are only stable until the next Create(), Destroy() or SetParent().
+	inline UINT GetDenseIndex(GRiSceneHandle handle)
+	{
+		return mSlotDenseIndex[handle.Index];
+	}
+
+	UINT GetObjectNum();
+
+	// An invalid parent handle makes the entry a root. Throws if the parent is the entry or one of its descendants.
+	void SetParent(GRiSceneHandle handle, GRiSceneHandle parent);
+
+	// Invalid handle for roots.
+	GRiSceneHandle GetParent(GRiSceneHandle handle);
+
+	std::vector<GRiSceneHandle> GetChildren(GRiSceneHandle handle);
+
+	// Roots are on level 0.
+	UINT GetLevel(GRiSceneHandle handle);
+
+	UINT GetLevelNum();
+
+	// Entries of a level occupy the dense range [GetLevelStart(level), GetLevelStart(level + 1)).
+	UINT GetLevelStart(UINT level);
+
+	// Queues the entry for the next world update, transform changes imply a bounds change.
+	void MarkBoundsDirty(UINT denseIndex);
+
+	// Starts a world update by sorting the queued entries into their levels and emptying the queue.
+	void BeginWorldUpdate();
+
+	// Dense indices of the entries to update on the level, including the children of the entries updated on the
+	// previous level. Must be called level by level, each after the previous level has been updated.
+	const std::vector<UINT>& GatherDirtyLevel(UINT level);
+
+	// Recomputes dirty local transforms through their owners, the world matrices from the parents, then the cached
+	// world AABB and bounding sphere. Safe to run concurrently on disjoint index ranges of one level. The owners
+	// aren't marked dirty here since the dirty list isn't thread safe, that is up to the caller.
+	void UpdateWorlds(const UINT* denseIndices, UINT num);
+
+	// Brings a single entry and its dirty ancestors up to date outside of a world update.
+	void RefreshEntry(UINT denseIndex);
+
+	// Stores the local transform and derives the world matrix from the parent's, which has to be up to date.
+	void SetLocal(UINT denseIndex, GGiFloat4x4 local);
+
+	// Dense arrays, indexed by GetDenseIndex(). Vector attributes hold 3 floats per entry.
+	float* GetLocations();
+	float* GetRotations();
+	float* GetScales();
+	GGiFloat4x4* GetLocals();
+	GGiFloat4x4* GetWorlds();
+	GGiFloat4x4* GetPrevWorlds();
+	float* GetWorldBoundMins();
+	float* GetWorldBoundMaxs();
+	// Center and radius, 4 floats per entry.
+	float* GetWorldSpheres();
+	// Mesh space bounds center and extents, 6 floats per entry.
+	float* GetLocalBounds();
+	UINT8* GetCullStates();
+	UINT8* GetFlags();
+	GRiSceneObject** GetOwners();
+
+private:
+
+	// Copy of every dense attribute of an entry, used to relocate it.
+	struct GRiSceneEntry
+	{
+		float Location[3];
+		float Rotation[3];
+		float Scale[3];
+		GGiFloat4x4 Local;
+		GGiFloat4x4 World;
+		GGiFloat4x4 PrevWorld;
+		float WorldBoundMin[3];
+		float WorldBoundMax[3];
+		float WorldSphere[4];
+		float LocalBounds[6];
+		UINT8 CullState;
+		UINT8 Flags;
+		GRiSceneObject* Owner;
+		UINT Slot;
+	};
+
+	GRiSceneStore() = default;
+	GRiSceneStore(const GRiSceneStore& rhs) = delete;
+	GRiSceneStore& operator=(const GRiSceneStore& rhs) = delete;
+
+	void LoadEntry(UINT denseIndex, GRiSceneEntry& entry);
+
+	void StoreEntry(UINT denseIndex, const GRiSceneEntry& entry);
+
+	void ResizeEntries(UINT num);
+
+	// Appends the entry to its level, shifting every higher level up by one entry. Returns the dense index.
+	UINT InsertEntry(UINT level, const GRiSceneEntry& entry);
+
+	// Fills the hole with the last entry of the level, shifting every higher level down by one entry.
+	void RemoveEntry(UINT denseIndex, UINT level);
+
+	// Relocates the entry and its subtree after a parent change.
+	void UpdateLevels(UINT slot);
+
+	void UpdateWorld(UINT denseIndex);
+
+	void UpdateBounds(UINT denseIndex);
+
+	// Slot data, indexed by GRiSceneHandle::Index.
+	std::vector<UINT> mSlotDenseIndex;
+	std::vector<UINT> mSlotGeneration;
+	std::vector<UINT> mSlotParent;
+	std::vector<UINT> mSlotLevel;
+	std::vector<std::vector<UINT>> mSlotChildren;
+	std::vector<UINT> mFreeSlots;
+	std::vector<UINT> mBoundsDirtySlots;
+
+	// First dense index of every level, followed by the entry count.
+	std::vector<UINT> mLevelStarts = { 0 };
+
+	// Dense indices of the current world update, per level.
+	std::vector<std::vector<UINT>> mDirtyLevels;
+
+	// Dense data.
+	std::vector<UINT> mDenseSlot;
+	std::vector<float> mLocations;
+	std::vector<float> mRotations;
+	std::vector<float> mScales;
+	std::vector<GGiFloat4x4> mLocals;
+	std::vector<GGiFloat4x4> mWorlds;
+	std::vector<GGiFloat4x4> mPrevWorlds;
+	std::vector<float> mWorldBoundMins;
+	std::vector<float> mWorldBoundMaxs;
+	std::vector<float> mWorldSpheres;
+	std::vector<float> mLocalBounds;
+	std::vector<UINT8> mCullStates;
+	std::vector<UINT8> mFlags;
+	std::vector<GRiSceneObject*> mOwners;
+
+};
+
@@ -0,0 +1,157 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiMesh.h"
+
+
+// Camera-centred global distance field composited from per-mesh SDFs.
+// Every level covers (Resolution * VoxelSize) around the camera, each level doubles the voxel size of the previous one.
+// Voxels are addressed toroidally so that a camera move only recomposites the bricks entering the window.
+struct GRiSdfClipmapObject
+{
+	GRiMesh* Mesh = nullptr;
+
+	// Keep the distance data alive even if the mesh re-initializes its SDF.
+	std::shared_ptr<std::vector<float>> Sdf;
+
+	int SdfResolution = 0;
+	float SdfExtent = 0.0f;
+
+	GGiFloat4x4 World;
+
+	// Row-vector inverse of World.
+	float InvWorld[4][4];
+
+	// Smallest axis scale of the world matrix, used to convert local distances conservatively.
+	float MinScale = 1.0f;
+
+	// World space bounds of the SDF volume.
+	float BoundMin[3] = { 0.0f, 0.0f, 0.0f };
+	float BoundMax[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+struct GRiSdfClipmapLevel
+{
+	float VoxelSize = 1.0f;
+
+	// Distances beyond this are clamped, so an object only affects voxels within its bounds expanded by it.
+	float TruncationDistance = 1.0f;
+
+	// Window minimum corner in world brick coordinates.
+	int Origin[3] = { 0, 0, 0 };
+
+	// Resolution^3 distances, toroidally addressed by world voxel coordinate.
+	std::vector<float> Distance;
+
+	// BrickNum^3 flags, toroidally addressed by world brick coordinate.
+	std::vector<UINT8> BrickDirty;
+};
+
+struct GRiSdfClipmapBrick
+{
+	int Level;
+
+	// World brick coordinate.
+	int Brick[3];
+};
+
+struct GRiSdfClipmapStats
+{
+	int ObjectNum = 0;
+	int DirtyBrickNum = 0;
+	int CompositedVoxelNum = 0;
+	float UpdateTime = 0.0f;
+};
+
+class GRiSdfClipmap
+{
+
+public:
+
+	GRiSdfClipmap() = default;
+	GRiSdfClipmap(const GRiSdfClipmap& rhs) = delete;
+	GRiSdfClipmap& operator=(const GRiSdfClipmap& rhs) = delete;
+	~GRiSdfClipmap() = default;
+
+	void Init(int levelNum, int resolution, int brickSize, float finestVoxelSize, float truncationVoxels);
+
+	// Adds or moves an object. Nothing is invalidated if neither the mesh nor the transform changed.
+	void SetObject(UINT id, GRiMesh* mesh, GGiFloat4x4 world);
+
+	void RemoveObject(UINT id);
+
+	bool HasObject(UINT id);
+
+	std::vector<UINT> GetObjectIds();
+
+	// Recenters the levels around the camera and recomposites every dirty brick on the thread pool.
+	void Update(GGiThreadPool* tp, float cameraX, float cameraY, float cameraZ);
+
+	// Bricks recomposited by the last Update(), for the renderer to upload.
+	const std::vector<GRiSdfClipmapBrick>& GetUpdatedBricks();
+
+	// Toroidal slot of the brick within its level, in [0, (Resolution / BrickSize)^3).
+	int GetBrickSlot(const GRiSdfClipmapBrick& brick);
+
+	// Writes the BrickSize^3 distances of the brick to dst, x fastest, so every brick is contiguous on the gpu.
+	void CopyBrick(const GRiSdfClipmapBrick& brick, float* dst);
+
+	GRiSdfClipmapStats GetStats();
+
+	int GetLevelNum();
+	int GetResolution();
+	int GetBrickSize();
+	const GRiSdfClipmapLevel& GetLevel(int level);
+
+	// Nearest voxel lookup in the finest level containing the position.
+	float Sample(float x, float y, float z);
+
+	// Brute-force min over all objects for one voxel, without any brick or bounds culling.
+	float ComputeReferenceDistance(int level, int vx, int vy, int vz);
+
+	// Compares every voxel of every level against ComputeReferenceDistance() and returns the largest absolute error.
+	float ValidateAgainstReference(GGiThreadPool* tp);
+
+private:
+
+	int mLevelNum = 0;
+	int mResolution = 0;
+	int mBrickSize = 0;
+	int mBrickNum = 0;
+
+	bool bInitialized = false;
+	bool bOriginValid = false;
+
+	std::vector<GRiSdfClipmapLevel> mLevels;
+
+	std::unordered_map<UINT, GRiSdfClipmapObject> mObjects;
+
+	std::vector<GRiSdfClipmapBrick> mUpdatedBricks;
+
+	GRiSdfClipmapStats mStats;
+
+	void MarkRegionDirty(const float* boundMin, const float* boundMax);
+
+	void RecenterLevel(int level, const int* newOrigin);
+
+	void CompositeBrick(const GRiSdfClipmapBrick& brick, const std::vector<GRiSdfClipmapObject*>& objects);
+
+	static float SampleObject(const GRiSdfClipmapObject& obj, float x, float y, float z);
+
+	inline int Wrap(int v, int n)
+	{
+		int r = v % n;
+		return r < 0 ? r + n : r;
+	}
+
+	inline int BrickSlot(int bx, int by, int bz)
+	{
+		return (Wrap(bz, mBrickNum) * mBrickNum + Wrap(by, mBrickNum)) * mBrickNum + Wrap(bx, mBrickNum);
+	}
+
+	inline int VoxelSlot(int vx, int vy, int vz)
+	{
+		return (Wrap(vz, mResolution) * mResolution + Wrap(vy, mResolution)) * mResolution + Wrap(vx, mResolution);
+	}
+
+};
+
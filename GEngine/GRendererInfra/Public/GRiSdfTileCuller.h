@@ -0,0 +1,91 @@
+#pragma once
+#include "GRiPreInclude.h"
+#include "GRiBoundingBox.h"
+
+
+// Tiles are the cells of a grid on the plane perpendicular to the light direction.
+// A shadow ray toward a directional light never leaves the tile its origin projects to,
+// so an object can only shadow a tile if its projected bounds overlap the tile.
+struct GRiSdfTileGrid
+{
+	// Plane axes, both perpendicular to the light direction.
+	float AxisU[3] = { 1.0f, 0.0f, 0.0f };
+	float AxisV[3] = { 0.0f, 1.0f, 0.0f };
+
+	// Grid minimum corner in plane coordinates.
+	float Origin[2] = { 0.0f, 0.0f };
+
+	float TileSize = 1.0f;
+
+	int TileNum = 0;
+};
+
+struct GRiSdfTileCullerStats
+{
+	int ObjectNum = 0;
+	int TileNum = 0;
+	int NonEmptyTileNum = 0;
+	int TotalEntryNum = 0;
+	int MaxEntryNum = 0;
+
+	// Averaged over non-empty tiles.
+	float AverageEntryNum = 0.0f;
+
+	// Milliseconds.
+	float BuildTime = 0.0f;
+};
+
+class GRiSdfTileCuller
+{
+
+public:
+
+	GRiSdfTileCuller() = default;
+	GRiSdfTileCuller(const GRiSdfTileCuller& rhs) = delete;
+	GRiSdfTileCuller& operator=(const GRiSdfTileCuller& rhs) = delete;
+	~GRiSdfTileCuller() = default;
+
+	// tileNum is the number of tiles along each axis of the grid.
+	void Init(int tileNum);
+
+	// Builds the per-tile object lists for world space bounds, lightDir points from the light to the scene.
+	void Build(GGiThreadPool* tp, const float* lightDir, const std::vector<GRiBoundingBox>& objectBounds);
+
+	const GRiSdfTileGrid& GetGrid();
+
+	// (offset, count) pairs into GetObjectIndices(), one per tile, row major.
+	const std::vector<UINT>& GetTileRanges();
+
+	const std::vector<UINT>& GetObjectIndices();
+
+	GRiSdfTileCullerStats GetStats();
+
+	// Returns -1 if the position projects outside of the grid.
+	int GetTileIndex(float x, float y, float z);
+
+private:
+
+	int mTileNum = 0;
+
+	GRiSdfTileGrid mGrid;
+
+	// Projected object bounds, padded to a multiple of 4 with empty ranges.
+	std::vector<float> mUMin;
+	std::vector<float> mUMax;
+	std::vector<float> mVMin;
+	std::vector<float> mVMax;
+
+	int mObjectNum = 0;
+
+	std::vector<std::vector<UINT>> mRowIndices;
+
+	std::vector<UINT> mTileRanges;
+
+	std::vector<UINT> mObjectIndices;
+
+	GRiSdfTileCullerStats mStats;
+
+	void BuildRow(int row);
+
+};
+
@@ -18,6 +18,10 @@ public:
 	UINT StartIndexLocation = 0;
 	INT BaseVertexLocation = 0;
 
+	// Range of the submesh in the meshlet set of its mesh.
+	UINT FirstMeshlet = 0;
+	UINT MeshletNum = 0;
+
 	void SetMaterial(GRiMaterial* material);
 
 	GRiMaterial* GetMaterial();
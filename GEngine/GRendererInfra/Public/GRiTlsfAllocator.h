@@ -0,0 +1,97 @@
+#pragma once
+#include "GRiPreInclude.h"
+
+
+// Two level segregated fit allocator over an abstract range [0, capacity), the unit is up to the caller.
+// Free blocks are binned by size into power of two classes split into linear subclasses, two bitmaps
+// locate a large enough free block in constant time. Freed blocks are merged with free neighbours at once.
+// Only bookkeeping is done here, the memory itself lives wherever the offsets point to.
+class GRiTlsfAllocator
+{
+
+public:
+
+	static const UINT InvalidBlock = (UINT)-1;
+
+	GRiTlsfAllocator() = default;
+	GRiTlsfAllocator(const GRiTlsfAllocator& rhs) = delete;
+	GRiTlsfAllocator& operator=(const GRiTlsfAllocator& rhs) = delete;
+	~GRiTlsfAllocator() = default;
+
+	// Drops every allocation.
+	void Init(UINT capacity);
+
+	// Returns the block id, InvalidBlock if no free block is large enough.
+	UINT Allocate(UINT size);
+
+	void Free(UINT block);
+
+	UINT GetOffset(UINT block);
+
+	UINT GetSize(UINT block);
+
+	UINT GetCapacity();
+
+	UINT GetUsedSize();
+
+	UINT GetAllocationNum();
+
+	// Checks that the blocks tile the range, that no two free blocks are adjacent and that the bins and
+	// bitmaps hold exactly the free blocks.
+	bool Validate();
+
+private:
+
+	// Subclasses per power of two class.
+	static const UINT SlBits = 4;
+	static const UINT SlNum = 1 << SlBits;
+	// Sizes below SlNum share the first class, one subclass per size.
+	static const UINT FlNum = 32 - SlBits + 1;
+
+	struct GRiTlsfBlock
+	{
+		UINT Offset = 0;
+		UINT Size = 0;
+
+		// Neighbours in the range.
+		UINT PrevPhysical = InvalidBlock;
+		UINT NextPhysical = InvalidBlock;
+
+		// Neighbours in the bin while free, next unused block while unused.
+		UINT PrevFree = InvalidBlock;
+		UINT NextFree = InvalidBlock;
+
+		bool bFree = false;
+		bool bUsed = false;
+	};
+
+	UINT mCapacity = 0;
+	UINT mUsedSize = 0;
+	UINT mAllocationNum = 0;
+
+	std::vector<GRiTlsfBlock> mBlocks;
+	UINT mUnusedBlocks = InvalidBlock;
+
+	UINT mFlBitmap = 0;
+	UINT mSlBitmaps[FlNum] = {};
+	UINT mBins[FlNum][SlNum];
+
+	// Class of a free block of the given size.
+	static void MapInsert(UINT size, UINT& fl, UINT& sl);
+
+	// Smallest class whose blocks are all at least the given size. Returns false if there is none.
+	static bool MapSearch(UINT size, UINT& fl, UINT& sl);
+
+	UINT NewBlock();
+
+	void ReleaseBlock(UINT block);
+
+	void InsertFree(UINT block);
+
+	void RemoveFree(UINT block);
+
+	// Returns a free block of the smallest suitable class at or above (fl, sl), InvalidBlock if there is none.
+	UINT FindFree(UINT fl, UINT sl);
+
+};
+
@@ -0,0 +1,227 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiClusteredLightAssigner.h"
+
+#include <random>
+
+
+// 64 pixel tiles and 16 exponential slices from 1 to 5000, as in the deferred light pass.
+static const UINT TileSize = 64;
+static const UINT SliceNum = 16;
+
+static void InitAssigner(GRiClusteredLightAssigner& assigner, bool bUseLightBvh)
+{
+	float sliceDepths[SliceNum + 1];
+	for (auto s = 0u; s <= SliceNum; s++)
+		sliceDepths[s] = powf(5000.0f, (float)s / (float)SliceNum);
+
+	assigner.Init(TileSize, TileSize, sliceDepths, SliceNum);
+	assigner.SetLightBvhEnabled(bUseLightBvh);
+}
+
+// Lights in a cube of the given half extent around the origin.
+static std::vector<GRiPointLight> CreateRandomLights(UINT lightNum, float extent, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> positionDist(-extent, extent);
+	std::uniform_real_distribution<float> rangeDist(5.0f, 50.0f);
+
+	std::vector<GRiPointLight> lights(lightNum);
+	for (auto& light : lights)
+	{
+		for (auto k = 0; k < 3; k++)
+			light.Position[k] = positionDist(rng);
+		light.Range = rangeDist(rng);
+	}
+	return lights;
+}
+
+static void MoveLights(std::vector<GRiPointLight>& lights, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> moveDist(-10.0f, 10.0f);
+	for (auto& light : lights)
+	{
+		for (auto k = 0; k < 3; k++)
+			light.Position[k] += moveDist(rng);
+	}
+}
+
+// Tests every light against every cluster with scalar code. The cluster frusta follow ClusteredDeferredCS:
+// side planes through the eye, built from the projection scale and the unrounded tile number, and depth slices.
+// Lights within a small margin of a plane may go either way.
+static void CheckAgainstReference(GRiClusteredLightAssigner& assigner, UINT width, UINT height, GGiFloat4x4& view, float projScaleX, float projScaleY, const std::vector<GRiPointLight>& lights)
+{
+	const float margin = 1e-2f;
+
+	UINT tileNumX = assigner.GetTileNumX();
+	UINT tileNumY = assigner.GetTileNumY();
+	BOOST_REQUIRE_EQUAL(tileNumX, (width + TileSize - 1) / TileSize);
+	BOOST_REQUIRE_EQUAL(tileNumY, (height + TileSize - 1) / TileSize);
+	BOOST_REQUIRE_EQUAL(assigner.GetClusterNum(), tileNumX * tileNumY * SliceNum);
+
+	auto& ranges = assigner.GetClusterRanges();
+	auto& indices = assigner.GetLightIndices();
+	BOOST_REQUIRE_EQUAL(ranges.size(), assigner.GetClusterNum() * 2);
+
+	float sliceDepths[SliceNum + 1];
+	for (auto s = 0u; s <= SliceNum; s++)
+		sliceDepths[s] = powf(5000.0f, (float)s / (float)SliceNum);
+
+	// Smallest signed distance of the sphere to the side planes, normalized planes with a zero offset.
+	auto sideDist = [](float a, float b, float c, const float* p, float radius)
+	{
+		float invLen = 1.0f / sqrtf(a * a + b * b + c * c);
+		return (a * p[0] + b * p[1] + c * p[2]) * invLen + radius;
+	};
+
+	std::vector<float> viewPositions(lights.size() * 3);
+	for (auto i = 0u; i < lights.size(); i++)
+	{
+		auto& p = lights[i].Position;
+		for (auto k = 0; k < 3; k++)
+			viewPositions[i * 3 + k] = p[0] * view.GetElement(0, k) + p[1] * view.GetElement(1, k) + p[2] * view.GetElement(2, k) + view.GetElement(3, k);
+	}
+
+	float tileNumXf = (float)width / (float)TileSize;
+	float tileNumYf = (float)height / (float)TileSize;
+	UINT checkedNum = 0;
+	for (auto ty = 0u; ty < tileNumY; ty++)
+	{
+		float offsetY = (float)ty * 2.0f + 1.0f - tileNumYf;
+		for (auto tx = 0u; tx < tileNumX; tx++)
+		{
+			float offsetX = (float)tx * 2.0f + 1.0f - tileNumXf;
+			for (auto s = 0u; s < SliceNum; s++)
+			{
+				UINT cluster = (ty * tileNumX + tx) * SliceNum + s;
+				UINT offset = ranges[cluster * 2];
+				UINT count = ranges[cluster * 2 + 1];
+				BOOST_REQUIRE_LE(offset + count, indices.size());
+
+				UINT next = offset;
+				for (auto i = 0u; i < lights.size(); i++)
+				{
+					const float* p = &viewPositions[i * 3];
+					float radius = lights[i].Range;
+					float dist = min(
+						min(sideDist(projScaleX * tileNumXf, 0.0f, 1.0f - offsetX, p, radius), sideDist(-projScaleX * tileNumXf, 0.0f, 1.0f + offsetX, p, radius)),
+						min(sideDist(0.0f, projScaleY * tileNumYf, 1.0f + offsetY, p, radius), sideDist(0.0f, -projScaleY * tileNumYf, 1.0f - offsetY, p, radius)));
+					dist = min(dist, min(p[2] - sliceDepths[s] + radius, sliceDepths[s + 1] - p[2] + radius));
+					if (dist < -margin)
+						continue;
+
+					if (next < offset + count && indices[next] == i)
+					{
+						next++;
+						checkedNum++;
+					}
+					else
+					{
+						BOOST_REQUIRE_MESSAGE(dist <= margin, "Light " << i << " is missing from cluster " << cluster << ".");
+					}
+				}
+				BOOST_REQUIRE_MESSAGE(next == offset + count, "Cluster " << cluster << " holds culled or unordered lights.");
+			}
+		}
+	}
+	BOOST_TEST_MESSAGE(checkedNum << " light cluster pairs checked");
+}
+
+BOOST_AUTO_TEST_SUITE(GRiClusteredLightAssignerTest)
+
+BOOST_AUTO_TEST_CASE(MatchesReference)
+{
+	GGiThreadPool tp(4);
+	std::mt19937 rng(1234);
+
+	// Partial tiles on both axes and a camera that isn't at the origin.
+	const UINT width = 1000;
+	const UINT height = 600;
+	float projScaleY = 1.0f;
+	float projScaleX = projScaleY * (float)height / (float)width;
+	GGiFloat4x4 view = GGiFloat4x4::Identity();
+	view.SetElement(3, 0, 100.0f);
+	view.SetElement(3, 2, 500.0f);
+
+	auto lights = CreateRandomLights(3000, 600.0f, rng);
+	for (auto bUseLightBvh : { false, true })
+	{
+		GRiClusteredLightAssigner assigner;
+		InitAssigner(assigner, bUseLightBvh);
+		for (auto frame = 0; frame < 2; frame++)
+		{
+			assigner.Assign(frame == 0 ? &tp : nullptr, width, height, view, projScaleX, projScaleY, lights.data(), (UINT)lights.size());
+			CheckAgainstReference(assigner, width, height, view, projScaleX, projScaleY, lights);
+			MoveLights(lights, rng);
+		}
+	}
+}
+
+// The bvh only narrows down the lights every tile row tests, the lists have to be identical.
+BOOST_AUTO_TEST_CASE(LightBvhMatchesBruteForce)
+{
+	GGiThreadPool tp(4);
+	std::mt19937 rng(5678);
+
+	const UINT width = 1920;
+	const UINT height = 1080;
+	float projScaleY = 1.0f;
+	float projScaleX = projScaleY * (float)height / (float)width;
+	GGiFloat4x4 view = GGiFloat4x4::Identity();
+
+	GRiClusteredLightAssigner bruteForce;
+	GRiClusteredLightAssigner bvh;
+	InitAssigner(bruteForce, false);
+	InitAssigner(bvh, true);
+
+	for (auto lightNum : { 0u, 1u, 7u, 1000u, 20000u })
+	{
+		auto lights = CreateRandomLights(lightNum, 2000.0f, rng);
+		for (auto frame = 0; frame < 3; frame++)
+		{
+			bruteForce.Assign(&tp, width, height, view, projScaleX, projScaleY, lights.data(), lightNum);
+			bvh.Assign(&tp, width, height, view, projScaleX, projScaleY, lights.data(), lightNum);
+			BOOST_REQUIRE(bruteForce.GetClusterRanges() == bvh.GetClusterRanges());
+			BOOST_REQUIRE(bruteForce.GetLightIndices() == bvh.GetLightIndices());
+			BOOST_CHECK_EQUAL(bruteForce.GetStats().TotalIndexNum, (UINT)bvh.GetLightIndices().size());
+			MoveLights(lights, rng);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(GRiClusteredLightAssignerBenchmark, *boost::unit_test::disabled())
+
+// Lights randomly scattered around the camera at 1080p, doubling the light count. Every count runs two frames
+// and the second one, after the lights moved, is reported.
+BOOST_AUTO_TEST_CASE(Assign)
+{
+	GGiThreadPool tp(std::thread::hardware_concurrency());
+
+	const UINT width = 1920;
+	const UINT height = 1080;
+	float projScaleY = 1.0f;
+	float projScaleX = projScaleY * (float)height / (float)width;
+	GGiFloat4x4 view = GGiFloat4x4::Identity();
+
+	for (auto bUseLightBvh : { false, true })
+	{
+		std::mt19937 rng(1234);
+		GRiClusteredLightAssigner assigner;
+		InitAssigner(assigner, bUseLightBvh);
+
+		for (auto lightNum = 256u; lightNum <= 65536u; lightNum *= 2)
+		{
+			auto lights = CreateRandomLights(lightNum, 2000.0f, rng);
+			assigner.Assign(&tp, width, height, view, projScaleX, projScaleY, lights.data(), lightNum);
+			MoveLights(lights, rng);
+			assigner.Assign(&tp, width, height, view, projScaleX, projScaleY, lights.data(), lightNum);
+
+			auto stats = assigner.GetStats();
+			BOOST_CHECK_EQUAL(stats.LightNum, lightNum);
+			BOOST_TEST_MESSAGE((bUseLightBvh ? "bvh" : "brute force") << " lights " << stats.LightNum << " indices " << stats.TotalIndexNum <<
+				" max per cluster " << stats.MaxClusterLightNum << " assign " << stats.AssignTime << " ms bvh update " << stats.BvhUpdateTime << " ms");
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
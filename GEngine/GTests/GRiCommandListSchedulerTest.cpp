@@ -0,0 +1,110 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiCommandListScheduler.h"
+
+
+// Logs what every list was given, each list only from the thread recording it.
+class GRiMockCommandListRecorder : public GRiCommandListRecorder
+{
+
+public:
+
+	struct List
+	{
+		UINT BeginNum = 0;
+		UINT EndNum = 0;
+		bool bRecordedOutside = false;
+		std::vector<UINT> Items;
+	};
+
+	std::vector<List> Lists;
+
+	virtual void BeginList(UINT listIndex) override
+	{
+		Lists[listIndex].BeginNum++;
+	}
+
+	virtual void RecordItems(UINT listIndex, UINT firstItem, UINT itemNum) override
+	{
+		auto& list = Lists[listIndex];
+		if (list.BeginNum != 1 || list.EndNum != 0)
+			list.bRecordedOutside = true;
+		for (auto i = firstItem; i < firstItem + itemNum; i++)
+			list.Items.push_back(i);
+	}
+
+	virtual void EndList(UINT listIndex) override
+	{
+		Lists[listIndex].EndNum++;
+	}
+
+};
+
+// Schedules and records into the mock recorder, checking that every list is opened, filled and closed once
+// and that the lists in index order hold every item exactly once, in order.
+static void TestSchedule(GGiThreadPool* tp, UINT itemNum, UINT maxListNum, UINT minItemNum)
+{
+	GRiCommandListScheduler scheduler;
+	scheduler.Schedule(itemNum, maxListNum, minItemNum);
+
+	UINT listNum = scheduler.GetListNum();
+	BOOST_REQUIRE_LE(listNum, maxListNum);
+	if (itemNum > 0 && maxListNum > 0)
+		BOOST_REQUIRE_GT(listNum, 0u);
+	if (listNum > 1)
+		BOOST_REQUIRE_GE(itemNum / listNum, minItemNum);
+
+	GRiMockCommandListRecorder recorder;
+	recorder.Lists.resize(listNum);
+	scheduler.Record(tp, &recorder);
+
+	UINT nextItem = 0;
+	UINT minChunk = UINT_MAX;
+	UINT maxChunk = 0;
+	for (auto& list : recorder.Lists)
+	{
+		BOOST_REQUIRE_EQUAL(list.BeginNum, 1u);
+		BOOST_REQUIRE_EQUAL(list.EndNum, 1u);
+		BOOST_REQUIRE(!list.bRecordedOutside);
+		BOOST_REQUIRE_GT(list.Items.size(), 0u);
+		for (auto item : list.Items)
+		{
+			BOOST_REQUIRE_EQUAL(item, nextItem);
+			nextItem++;
+		}
+		minChunk = min(minChunk, (UINT)list.Items.size());
+		maxChunk = max(maxChunk, (UINT)list.Items.size());
+	}
+
+	BOOST_REQUIRE_EQUAL(nextItem, listNum > 0 ? itemNum : 0u);
+	if (listNum > 0)
+		BOOST_REQUIRE_LE(maxChunk - minChunk, 1u);
+}
+
+BOOST_AUTO_TEST_SUITE(GRiCommandListSchedulerTest)
+
+BOOST_AUTO_TEST_CASE(SingleThreaded)
+{
+	for (auto itemNum : { 0u, 1u, 5u, 63u, 64u, 65u, 1000u, 4097u })
+	{
+		for (auto maxListNum : { 0u, 1u, 2u, 8u })
+		{
+			for (auto minItemNum : { 0u, 1u, 64u, 500u })
+				TestSchedule(nullptr, itemNum, maxListNum, minItemNum);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPool)
+{
+	GGiThreadPool tp(4);
+	for (auto itemNum : { 0u, 1u, 5u, 63u, 64u, 65u, 1000u, 4097u })
+	{
+		for (auto maxListNum : { 0u, 1u, 2u, 8u })
+		{
+			for (auto minItemNum : { 0u, 1u, 64u, 500u })
+				TestSchedule(&tp, itemNum, maxListNum, minItemNum);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,149 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiCompressedVertex.h"
+#include "GRiMeshTestUtil.h"
+
+#include <random>
+
+
+// Requires the errors to stay within what the formats allow: half a quantization step per position axis, the half
+// float rounding of the uvs and a small angle for the vectors.
+static void CheckCompressionError(const GRiMeshData& shape)
+{
+	UINT vertexNum = (UINT)shape.Vertices.size();
+	auto error = GRiVertexCompressor::MeasureError(shape.Vertices.data(), vertexNum);
+
+	auto quantization = GRiVertexCompressor::ComputeQuantization(shape.Vertices.data(), vertexNum);
+	float maxStep = 0.0f;
+	float maxMagnitude = 0.0f;
+	float maxUV = 0.0f;
+	for (auto k = 0; k < 3; k++)
+	{
+		maxStep = max(maxStep, quantization.Scale[k] / 65535.0f);
+		maxMagnitude = max(maxMagnitude, fabsf(quantization.Offset[k]) + quantization.Scale[k]);
+	}
+	for (auto& v : shape.Vertices)
+		maxUV = max(maxUV, max(fabsf(v.UV[0]), fabsf(v.UV[1])));
+
+	// The float math of the decode adds a few ulps on top of the rounding.
+	BOOST_CHECK_LE(error.Position, maxStep * 0.5f + maxMagnitude * 1e-6f);
+	BOOST_CHECK_LE(error.UV, maxUV / 2048.0f + 1e-7f);
+	BOOST_CHECK_LE(error.Normal, 0.01f);
+	BOOST_CHECK_LE(error.TangentU, 0.01f);
+	BOOST_TEST_MESSAGE("position " << error.Position << " uv " << error.UV << " normal " << error.Normal << " tangent " << error.TangentU);
+}
+
+// Two triangles of the z = 0 plane sharing an edge, with the same tangent frame and the uvs of the second one
+// mirrored in v.
+static GRiMeshData CreateMirroredQuad()
+{
+	GRiMeshData quad;
+	quad.Vertices = {
+		GRiVertex(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f),
+		GRiVertex(0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f),
+		GRiVertex(1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f),
+		GRiVertex(0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f),
+		GRiVertex(1.0f, 2.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f),
+		GRiVertex(1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f)
+	};
+	quad.Indices = { 0, 1, 2, 3, 4, 5 };
+	return quad;
+}
+
+BOOST_AUTO_TEST_SUITE(GRiCompressedVertexTest)
+
+BOOST_AUTO_TEST_CASE(GeometryGenerator)
+{
+	for (auto& shape : CreateTestShapes())
+		CheckCompressionError(shape);
+
+	// Large enough for the quantization step to matter.
+	GRiGeometryGenerator geoGen;
+	CheckCompressionError(geoGen.CreateGrid(2000.0f, 2000.0f, 100, 100));
+}
+
+// The generated box and grid are right handed, mirrored uvs flip the sign and the sign survives the compression.
+BOOST_AUTO_TEST_CASE(TangentSign)
+{
+	GRiGeometryGenerator geoGen;
+	for (auto& shape : { geoGen.CreateBox(1.0f, 2.0f, 3.0f, 2), geoGen.CreateGrid(20.0f, 20.0f, 10, 10) })
+	{
+		UINT vertexNum = (UINT)shape.Vertices.size();
+		std::vector<float> signs(vertexNum);
+		GRiMeshData::ComputeTangentSigns(shape.Vertices.data(), vertexNum, shape.Indices.data(), (UINT)shape.Indices.size(), signs.data());
+		BOOST_CHECK(std::all_of(signs.begin(), signs.end(), [](float sign) { return sign == 1.0f; }));
+	}
+
+	auto quad = CreateMirroredQuad();
+	std::vector<float> signs(quad.Vertices.size());
+	GRiMeshData::ComputeTangentSigns(quad.Vertices.data(), (UINT)quad.Vertices.size(), quad.Indices.data(), (UINT)quad.Indices.size(), signs.data());
+	BOOST_CHECK(signs == std::vector<float>({ 1.0f, 1.0f, 1.0f, -1.0f, -1.0f, -1.0f }));
+
+	auto quantization = GRiVertexCompressor::ComputeQuantization(quad.Vertices.data(), (UINT)quad.Vertices.size());
+	std::vector<GRiCompressedVertex> compressed(quad.Vertices.size());
+	std::vector<GRiVertex> decoded(quad.Vertices.size());
+	std::vector<float> decodedSigns(quad.Vertices.size());
+	GRiVertexCompressor::Encode(quad.Vertices.data(), (UINT)quad.Vertices.size(), quantization, compressed.data(), signs.data());
+	GRiVertexCompressor::Decode(compressed.data(), (UINT)compressed.size(), quantization, decoded.data(), decodedSigns.data());
+	BOOST_CHECK(decodedSigns == signs);
+
+	// Without signs every vertex is right handed.
+	GRiVertexCompressor::Encode(quad.Vertices.data(), (UINT)quad.Vertices.size(), quantization, compressed.data());
+	GRiVertexCompressor::Decode(compressed.data(), (UINT)compressed.size(), quantization, decoded.data(), decodedSigns.data());
+	BOOST_CHECK(std::all_of(decodedSigns.begin(), decodedSigns.end(), [](float sign) { return sign == 1.0f; }));
+
+	// The corners of the shared edge have the same attributes on both sides of the mirror, they stay apart.
+	BOOST_CHECK_EQUAL(quad.WeldVertices(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(HalfFloat)
+{
+	// Every finite half survives the round trip.
+	for (UINT32 bits = 0; bits < 0x10000; bits++)
+	{
+		if (((bits >> 10) & 0x1F) == 0x1F)
+			continue;
+		float value = GRiVertexCompressor::HalfToFloat((UINT16)bits);
+		BOOST_REQUIRE_EQUAL(GRiVertexCompressor::FloatToHalf(value), bits);
+	}
+
+	// Ties round to even, values out of range go to infinity.
+	BOOST_CHECK_EQUAL(GRiVertexCompressor::FloatToHalf(1.0f + 1.0f / 2048.0f), 0x3C00);
+	BOOST_CHECK_EQUAL(GRiVertexCompressor::FloatToHalf(1.0f + 3.0f / 2048.0f), 0x3C02);
+	BOOST_CHECK_EQUAL(GRiVertexCompressor::FloatToHalf(70000.0f), 0x7C00);
+	BOOST_CHECK_EQUAL(GRiVertexCompressor::FloatToHalf(-70000.0f), 0xFC00);
+}
+
+BOOST_AUTO_TEST_CASE(Octahedral)
+{
+	std::mt19937 rng(1234);
+	std::normal_distribution<float> dist;
+	for (auto i = 0; i < 100000; i++)
+	{
+		float v[3] = { dist(rng), dist(rng), dist(rng) };
+		if (i < 6)
+		{
+			// The axes, where the folding flips.
+			v[0] = v[1] = v[2] = 0.0f;
+			v[i / 2] = i % 2 == 0 ? 1.0f : -1.0f;
+		}
+		float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		for (auto k = 0; k < 3; k++)
+			v[k] /= length;
+
+		INT16 octahedral[2];
+		float decoded[3];
+		GRiVertexCompressor::EncodeOctahedral(v, octahedral);
+		GRiVertexCompressor::DecodeOctahedral(octahedral, decoded);
+
+		// Within 0.01 degrees, from the cross product since the cosine of such angles rounds to 1.
+		float cross[3] = {
+			v[1] * decoded[2] - v[2] * decoded[1],
+			v[2] * decoded[0] - v[0] * decoded[2],
+			v[0] * decoded[1] - v[1] * decoded[0]
+		};
+		BOOST_REQUIRE_GT(v[0] * decoded[0] + v[1] * decoded[1] + v[2] * decoded[2], 0.0f);
+		BOOST_REQUIRE_LE(sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), sinf(0.01f * GGiEngineUtil::PI / 180.0f));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,242 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiDynamicAabbTree.h"
+
+#include <random>
+
+
+// Proxy as the test sees it. The tree never dereferences its scene objects, the slot index stands in for them.
+struct GRiTestProxy
+{
+	int ProxyId = -1;
+	GRiBoundingBox Bounds;
+};
+
+static GRiSceneObject* GetTestObject(size_t slot)
+{
+	return (GRiSceneObject*)(slot + 1);
+}
+
+static GRiBoundingBox CreateRandomBounds(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> posDist(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> extDist(0.1f, 30.0f);
+
+	GRiBoundingBox bounds;
+	for (auto k = 0; k < 3; k++)
+	{
+		bounds.Center[k] = posDist(rng);
+		bounds.Extents[k] = extDist(rng);
+	}
+	return bounds;
+}
+
+// Camera at position looking down +z, row-vector view projection with a [0, 1] depth range.
+static GGiFloat4x4 CreateViewProj(const float* position, float tanHalfFov, float aspect, float nearZ, float farZ)
+{
+	GGiFloat4x4 view = GGiFloat4x4::Identity();
+	for (auto k = 0; k < 3; k++)
+		view.SetElement(3, k, -position[k]);
+
+	GGiFloat4x4 proj = GGiFloat4x4::Identity();
+	proj.SetElement(0, 0, 1.0f / (tanHalfFov * aspect));
+	proj.SetElement(1, 1, 1.0f / tanHalfFov);
+	proj.SetElement(2, 2, farZ / (farZ - nearZ));
+	proj.SetElement(2, 3, 1.0f);
+	proj.SetElement(3, 2, -nearZ * farZ / (farZ - nearZ));
+	proj.SetElement(3, 3, 0.0f);
+
+	return view * proj;
+}
+
+// Sorted slots of the scene objects a query returned, every object at most once.
+static std::vector<size_t> GetSlots(const std::vector<GRiSceneObject*>& result)
+{
+	std::vector<size_t> slots;
+	for (auto so : result)
+		slots.push_back((size_t)so - 1);
+	std::sort(slots.begin(), slots.end());
+	BOOST_REQUIRE(std::adjacent_find(slots.begin(), slots.end()) == slots.end());
+	return slots;
+}
+
+// Runs every query type against the fat bounds of every live proxy and checks the tree itself. Returns the number
+// of proxies in the frustum.
+static size_t CheckQueries(GRiDynamicAabbTree& tree, const std::vector<GRiTestProxy>& proxies, std::mt19937& rng)
+{
+	BOOST_REQUIRE(tree.Validate());
+
+	int liveNum = 0;
+	std::vector<std::array<float, 6>> fatBounds(proxies.size());
+	for (auto i = 0u; i < proxies.size(); i++)
+	{
+		auto& proxy = proxies[i];
+		if (proxy.ProxyId == -1)
+			continue;
+		liveNum++;
+
+		BOOST_REQUIRE(tree.GetSceneObject(proxy.ProxyId) == GetTestObject(i));
+		tree.GetFatBounds(proxy.ProxyId, &fatBounds[i][0], &fatBounds[i][3]);
+		for (auto k = 0; k < 3; k++)
+		{
+			BOOST_REQUIRE_LE(fatBounds[i][k], proxy.Bounds.BoundMin(k));
+			BOOST_REQUIRE_GE(fatBounds[i][3 + k], proxy.Bounds.BoundMax(k));
+		}
+	}
+	BOOST_REQUIRE_EQUAL(tree.GetProxyNum(), liveNum);
+
+	// Balanced, an avl tree is at most about 1.44 log2(n) high.
+	if (liveNum > 0)
+		BOOST_REQUIRE_LE(tree.GetHeight(), (int)(1.45f * log2f((float)liveNum + 2.0f)) + 1);
+
+	auto bruteForce = [&](std::function<bool(const float*, const float*)> overlaps)
+	{
+		std::vector<size_t> slots;
+		for (auto i = 0u; i < proxies.size(); i++)
+		{
+			if (proxies[i].ProxyId != -1 && overlaps(&fatBounds[i][0], &fatBounds[i][3]))
+				slots.push_back(i);
+		}
+		return slots;
+	};
+
+	std::vector<GRiSceneObject*> result;
+
+	auto box = CreateRandomBounds(rng);
+	for (auto k = 0; k < 3; k++)
+		box.Extents[k] *= 5.0f;
+	tree.QueryBox(box, result);
+	BOOST_REQUIRE(GetSlots(result) == bruteForce([&](const float* bMin, const float* bMax)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			if (bMin[k] > box.BoundMax(k) || bMax[k] < box.BoundMin(k))
+				return false;
+		}
+		return true;
+	}));
+
+	result.clear();
+	float center[3] = { box.Center[0], box.Center[1], box.Center[2] };
+	float radius = box.Extents[0];
+	tree.QuerySphere(center, radius, result);
+	BOOST_REQUIRE(GetSlots(result) == bruteForce([&](const float* bMin, const float* bMax)
+	{
+		float distSq = 0.0f;
+		for (auto k = 0; k < 3; k++)
+		{
+			float d = max(max(bMin[k] - center[k], center[k] - bMax[k]), 0.0f);
+			distSq += d * d;
+		}
+		return distSq <= radius * radius;
+	}));
+
+	result.clear();
+	std::uniform_real_distribution<float> camDist(-600.0f, 0.0f);
+	float cameraPosition[3] = { camDist(rng) + 300.0f, camDist(rng) + 300.0f, camDist(rng) };
+	float planes[6][4];
+	GRiDynamicAabbTree::ExtractFrustumPlanes(CreateViewProj(cameraPosition, 0.5f, 1.5f, 1.0f, 600.0f), planes);
+	tree.QueryFrustum(planes, result);
+	BOOST_REQUIRE(GetSlots(result) == bruteForce([&](const float* bMin, const float* bMax)
+	{
+		for (auto p = 0; p < 6; p++)
+		{
+			float dMax = planes[p][3];
+			for (auto k = 0; k < 3; k++)
+				dMax += max(planes[p][k] * bMin[k], planes[p][k] * bMax[k]);
+			if (dMax < 0.0f)
+				return false;
+		}
+		return true;
+	}));
+
+	return result.size();
+}
+
+BOOST_AUTO_TEST_SUITE(GRiDynamicAabbTreeTest)
+
+// Random creates, small and large moves and destroys, the queries have to match after every step.
+BOOST_AUTO_TEST_CASE(RandomOperations)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+
+	GRiDynamicAabbTree tree;
+	std::vector<GRiTestProxy> proxies;
+	int reinsertedNum = 0;
+	int keptNum = 0;
+	size_t frustumHitNum = 0;
+	CheckQueries(tree, proxies, rng);
+
+	for (auto step = 0; step < 3000; step++)
+	{
+		float op = unitDist(rng);
+		size_t slot = rng() % (proxies.size() + 1);
+		if (slot == proxies.size() || op < 0.3f)
+		{
+			// Free slots are reused, so proxy ids get recycled.
+			auto freeSlot = std::find_if(proxies.begin(), proxies.end(), [](const GRiTestProxy& p) { return p.ProxyId == -1; });
+			if (freeSlot == proxies.end())
+				freeSlot = proxies.insert(proxies.end(), GRiTestProxy());
+			freeSlot->Bounds = CreateRandomBounds(rng);
+			freeSlot->ProxyId = tree.CreateProxy(freeSlot->Bounds, GetTestObject(freeSlot - proxies.begin()));
+		}
+		else if (proxies[slot].ProxyId == -1)
+		{
+			continue;
+		}
+		else if (op < 0.45f)
+		{
+			tree.DestroyProxy(proxies[slot].ProxyId);
+			proxies[slot].ProxyId = -1;
+		}
+		else
+		{
+			// Half of the moves stay within the fat bounds.
+			auto& proxy = proxies[slot];
+			if (op < 0.7f)
+			{
+				for (auto k = 0; k < 3; k++)
+					proxy.Bounds.Center[k] += (unitDist(rng) - 0.5f) * 0.5f;
+			}
+			else
+			{
+				proxy.Bounds = CreateRandomBounds(rng);
+			}
+			if (tree.MoveProxy(proxy.ProxyId, proxy.Bounds))
+				reinsertedNum++;
+			else
+				keptNum++;
+		}
+
+		frustumHitNum += CheckQueries(tree, proxies, rng);
+	}
+
+	BOOST_CHECK_GT(frustumHitNum, 0u);
+	BOOST_CHECK_GT(reinsertedNum, 0);
+	BOOST_CHECK_GT(keptNum, 0);
+
+	// Empty again.
+	for (auto& proxy : proxies)
+	{
+		if (proxy.ProxyId != -1)
+			tree.DestroyProxy(proxy.ProxyId);
+		proxy.ProxyId = -1;
+	}
+	CheckQueries(tree, proxies, rng);
+	BOOST_CHECK_EQUAL(tree.GetProxyNum(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidProxy)
+{
+	GRiDynamicAabbTree tree;
+	std::mt19937 rng(5678);
+	int proxyId = tree.CreateProxy(CreateRandomBounds(rng), GetTestObject(0));
+	tree.DestroyProxy(proxyId);
+
+	BOOST_CHECK_THROW(tree.DestroyProxy(proxyId), GGiException);
+	BOOST_CHECK_THROW(tree.MoveProxy(proxyId, CreateRandomBounds(rng)), GGiException);
+	BOOST_CHECK_THROW(tree.DestroyProxy(-1), GGiException);
+	BOOST_CHECK(tree.Validate());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiIndirectArgumentBuilder.h"
+
+#include <random>
+
+
+// Builds random draws into plain memory and reads every command back, checking its fields, its range
+// and the submission order within the range.
+static void TestRandom(GGiThreadPool* tp, UINT num, UINT pipelineNum)
+{
+	std::mt19937 rng(num + pipelineNum);
+
+	// Root constant buffer address, two root constants and the draw arguments, 8 byte aligned.
+	GRiIndirectCommandLayout layout;
+	layout.ConstantBufferOffset = 0;
+	layout.RootConstantOffset = sizeof(UINT64);
+	layout.RootConstantNum = 2;
+	layout.DrawArgumentsOffset = layout.RootConstantOffset + sizeof(UINT) * layout.RootConstantNum;
+	layout.Stride = (layout.DrawArgumentsOffset + sizeof(GRiDrawIndexedArguments) + 7) & ~7u;
+
+	std::vector<GRiIndirectDraw> draws(num);
+	for (auto i = 0u; i < num; i++)
+	{
+		draws[i].PipelineIndex = rng() % pipelineNum;
+		draws[i].ConstantBufferAddress = ((UINT64)rng() << 32) | rng();
+		draws[i].RootConstants[0] = rng();
+		draws[i].RootConstants[1] = rng();
+		draws[i].DrawArguments.IndexCountPerInstance = rng();
+		draws[i].DrawArguments.InstanceCount = rng();
+		draws[i].DrawArguments.StartIndexLocation = rng();
+		draws[i].DrawArguments.BaseVertexLocation = (INT)rng();
+		draws[i].DrawArguments.StartInstanceLocation = rng();
+	}
+
+	std::vector<UINT8> buffer((size_t)num * layout.Stride);
+
+	GRiIndirectArgumentBuilder builder;
+	builder.SetLayout(layout);
+	builder.Build(tp, draws, pipelineNum, buffer.data(), num);
+
+	auto& ranges = builder.GetRanges();
+	auto& commandDraws = builder.GetCommandDraws();
+
+	std::vector<UINT> drawCount(num, 0);
+	UINT command = 0;
+	for (auto r = 0u; r < ranges.size(); r++)
+	{
+		auto& range = ranges[r];
+		BOOST_REQUIRE_EQUAL(range.FirstCommand, command);
+		BOOST_REQUIRE_GT(range.CommandNum, 0u);
+		if (r > 0)
+			BOOST_REQUIRE_LT(ranges[r - 1].PipelineIndex, range.PipelineIndex);
+
+		for (auto c = range.FirstCommand; c < range.FirstCommand + range.CommandNum; c++)
+		{
+			UINT drawIndex = commandDraws[c];
+			BOOST_REQUIRE_LT(drawIndex, num);
+			BOOST_REQUIRE_EQUAL(draws[drawIndex].PipelineIndex, range.PipelineIndex);
+			if (c > range.FirstCommand)
+				BOOST_REQUIRE_LT(commandDraws[c - 1], drawIndex);
+			drawCount[drawIndex]++;
+
+			auto& draw = draws[drawIndex];
+			UINT8* data = buffer.data() + (size_t)c * layout.Stride;
+			UINT64 address;
+			UINT rootConstants[2];
+			GRiDrawIndexedArguments arguments;
+			memcpy(&address, data + layout.ConstantBufferOffset, sizeof(address));
+			memcpy(rootConstants, data + layout.RootConstantOffset, sizeof(rootConstants));
+			memcpy(&arguments, data + layout.DrawArgumentsOffset, sizeof(arguments));
+			BOOST_REQUIRE_EQUAL(address, draw.ConstantBufferAddress);
+			BOOST_REQUIRE_EQUAL(rootConstants[0], draw.RootConstants[0]);
+			BOOST_REQUIRE_EQUAL(rootConstants[1], draw.RootConstants[1]);
+			BOOST_REQUIRE_EQUAL(arguments.IndexCountPerInstance, draw.DrawArguments.IndexCountPerInstance);
+			BOOST_REQUIRE_EQUAL(arguments.InstanceCount, draw.DrawArguments.InstanceCount);
+			BOOST_REQUIRE_EQUAL(arguments.StartIndexLocation, draw.DrawArguments.StartIndexLocation);
+			BOOST_REQUIRE_EQUAL(arguments.BaseVertexLocation, draw.DrawArguments.BaseVertexLocation);
+			BOOST_REQUIRE_EQUAL(arguments.StartInstanceLocation, draw.DrawArguments.StartInstanceLocation);
+		}
+		command += range.CommandNum;
+	}
+
+	BOOST_REQUIRE_EQUAL(command, num);
+	for (auto count : drawCount)
+		BOOST_REQUIRE_EQUAL(count, 1u);
+}
+
+BOOST_AUTO_TEST_SUITE(GRiIndirectArgumentBuilderTest)
+
+BOOST_AUTO_TEST_CASE(SingleThreaded)
+{
+	for (auto num : { 0u, 1u, 5u, 1000u, 5000u })
+	{
+		for (auto pipelineNum : { 1u, 2u, 7u })
+			TestRandom(nullptr, num, pipelineNum);
+	}
+}
+
+// Above the parallel threshold the draws are counted and written in chunks.
+BOOST_AUTO_TEST_CASE(ThreadPool)
+{
+	GGiThreadPool tp(4);
+	for (auto num : { 1000u, 1024u, 5000u, 40000u })
+	{
+		for (auto pipelineNum : { 1u, 2u, 4u, 7u })
+			TestRandom(&tp, num, pipelineNum);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RejectsOverflow)
+{
+	GRiIndirectCommandLayout layout;
+	layout.Stride = sizeof(GRiDrawIndexedArguments);
+
+	GRiIndirectArgumentBuilder builder;
+	builder.SetLayout(layout);
+
+	std::vector<GRiIndirectDraw> draws(4);
+	std::vector<UINT8> buffer(3 * layout.Stride);
+	BOOST_CHECK_THROW(builder.Build(nullptr, draws, 1, buffer.data(), 3), GGiException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
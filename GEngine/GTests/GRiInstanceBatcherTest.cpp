@@ -0,0 +1,87 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiInstanceBatcher.h"
+
+#include <random>
+
+
+// Batches random keys and requires every draw to end up exactly once, in a batch of its own key, in submission
+// order, and no two batches to share a key.
+static void CheckRandomBatches(GGiThreadPool* tp, UINT num, UINT keyNum, UINT minInstanceNum, UINT maxInstanceNum)
+{
+	std::mt19937 rng(num + keyNum);
+
+	std::vector<UINT64> keys(num);
+	for (auto i = 0u; i < num; i++)
+		keys[i] = GRiInstanceBatcher::MakeBatchKey(rng() % 2, rng() % keyNum, rng() % 3, rng() % 4);
+
+	GRiInstanceBatcher batcher;
+	batcher.Build(tp, keys, minInstanceNum, maxInstanceNum);
+
+	auto& batches = batcher.GetBatches();
+	auto& instanceItems = batcher.GetInstanceItems();
+	auto& singleItems = batcher.GetSingleItems();
+
+	BOOST_REQUIRE_EQUAL(instanceItems.size() + singleItems.size(), num);
+	BOOST_REQUIRE_LE(instanceItems.size(), maxInstanceNum);
+
+	std::vector<UINT> itemCount(num, 0);
+	std::unordered_map<UINT64, UINT> batchKeys;
+	UINT nextInstance = 0;
+	for (auto& batch : batches)
+	{
+		BOOST_REQUIRE_EQUAL(batch.FirstInstance, nextInstance);
+		BOOST_REQUIRE_GE(batch.InstanceNum, minInstanceNum);
+		BOOST_REQUIRE(batchKeys.find(batch.Key) == batchKeys.end());
+		batchKeys[batch.Key] = batch.InstanceNum;
+
+		for (auto i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceNum; i++)
+		{
+			UINT item = instanceItems[i];
+			BOOST_REQUIRE_EQUAL(keys[item], batch.Key);
+			if (i > batch.FirstInstance)
+				BOOST_REQUIRE_GT(item, instanceItems[i - 1]);
+			itemCount[item]++;
+		}
+		nextInstance += batch.InstanceNum;
+	}
+
+	for (auto i = 0u; i < singleItems.size(); i++)
+	{
+		if (i > 0)
+			BOOST_REQUIRE_GT(singleItems[i], singleItems[i - 1]);
+		itemCount[singleItems[i]]++;
+	}
+
+	for (auto i = 0u; i < num; i++)
+		BOOST_REQUIRE_EQUAL(itemCount[i], 1u);
+
+	// Every batch holds all the draws of its key.
+	for (auto i = 0u; i < num; i++)
+	{
+		auto batchKey = batchKeys.find(keys[i]);
+		if (batchKey == batchKeys.end())
+			continue;
+		BOOST_REQUIRE_GT(batchKey->second, 0u);
+		batchKey->second--;
+	}
+	for (auto& batchKey : batchKeys)
+		BOOST_REQUIRE_EQUAL(batchKey.second, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE(GRiInstanceBatcherTest)
+
+BOOST_AUTO_TEST_CASE(RandomKeys)
+{
+	GGiThreadPool tp(4);
+	for (auto num : { 0u, 1u, 10u, 1000u, 50000u })
+	{
+		for (auto keyNum : { 1u, 7u, 100u })
+		{
+			CheckRandomBatches(nullptr, num, keyNum, 2, 0xFFFFFFFF);
+			CheckRandomBatches(&tp, num, keyNum, 2, 0xFFFFFFFF);
+			CheckRandomBatches(&tp, num, keyNum, 8, num / 2);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
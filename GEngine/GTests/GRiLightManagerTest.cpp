@@ -0,0 +1,308 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiLightManager.h"
+
+#include <random>
+
+
+// Camera at the origin looking down +z with a 90 degree field of view.
+static const float FrustumPlanes[6][4] = {
+	{ 0.70710678f, 0.0f, 0.70710678f, 0.0f },
+	{ -0.70710678f, 0.0f, 0.70710678f, 0.0f },
+	{ 0.0f, 0.70710678f, 0.70710678f, 0.0f },
+	{ 0.0f, -0.70710678f, 0.70710678f, 0.0f },
+	{ 0.0f, 0.0f, 1.0f, -1.0f },
+	{ 0.0f, 0.0f, -1.0f, 1000.0f }
+};
+
+// Registered light as the test sees it. Color[0] holds the id, so culled lists can be matched back.
+struct GRiTestLight
+{
+	GRiLightHandle Handle;
+	GRiLightType Type = GRiLightType::Point;
+	GRiPointLight Point;
+	GRiSpotlight Spot;
+	bool bAlive = true;
+};
+
+// Signed distance of the bounding sphere to the frustum, negative if it's entirely behind a plane.
+static float GetFrustumDistance(const GRiTestLight& light)
+{
+	float center[3];
+	float radius;
+	if (light.Type == GRiLightType::Point)
+	{
+		for (auto k = 0; k < 3; k++)
+			center[k] = light.Point.Position[k];
+		radius = light.Point.Range;
+	}
+	else
+	{
+		// Same sphere as the manager, around the cap for wide cones and around apex and rim for narrow ones.
+		auto& spot = light.Spot;
+		float len = sqrtf(spot.Direction[0] * spot.Direction[0] + spot.Direction[1] * spot.Direction[1] + spot.Direction[2] * spot.Direction[2]);
+		float cosAngle = cosf(spot.SpotlightAngle);
+		float centerDist = cosAngle < 0.70710678f ? spot.Range * cosAngle : spot.Range / (2.0f * cosAngle);
+		radius = cosAngle < 0.70710678f ? spot.Range * sinf(spot.SpotlightAngle) : centerDist;
+		for (auto k = 0; k < 3; k++)
+			center[k] = spot.Position[k] + spot.Direction[k] / len * centerDist;
+	}
+
+	float minDist = GGiEngineUtil::Infinity;
+	for (auto p = 0; p < 6; p++)
+	{
+		float dist = FrustumPlanes[p][0] * center[0] + FrustumPlanes[p][1] * center[1] + FrustumPlanes[p][2] * center[2] + FrustumPlanes[p][3];
+		minDist = min(minDist, dist + radius);
+	}
+	return minDist;
+}
+
+static void AddRandomLight(GRiLightManager& manager, std::vector<GRiTestLight>& lights, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> posDist(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> rangeDist(1.0f, 50.0f);
+	std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+
+	GRiTestLight light;
+	float id = (float)lights.size();
+	if (rng() % 4 == 3)
+	{
+		light.Type = GRiLightType::Spot;
+		light.Spot.Color[0] = id;
+		for (auto k = 0; k < 3; k++)
+			light.Spot.Position[k] = posDist(rng);
+		do
+		{
+			for (auto k = 0; k < 3; k++)
+				light.Spot.Direction[k] = unitDist(rng);
+		} while (fabsf(light.Spot.Direction[0]) + fabsf(light.Spot.Direction[1]) + fabsf(light.Spot.Direction[2]) < 0.1f);
+		light.Spot.Direction[3] = 0.0f;
+		light.Spot.Range = rangeDist(rng);
+		light.Spot.SpotlightAngle = 0.05f + 1.45f * (unitDist(rng) * 0.5f + 0.5f);
+		light.Handle = manager.AddSpotlight(light.Spot);
+	}
+	else
+	{
+		light.Type = GRiLightType::Point;
+		light.Point.Color[0] = id;
+		for (auto k = 0; k < 3; k++)
+			light.Point.Position[k] = posDist(rng);
+		light.Point.Range = rangeDist(rng);
+		light.Handle = manager.AddPointLight(light.Point);
+	}
+	lights.push_back(light);
+}
+
+// Checks the visible lists against a scalar sphere test. They hold the lights in registration slot order,
+// lights within a small margin of a plane may go either way.
+static void CheckVisibleLights(GRiLightManager& manager, const std::vector<GRiTestLight>& lights)
+{
+	const float margin = 1e-3f;
+
+	for (auto type : { GRiLightType::Point, GRiLightType::Spot })
+	{
+		std::vector<const GRiTestLight*> candidates;
+		for (auto& light : lights)
+		{
+			if (light.bAlive && light.Type == type)
+				candidates.push_back(&light);
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const GRiTestLight* a, const GRiTestLight* b)
+		{
+			return a->Handle.Index < b->Handle.Index;
+		}
+		);
+
+		std::vector<float> visibleIds;
+		if (type == GRiLightType::Point)
+		{
+			for (auto& l : manager.GetVisiblePointLights())
+				visibleIds.push_back(l.Color[0]);
+		}
+		else
+		{
+			for (auto& l : manager.GetVisibleSpotlights())
+				visibleIds.push_back(l.Color[0]);
+		}
+
+		UINT next = 0;
+		for (auto light : candidates)
+		{
+			float dist = GetFrustumDistance(*light);
+			if (dist < -margin)
+				continue;
+
+			float id = type == GRiLightType::Point ? light->Point.Color[0] : light->Spot.Color[0];
+			if (next < visibleIds.size() && visibleIds[next] == id)
+			{
+				auto& expected = lights[(UINT)id];
+				if (type == GRiLightType::Point)
+					BOOST_REQUIRE(memcmp(&manager.GetVisiblePointLights()[next], &expected.Point, sizeof(GRiPointLight)) == 0);
+				else
+					BOOST_REQUIRE(memcmp(&manager.GetVisibleSpotlights()[next], &expected.Spot, sizeof(GRiSpotlight)) == 0);
+				next++;
+			}
+			else
+			{
+				BOOST_REQUIRE_MESSAGE(dist <= margin, "Light " << id << " is inside the frustum but not visible.");
+			}
+		}
+		BOOST_REQUIRE_MESSAGE(next == visibleIds.size(), "Visible list holds culled or unordered lights.");
+	}
+}
+
+// Entries outside the changed range have to match the previous list.
+template<typename T>
+static void CheckChangedRange(const std::vector<T>& prevLights, const std::vector<T>& lights, GRiLightRange range)
+{
+	for (auto i = 0u; i < lights.size(); i++)
+	{
+		if (i >= range.First && i < range.First + range.Num)
+			continue;
+		BOOST_REQUIRE_LT(i, prevLights.size());
+		BOOST_REQUIRE(memcmp(&prevLights[i], &lights[i], sizeof(T)) == 0);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(GRiLightManagerTest)
+
+BOOST_AUTO_TEST_CASE(ChangedRanges)
+{
+	GRiLightManager manager;
+
+	GRiPointLight point;
+	point.Position[0] = 0.0f;
+	point.Position[1] = 0.0f;
+	point.Position[2] = 50.0f;
+	point.Range = 10.0f;
+	auto first = manager.AddPointLight(point);
+	manager.AddDirectionalLight(GRiDirectionalLight());
+
+	manager.Cull(nullptr, FrustumPlanes);
+	BOOST_CHECK_EQUAL(manager.GetVisiblePointLights().size(), 1u);
+	BOOST_CHECK_EQUAL(manager.GetChangedPointLightRange().Num, 1u);
+	BOOST_CHECK_EQUAL(manager.GetDirectionalLights().size(), 1u);
+	BOOST_CHECK(manager.HaveDirectionalLightsChanged());
+
+	// Nothing changed.
+	manager.Cull(nullptr, FrustumPlanes);
+	BOOST_CHECK_EQUAL(manager.GetChangedPointLightRange().Num, 0u);
+	BOOST_CHECK(!manager.HaveDirectionalLightsChanged());
+
+	auto second = manager.AddPointLight(point);
+	manager.Cull(nullptr, FrustumPlanes);
+	BOOST_CHECK_EQUAL(manager.GetChangedPointLightRange().First, 1u);
+	BOOST_CHECK_EQUAL(manager.GetChangedPointLightRange().Num, 1u);
+
+	// The second light moves to the front of the list.
+	manager.Remove(first);
+	BOOST_CHECK(!manager.IsValid(first));
+	manager.Cull(nullptr, FrustumPlanes);
+	BOOST_CHECK_EQUAL(manager.GetVisiblePointLights().size(), 1u);
+	BOOST_CHECK_EQUAL(manager.GetChangedPointLightRange().First, 0u);
+	BOOST_CHECK_EQUAL(manager.GetChangedPointLightRange().Num, 1u);
+
+	point.Position[2] = -50.0f;
+	manager.SetPointLight(second, point);
+	manager.Cull(nullptr, FrustumPlanes);
+	BOOST_CHECK_EQUAL(manager.GetVisiblePointLights().size(), 0u);
+	BOOST_CHECK_THROW(manager.SetSpotlight(second, GRiSpotlight()), GGiException);
+}
+
+BOOST_AUTO_TEST_CASE(MatchesReference)
+{
+	GGiThreadPool tp(4);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> moveDist(-20.0f, 20.0f);
+
+	GRiLightManager manager;
+	std::vector<GRiTestLight> lights;
+	for (auto i = 0; i < 5000; i++)
+		AddRandomLight(manager, lights, rng);
+	manager.AddDirectionalLight(GRiDirectionalLight());
+
+	manager.Cull(&tp, FrustumPlanes);
+	CheckVisibleLights(manager, lights);
+
+	for (auto frame = 0; frame < 8; frame++)
+	{
+		auto prevPointLights = manager.GetVisiblePointLights();
+		auto prevSpotlights = manager.GetVisibleSpotlights();
+
+		// Move some lights, remove some and add new ones into the freed slots.
+		for (auto& light : lights)
+		{
+			if (!light.bAlive || rng() % 10 != 0)
+				continue;
+
+			if (rng() % 4 == 0)
+			{
+				manager.Remove(light.Handle);
+				light.bAlive = false;
+			}
+			else if (light.Type == GRiLightType::Point)
+			{
+				light.Point.Position[0] += moveDist(rng);
+				manager.SetPointLight(light.Handle, light.Point);
+			}
+			else
+			{
+				light.Spot.Position[2] += moveDist(rng);
+				manager.SetSpotlight(light.Handle, light.Spot);
+			}
+		}
+		for (auto i = 0; i < 100; i++)
+			AddRandomLight(manager, lights, rng);
+
+		manager.Cull(frame % 2 == 0 ? &tp : nullptr, FrustumPlanes);
+		CheckVisibleLights(manager, lights);
+		CheckChangedRange(prevPointLights, manager.GetVisiblePointLights(), manager.GetChangedPointLightRange());
+		CheckChangedRange(prevSpotlights, manager.GetVisibleSpotlights(), manager.GetChangedSpotlightRange());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(GRiLightManagerBenchmark, *boost::unit_test::disabled())
+
+// Culls randomly scattered point lights and spotlights, moving a tenth of them every frame.
+BOOST_AUTO_TEST_CASE(Cull)
+{
+	GGiThreadPool tp(std::thread::hardware_concurrency());
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> moveDist(-0.5f, 0.5f);
+
+	for (auto lightNum : { 1000u, 10000u, 100000u })
+	{
+		GRiLightManager manager;
+		std::vector<GRiTestLight> lights;
+		for (auto i = 0u; i < lightNum; i++)
+			AddRandomLight(manager, lights, rng);
+
+		for (auto frame = 0; frame < 5; frame++)
+		{
+			for (auto& light : lights)
+			{
+				if (rng() % 10 != 0)
+					continue;
+
+				if (light.Type == GRiLightType::Point)
+				{
+					light.Point.Position[0] += moveDist(rng);
+					manager.SetPointLight(light.Handle, light.Point);
+				}
+				else
+				{
+					light.Spot.Position[0] += moveDist(rng);
+					manager.SetSpotlight(light.Handle, light.Spot);
+				}
+			}
+
+			manager.Cull(&tp, FrustumPlanes);
+			auto stats = manager.GetStats();
+			BOOST_CHECK_LE(stats.VisibleNum, stats.LightNum);
+			BOOST_TEST_MESSAGE("lights " << stats.LightNum << " visible " << stats.VisibleNum << " changed " << stats.ChangedNum << " cull " << stats.CullTime << " ms");
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,186 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiMeshCooker.h"
+#include "GRiMeshTestUtil.h"
+
+#include <fstream>
+
+
+#define TEST_COOKED_PATH "GRiMeshCookerTest.gmesh"
+
+#define TEST_SOURCE_HASH 0x0123456789ABCDEFull
+
+static std::vector<GRiMeshData> CreateNamedShapes()
+{
+	auto shapes = CreateTestShapes();
+	for (auto i = 0u; i < shapes.size(); i++)
+		shapes[i].SubmeshName = L"Shape" + std::to_wstring(i);
+	return shapes;
+}
+
+static void CookTestShapes(const std::vector<GRiMeshData>& shapes)
+{
+	GRiMeshCooker::Cook(L"" TEST_COOKED_PATH, TEST_SOURCE_HASH, shapes, true, true, true);
+}
+
+static GRiCookedMeshHeader ReadHeader()
+{
+	GRiCookedMeshHeader header;
+	std::ifstream file(TEST_COOKED_PATH, std::ios::in | std::ios::binary);
+	file.read((char*)&header, sizeof(header));
+	BOOST_REQUIRE(file.good());
+	return header;
+}
+
+static void Overwrite(UINT64 offset, const void* data, size_t byteSize)
+{
+	std::fstream file(TEST_COOKED_PATH, std::ios::in | std::ios::out | std::ios::binary);
+	file.seekp((std::streamoff)offset);
+	file.write((const char*)data, (std::streamsize)byteSize);
+	BOOST_REQUIRE(file.good());
+}
+
+static bool OpenTestFile()
+{
+	GRiCookedMesh cookedMesh;
+	return cookedMesh.Open(L"" TEST_COOKED_PATH, TEST_SOURCE_HASH);
+}
+
+BOOST_AUTO_TEST_SUITE(GRiMeshCookerTest)
+
+// Every submesh comes back with its name and the same triangles, along with its meshlets, the bvh and the sdf.
+BOOST_AUTO_TEST_CASE(CookOpenRoundTrip)
+{
+	auto shapes = CreateNamedShapes();
+	CookTestShapes(shapes);
+	BOOST_CHECK(!std::ifstream(TEST_COOKED_PATH ".tmp").is_open());
+
+	{
+		GRiCookedMesh cookedMesh;
+		BOOST_REQUIRE(cookedMesh.Open(L"" TEST_COOKED_PATH, TEST_SOURCE_HASH));
+		BOOST_REQUIRE_EQUAL(cookedMesh.GetSubmeshNum(), shapes.size());
+		BOOST_CHECK(cookedMesh.HasMeshlets());
+		BOOST_CHECK(!cookedMesh.HasSdf());
+
+		for (auto i = 0u; i < shapes.size(); i++)
+		{
+			auto& submesh = cookedMesh.GetSubmesh(i);
+			BOOST_CHECK(cookedMesh.GetSubmeshName(i) == shapes[i].SubmeshName);
+
+			GRiMeshData cooked;
+			cooked.Vertices.assign(cookedMesh.GetVertices() + submesh.BaseVertexLocation, cookedMesh.GetVertices() + cookedMesh.GetVertexNum());
+			cooked.Indices.assign(cookedMesh.GetIndices() + submesh.StartIndexLocation, cookedMesh.GetIndices() + submesh.StartIndexLocation + submesh.IndexCount);
+			CheckSameTriangles(shapes[i], cooked);
+
+			// The meshlets of a submesh cover its index range in order.
+			UINT nextIndex = submesh.StartIndexLocation;
+			for (auto m = submesh.FirstMeshlet; m < submesh.FirstMeshlet + submesh.MeshletNum; m++)
+			{
+				BOOST_REQUIRE_EQUAL(cookedMesh.GetMeshlets()[m].StartIndexLocation, nextIndex);
+				nextIndex += cookedMesh.GetMeshlets()[m].IndexCount;
+			}
+			BOOST_CHECK_EQUAL(nextIndex, submesh.StartIndexLocation + submesh.IndexCount);
+		}
+
+		// A ray straight down hits the top cap of the cylinder, the tallest shape, first.
+		auto bvh = cookedMesh.CreateBvh();
+		BOOST_REQUIRE(bvh != nullptr);
+		BOOST_CHECK_EQUAL(bvh->GetTriangleNum(), (int)(cookedMesh.GetIndexNum() / 3));
+
+		GRiRay ray;
+		ray.Origin[0] = 0.1f;
+		ray.Origin[1] = 10.0f;
+		ray.Origin[2] = 0.1f;
+		ray.Direction[0] = 0.0f;
+		ray.Direction[1] = -1.0f;
+		ray.Direction[2] = 0.0f;
+		float tHit;
+		UINT triangleIndex;
+		BOOST_REQUIRE(bvh->Intersect(ray, tHit, triangleIndex));
+		BOOST_CHECK_CLOSE(tHit, 8.5f, 1e-3f);
+	}
+
+	std::vector<float> sdf(8 * 8 * 8);
+	for (auto i = 0u; i < sdf.size(); i++)
+		sdf[i] = (float)i;
+	GRiMeshCooker::WriteSdf(L"" TEST_COOKED_PATH, 8, 2.0f, sdf.data());
+
+	{
+		GRiCookedMesh cookedMesh;
+		BOOST_REQUIRE(cookedMesh.Open(L"" TEST_COOKED_PATH, TEST_SOURCE_HASH));
+		BOOST_REQUIRE(cookedMesh.HasSdf());
+		BOOST_CHECK_EQUAL(cookedMesh.GetSdfResolution(), 8);
+		BOOST_CHECK_EQUAL(cookedMesh.GetSdfExtent(), 2.0f);
+		BOOST_CHECK(std::equal(sdf.begin(), sdf.end(), cookedMesh.GetSdf()));
+		BOOST_CHECK_EQUAL(cookedMesh.GetSubmeshNum(), shapes.size());
+	}
+
+	// Cooking again replaces the file, the sdf has to be added again.
+	CookTestShapes(shapes);
+	{
+		GRiCookedMesh cookedMesh;
+		BOOST_REQUIRE(cookedMesh.Open(L"" TEST_COOKED_PATH, TEST_SOURCE_HASH));
+		BOOST_CHECK(!cookedMesh.HasSdf());
+	}
+
+	std::remove(TEST_COOKED_PATH);
+}
+
+// Files that would make the loader read out of range are rejected, so that they are cooked again.
+BOOST_AUTO_TEST_CASE(OpenRejectsBrokenFiles)
+{
+	auto shapes = CreateNamedShapes();
+
+	GRiCookedMesh missing;
+	BOOST_CHECK(!missing.Open(L"GRiMeshCookerTest.missing", TEST_SOURCE_HASH));
+
+	CookTestShapes(shapes);
+	{
+		GRiCookedMesh cookedMesh;
+		BOOST_CHECK(!cookedMesh.Open(L"" TEST_COOKED_PATH, TEST_SOURCE_HASH + 1));
+	}
+
+	// An index past the vertices.
+	auto header = ReadHeader();
+	UINT32 badIndex = header.VertexNum;
+	Overwrite(header.IndexOffset + (header.IndexNum - 1) * sizeof(UINT32), &badIndex, sizeof(badIndex));
+	BOOST_CHECK(!OpenTestFile());
+
+	// An interior node pointing back at itself.
+	CookTestShapes(shapes);
+	header = ReadHeader();
+	BOOST_REQUIRE_GT(header.BvhNodeNum, 1u);
+	GRiBvhNode root;
+	{
+		std::ifstream file(TEST_COOKED_PATH, std::ios::in | std::ios::binary);
+		file.seekg((std::streamoff)header.BvhNodeOffset);
+		file.read((char*)&root, sizeof(root));
+	}
+	BOOST_REQUIRE_EQUAL(root.Count, 0);
+	root.Offset = 0;
+	Overwrite(header.BvhNodeOffset, &root, sizeof(root));
+	BOOST_CHECK(!OpenTestFile());
+
+	// A primitive past the triangles.
+	CookTestShapes(shapes);
+	header = ReadHeader();
+	UINT32 badPrimitive = header.IndexNum / 3;
+	Overwrite(header.BvhPrimitiveOffset, &badPrimitive, sizeof(badPrimitive));
+	BOOST_CHECK(!OpenTestFile());
+
+	// A file cut short.
+	CookTestShapes(shapes);
+	header = ReadHeader();
+	{
+		std::vector<char> data((size_t)header.FileSize / 2);
+		std::ifstream source(TEST_COOKED_PATH, std::ios::in | std::ios::binary);
+		source.read(data.data(), (std::streamsize)data.size());
+		source.close();
+		std::ofstream file(TEST_COOKED_PATH, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(data.data(), (std::streamsize)data.size());
+	}
+	BOOST_CHECK(!OpenTestFile());
+
+	std::remove(TEST_COOKED_PATH);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
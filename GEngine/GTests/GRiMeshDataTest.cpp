@@ -0,0 +1,84 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiMeshData.h"
+#include "GRiMeshTestUtil.h"
+
+#include <set>
+
+
+// Unwelds the mesh, every corner gets a vertex of its own.
+static GRiMeshData Unweld(const GRiMeshData& meshData)
+{
+	GRiMeshData ret;
+	for (auto index : meshData.Indices)
+	{
+		ret.Indices.push_back((uint32_t)ret.Vertices.size());
+		ret.Vertices.push_back(meshData.Vertices[index]);
+	}
+	return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(GRiMeshDataTest)
+
+// Welding the unwelded shapes gets back to at most their vertex count with the same triangles. Corners of a vertex
+// whose triangles disagree on the tangent sign, like the poles of the sphere, stay apart.
+BOOST_AUTO_TEST_CASE(WeldRestoresShapes)
+{
+	for (auto& shape : CreateTestShapes())
+	{
+		auto unwelded = Unweld(shape);
+		auto welded = unwelded;
+		UINT removed = welded.WeldVertices();
+
+		std::vector<float> cornerSigns(unwelded.Vertices.size());
+		GRiMeshData::ComputeTangentSigns(unwelded.Vertices.data(), (UINT)unwelded.Vertices.size(), unwelded.Indices.data(), (UINT)unwelded.Indices.size(), cornerSigns.data());
+		std::set<std::pair<uint32_t, float>> frames;
+		for (size_t c = 0; c < shape.Indices.size(); c++)
+			frames.insert({ shape.Indices[c], cornerSigns[c] });
+
+		BOOST_CHECK_EQUAL(removed, unwelded.Vertices.size() - welded.Vertices.size());
+		BOOST_CHECK_LE(welded.Vertices.size(), frames.size());
+		CheckSameTriangles(unwelded, welded);
+	}
+}
+
+// Offsets below the epsilon are only merged when welding with a tolerance.
+BOOST_AUTO_TEST_CASE(WeldEpsilon)
+{
+	GRiMeshData quad;
+	quad.Vertices = {
+		GRiVertex(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f),
+		GRiVertex(0.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f),
+		GRiVertex(1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f),
+		GRiVertex(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f),
+		GRiVertex(1.0f, 1.00001f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f),
+		GRiVertex(1.0f, 0.0f, -0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f)
+	};
+	quad.Indices = { 0, 1, 2, 3, 4, 5 };
+
+	auto exact = quad;
+	BOOST_CHECK_EQUAL(exact.WeldVertices(), 1u);
+	BOOST_CHECK_EQUAL(exact.Vertices.size(), 5u);
+
+	auto snapped = quad;
+	BOOST_CHECK_EQUAL(snapped.WeldVertices(1e-3f), 2u);
+	BOOST_CHECK_EQUAL(snapped.Vertices.size(), 4u);
+	BOOST_CHECK_EQUAL(snapped.Indices[2], snapped.Indices[4]);
+}
+
+// A broken index throws before any vertex is moved.
+BOOST_AUTO_TEST_CASE(WeldRejectsBadIndices)
+{
+	auto shape = Unweld(CreateTestShapes()[0]);
+	shape.Indices.back() = (uint32_t)shape.Vertices.size();
+	auto original = shape;
+
+	BOOST_CHECK_THROW(shape.WeldVertices(), GGiException);
+	BOOST_REQUIRE_EQUAL(shape.Vertices.size(), original.Vertices.size());
+	BOOST_CHECK(memcmp(shape.Vertices.data(), original.Vertices.data(), shape.Vertices.size() * sizeof(GRiVertex)) == 0);
+	BOOST_CHECK(shape.Indices == original.Indices);
+
+	GRiMeshData empty;
+	BOOST_CHECK_EQUAL(empty.WeldVertices(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
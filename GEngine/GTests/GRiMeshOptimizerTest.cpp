@@ -0,0 +1,89 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiMeshOptimizer.h"
+#include "GRiMeshTestUtil.h"
+
+
+BOOST_AUTO_TEST_SUITE(GRiMeshOptimizerTest)
+
+// Every shape keeps its triangles and no pass makes the cache behaviour worse.
+BOOST_AUTO_TEST_CASE(GeometryGenerator)
+{
+	for (auto& shape : CreateTestShapes())
+	{
+		GRiMeshData optimized = shape;
+		auto stats = GRiMeshOptimizer::Optimize(optimized);
+
+		CheckSameTriangles(shape, optimized);
+		BOOST_CHECK_LE(stats.ACMRAfter, stats.ACMRBefore);
+		BOOST_CHECK_LE(stats.ATVRAfter, stats.ATVRBefore);
+		BOOST_CHECK_GE(stats.ClusterNum, 1u);
+		BOOST_TEST_MESSAGE("triangles " << stats.TriangleNum << " ACMR " << stats.ACMRBefore << " -> " << stats.ACMRAfter <<
+			" ATVR " << stats.ATVRBefore << " -> " << stats.ATVRAfter << " clusters " << stats.ClusterNum);
+	}
+}
+
+// Vertices no triangle references are dropped and the rest come in the order the triangles fetch them.
+BOOST_AUTO_TEST_CASE(VertexFetchOrder)
+{
+	GRiGeometryGenerator geoGen;
+	auto shape = geoGen.CreateSphere(0.5f, 20, 20);
+	GRiMeshData unused = shape;
+	unused.Vertices.insert(unused.Vertices.begin(), shape.Vertices.begin(), shape.Vertices.begin() + 10);
+	for (auto& index : unused.Indices)
+		index += 10;
+
+	GRiMeshData optimized = unused;
+	GRiMeshOptimizer::OptimizeVertexFetch(optimized);
+	CheckSameTriangles(unused, optimized);
+	BOOST_CHECK_EQUAL(optimized.Vertices.size(), shape.Vertices.size());
+
+	uint32_t next = 0;
+	for (auto index : optimized.Indices)
+	{
+		BOOST_REQUIRE_LE(index, next);
+		if (index == next)
+			next++;
+	}
+	BOOST_CHECK_EQUAL(next, optimized.Vertices.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(GRiMeshOptimizerShippedModelTest, *boost::unit_test::disabled())
+
+// Optimizes every submesh of the shipped models like the cooker does and reports the cache behaviour per model.
+BOOST_AUTO_TEST_CASE(ShippedModels)
+{
+	for (auto& model : ImportShippedModels())
+	{
+		GRiMeshOptimizationStats modelStats;
+		for (auto& submesh : model.Submeshes)
+		{
+			GRiMeshData optimized = submesh;
+			auto stats = GRiMeshOptimizer::Optimize(optimized);
+
+			CheckSameTriangles(submesh, optimized);
+			BOOST_CHECK_LE(stats.ACMRAfter, stats.ACMRBefore);
+			BOOST_CHECK_LE(stats.ATVRAfter, stats.ATVRBefore);
+
+			// Sums of the transformed vertices, divided into ratios over the whole model below.
+			modelStats.TriangleNum += stats.TriangleNum;
+			modelStats.VertexNum += stats.VertexNum;
+			modelStats.ACMRBefore += stats.ACMRBefore * stats.TriangleNum;
+			modelStats.ACMRAfter += stats.ACMRAfter * stats.TriangleNum;
+			modelStats.ATVRBefore += stats.ATVRBefore * stats.VertexNum;
+			modelStats.ATVRAfter += stats.ATVRAfter * stats.VertexNum;
+			modelStats.ClusterNum += stats.ClusterNum;
+		}
+
+		BOOST_REQUIRE_GT(modelStats.TriangleNum, 0u);
+		float triangleNum = (float)modelStats.TriangleNum;
+		float vertexNum = (float)modelStats.VertexNum;
+		BOOST_TEST_MESSAGE(model.Name << " submeshes " << model.Submeshes.size() << " triangles " << modelStats.TriangleNum <<
+			" ACMR " << modelStats.ACMRBefore / triangleNum << " -> " << modelStats.ACMRAfter / triangleNum <<
+			" ATVR " << modelStats.ATVRBefore / vertexNum << " -> " << modelStats.ATVRAfter / vertexNum <<
+			" clusters " << modelStats.ClusterNum);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,88 @@
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "GRiMeshData.h"
+#include "GRiGeometryGenerator.h"
+#include "GRiFilmboxManager.h"
+#include "GRiTestDataUtil.h"
+
+
+// The shapes of GRiGeometryGenerator the mesh processing tests run on.
+inline std::vector<GRiMeshData> CreateTestShapes()
+{
+	GRiGeometryGenerator geoGen;
+	std::vector<GRiMeshData> shapes;
+	shapes.push_back(geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3));
+	shapes.push_back(geoGen.CreateSphere(0.5f, 40, 40));
+	shapes.push_back(geoGen.CreateGeosphere(0.5f, 4));
+	shapes.push_back(geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 40, 40));
+	shapes.push_back(geoGen.CreateGrid(20.0f, 20.0f, 100, 100));
+	return shapes;
+}
+
+// Requires both meshes to draw the same triangles with the same winding, in whatever order.
+inline void CheckSameTriangles(const GRiMeshData& original, const GRiMeshData& processed)
+{
+	BOOST_REQUIRE_EQUAL(original.Indices.size(), processed.Indices.size());
+
+	// Every triangle as the bytes of its vertices, rotated to start with the smallest one to keep the winding.
+	auto collect = [](const GRiMeshData& meshData)
+	{
+		std::vector<std::string> triangles;
+		for (size_t t = 0; t + 2 < meshData.Indices.size(); t += 3)
+		{
+			std::string corners[3];
+			for (int k = 0; k < 3; k++)
+			{
+				BOOST_REQUIRE_LT(meshData.Indices[t + k], meshData.Vertices.size());
+				auto vertex = (const char*)&meshData.Vertices[meshData.Indices[t + k]];
+				corners[k].assign(vertex, sizeof(GRiVertex));
+			}
+			int first = 0;
+			for (int k = 1; k < 3; k++)
+			{
+				if (corners[k] < corners[first])
+					first = k;
+			}
+			triangles.push_back(corners[first] + corners[(first + 1) % 3] + corners[(first + 2) % 3]);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	};
+
+	BOOST_REQUIRE(collect(original) == collect(processed));
+}
+
+// Submeshes of one of the shipped models, by the file it comes from.
+struct GRiTestModel
+{
+	std::string Name;
+	std::vector<GRiMeshData> Submeshes;
+};
+
+// The .fbx models under Debug/Project/Content/Models, imported and welded the way GCore hands them to the cooker.
+// Needs the FBX SDK runtime next to the test executable.
+inline std::vector<GRiTestModel> ImportShippedModels()
+{
+	const char* files[] = {
+		"Cube.fbx",
+		"UserQuad.fbx",
+		"Cerberus.fbx",
+		"Helmet/Helmet.fbx",
+		"Rifle_1/Rifle_1.fbx",
+		"Rifle_2/Rifle_2.fbx",
+		"Stool/Stool.fbx"
+	};
+
+	GRiFilmboxManager filmboxManager;
+	std::vector<GRiTestModel> models;
+	for (auto file : files)
+	{
+		GRiTestModel model;
+		model.Name = file;
+		auto path = GetSolutionPath(std::string("Debug/Project/Content/Models/") + file);
+		BOOST_REQUIRE_MESSAGE(filmboxManager.ImportFbxFile_Mesh(std::wstring(path.begin(), path.end()), model.Submeshes), "Can't import " << file << ".");
+		BOOST_REQUIRE(!model.Submeshes.empty());
+		models.push_back(std::move(model));
+	}
+	return models;
+}
@@ -0,0 +1,129 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiMeshletBuilder.h"
+#include "GRiMeshOptimizer.h"
+#include "GRiMeshTestUtil.h"
+
+#include <random>
+
+
+static float Dot3(const float* a, const float* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Requires the meshlets to cover the indices of built in order within the limits, and the bounds and cones to
+// hold every triangle of their meshlet.
+static void CheckMeshlets(const GRiMeshData& built, const std::vector<GRiMeshlet>& meshlets, UINT maxVertexNum, UINT maxTriangleNum)
+{
+	std::unordered_set<uint32_t> meshletVertices;
+	UINT expectedStart = 0;
+	for (auto& meshlet : meshlets)
+	{
+		BOOST_REQUIRE_EQUAL(meshlet.StartIndexLocation, expectedStart);
+		BOOST_REQUIRE_GT(meshlet.IndexCount, 0u);
+		BOOST_REQUIRE_EQUAL(meshlet.IndexCount % 3, 0u);
+		BOOST_REQUIRE_LE(meshlet.IndexCount, maxTriangleNum * 3);
+		BOOST_REQUIRE_LE((size_t)meshlet.StartIndexLocation + meshlet.IndexCount, built.Indices.size());
+		expectedStart += meshlet.IndexCount;
+
+		meshletVertices.clear();
+		for (auto i = meshlet.StartIndexLocation; i < meshlet.StartIndexLocation + meshlet.IndexCount; i++)
+		{
+			meshletVertices.insert(built.Indices[i]);
+
+			// Relative tolerance for the rounding of the bounds.
+			auto& p = built.Vertices[built.Indices[i]].Position;
+			float tolerance = 1e-5f * (1.0f + fabsf(p[0]) + fabsf(p[1]) + fabsf(p[2]));
+			float d[3];
+			for (auto k = 0; k < 3; k++)
+			{
+				BOOST_REQUIRE_LE(fabsf(p[k] - meshlet.BoundsCenter[k]), meshlet.BoundsExtents[k] + tolerance);
+				d[k] = p[k] - meshlet.Center[k];
+			}
+			BOOST_REQUIRE_LE(sqrtf(Dot3(d, d)), meshlet.Radius + tolerance);
+		}
+		BOOST_REQUIRE_LE(meshletVertices.size(), maxVertexNum);
+
+		if (meshlet.ConeCutoff < 1.0f)
+		{
+			float minDot = sqrtf(1.0f - meshlet.ConeCutoff * meshlet.ConeCutoff);
+			for (auto i = meshlet.StartIndexLocation; i < meshlet.StartIndexLocation + meshlet.IndexCount; i += 3)
+			{
+				auto& p0 = built.Vertices[built.Indices[i]].Position;
+				auto& p1 = built.Vertices[built.Indices[i + 1]].Position;
+				auto& p2 = built.Vertices[built.Indices[i + 2]].Position;
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float length = sqrtf(Dot3(normal, normal));
+				if (length > 0.0f)
+					BOOST_REQUIRE_GE(Dot3(normal, meshlet.ConeAxis) / length, minDot - 1e-4f);
+			}
+		}
+	}
+	BOOST_REQUIRE_EQUAL(expectedStart, built.Indices.size());
+}
+
+BOOST_AUTO_TEST_SUITE(GRiMeshletBuilderTest)
+
+BOOST_AUTO_TEST_CASE(GeometryGenerator)
+{
+	for (auto& shape : CreateTestShapes())
+	{
+		GRiMeshData built = shape;
+		GRiMeshOptimizer::Optimize(built);
+		std::vector<GRiMeshlet> meshlets;
+		auto stats = GRiMeshletBuilder::Build(built, meshlets);
+
+		CheckSameTriangles(shape, built);
+		CheckMeshlets(built, meshlets, MESHLET_MAX_VERTEX_NUM, MESHLET_MAX_TRIANGLE_NUM);
+		BOOST_CHECK_EQUAL(stats.MeshletNum, meshlets.size());
+		BOOST_CHECK_EQUAL(stats.TriangleNum, built.Indices.size() / 3);
+		BOOST_TEST_MESSAGE("meshlets " << stats.MeshletNum << " triangles " << stats.AverageTriangleNum << " vertices " << stats.AverageVertexNum << " cones " << stats.ConeNum);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(SmallLimits)
+{
+	for (auto& shape : CreateTestShapes())
+	{
+		GRiMeshData built = shape;
+		std::vector<GRiMeshlet> meshlets;
+		GRiMeshletBuilder::Build(built, meshlets, 16, 20);
+
+		CheckSameTriangles(shape, built);
+		CheckMeshlets(built, meshlets, 16, 20);
+	}
+}
+
+// Disconnected triangles in random order, every meshlet has to fall back to the grid search.
+BOOST_AUTO_TEST_CASE(ShuffledTriangles)
+{
+	GRiGeometryGenerator geoGen;
+	auto grid = geoGen.CreateGrid(10.0f, 10.0f, 60, 60);
+
+	std::vector<UINT> order(grid.Indices.size() / 3);
+	for (auto t = 0u; t < order.size(); t++)
+		order[t] = t;
+	std::mt19937 rng(1234);
+	std::shuffle(order.begin(), order.end(), rng);
+
+	GRiMeshData soup;
+	for (auto t : order)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			soup.Vertices.push_back(grid.Vertices[grid.Indices[t * 3 + k]]);
+			soup.Indices.push_back((uint32_t)soup.Vertices.size() - 1);
+		}
+	}
+
+	GRiMeshData built = soup;
+	std::vector<GRiMeshlet> meshlets;
+	GRiMeshletBuilder::Build(built, meshlets);
+
+	CheckSameTriangles(soup, built);
+	CheckMeshlets(built, meshlets, MESHLET_MAX_VERTEX_NUM, MESHLET_MAX_TRIANGLE_NUM);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,418 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiMeshletCuller.h"
+#include "GRiMeshletBuilder.h"
+#include "GRiMeshOptimizer.h"
+#include "GRiMeshTestUtil.h"
+
+#include <random>
+
+
+struct GRiTestMeshlets
+{
+	GRiMeshData MeshData;
+	std::vector<GRiMeshlet> Meshlets;
+	GRiMeshletSet Set;
+};
+
+// Optimized and split into meshlets the way the cooker does it.
+static std::unique_ptr<GRiTestMeshlets> CreateMeshlets(const GRiMeshData& meshData)
+{
+	std::unique_ptr<GRiTestMeshlets> mesh(new GRiTestMeshlets());
+	mesh->MeshData = meshData;
+	GRiMeshOptimizer::Optimize(mesh->MeshData);
+	GRiMeshletBuilder::Build(mesh->MeshData, mesh->Meshlets);
+	mesh->Set.Init(mesh->Meshlets.data(), (UINT)mesh->Meshlets.size());
+	return mesh;
+}
+
+static std::vector<std::unique_ptr<GRiTestMeshlets>> CreateTestMeshlets()
+{
+	std::vector<std::unique_ptr<GRiTestMeshlets>> meshes;
+	for (auto& shape : CreateTestShapes())
+		meshes.push_back(CreateMeshlets(shape));
+	return meshes;
+}
+
+// Inward planes of a 90 degree view from camera along the unit vector forward, left handed.
+static void GetViewPlanes(const float* camera, const float* forward, float nearZ, float farZ, float planes[6][4])
+{
+	const float invSqrt2 = 0.70710678f;
+
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	if (fabsf(forward[1]) > 0.99f)
+	{
+		up[0] = 1.0f;
+		up[1] = 0.0f;
+	}
+	float right[3] = {
+		up[1] * forward[2] - up[2] * forward[1],
+		up[2] * forward[0] - up[0] * forward[2],
+		up[0] * forward[1] - up[1] * forward[0]
+	};
+	float rightLength = sqrtf(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+	for (auto k = 0; k < 3; k++)
+		right[k] /= rightLength;
+	float trueUp[3] = {
+		forward[1] * right[2] - forward[2] * right[1],
+		forward[2] * right[0] - forward[0] * right[2],
+		forward[0] * right[1] - forward[1] * right[0]
+	};
+
+	for (auto k = 0; k < 3; k++)
+	{
+		planes[0][k] = (forward[k] + right[k]) * invSqrt2;  // left
+		planes[1][k] = (forward[k] - right[k]) * invSqrt2;  // right
+		planes[2][k] = (forward[k] + trueUp[k]) * invSqrt2; // bottom
+		planes[3][k] = (forward[k] - trueUp[k]) * invSqrt2; // top
+		planes[4][k] = forward[k];                          // near
+		planes[5][k] = -forward[k];                         // far
+	}
+	for (auto p = 0; p < 6; p++)
+		planes[p][3] = -(planes[p][0] * camera[0] + planes[p][1] * camera[1] + planes[p][2] * camera[2]);
+	planes[4][3] -= nearZ;
+	planes[5][3] += farZ;
+}
+
+// Camera v of viewNum spread evenly over the sphere of the given radius around center, looking at it.
+static void GetSphereView(UINT v, UINT viewNum, const float* center, float radius, float* camera, float* forward)
+{
+	const float goldenAngle = GGiEngineUtil::PI * (3.0f - sqrtf(5.0f));
+
+	float dir[3];
+	dir[1] = 1.0f - 2.0f * (v + 0.5f) / viewNum;
+	float ring = sqrtf(max(1.0f - dir[1] * dir[1], 0.0f));
+	dir[0] = ring * cosf(goldenAngle * v);
+	dir[2] = ring * sinf(goldenAngle * v);
+	for (auto k = 0; k < 3; k++)
+	{
+		camera[k] = center[k] + dir[k] * radius;
+		forward[k] = -dir[k];
+	}
+}
+
+// Visibility of the meshlets [firstMeshlet, firstMeshlet + meshletNum) from the ranges of the draw. The ranges
+// have to be sorted, merged and made of whole meshlets.
+static std::vector<bool> GetVisibleMeshlets(GRiMeshletCuller& culler, UINT draw, const GRiTestMeshlets& mesh, UINT firstMeshlet, UINT meshletNum, UINT indexOffset)
+{
+	std::vector<bool> visible(meshletNum, false);
+	auto ranges = culler.GetRanges(draw);
+	UINT m = firstMeshlet;
+	for (auto r = 0u; r < culler.GetRangeNum(draw); r++)
+	{
+		UINT start = ranges[r * 2];
+		UINT end = start + ranges[r * 2 + 1];
+		if (r > 0)
+			BOOST_REQUIRE_GT(start, ranges[r * 2 - 2] + ranges[r * 2 - 1]);
+
+		while (m < firstMeshlet + meshletNum && mesh.Meshlets[m].StartIndexLocation + indexOffset < start)
+			m++;
+		for (auto index = start; index < end; m++)
+		{
+			BOOST_REQUIRE_LT(m, firstMeshlet + meshletNum);
+			BOOST_REQUIRE_EQUAL(mesh.Meshlets[m].StartIndexLocation + indexOffset, index);
+			visible[m - firstMeshlet] = true;
+			index += mesh.Meshlets[m].IndexCount;
+		}
+	}
+	return visible;
+}
+
+BOOST_AUTO_TEST_SUITE(GRiMeshletCullerTest)
+
+// Draws in mesh space, checked with the scalar sphere and cone tests. Meshlets within a small margin of a plane or
+// of the cone limit may go either way.
+BOOST_AUTO_TEST_CASE(MatchesReference)
+{
+	const float identity[4][4] = {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	};
+	const float margin = 1e-4f;
+	const UINT viewNum = 32;
+	const float center[3] = { 0.0f, 0.0f, 0.0f };
+
+	GGiThreadPool tp(4);
+	auto meshes = CreateTestMeshlets();
+	GRiMeshletCuller culler;
+	culler.Reset();
+	for (auto& mesh : meshes)
+		culler.AddDraw(&mesh->Set, 0, mesh->Set.GetMeshletNum(), &identity[0][0], 0);
+
+	UINT culledNum = 0;
+	for (auto v = 0u; v < viewNum; v++)
+	{
+		float camera[3], forward[3], planes[6][4];
+		GetSphereView(v, viewNum, center, 2.0f + (float)(v % 4), camera, forward);
+		GetViewPlanes(camera, forward, 0.01f, 20.0f, planes);
+
+		culler.Cull(v % 2 == 0 ? &tp : nullptr, planes, camera);
+		auto stats = culler.GetStats();
+		BOOST_CHECK_EQUAL(stats.DrawNum, meshes.size());
+		BOOST_CHECK_EQUAL(stats.TriangleNum, stats.FrustumCulledTriangleNum + stats.BackfaceCulledTriangleNum + stats.VisibleTriangleNum);
+
+		for (auto d = 0u; d < meshes.size(); d++)
+		{
+			auto& mesh = *meshes[d];
+			auto visible = GetVisibleMeshlets(culler, d, mesh, 0, mesh.Set.GetMeshletNum(), 0);
+			for (auto i = 0u; i < mesh.Meshlets.size(); i++)
+			{
+				auto& meshlet = mesh.Meshlets[i];
+
+				float dist = GGiEngineUtil::Infinity;
+				for (auto p = 0; p < 6; p++)
+					dist = min(dist, planes[p][0] * meshlet.Center[0] + planes[p][1] * meshlet.Center[1] + planes[p][2] * meshlet.Center[2] + planes[p][3] + meshlet.Radius);
+
+				float d3[3] = { meshlet.Center[0] - camera[0], meshlet.Center[1] - camera[1], meshlet.Center[2] - camera[2] };
+				float length = sqrtf(d3[0] * d3[0] + d3[1] * d3[1] + d3[2] * d3[2]);
+				float coneDist = meshlet.ConeCutoff * length + meshlet.Radius - (d3[0] * meshlet.ConeAxis[0] + d3[1] * meshlet.ConeAxis[1] + d3[2] * meshlet.ConeAxis[2]);
+				dist = min(dist, coneDist);
+
+				if (dist < -margin)
+					BOOST_REQUIRE_MESSAGE(!visible[i], "Meshlet " << i << " of draw " << d << " is visible.");
+				else if (dist > margin)
+					BOOST_REQUIRE_MESSAGE(visible[i], "Meshlet " << i << " of draw " << d << " is culled.");
+				if (!visible[i])
+					culledNum++;
+			}
+		}
+	}
+	BOOST_CHECK_GT(culledNum, 0u);
+	BOOST_TEST_MESSAGE(culledNum << " meshlets culled");
+}
+
+// Draws of parts of the meshes with random, also mirrored and non-uniformly scaled, world matrices. A culled meshlet
+// has to have all its vertices behind one plane, or every triangle facing away from the camera.
+BOOST_AUTO_TEST_CASE(Conservative)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+	auto meshes = CreateTestMeshlets();
+
+	GGiThreadPool tp(4);
+	GRiMeshletCuller culler;
+	UINT culledNum = 0;
+	for (auto iteration = 0; iteration < 100; iteration++)
+	{
+		struct GRiTestDraw
+		{
+			GRiTestMeshlets* Mesh;
+			UINT FirstMeshlet;
+			UINT MeshletNum;
+			float World[4][4];
+		};
+		std::vector<GRiTestDraw> draws(1 + iteration % 40);
+
+		culler.Reset();
+		for (auto d = 0u; d < draws.size(); d++)
+		{
+			auto& draw = draws[d];
+			draw.Mesh = meshes[rng() % meshes.size()].get();
+			UINT meshletNum = draw.Mesh->Set.GetMeshletNum();
+			draw.FirstMeshlet = iteration % 3 == 0 ? 0 : rng() % meshletNum;
+			draw.MeshletNum = iteration % 3 == 0 ? meshletNum : 1 + rng() % (meshletNum - draw.FirstMeshlet);
+
+			float a = unitDist(rng) * 3.0f;
+			float b = unitDist(rng) * 3.0f;
+			float scale[3] = { 0.5f + fabsf(unitDist(rng)), 0.5f + fabsf(unitDist(rng)), 0.5f + fabsf(unitDist(rng)) };
+			if (iteration % 7 == 0)
+				scale[0] = -scale[0];
+			float rotation[3][3] = {
+				{ cosf(a), sinf(a), 0.0f },
+				{ -sinf(a) * cosf(b), cosf(a) * cosf(b), sinf(b) },
+				{ sinf(a) * sinf(b), -cosf(a) * sinf(b), cosf(b) }
+			};
+			for (auto i = 0; i < 3; i++)
+			{
+				for (auto j = 0; j < 3; j++)
+					draw.World[i][j] = scale[i] * rotation[i][j];
+				draw.World[i][3] = 0.0f;
+				draw.World[3][i] = unitDist(rng) * 2.0f;
+			}
+			draw.World[3][3] = 1.0f;
+
+			BOOST_REQUIRE_EQUAL(culler.AddDraw(&draw.Mesh->Set, draw.FirstMeshlet, draw.MeshletNum, &draw.World[0][0], 100000 * d), d);
+		}
+
+		float camera[3] = { unitDist(rng) * 4.0f, unitDist(rng) * 4.0f, unitDist(rng) * 4.0f };
+		float forward[3] = { -camera[0], -camera[1], -camera[2] };
+		float forwardLength = sqrtf(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+		for (auto k = 0; k < 3; k++)
+			forward[k] /= forwardLength;
+		float planes[6][4];
+		GetViewPlanes(camera, forward, 0.1f, 5.0f, planes);
+		culler.Cull(&tp, planes, camera);
+
+		for (auto d = 0u; d < draws.size(); d++)
+		{
+			auto& draw = draws[d];
+			auto& meshData = draw.Mesh->MeshData;
+			auto visible = GetVisibleMeshlets(culler, d, *draw.Mesh, draw.FirstMeshlet, draw.MeshletNum, 100000 * d);
+
+			std::vector<float> positions(meshData.Vertices.size() * 3);
+			for (auto v = 0u; v < meshData.Vertices.size(); v++)
+			{
+				auto& p = meshData.Vertices[v].Position;
+				for (auto k = 0; k < 3; k++)
+					positions[v * 3 + k] = p[0] * draw.World[0][k] + p[1] * draw.World[1][k] + p[2] * draw.World[2][k] + draw.World[3][k];
+			}
+
+			for (auto i = 0u; i < draw.MeshletNum; i++)
+			{
+				if (visible[i])
+					continue;
+				culledNum++;
+
+				auto& meshlet = draw.Mesh->Meshlets[draw.FirstMeshlet + i];
+				UINT start = meshlet.StartIndexLocation;
+				UINT end = start + meshlet.IndexCount;
+
+				bool bOutside = false;
+				for (auto p = 0; p < 6 && !bOutside; p++)
+				{
+					bOutside = true;
+					for (auto index = start; index < end && bOutside; index++)
+					{
+						const float* w = &positions[meshData.Indices[index] * 3];
+						if (planes[p][0] * w[0] + planes[p][1] * w[1] + planes[p][2] * w[2] + planes[p][3] >= -1e-4f)
+							bOutside = false;
+					}
+				}
+				if (bOutside)
+					continue;
+
+				for (auto index = start; index < end; index += 3)
+				{
+					const float* p0 = &positions[meshData.Indices[index] * 3];
+					const float* p1 = &positions[meshData.Indices[index + 1] * 3];
+					const float* p2 = &positions[meshData.Indices[index + 2] * 3];
+					float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+					if (normalLength == 0.0f)
+						continue;
+					float facing = (normal[0] * (p0[0] - camera[0]) + normal[1] * (p0[1] - camera[1]) + normal[2] * (p0[2] - camera[2])) / normalLength;
+					BOOST_REQUIRE_MESSAGE(facing >= -1e-4f, "Meshlet " << draw.FirstMeshlet + i << " of draw " << d << " is culled with a front facing triangle.");
+				}
+			}
+		}
+	}
+	BOOST_CHECK_GT(culledNum, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+// Culls the submeshes as one mesh, a draw each, from viewNum cameras around it at distance times the radius of its
+// bounds. Returns the statistics summed over the views.
+static GRiMeshletCullingStats CullFromAround(GRiMeshletCuller& culler, const std::vector<GRiTestMeshlets*>& submeshes, UINT viewNum, float distance)
+{
+	const float identity[4][4] = {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	};
+
+	// Bounds of the mesh from the boxes of its meshlets.
+	float vMin[3] = { GGiEngineUtil::Infinity, GGiEngineUtil::Infinity, GGiEngineUtil::Infinity };
+	float vMax[3] = { -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity, -GGiEngineUtil::Infinity };
+	culler.Reset();
+	for (auto submesh : submeshes)
+	{
+		for (auto& meshlet : submesh->Meshlets)
+		{
+			for (auto k = 0; k < 3; k++)
+			{
+				vMin[k] = min(vMin[k], meshlet.BoundsCenter[k] - meshlet.BoundsExtents[k]);
+				vMax[k] = max(vMax[k], meshlet.BoundsCenter[k] + meshlet.BoundsExtents[k]);
+			}
+		}
+		culler.AddDraw(&submesh->Set, 0, submesh->Set.GetMeshletNum(), &identity[0][0], 0);
+	}
+	float center[3];
+	float radius = 0.0f;
+	for (auto k = 0; k < 3; k++)
+	{
+		center[k] = (vMin[k] + vMax[k]) / 2;
+		radius += (vMax[k] - vMin[k]) * (vMax[k] - vMin[k]) / 4;
+	}
+	radius = max(sqrtf(radius), 1e-3f);
+
+	GRiMeshletCullingStats meshStats;
+	for (auto v = 0u; v < viewNum; v++)
+	{
+		float camera[3], forward[3], planes[6][4];
+		GetSphereView(v, viewNum, center, distance * radius, camera, forward);
+		GetViewPlanes(camera, forward, 0.01f * radius, (distance + 1.0f) * radius, planes);
+		culler.Cull(nullptr, planes, camera);
+
+		auto stats = culler.GetStats();
+		meshStats.TriangleNum += stats.TriangleNum;
+		meshStats.FrustumCulledTriangleNum += stats.FrustumCulledTriangleNum;
+		meshStats.BackfaceCulledTriangleNum += stats.BackfaceCulledTriangleNum;
+		meshStats.VisibleTriangleNum += stats.VisibleTriangleNum;
+		meshStats.CullTime += stats.CullTime;
+	}
+	return meshStats;
+}
+
+static std::string FormatCullingStats(const GRiMeshletCullingStats& stats, UINT viewNum)
+{
+	std::ostringstream line;
+	line << "rejected " << 100.0f * (stats.TriangleNum - stats.VisibleTriangleNum) / stats.TriangleNum << "%" <<
+		" frustum " << 100.0f * stats.FrustumCulledTriangleNum / stats.TriangleNum << "%" <<
+		" cone " << 100.0f * stats.BackfaceCulledTriangleNum / stats.TriangleNum << "%" <<
+		" " << stats.CullTime / viewNum << " ms per view";
+	return line.str();
+}
+
+BOOST_AUTO_TEST_SUITE(GRiMeshletCullerBenchmark, *boost::unit_test::disabled())
+
+// Culls every shape on its own from 64 cameras around it, at 3 times the radius of its bounds. Reports the share of
+// the triangles each test rejects and the time per view.
+BOOST_AUTO_TEST_CASE(Cull)
+{
+	const UINT viewNum = 64;
+	const float distance = 3.0f;
+
+	auto meshes = CreateTestMeshlets();
+	GRiMeshletCuller culler;
+	for (auto& mesh : meshes)
+	{
+		auto stats = CullFromAround(culler, { mesh.get() }, viewNum, distance);
+		BOOST_CHECK_EQUAL(stats.TriangleNum, mesh->Set.GetTriangleNum() * viewNum);
+		BOOST_TEST_MESSAGE("meshlets " << mesh->Set.GetMeshletNum() << " triangles " << mesh->Set.GetTriangleNum() << " " << FormatCullingStats(stats, viewNum));
+	}
+}
+
+// Same views around every shipped model, with its submeshes welded, optimized and split into meshlets like the
+// cooker does it, one draw each.
+BOOST_AUTO_TEST_CASE(ShippedModels)
+{
+	const UINT viewNum = 64;
+	const float distance = 3.0f;
+
+	GRiMeshletCuller culler;
+	for (auto& model : ImportShippedModels())
+	{
+		std::vector<std::unique_ptr<GRiTestMeshlets>> submeshes;
+		std::vector<GRiTestMeshlets*> draws;
+		UINT meshletNum = 0;
+		UINT triangleNum = 0;
+		for (auto& submesh : model.Submeshes)
+		{
+			submeshes.push_back(CreateMeshlets(submesh));
+			draws.push_back(submeshes.back().get());
+			meshletNum += submeshes.back()->Set.GetMeshletNum();
+			triangleNum += submeshes.back()->Set.GetTriangleNum();
+		}
+
+		auto stats = CullFromAround(culler, draws, viewNum, distance);
+		BOOST_CHECK_EQUAL(stats.TriangleNum, triangleNum * viewNum);
+		BOOST_TEST_MESSAGE(model.Name << " meshlets " << meshletNum << " triangles " << triangleNum << " " << FormatCullingStats(stats, viewNum));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,383 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiOcclusionCullingRasterizer.h"
+#include "GRiLightManager.h"
+#include "GRiTestDataUtil.h"
+
+#include <random>
+
+
+// Depth readback size and reversed depth range of the renderer.
+static const int BufferWidth = 256;
+static const int BufferHeight = 128;
+static const float NearZ = 1.0f;
+static const float FarZ = 50000.0f;
+
+// Reversed depth perspective projection looking down +z from the origin, and its inverse.
+struct GRiTestProjection
+{
+	float ViewProj[4][4];
+	__m128 Rows[4];
+	__m128 InvRows[4];
+
+	GRiTestProjection()
+	{
+		float a = NearZ / (NearZ - FarZ);
+		float b = -FarZ * NearZ / (NearZ - FarZ);
+		float scaleY = 1.0f / tanf(0.5f);
+		float scaleX = scaleY * (float)BufferHeight / (float)BufferWidth;
+
+		float viewProj[4][4] = {
+			{ scaleX, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, scaleY, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, a, 1.0f },
+			{ 0.0f, 0.0f, b, 0.0f }
+		};
+		float invViewProj[4][4] = {
+			{ 1.0f / scaleX, 0.0f, 0.0f, 0.0f },
+			{ 0.0f, 1.0f / scaleY, 0.0f, 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 1.0f / b },
+			{ 0.0f, 0.0f, 1.0f, -a / b }
+		};
+		for (auto i = 0; i < 4; i++)
+		{
+			for (auto j = 0; j < 4; j++)
+				ViewProj[i][j] = viewProj[i][j];
+			Rows[i] = _mm_loadu_ps(viewProj[i]);
+			InvRows[i] = _mm_loadu_ps(invViewProj[i]);
+		}
+	}
+
+	float GetDepth(float viewZ) const
+	{
+		return ViewProj[2][2] + ViewProj[3][2] / viewZ;
+	}
+};
+
+// Depth readback as dumped by the occlusion culling of GDxRenderer, a frame of the shipped scene.
+static std::vector<float> LoadCapturedDepth()
+{
+	auto data = ReadTestFile("Debug/depth.raw");
+	BOOST_REQUIRE_EQUAL(data.size(), BufferWidth * BufferHeight * sizeof(float));
+	std::vector<float> depth(BufferWidth * BufferHeight);
+	memcpy(depth.data(), data.data(), data.size());
+	return depth;
+}
+
+// Supplements the captured depth with known geometry. A wall at z = 100 on the left half, a wall at z = 500 on the top right quarter and sky everywhere else.
+static std::vector<float> CreateDepth(const GRiTestProjection& proj)
+{
+	std::vector<float> depth(BufferWidth * BufferHeight);
+	for (auto y = 0; y < BufferHeight; y++)
+	{
+		for (auto x = 0; x < BufferWidth; x++)
+		{
+			float d = 0.0f;
+			if (x < BufferWidth / 2)
+				d = proj.GetDepth(100.0f);
+			else if (y < BufferHeight / 2)
+				d = proj.GetDepth(500.0f);
+			depth[y * BufferWidth + x] = d;
+		}
+	}
+	return depth;
+}
+
+static GRiOcclusionCullingRasterizer& InitRasterizer(GRiTestProjection& proj, std::vector<float>& depth)
+{
+	auto& rasterizer = GRiOcclusionCullingRasterizer::GetInstance();
+	rasterizer.Init(BufferWidth, BufferHeight, NearZ, FarZ, true);
+	rasterizer.ReprojectToMaskedBuffer(depth.data(), proj.Rows, proj.InvRows);
+	return rasterizer;
+}
+
+// Inward facing, normalized frustum planes of the projection, reversed depth keeps z between 0 and w.
+static void GetFrustumPlanes(const GRiTestProjection& proj, float planes[6][4])
+{
+	const int axes[6] = { 0, 0, 1, 1, 2, 2 };
+	const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f };
+	for (auto p = 0; p < 6; p++)
+	{
+		for (auto k = 0; k < 4; k++)
+		{
+			float w = p == 5 ? 0.0f : proj.ViewProj[k][3];
+			planes[p][k] = w + signs[p] * proj.ViewProj[k][axes[p]];
+		}
+		float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+		for (auto k = 0; k < 4; k++)
+			planes[p][k] /= len;
+	}
+}
+
+static GRiBoundingBox CreateBox(float x, float y, float z, float extent)
+{
+	GRiBoundingBox box;
+	box.Center[0] = x;
+	box.Center[1] = y;
+	box.Center[2] = z;
+	for (auto k = 0; k < 3; k++)
+		box.Extents[k] = extent;
+	return box;
+}
+
+// Every pixel under the screen rectangle of a hidden box has to be nearer than the nearest point of the box in
+// the reprojected depth the masked buffer was built from. Boxes reaching in front of the near plane can't be hidden.
+static bool IsHiddenByDepth(const GRiTestProjection& proj, const std::vector<float>& reprojected, const GRiBoundingBox& box)
+{
+	float rect[4] = { (float)BufferWidth, 0.0f, (float)BufferHeight, 0.0f };
+	float maxZ = 0.0f;
+	for (auto i = 0; i < 8; i++)
+	{
+		float corner[3] = {
+			box.Center[0] + ((i & 1) ? box.Extents[0] : -box.Extents[0]),
+			box.Center[1] + ((i & 2) ? box.Extents[1] : -box.Extents[1]),
+			box.Center[2] + ((i & 4) ? box.Extents[2] : -box.Extents[2])
+		};
+
+		float clip[4];
+		for (auto j = 0; j < 4; j++)
+			clip[j] = corner[0] * proj.ViewProj[0][j] + corner[1] * proj.ViewProj[1][j] + corner[2] * proj.ViewProj[2][j] + proj.ViewProj[3][j];
+		if (clip[3] < NearZ)
+			return false;
+
+		float x = (clip[0] / clip[3] + 1) * 0.5f * BufferWidth;
+		float y = (-clip[1] / clip[3] + 1) * 0.5f * BufferHeight;
+		rect[0] = min(rect[0], x);
+		rect[1] = max(rect[1], x);
+		rect[2] = min(rect[2], y);
+		rect[3] = max(rect[3], y);
+		maxZ = max(maxZ, clip[2] / clip[3]);
+	}
+
+	int xMin = max(0, min(BufferWidth - 1, (int)rect[0]));
+	int xMax = max(0, min(BufferWidth - 1, (int)rect[1]));
+	int yMin = max(0, min(BufferHeight - 1, (int)rect[2]));
+	int yMax = max(0, min(BufferHeight - 1, (int)rect[3]));
+	for (auto y = yMin; y <= yMax; y++)
+	{
+		for (auto x = xMin; x <= xMax; x++)
+		{
+			if (reprojected[y * BufferWidth + x] <= maxZ)
+				return false;
+		}
+	}
+	return true;
+}
+
+BOOST_AUTO_TEST_SUITE(GRiOcclusionCullingRasterizerTest)
+
+BOOST_AUTO_TEST_CASE(BoundsAgainstWalls)
+{
+	GRiTestProjection proj;
+	auto depth = CreateDepth(proj);
+	auto& rasterizer = InitRasterizer(proj, depth);
+
+	std::vector<GRiBoundingBox> boxes = {
+		CreateBox(-60.0f, 0.0f, 300.0f, 20.0f),	// behind the left wall
+		CreateBox(60.0f, -20.0f, 300.0f, 10.0f),	// in front of the sky
+		CreateBox(-20.0f, 0.0f, 60.0f, 10.0f),	// in front of the left wall
+		CreateBox(-10.0f, 0.0f, 100.0f, 20.0f),	// crossing the left wall
+		CreateBox(0.0f, 0.0f, 0.5f, 5.0f),		// reaching in front of the near plane
+		CreateBox(400.0f, 150.0f, 2000.0f, 50.0f)	// behind the top right wall
+	};
+	const bool expected[] = { false, true, true, true, true, false };
+
+	bool visible[_countof(expected)];
+	rasterizer.RectTestBoundsMaskedMT(nullptr, boxes.data(), (int)boxes.size(), proj.Rows, visible);
+	for (auto i = 0u; i < boxes.size(); i++)
+		BOOST_CHECK_MESSAGE(visible[i] == expected[i], "Box " << i << " visibility is " << visible[i] << ".");
+}
+
+BOOST_AUTO_TEST_CASE(HiddenBoundsMatchDepth)
+{
+	GRiTestProjection proj;
+	auto depth = CreateDepth(proj);
+	auto& rasterizer = InitRasterizer(proj, depth);
+
+	std::vector<float> reprojected(BufferWidth * BufferHeight);
+	rasterizer.Reproject(depth.data(), reprojected.data(), proj.Rows, proj.InvRows);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> xyDist(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> zDist(0.0f, 3000.0f);
+	std::uniform_real_distribution<float> extentDist(0.5f, 50.0f);
+	const int boxNum = 5000;
+	std::vector<GRiBoundingBox> boxes(boxNum);
+	for (auto& box : boxes)
+	{
+		// Spread over the view, with some boxes outside the screen and in front of the near plane.
+		float z = zDist(rng);
+		box = CreateBox(xyDist(rng) * z * 1.2f, xyDist(rng) * z * 0.6f, z, extentDist(rng));
+	}
+
+	GGiThreadPool tp(4);
+	std::unique_ptr<bool[]> visible(new bool[boxNum]);
+	std::unique_ptr<bool[]> visibleMT(new bool[boxNum]);
+	rasterizer.RectTestBoundsMaskedMT(nullptr, boxes.data(), boxNum, proj.Rows, visible.get());
+	rasterizer.RectTestBoundsMaskedMT(&tp, boxes.data(), boxNum, proj.Rows, visibleMT.get());
+
+	int hiddenNum = 0;
+	for (auto i = 0; i < boxNum; i++)
+	{
+		BOOST_REQUIRE_EQUAL(visible[i], visibleMT[i]);
+		if (visible[i])
+			continue;
+
+		BOOST_REQUIRE_MESSAGE(IsHiddenByDepth(proj, reprojected, boxes[i]), "Box " << i << " is culled but not hidden.");
+		hiddenNum++;
+	}
+	BOOST_CHECK_GT(hiddenNum, 0);
+	BOOST_TEST_MESSAGE(hiddenNum << " of " << boxNum << " boxes hidden");
+}
+
+// Point lights and spotlights in front of the captured frame. Every light the manager drops as hidden has to lie
+// behind the captured depth at every sampled point of its sphere or cone.
+BOOST_AUTO_TEST_CASE(LightsAgainstCapturedDepth)
+{
+	GRiTestProjection proj;
+	auto depth = LoadCapturedDepth();
+	InitRasterizer(proj, depth);
+
+	float planes[6][4];
+	GetFrustumPlanes(proj, planes);
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+	std::uniform_real_distribution<float> xyDist(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> zDist(5.0f, 600.0f);
+	std::uniform_real_distribution<float> rangeDist(0.5f, 30.0f);
+
+	GRiLightManager manager;
+	std::vector<GRiPointLight> pointLights;
+	std::vector<GRiSpotlight> spotlights;
+	for (auto i = 0; i < 4000; i++)
+	{
+		float z = zDist(rng);
+		float position[3] = { xyDist(rng) * z * 1.2f, xyDist(rng) * z * 0.6f, z };
+		if (i % 2 == 0)
+		{
+			GRiPointLight light;
+			light.Color[0] = (float)pointLights.size();
+			for (auto k = 0; k < 3; k++)
+				light.Position[k] = position[k];
+			light.Range = rangeDist(rng);
+			manager.AddPointLight(light);
+			pointLights.push_back(light);
+		}
+		else
+		{
+			GRiSpotlight light;
+			light.Color[0] = (float)spotlights.size();
+			for (auto k = 0; k < 3; k++)
+			{
+				light.Position[k] = position[k];
+				light.Direction[k] = xyDist(rng);
+			}
+			light.Direction[3] = 0.0f;
+			light.Range = rangeDist(rng);
+			light.SpotlightAngle = 0.05f + 1.45f * unitDist(rng);
+			manager.AddSpotlight(light);
+			spotlights.push_back(light);
+		}
+	}
+
+	// Lights inside the frustum, then the ones that survive the masked buffer as well.
+	GGiThreadPool tp(4);
+	manager.Cull(&tp, planes);
+	std::vector<bool> pointInFrustum(pointLights.size()), spotInFrustum(spotlights.size());
+	for (auto& light : manager.GetVisiblePointLights())
+		pointInFrustum[(size_t)light.Color[0]] = true;
+	for (auto& light : manager.GetVisibleSpotlights())
+		spotInFrustum[(size_t)light.Color[0]] = true;
+
+	manager.Cull(&tp, planes, proj.Rows);
+	std::vector<bool> pointVisible(pointLights.size()), spotVisible(spotlights.size());
+	for (auto& light : manager.GetVisiblePointLights())
+		pointVisible[(size_t)light.Color[0]] = true;
+	for (auto& light : manager.GetVisibleSpotlights())
+		spotVisible[(size_t)light.Color[0]] = true;
+
+	// Reversed depth, the captured depth has to be nearer, so greater, than the sample wherever it's on screen.
+	auto isBehindDepth = [&](const float* point)
+	{
+		float clip[4];
+		for (auto j = 0; j < 4; j++)
+			clip[j] = point[0] * proj.ViewProj[0][j] + point[1] * proj.ViewProj[1][j] + point[2] * proj.ViewProj[2][j] + proj.ViewProj[3][j];
+		if (clip[3] < NearZ)
+			return false;
+
+		float x = (clip[0] / clip[3] + 1) * 0.5f * BufferWidth;
+		float y = (-clip[1] / clip[3] + 1) * 0.5f * BufferHeight;
+		if (x < 0.0f || x >= BufferWidth || y < 0.0f || y >= BufferHeight)
+			return true;
+		return depth[(int)y * BufferWidth + (int)x] > clip[2] / clip[3];
+	};
+
+	// Samples the ball of radius range around the position, restricted to the cone for spotlights.
+	auto isVolumeBehindDepth = [&](const float* position, const float* direction, float range, float cosAngle)
+	{
+		if (!isBehindDepth(position))
+			return false;
+
+		const int stepNum = 16;
+		for (auto r = 1; r <= 4; r++)
+		{
+			for (auto i = 0; i <= stepNum; i++)
+			{
+				float cosTheta = 1.0f - 2.0f * i / stepNum;
+				float sinTheta = sqrtf(max(0.0f, 1.0f - cosTheta * cosTheta));
+				for (auto j = 0; j < 2 * stepNum; j++)
+				{
+					float phi = GGiEngineUtil::PI * j / stepNum;
+					float dir[3] = { sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta };
+					if (direction != nullptr && dir[0] * direction[0] + dir[1] * direction[1] + dir[2] * direction[2] < cosAngle)
+						continue;
+
+					float point[3];
+					for (auto k = 0; k < 3; k++)
+						point[k] = position[k] + dir[k] * range * r / 4;
+					if (!isBehindDepth(point))
+						return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	int inFrustumNum = 0, hiddenNum = 0;
+	for (auto i = 0u; i < pointLights.size(); i++)
+	{
+		BOOST_REQUIRE(pointInFrustum[i] || !pointVisible[i]);
+		if (!pointInFrustum[i])
+			continue;
+		inFrustumNum++;
+		if (pointVisible[i])
+			continue;
+
+		hiddenNum++;
+		auto& light = pointLights[i];
+		BOOST_REQUIRE_MESSAGE(isVolumeBehindDepth(light.Position, nullptr, light.Range, 0.0f), "Point light " << i << " is culled but not hidden.");
+	}
+	for (auto i = 0u; i < spotlights.size(); i++)
+	{
+		BOOST_REQUIRE(spotInFrustum[i] || !spotVisible[i]);
+		if (!spotInFrustum[i])
+			continue;
+		inFrustumNum++;
+		if (spotVisible[i])
+			continue;
+
+		hiddenNum++;
+		auto& light = spotlights[i];
+		float len = sqrtf(light.Direction[0] * light.Direction[0] + light.Direction[1] * light.Direction[1] + light.Direction[2] * light.Direction[2]);
+		float direction[3] = { light.Direction[0] / len, light.Direction[1] / len, light.Direction[2] / len };
+		BOOST_REQUIRE_MESSAGE(isVolumeBehindDepth(light.Position, direction, light.Range, cosf(light.SpotlightAngle)), "Spotlight " << i << " is culled but not hidden.");
+	}
+
+	auto stats = manager.GetStats();
+	BOOST_CHECK_EQUAL(stats.OccludedNum, (UINT)hiddenNum);
+	BOOST_CHECK_GT(hiddenNum, 0);
+	BOOST_CHECK_LT(hiddenNum, inFrustumNum);
+	BOOST_TEST_MESSAGE(hiddenNum << " of " << inFrustumNum << " lights in the frustum hidden");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
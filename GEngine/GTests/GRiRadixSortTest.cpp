@@ -0,0 +1,72 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiRadixSort.h"
+
+#include <random>
+
+
+// Sorts random keys of the given bit width and compares the result with std::stable_sort.
+static void CheckRandomSort(GRiRadixSort& sorter, GGiThreadPool* tp, UINT num, UINT keyBits)
+{
+	std::mt19937_64 rng(num + keyBits);
+	UINT64 keyMask = keyBits >= 64 ? ~(UINT64)0 : (((UINT64)1 << keyBits) - 1);
+
+	std::vector<UINT64> keys(num);
+	std::vector<UINT> values(num);
+	std::vector<std::pair<UINT64, UINT>> reference(num);
+	for (auto i = 0u; i < num; i++)
+	{
+		keys[i] = rng() & keyMask;
+		values[i] = i;
+		reference[i] = std::make_pair(keys[i], i);
+	}
+
+	std::stable_sort(reference.begin(), reference.end(),
+		[](const std::pair<UINT64, UINT>& a, const std::pair<UINT64, UINT>& b)
+	{
+		return a.first < b.first;
+	}
+	);
+
+	sorter.Sort(tp, keys, values);
+
+	BOOST_REQUIRE_EQUAL(keys.size(), num);
+	BOOST_REQUIRE_EQUAL(values.size(), num);
+	for (auto i = 0u; i < num; i++)
+	{
+		BOOST_REQUIRE_EQUAL(keys[i], reference[i].first);
+		BOOST_REQUIRE_EQUAL(values[i], reference[i].second);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(GRiRadixSortTest)
+
+// Below and above the parallel threshold, with and without a thread pool, reusing one sorter.
+BOOST_AUTO_TEST_CASE(MatchesStableSort)
+{
+	GGiThreadPool tp(4);
+	GRiRadixSort sorter;
+	for (auto num : { 0u, 1u, 100u, 4095u, 4096u, 100000u })
+	{
+		for (auto keyBits : { 1u, 8u, 20u, 33u, 64u })
+		{
+			CheckRandomSort(sorter, nullptr, num, keyBits);
+			CheckRandomSort(sorter, &tp, num, keyBits);
+		}
+	}
+}
+
+// Digits every key shares are skipped.
+BOOST_AUTO_TEST_CASE(SkipsSharedDigits)
+{
+	GRiRadixSort sorter;
+	std::vector<UINT64> keys = { 0x0100000000000003ull, 0x0100000000000001ull, 0x0200000000000002ull };
+	std::vector<UINT> values = { 0, 1, 2 };
+	sorter.Sort(nullptr, keys, values);
+
+	BOOST_CHECK_EQUAL(sorter.GetLastPassNum(), 2u);
+	BOOST_CHECK_EQUAL(values[0], 1u);
+	BOOST_CHECK_EQUAL(values[1], 0u);
+	BOOST_CHECK_EQUAL(values[2], 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
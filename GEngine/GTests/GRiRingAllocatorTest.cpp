@@ -0,0 +1,107 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiRingAllocator.h"
+
+#include <random>
+
+
+// Runs random frames of random allocations with a lagging fence and checks that no two live allocations
+// overlap, that every allocation is aligned and that the ring drains completely.
+static void TestRandom(UINT64 capacity, UINT frameNum, UINT maxAllocationNum, UINT64 maxAllocationSize, UINT frameLatency)
+{
+	std::mt19937 rng((UINT)capacity ^ frameNum);
+	std::uniform_int_distribution<UINT64> sizeDist(1, maxAllocationSize);
+
+	GRiRingAllocator allocator;
+	allocator.Init(capacity);
+
+	struct Allocation
+	{
+		UINT64 Offset;
+		UINT64 Size;
+		UINT64 FenceValue;
+	};
+	std::vector<Allocation> liveAllocations;
+
+	UINT64 fenceValue = 0;
+	for (auto frame = 0u; frame < frameNum; frame++)
+	{
+		// The gpu runs frameLatency frames behind at most.
+		UINT64 completedFenceValue = fenceValue > frameLatency ? fenceValue - frameLatency : 0;
+		completedFenceValue += rng() % (frameLatency + 1);
+		if (completedFenceValue > fenceValue)
+			completedFenceValue = fenceValue;
+		allocator.ReleaseCompletedFrames(completedFenceValue);
+		liveAllocations.erase(std::remove_if(liveAllocations.begin(), liveAllocations.end(),
+			[&](const Allocation& a)
+		{
+			return a.FenceValue <= completedFenceValue;
+		}
+		), liveAllocations.end());
+
+		fenceValue++;
+		UINT allocationNum = rng() % (maxAllocationNum + 1);
+		for (auto i = 0u; i < allocationNum; i++)
+		{
+			UINT64 size = sizeDist(rng);
+			UINT64 alignment = (UINT64)1 << (rng() % 9);
+			UINT64 offset = allocator.Allocate(size, alignment);
+			if (offset == GRiRingAllocator::InvalidOffset)
+				continue;
+
+			BOOST_REQUIRE_EQUAL(offset & (alignment - 1), 0u);
+			BOOST_REQUIRE_LE(offset + size, capacity);
+			for (auto& a : liveAllocations)
+				BOOST_REQUIRE(offset >= a.Offset + a.Size || a.Offset >= offset + size);
+
+			Allocation allocation;
+			allocation.Offset = offset;
+			allocation.Size = size;
+			allocation.FenceValue = fenceValue;
+			liveAllocations.push_back(allocation);
+		}
+		allocator.FinishFrame(fenceValue);
+
+		UINT64 liveSize = 0;
+		for (auto& a : liveAllocations)
+			liveSize += a.Size;
+		BOOST_REQUIRE_GE(allocator.GetUsedSize(), liveSize);
+		BOOST_REQUIRE_LE(allocator.GetUsedSize(), capacity);
+	}
+
+	// Everything recycled, the whole ring is available again.
+	allocator.ReleaseCompletedFrames(fenceValue);
+	BOOST_CHECK_EQUAL(allocator.GetUsedSize(), 0u);
+	BOOST_CHECK_EQUAL(allocator.GetFrameNum(), 0u);
+	BOOST_CHECK_EQUAL(allocator.Allocate(capacity, 1), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE(GRiRingAllocatorTest)
+
+BOOST_AUTO_TEST_CASE(WaitsForFence)
+{
+	GRiRingAllocator allocator;
+	allocator.Init(1000);
+
+	BOOST_CHECK_EQUAL(allocator.Allocate(300, 256), 0u);
+	BOOST_CHECK_EQUAL(allocator.Allocate(300, 256), 512u);
+	allocator.FinishFrame(1);
+
+	// Doesn't fit before frame 1 is recycled.
+	BOOST_CHECK(allocator.Allocate(500, 256) == GRiRingAllocator::InvalidOffset);
+
+	allocator.ReleaseCompletedFrames(1);
+	UINT64 offset = allocator.Allocate(500, 256);
+	BOOST_CHECK(offset != GRiRingAllocator::InvalidOffset);
+	BOOST_CHECK_EQUAL(offset % 256, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(RandomFrames)
+{
+	TestRandom(1024, 500, 8, 100, 2);
+	TestRandom(1 << 20, 300, 50, 40000, 3);
+	TestRandom(4096, 1000, 3, 4096, 1);
+	TestRandom(777, 2000, 10, 300, 4);
+	TestRandom(65536, 500, 200, 256, 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
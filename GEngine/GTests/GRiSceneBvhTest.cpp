@@ -0,0 +1,293 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiBvh.h"
+#include "GRiMeshTestUtil.h"
+#include "GRiSceneTestUtil.h"
+
+#include <random>
+
+
+// A mesh per generator shape with its bottom level structure.
+struct GRiTestBvhMesh
+{
+	GRiMeshData MeshData;
+	GRiMesh Mesh;
+};
+
+static std::vector<std::unique_ptr<GRiTestBvhMesh>> CreateBvhMeshes()
+{
+	std::vector<std::unique_ptr<GRiTestBvhMesh>> meshes;
+	for (auto& shape : CreateTestShapes())
+	{
+		auto mesh = std::make_unique<GRiTestBvhMesh>();
+		mesh->MeshData = shape;
+
+		std::vector<float> positions;
+		for (auto& v : shape.Vertices)
+			positions.insert(positions.end(), v.Position, v.Position + 3);
+		auto bvh = std::make_shared<GRiMeshBvh>();
+		bvh->Build(positions, std::vector<UINT>(shape.Indices.begin(), shape.Indices.end()));
+		mesh->Mesh.SetBvh(bvh);
+
+		meshes.push_back(std::move(mesh));
+	}
+	return meshes;
+}
+
+static void PlaceRandomly(GRiSceneObject& so, std::mt19937& rng, float sceneExtent)
+{
+	std::uniform_real_distribution<float> locDist(-0.5f * sceneExtent, 0.5f * sceneExtent);
+	std::uniform_real_distribution<float> rotDist(-180.0f, 180.0f);
+	std::uniform_real_distribution<float> scaleDist(0.5f, 3.0f);
+	so.SetLocation(locDist(rng), locDist(rng), locDist(rng));
+	so.SetRotation(rotDist(rng), rotDist(rng), rotDist(rng));
+	so.SetScale(scaleDist(rng), scaleDist(rng), scaleDist(rng));
+}
+
+// Vertices of the object's mesh in world space.
+static std::vector<double> GetWorldPositions(GRiSceneObject* so, const GRiMeshData& meshData)
+{
+	auto world = so->GetTransform();
+	std::vector<double> positions;
+	for (auto& v : meshData.Vertices)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			double p = world.GetElement(3, k);
+			for (auto i = 0; i < 3; i++)
+				p += (double)v.Position[i] * world.GetElement(i, k);
+			positions.push_back(p);
+		}
+	}
+	return positions;
+}
+
+// Nearest hit of the ray with every world space triangle of the object, two sided like the mesh structure.
+static bool IntersectBruteForce(const GRiRay& ray, const std::vector<double>& positions, const GRiMeshData& meshData, double& tHit)
+{
+	bool bHit = false;
+	tHit = ray.tMax;
+	for (size_t t = 0; t + 2 < meshData.Indices.size(); t += 3)
+	{
+		const double* v0 = &positions[meshData.Indices[t] * 3];
+		const double* v1 = &positions[meshData.Indices[t + 1] * 3];
+		const double* v2 = &positions[meshData.Indices[t + 2] * 3];
+
+		double e1[3], e2[3], s[3];
+		for (auto k = 0; k < 3; k++)
+		{
+			e1[k] = v1[k] - v0[k];
+			e2[k] = v2[k] - v0[k];
+			s[k] = ray.Origin[k] - v0[k];
+		}
+		const float* d = ray.Direction;
+		double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (fabs(det) < 1e-12)
+			continue;
+
+		double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+		double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+		double tt = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+		if (u < 0.0 || v < 0.0 || u + v > 1.0 || tt < 0.0 || tt > tHit)
+			continue;
+
+		tHit = tt;
+		bHit = true;
+	}
+	return bHit;
+}
+
+// Checks the queries against brute force over every object, as picking did before the scene structure. Rays aim at
+// random objects so that most of them hit something.
+static void CheckQueries(GRiSceneBvh& sceneBvh, const std::vector<GRiSceneObject*>& objects, const std::unordered_map<GRiMesh*, const GRiMeshData*>& meshData, std::mt19937& rng)
+{
+	BOOST_REQUIRE_EQUAL(sceneBvh.GetInstanceNum(), (int)objects.size());
+
+	std::vector<std::vector<double>> positions;
+	for (auto so : objects)
+		positions.push_back(GetWorldPositions(so, *meshData.at(so->GetMesh())));
+
+	std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+	int hitNum = 0;
+	for (auto r = 0; r < 300; r++)
+	{
+		GRiRay ray;
+		auto target = objects.empty() ? std::vector<float>(3, 0.0f) : objects[rng() % objects.size()]->GetLocation();
+		float length = 0.0f;
+		for (auto k = 0; k < 3; k++)
+		{
+			ray.Origin[k] = unitDist(rng) * 200.0f;
+			ray.Direction[k] = target[k] + unitDist(rng) - ray.Origin[k];
+			length += ray.Direction[k] * ray.Direction[k];
+		}
+		for (auto k = 0; k < 3; k++)
+			ray.Direction[k] /= sqrtf(length);
+		ray.tMax = r % 3 == 0 ? 150.0f : 1000.0f;
+
+		// Nearest hit per object.
+		std::vector<std::pair<double, GRiSceneObject*>> expected;
+		for (auto i = 0u; i < objects.size(); i++)
+		{
+			double t;
+			if (IntersectBruteForce(ray, positions[i], *meshData.at(objects[i]->GetMesh()), t))
+				expected.push_back(std::make_pair(t, objects[i]));
+		}
+		std::sort(expected.begin(), expected.end());
+
+		GRiRayHit hit;
+		bool bHit = sceneBvh.Raycast(ray, hit);
+		BOOST_REQUIRE_EQUAL(bHit, !expected.empty());
+		if (bHit)
+		{
+			hitNum++;
+			BOOST_REQUIRE_CLOSE(hit.Distance, expected[0].first, 1e-2);
+			// Objects touching at the hit may swap.
+			if (hit.SceneObject != expected[0].second)
+				BOOST_REQUIRE(expected.size() > 1 && fabs(expected[1].first - expected[0].first) < 1e-3 * expected[0].first);
+			for (auto k = 0; k < 3; k++)
+				BOOST_REQUIRE_SMALL(hit.Position[k] - (ray.Origin[k] + ray.Direction[k] * hit.Distance), 1e-3f);
+		}
+
+		auto hits = sceneBvh.RaycastAll(ray);
+		BOOST_REQUIRE_EQUAL(hits.size(), expected.size());
+		std::unordered_map<GRiSceneObject*, double> expectedDistances;
+		for (auto& e : expected)
+			expectedDistances[e.second] = e.first;
+		for (auto i = 0u; i < hits.size(); i++)
+		{
+			if (i > 0)
+				BOOST_REQUIRE_LE(hits[i - 1].Distance, hits[i].Distance);
+			auto e = expectedDistances.find(hits[i].SceneObject);
+			BOOST_REQUIRE(e != expectedDistances.end());
+			BOOST_REQUIRE_CLOSE(hits[i].Distance, e->second, 1e-2);
+			expectedDistances.erase(e);
+		}
+	}
+	if (!objects.empty())
+		BOOST_CHECK_GT(hitNum, 100);
+
+	// Every object whose vertices reach into the box is found, nothing beyond its conservative world bounds.
+	for (auto b = 0; b < 50; b++)
+	{
+		GRiBoundingBox box;
+		for (auto k = 0; k < 3; k++)
+		{
+			box.Center[k] = unitDist(rng) * 60.0f;
+			box.Extents[k] = (unitDist(rng) + 1.0f) * 10.0f;
+		}
+
+		auto result = sceneBvh.Overlap(box);
+		std::sort(result.begin(), result.end());
+		BOOST_REQUIRE(std::adjacent_find(result.begin(), result.end()) == result.end());
+
+		for (auto i = 0u; i < objects.size(); i++)
+		{
+			double vMin[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
+			double vMax[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+			for (size_t v = 0; v < positions[i].size(); v += 3)
+			{
+				for (auto k = 0; k < 3; k++)
+				{
+					vMin[k] = min(vMin[k], positions[i][v + k]);
+					vMax[k] = max(vMax[k], positions[i][v + k]);
+				}
+			}
+
+			auto local = objects[i]->GetMesh()->GetBvh()->GetBounds();
+			auto world = objects[i]->GetTransform();
+			bool bTight = true;
+			bool bConservative = true;
+			for (auto k = 0; k < 3; k++)
+			{
+				double center = world.GetElement(3, k);
+				double extent = 0.0;
+				for (auto j = 0; j < 3; j++)
+				{
+					center += local.Center[j] * world.GetElement(j, k);
+					extent += local.Extents[j] * fabs(world.GetElement(j, k));
+				}
+				bTight = bTight && vMin[k] <= box.BoundMax(k) - 1e-3 && vMax[k] >= box.BoundMin(k) + 1e-3;
+				bConservative = bConservative && center - extent <= box.BoundMax(k) + 1e-3 && center + extent >= box.BoundMin(k) - 1e-3;
+			}
+
+			bool bFound = std::binary_search(result.begin(), result.end(), objects[i]);
+			if (bTight)
+				BOOST_REQUIRE(bFound);
+			if (bFound)
+				BOOST_REQUIRE(bConservative);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(GRiSceneBvhTest)
+
+// Queries after building, after small moves that only refit, after large moves that degrade the tree and after
+// removing objects.
+BOOST_AUTO_TEST_CASE(MatchesBruteForce)
+{
+	std::mt19937 rng(1234);
+	auto meshes = CreateBvhMeshes();
+	std::unordered_map<GRiMesh*, const GRiMeshData*> meshData;
+	for (auto& mesh : meshes)
+		meshData[&mesh->Mesh] = &mesh->MeshData;
+
+	std::vector<std::unique_ptr<GRiTestSceneObject>> sceneObjects;
+	std::vector<GRiSceneObject*> objects;
+	for (auto i = 0; i < 150; i++)
+	{
+		auto so = std::make_unique<GRiTestSceneObject>();
+		so->SetMesh(&meshes[i % meshes.size()]->Mesh);
+		PlaceRandomly(*so, rng, 100.0f);
+		objects.push_back(so.get());
+		sceneObjects.push_back(std::move(so));
+	}
+
+	// An object without a mesh structure is skipped.
+	GRiMesh emptyMesh;
+	GRiTestSceneObject skipped;
+	skipped.SetMesh(&emptyMesh);
+	PlaceRandomly(skipped, rng, 100.0f);
+
+	GRiSceneBvh sceneBvh;
+	UpdateWorlds();
+	auto withSkipped = objects;
+	withSkipped.push_back(&skipped);
+	sceneBvh.Update(withSkipped);
+	CheckQueries(sceneBvh, objects, meshData, rng);
+
+	// Nothing moved.
+	sceneBvh.Update(objects);
+	CheckQueries(sceneBvh, objects, meshData, rng);
+
+	for (auto i = 0; i < 10; i++)
+	{
+		auto location = objects[i * 7]->GetLocation();
+		objects[i * 7]->SetLocation(location[0] + 0.5f, location[1], location[2] - 0.5f);
+	}
+	UpdateWorlds();
+	sceneBvh.Update(objects);
+	CheckQueries(sceneBvh, objects, meshData, rng);
+
+	for (auto so : objects)
+		PlaceRandomly(*so, rng, 150.0f);
+	UpdateWorlds();
+	sceneBvh.Update(objects);
+	CheckQueries(sceneBvh, objects, meshData, rng);
+
+	objects.erase(objects.begin() + 20, objects.begin() + 60);
+	sceneBvh.Update(objects);
+	CheckQueries(sceneBvh, objects, meshData, rng);
+
+	objects.clear();
+	sceneBvh.Update(objects);
+	CheckQueries(sceneBvh, objects, meshData, rng);
+	GRiRayHit hit;
+	GRiRay ray;
+	ray.Origin[0] = ray.Origin[1] = ray.Origin[2] = 0.0f;
+	ray.Direction[0] = 1.0f;
+	ray.Direction[1] = ray.Direction[2] = 0.0f;
+	BOOST_CHECK(!sceneBvh.Raycast(ray, hit));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
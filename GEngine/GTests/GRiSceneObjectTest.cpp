@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiSceneTestUtil.h"
+
+#include <random>
+
+
+static void CheckSameTransform(GGiFloat4x4 a, GGiFloat4x4 b, float tolerance)
+{
+	for (auto i = 0; i < 4; i++)
+	{
+		for (auto j = 0; j < 4; j++)
+			BOOST_REQUIRE_SMALL(a.GetElement(i, j) - b.GetElement(i, j), tolerance);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(GRiSceneObjectTest)
+
+// Attaching, moving between parents and detaching leaves every object where it was.
+BOOST_AUTO_TEST_CASE(ReparentKeepsWorldTransform)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> locDist(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> rotDist(-180.0f, 180.0f);
+	std::uniform_real_distribution<float> scaleDist(0.5f, 2.0f);
+
+	std::vector<std::unique_ptr<GRiTestSceneObject>> objects;
+	for (auto i = 0; i < 200; i++)
+	{
+		auto so = std::make_unique<GRiTestSceneObject>();
+		so->SetLocation(locDist(rng), locDist(rng), locDist(rng));
+		so->SetRotation(rotDist(rng), rotDist(rng), rotDist(rng));
+		// Parents are scaled uniformly, anything else would need a shear.
+		float scale = scaleDist(rng);
+		so->SetScale(scale, scale, (i % 7 == 0) ? -scale : scale);
+		objects.push_back(std::move(so));
+	}
+	UpdateWorlds();
+
+	for (auto step = 0; step < 1000; step++)
+	{
+		auto& so = objects[rng() % objects.size()];
+		GRiSceneObject* parent = step % 5 == 0 ? nullptr : objects[rng() % objects.size()].get();
+
+		auto world = so->GetTransform();
+		try
+		{
+			so->SetParent(parent);
+		}
+		catch (GGiException&)
+		{
+			// Attaching to a descendant, nothing may have changed.
+			continue;
+		}
+		BOOST_REQUIRE(so->GetParent() == parent);
+
+		UpdateWorlds();
+		CheckSameTransform(so->GetTransform(), world, 1e-2f);
+	}
+}
+
+// Straight up and down pitches lose the roll, the transform has to survive anyway.
+BOOST_AUTO_TEST_CASE(DecomposeGimbalLock)
+{
+	GRiTestSceneObject parent;
+	GRiTestSceneObject child;
+	parent.SetRotation(0.0f, 0.0f, 0.0f);
+	parent.SetScale(1.0f, 1.0f, 1.0f);
+	parent.SetLocation(0.0f, 0.0f, 0.0f);
+
+	for (auto pitch : { 90.0f, -90.0f })
+	{
+		child.SetLocation(1.0f, 2.0f, 3.0f);
+		child.SetRotation(pitch, 30.0f, 40.0f);
+		child.SetScale(1.0f, 2.0f, 3.0f);
+		UpdateWorlds();
+
+		auto world = child.GetTransform();
+		child.SetParent(&parent);
+		UpdateWorlds();
+		CheckSameTransform(child.GetTransform(), world, 1e-3f);
+
+		child.SetParent(nullptr);
+		UpdateWorlds();
+		CheckSameTransform(child.GetTransform(), world, 1e-3f);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,50 @@
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "GRiSceneObject.h"
+
+
+// Scene object for the tests that need world transforms. Builds the same scale * roll-pitch-yaw rotation *
+// translation transform as GDxSceneObject without DirectXMath.
+class GRiTestSceneObject : public GRiSceneObject
+{
+public:
+
+	virtual void UpdateTransform() override
+	{
+		auto& store = GRiSceneStore::GetInstance();
+		UINT dense = GetDenseIndex();
+		float* location = store.GetLocations() + dense * 3;
+		float* rotation = store.GetRotations() + dense * 3;
+		float* scale = store.GetScales() + dense * 3;
+
+		float cp = cosf(rotation[0] * GGiEngineUtil::PI / 180.0f), sp = sinf(rotation[0] * GGiEngineUtil::PI / 180.0f);
+		float cy = cosf(rotation[1] * GGiEngineUtil::PI / 180.0f), sy = sinf(rotation[1] * GGiEngineUtil::PI / 180.0f);
+		float cr = cosf(rotation[2] * GGiEngineUtil::PI / 180.0f), sr = sinf(rotation[2] * GGiEngineUtil::PI / 180.0f);
+		float r[3][3] = {
+			{ cr * cy + sr * sp * sy, sr * cp, sr * sp * cy - cr * sy },
+			{ cr * sp * sy - sr * cy, cr * cp, sr * sy + cr * sp * cy },
+			{ cp * sy, -sp, cp * cy }
+		};
+
+		GGiFloat4x4 trans = GGiFloat4x4::Identity();
+		for (auto i = 0; i < 3; i++)
+		{
+			for (auto k = 0; k < 3; k++)
+				trans.SetElement(i, k, scale[i] * r[i][k]);
+			trans.SetElement(3, i, location[i]);
+		}
+		SetTransform(trans);
+	}
+};
+
+// Propagates the dirty transforms the way the renderer does once per frame.
+inline void UpdateWorlds()
+{
+	auto& store = GRiSceneStore::GetInstance();
+	store.BeginWorldUpdate();
+	for (auto level = 0u; level < store.GetLevelNum(); level++)
+	{
+		auto& dirty = store.GatherDirtyLevel(level);
+		store.UpdateWorlds(dirty.data(), (UINT)dirty.size());
+	}
+}
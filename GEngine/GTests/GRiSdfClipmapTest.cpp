@@ -0,0 +1,304 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiSdfClipmap.h"
+
+#include <random>
+
+
+// Same voxel layout as GDxRenderer::BuildMeshSDF, voxel i is centered at (i - res / 2 + 0.5) * unit.
+static void InitializeSphereSdf(GRiMesh& mesh, int res, float extent, float radius)
+{
+	float unit = extent / (float)res;
+	std::vector<float> sdf(res * res * res);
+	for (auto z = 0; z < res; z++)
+	{
+		for (auto y = 0; y < res; y++)
+		{
+			for (auto x = 0; x < res; x++)
+			{
+				float px = ((float)(x - res / 2) + 0.5f) * unit;
+				float py = ((float)(y - res / 2) + 0.5f) * unit;
+				float pz = ((float)(z - res / 2) + 0.5f) * unit;
+				sdf[(z * res + y) * res + x] = sqrtf(px * px + py * py + pz * pz) - radius;
+			}
+		}
+	}
+	mesh.InitializeSdf(sdf);
+	mesh.SetSdfResolution(res);
+	mesh.SetSdfExtent(extent);
+}
+
+static void InitializeBoxSdf(GRiMesh& mesh, int res, float extent, float halfSize)
+{
+	float unit = extent / (float)res;
+	std::vector<float> sdf(res * res * res);
+	for (auto z = 0; z < res; z++)
+	{
+		for (auto y = 0; y < res; y++)
+		{
+			for (auto x = 0; x < res; x++)
+			{
+				float q[3] = {
+					fabsf(((float)(x - res / 2) + 0.5f) * unit) - halfSize,
+					fabsf(((float)(y - res / 2) + 0.5f) * unit) - halfSize,
+					fabsf(((float)(z - res / 2) + 0.5f) * unit) - halfSize
+				};
+				float outside = 0.0f;
+				for (auto k = 0; k < 3; k++)
+					outside += max(q[k], 0.0f) * max(q[k], 0.0f);
+				sdf[(z * res + y) * res + x] = sqrtf(outside) + min(max(q[0], max(q[1], q[2])), 0.0f);
+			}
+		}
+	}
+	mesh.InitializeSdf(sdf);
+	mesh.SetSdfResolution(res);
+	mesh.SetSdfExtent(extent);
+}
+
+// Random rotation about y, uniform scale and translation within the scene.
+static GGiFloat4x4 CreateRandomWorld(std::mt19937& rng, float sceneExtent)
+{
+	std::uniform_real_distribution<float> posDist(-0.5f * sceneExtent, 0.5f * sceneExtent);
+	std::uniform_real_distribution<float> angleDist(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> scaleDist(0.5f, 2.0f);
+
+	float angle = angleDist(rng);
+	float scale = scaleDist(rng);
+
+	GGiFloat4x4 world = GGiFloat4x4::Identity();
+	world.SetElement(0, 0, cosf(angle) * scale);
+	world.SetElement(0, 2, -sinf(angle) * scale);
+	world.SetElement(1, 1, scale);
+	world.SetElement(2, 0, sinf(angle) * scale);
+	world.SetElement(2, 2, cosf(angle) * scale);
+	world.SetElement(3, 0, posDist(rng));
+	world.SetElement(3, 1, 0.25f * posDist(rng));
+	world.SetElement(3, 2, posDist(rng));
+	return world;
+}
+
+static int GetTotalBrickNum(GRiSdfClipmap& clipmap)
+{
+	int brickNum = clipmap.GetResolution() / clipmap.GetBrickSize();
+	return clipmap.GetLevelNum() * brickNum * brickNum * brickNum;
+}
+
+BOOST_AUTO_TEST_SUITE(GRiSdfClipmapTest)
+
+// Adds, moves and removes objects and moves the camera, after every update each voxel of every level has to match the
+// brute-force min over all objects, while only a part of the bricks is recomposited.
+BOOST_AUTO_TEST_CASE(IncrementalUpdates)
+{
+	std::mt19937 rng(1234);
+	GGiThreadPool tp(4);
+
+	GRiMesh meshes[2];
+	InitializeSphereSdf(meshes[0], 16, 20.0f, 6.0f);
+	InitializeBoxSdf(meshes[1], 16, 24.0f, 7.0f);
+
+	GRiSdfClipmap clipmap;
+	clipmap.Init(3, 32, 8, 2.0f, 4.0f);
+	int totalBrickNum = GetTotalBrickNum(clipmap);
+
+	const float sceneExtent = 120.0f;
+	UINT nextId = 0;
+	for (auto i = 0; i < 24; i++, nextId++)
+		clipmap.SetObject(nextId, &meshes[i % 2], CreateRandomWorld(rng, sceneExtent));
+
+	float camera[3] = { 0.0f, 0.0f, 0.0f };
+	clipmap.Update(&tp, camera[0], camera[1], camera[2]);
+	BOOST_CHECK_EQUAL(clipmap.GetStats().DirtyBrickNum, totalBrickNum);
+	BOOST_CHECK_EQUAL(clipmap.GetStats().ObjectNum, 24);
+	BOOST_REQUIRE_LE(clipmap.ValidateAgainstReference(&tp), 1e-5f);
+
+	// Nothing changed.
+	clipmap.Update(&tp, camera[0], camera[1], camera[2]);
+	BOOST_CHECK_EQUAL(clipmap.GetStats().DirtyBrickNum, 0);
+
+	// Setting the same transform again doesn't invalidate anything.
+	auto ids = clipmap.GetObjectIds();
+	std::vector<GGiFloat4x4> worlds(nextId);
+	for (auto id = 0u; id < nextId; id++)
+		worlds[id] = CreateRandomWorld(rng, sceneExtent);
+	for (auto id : ids)
+		clipmap.SetObject(id, &meshes[id % 2], worlds[id]);
+	clipmap.Update(&tp, camera[0], camera[1], camera[2]);
+	for (auto id : ids)
+		clipmap.SetObject(id, &meshes[id % 2], worlds[id]);
+	clipmap.Update(&tp, camera[0], camera[1], camera[2]);
+	BOOST_CHECK_EQUAL(clipmap.GetStats().DirtyBrickNum, 0);
+	BOOST_REQUIRE_LE(clipmap.ValidateAgainstReference(&tp), 1e-5f);
+
+	std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+	int partialUpdateNum = 0;
+	for (auto step = 0; step < 40; step++)
+	{
+		float op = unitDist(rng);
+		auto liveIds = clipmap.GetObjectIds();
+		if (op < 0.25f || liveIds.size() == 0)
+		{
+			clipmap.SetObject(nextId, &meshes[nextId % 2], CreateRandomWorld(rng, sceneExtent));
+			nextId++;
+		}
+		else if (op < 0.45f)
+		{
+			auto id = liveIds[rng() % liveIds.size()];
+			clipmap.RemoveObject(id);
+			BOOST_CHECK(!clipmap.HasObject(id));
+		}
+		else if (op < 0.75f)
+		{
+			// Small moves only touch the bricks around the object.
+			auto id = liveIds[rng() % liveIds.size()];
+			auto world = CreateRandomWorld(rng, 8.0f);
+			world.SetElement(3, 0, world.GetElement(3, 0) + (float)(id % 7) * 10.0f - 30.0f);
+			world.SetElement(3, 2, world.GetElement(3, 2) + (float)(id % 5) * 10.0f - 20.0f);
+			clipmap.SetObject(id, &meshes[id % 2], world);
+		}
+		else
+		{
+			// Camera moves of up to a few bricks of the finest level, some of them crossing brick boundaries.
+			for (auto k = 0; k < 3; k++)
+				camera[k] += (unitDist(rng) - 0.5f) * 64.0f;
+		}
+
+		clipmap.Update(&tp, camera[0], camera[1], camera[2]);
+		BOOST_REQUIRE_LE(clipmap.ValidateAgainstReference(&tp), 1e-5f);
+		BOOST_CHECK_EQUAL(clipmap.GetStats().ObjectNum, (int)clipmap.GetObjectIds().size());
+
+		if (clipmap.GetStats().DirtyBrickNum < totalBrickNum)
+			partialUpdateNum++;
+	}
+	BOOST_CHECK_GT(partialUpdateNum, 30);
+
+	// A jump farther than the coarsest window rebuilds everything.
+	clipmap.Update(&tp, camera[0] + 1000.0f, camera[1], camera[2]);
+	BOOST_CHECK_EQUAL(clipmap.GetStats().DirtyBrickNum, totalBrickNum);
+	BOOST_REQUIRE_LE(clipmap.ValidateAgainstReference(&tp), 1e-5f);
+
+	// Empty again, every voxel is at the truncation distance.
+	for (auto id : clipmap.GetObjectIds())
+		clipmap.RemoveObject(id);
+	clipmap.Update(nullptr, camera[0], camera[1], camera[2]);
+	BOOST_REQUIRE_LE(clipmap.ValidateAgainstReference(nullptr), 1e-5f);
+	BOOST_CHECK_EQUAL(clipmap.Sample(camera[0], camera[1], camera[2]), clipmap.GetLevel(0).TruncationDistance);
+}
+
+// The composited field has to be close to the analytic distance of a single sphere, in every level.
+BOOST_AUTO_TEST_CASE(SphereDistance)
+{
+	GRiMesh mesh;
+	InitializeSphereSdf(mesh, 32, 40.0f, 10.0f);
+
+	GRiSdfClipmap clipmap;
+	clipmap.Init(3, 32, 8, 1.0f, 4.0f);
+
+	GGiFloat4x4 world = GGiFloat4x4::Identity();
+	world.SetElement(3, 0, 5.0f);
+	clipmap.SetObject(0, &mesh, world);
+	clipmap.Update(nullptr, 0.0f, 0.0f, 0.0f);
+
+	// Trilinear interpolation of the mesh sdf is off by a fraction of its voxel, most near the sphere center.
+	const float tolerance = 0.25f * 40.0f / 32.0f;
+	for (auto l = 0; l < clipmap.GetLevelNum(); l++)
+	{
+		auto& level = clipmap.GetLevel(l);
+		int brickNum = clipmap.GetResolution() / clipmap.GetBrickSize();
+		int vMin[3], vMax[3];
+		for (auto k = 0; k < 3; k++)
+		{
+			vMin[k] = level.Origin[k] * clipmap.GetBrickSize();
+			vMax[k] = (level.Origin[k] + brickNum) * clipmap.GetBrickSize();
+		}
+		for (auto vz = vMin[2]; vz < vMax[2]; vz++)
+		{
+			for (auto vy = vMin[1]; vy < vMax[1]; vy++)
+			{
+				for (auto vx = vMin[0]; vx < vMax[0]; vx++)
+				{
+					float x = ((float)vx + 0.5f) * level.VoxelSize - 5.0f;
+					float y = ((float)vy + 0.5f) * level.VoxelSize;
+					float z = ((float)vz + 0.5f) * level.VoxelSize;
+
+					// Outside the sdf volume the distance is only estimated from its border.
+					if (fabsf(x) > 20.0f || fabsf(y) > 20.0f || fabsf(z) > 20.0f)
+						continue;
+
+					float expected = min(sqrtf(x * x + y * y + z * z) - 10.0f, level.TruncationDistance);
+					BOOST_REQUIRE_SMALL(clipmap.ComputeReferenceDistance(l, vx, vy, vz) - expected, tolerance);
+				}
+			}
+		}
+	}
+
+	BOOST_CHECK_SMALL(clipmap.Sample(5.5f, 0.5f, 0.5f) - (sqrtf(0.75f) - 10.0f), tolerance);
+	BOOST_CHECK_SMALL(clipmap.Sample(5.5f, 12.5f, 0.5f) - (sqrtf(156.75f) - 10.0f), tolerance);
+}
+
+// Copied bricks have to hold the voxels of the level in x fastest order and fill every slot exactly once.
+BOOST_AUTO_TEST_CASE(BrickCopies)
+{
+	std::mt19937 rng(5678);
+
+	GRiMesh mesh;
+	InitializeSphereSdf(mesh, 16, 20.0f, 6.0f);
+
+	GRiSdfClipmap clipmap;
+	clipmap.Init(2, 32, 8, 2.0f, 4.0f);
+	for (auto i = 0u; i < 16; i++)
+		clipmap.SetObject(i, &mesh, CreateRandomWorld(rng, 60.0f));
+
+	// Off-center camera, so the windows wrap.
+	clipmap.Update(nullptr, 37.0f, -21.0f, 50.0f);
+
+	int brickSize = clipmap.GetBrickSize();
+	int brickNum = clipmap.GetResolution() / brickSize;
+	std::vector<int> slotCounts(GetTotalBrickNum(clipmap), 0);
+	std::vector<float> data(brickSize * brickSize * brickSize);
+	for (auto& brick : clipmap.GetUpdatedBricks())
+	{
+		int slot = clipmap.GetBrickSlot(brick);
+		BOOST_REQUIRE(slot >= 0 && slot < brickNum * brickNum * brickNum);
+		slotCounts[brick.Level * brickNum * brickNum * brickNum + slot]++;
+
+		clipmap.CopyBrick(brick, data.data());
+		auto& level = clipmap.GetLevel(brick.Level);
+		float voxelSize = level.VoxelSize;
+		for (auto z = 0; z < brickSize; z++)
+		{
+			for (auto y = 0; y < brickSize; y++)
+			{
+				for (auto x = 0; x < brickSize; x++)
+				{
+					int v[3] = { brick.Brick[0] * brickSize + x, brick.Brick[1] * brickSize + y, brick.Brick[2] * brickSize + z };
+					float expected = clipmap.ComputeReferenceDistance(brick.Level, v[0], v[1], v[2]);
+					BOOST_REQUIRE_EQUAL(data[(z * brickSize + y) * brickSize + x], expected);
+
+					// The finest level wins wherever it covers the voxel center.
+					if (brick.Level == 0)
+						BOOST_REQUIRE_EQUAL(clipmap.Sample((v[0] + 0.5f) * voxelSize, (v[1] + 0.5f) * voxelSize, (v[2] + 0.5f) * voxelSize), expected);
+				}
+			}
+		}
+	}
+	BOOST_CHECK(std::all_of(slotCounts.begin(), slotCounts.end(), [](int c) { return c == 1; }));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidParameters)
+{
+	GRiSdfClipmap clipmap;
+	BOOST_CHECK_THROW(clipmap.Update(nullptr, 0.0f, 0.0f, 0.0f), GGiException);
+	BOOST_CHECK_THROW(clipmap.Init(0, 32, 8, 1.0f, 4.0f), GGiException);
+	BOOST_CHECK_THROW(clipmap.Init(2, 30, 8, 1.0f, 4.0f), GGiException);
+	BOOST_CHECK_THROW(clipmap.Init(2, 32, 8, 0.0f, 4.0f), GGiException);
+
+	clipmap.Init(2, 32, 8, 1.0f, 4.0f);
+	BOOST_CHECK_THROW(clipmap.Sample(0.0f, 0.0f, 0.0f), GGiException);
+	BOOST_CHECK_THROW(clipmap.GetLevel(2), GGiException);
+
+	// Meshes without an sdf are ignored.
+	GRiMesh mesh;
+	clipmap.SetObject(0, &mesh, GGiFloat4x4::Identity());
+	BOOST_CHECK(!clipmap.HasObject(0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
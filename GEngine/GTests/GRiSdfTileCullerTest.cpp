@@ -0,0 +1,146 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiSdfTileCuller.h"
+
+#include <random>
+
+
+// Same light direction as the main pass.
+static const float LightDir[3] = { 0.57735f, -0.57735f, -0.57735f };
+
+static std::vector<GRiBoundingBox> CreateRandomBounds(int objectNum, float sceneExtent, float objectExtent, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> posDist(-0.5f * sceneExtent, 0.5f * sceneExtent);
+	std::uniform_real_distribution<float> extDist(0.25f * objectExtent, objectExtent);
+
+	std::vector<GRiBoundingBox> bounds(objectNum);
+	for (auto& b : bounds)
+	{
+		for (auto k = 0; k < 3; k++)
+		{
+			b.Center[k] = posDist(rng);
+			b.Extents[k] = extDist(rng);
+		}
+	}
+	return bounds;
+}
+
+// Tests every object against every tile with scalar code on the plane of the grid. Objects within a small margin of
+// a tile may go either way, the lists have to keep the object order.
+static void CheckAgainstReference(GRiSdfTileCuller& culler, const std::vector<GRiBoundingBox>& bounds)
+{
+	auto& grid = culler.GetGrid();
+	auto& ranges = culler.GetTileRanges();
+	auto& indices = culler.GetObjectIndices();
+	BOOST_REQUIRE_EQUAL(ranges.size(), (size_t)grid.TileNum * grid.TileNum * 2);
+
+	const float margin = 1e-4f * grid.TileSize * grid.TileNum;
+	for (auto r = 0; r < grid.TileNum; r++)
+	{
+		float tileVMin = grid.Origin[1] + r * grid.TileSize;
+		float tileVMax = grid.Origin[1] + (r + 1) * grid.TileSize;
+		for (auto c = 0; c < grid.TileNum; c++)
+		{
+			float tileUMin = grid.Origin[0] + c * grid.TileSize;
+			float tileUMax = grid.Origin[0] + (c + 1) * grid.TileSize;
+
+			auto tile = r * grid.TileNum + c;
+			auto offset = ranges[tile * 2];
+			auto count = ranges[tile * 2 + 1];
+			BOOST_REQUIRE_LE(offset + count, indices.size());
+
+			UINT next = offset;
+			for (auto i = 0u; i < bounds.size(); i++)
+			{
+				auto& b = bounds[i];
+				float cu = b.Center[0] * grid.AxisU[0] + b.Center[1] * grid.AxisU[1] + b.Center[2] * grid.AxisU[2];
+				float ru = b.Extents[0] * fabsf(grid.AxisU[0]) + b.Extents[1] * fabsf(grid.AxisU[1]) + b.Extents[2] * fabsf(grid.AxisU[2]);
+				float cv = b.Center[0] * grid.AxisV[0] + b.Center[1] * grid.AxisV[1] + b.Center[2] * grid.AxisV[2];
+				float rv = b.Extents[0] * fabsf(grid.AxisV[0]) + b.Extents[1] * fabsf(grid.AxisV[1]) + b.Extents[2] * fabsf(grid.AxisV[2]);
+
+				// Overlap depth of the projected bounds and the tile, negative if they are apart.
+				float dist = min(min(tileUMax - (cu - ru), (cu + ru) - tileUMin), min(tileVMax - (cv - rv), (cv + rv) - tileVMin));
+				if (dist < -margin)
+					continue;
+
+				if (next < offset + count && indices[next] == i)
+					next++;
+				else
+					BOOST_REQUIRE_MESSAGE(dist <= margin, "Object " << i << " is missing from tile " << tile << ".");
+			}
+			BOOST_REQUIRE_MESSAGE(next == offset + count, "Tile " << tile << " holds culled or unordered objects.");
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(GRiSdfTileCullerTest)
+
+BOOST_AUTO_TEST_CASE(MatchesReference)
+{
+	GGiThreadPool tp(4);
+	std::mt19937 rng(1234);
+	GRiSdfTileCuller culler;
+	culler.Init(16);
+
+	for (auto objectNum : { 0, 1, 5, 100, 2000 })
+	{
+		auto bounds = CreateRandomBounds(objectNum, 200.0f, 20.0f, rng);
+		culler.Build(objectNum % 2 == 0 ? &tp : nullptr, LightDir, bounds);
+		CheckAgainstReference(culler, bounds);
+
+		auto stats = culler.GetStats();
+		BOOST_CHECK_EQUAL(stats.ObjectNum, objectNum);
+		BOOST_CHECK_EQUAL(stats.TotalEntryNum, (int)culler.GetObjectIndices().size());
+	}
+}
+
+// Every object is in the list of the tile its center projects to, also with the light straight down.
+BOOST_AUTO_TEST_CASE(CentersInTheirTile)
+{
+	std::mt19937 rng(5678);
+	GRiSdfTileCuller culler;
+	culler.Init(32);
+
+	const float downDir[3] = { 0.0f, -1.0f, 0.0f };
+	for (auto lightDir : { LightDir, downDir })
+	{
+		auto bounds = CreateRandomBounds(500, 500.0f, 10.0f, rng);
+		culler.Build(nullptr, lightDir, bounds);
+
+		auto& ranges = culler.GetTileRanges();
+		auto& indices = culler.GetObjectIndices();
+		for (auto i = 0u; i < bounds.size(); i++)
+		{
+			int tile = culler.GetTileIndex(bounds[i].Center[0], bounds[i].Center[1], bounds[i].Center[2]);
+			BOOST_REQUIRE_GE(tile, 0);
+			auto first = indices.begin() + ranges[tile * 2];
+			auto last = first + ranges[tile * 2 + 1];
+			BOOST_REQUIRE(std::find(first, last, i) != last);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(GRiSdfTileCullerBenchmark, *boost::unit_test::disabled())
+
+// Randomly scattered objects on a 64 x 64 grid, doubling the object count from 16.
+BOOST_AUTO_TEST_CASE(Build)
+{
+	GGiThreadPool tp(std::thread::hardware_concurrency());
+	std::mt19937 rng(1234);
+	GRiSdfTileCuller culler;
+	culler.Init(64);
+
+	for (auto objectNum = 16; objectNum <= 16384; objectNum *= 2)
+	{
+		auto bounds = CreateRandomBounds(objectNum, 2000.0f, 20.0f, rng);
+		culler.Build(&tp, LightDir, bounds);
+
+		auto stats = culler.GetStats();
+		BOOST_CHECK_EQUAL(stats.ObjectNum, objectNum);
+		BOOST_TEST_MESSAGE("objects " << stats.ObjectNum << " non-empty tiles " << stats.NonEmptyTileNum << " entries " << stats.TotalEntryNum <<
+			" average " << stats.AverageEntryNum << " max " << stats.MaxEntryNum << " build " << stats.BuildTime << " ms");
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
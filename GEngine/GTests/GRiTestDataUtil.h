@@ -0,0 +1,29 @@
+#pragma once
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+// Path of a file relative to the GEngine directory, the parent of this file's directory, so the shipped content is
+// found wherever the tests run from.
+inline std::string GetSolutionPath(const std::string& relPath)
+{
+	std::string dir = __FILE__;
+	dir = dir.substr(0, dir.find_last_of("\\/"));
+	dir = dir.substr(0, dir.find_last_of("\\/") + 1);
+	return dir + relPath;
+}
+
+// Whole binary file, the test fails if it can't be read.
+inline std::vector<char> ReadTestFile(const std::string& relPath)
+{
+	std::ifstream file(GetSolutionPath(relPath), std::ios::in | std::ios::binary | std::ios::ate);
+	BOOST_REQUIRE_MESSAGE(file.is_open(), "Can't open " << relPath << ".");
+	std::vector<char> data((size_t)file.tellg());
+	file.seekg(0);
+	file.read(data.data(), data.size());
+	BOOST_REQUIRE(file);
+	return data;
+}
@@ -0,0 +1,104 @@
+#include <boost/test/unit_test.hpp>
+#include "GRiTlsfAllocator.h"
+
+#include <random>
+
+
+// Runs random allocations and frees against a reference occupancy map, validating along the way.
+static void TestRandom(UINT capacity, UINT operationNum, UINT maxAllocationSize)
+{
+	std::mt19937 rng(capacity ^ operationNum);
+	std::uniform_int_distribution<UINT> sizeDist(1, maxAllocationSize);
+
+	GRiTlsfAllocator allocator;
+	allocator.Init(capacity);
+
+	std::vector<UINT8> occupancy(capacity, 0);
+	std::vector<UINT> liveBlocks;
+
+	for (auto i = 0u; i < operationNum; i++)
+	{
+		if (liveBlocks.size() == 0 || rng() % 5 < 3)
+		{
+			UINT size = sizeDist(rng);
+			UINT block = allocator.Allocate(size);
+			if (block == GRiTlsfAllocator::InvalidBlock)
+				continue;
+
+			UINT offset = allocator.GetOffset(block);
+			BOOST_REQUIRE_EQUAL(allocator.GetSize(block), size);
+			BOOST_REQUIRE_LE(offset + size, capacity);
+			for (auto j = offset; j < offset + size; j++)
+			{
+				BOOST_REQUIRE(occupancy[j] == 0);
+				occupancy[j] = 1;
+			}
+			liveBlocks.push_back(block);
+		}
+		else
+		{
+			UINT liveIndex = rng() % (UINT)liveBlocks.size();
+			UINT block = liveBlocks[liveIndex];
+			UINT offset = allocator.GetOffset(block);
+			for (auto j = offset; j < offset + allocator.GetSize(block); j++)
+				occupancy[j] = 0;
+			allocator.Free(block);
+			liveBlocks[liveIndex] = liveBlocks.back();
+			liveBlocks.pop_back();
+		}
+
+		BOOST_REQUIRE(allocator.Validate());
+	}
+
+	for (auto block : liveBlocks)
+		allocator.Free(block);
+
+	// Everything merged back into a single free block.
+	BOOST_REQUIRE(allocator.Validate());
+	BOOST_CHECK_EQUAL(allocator.GetUsedSize(), 0u);
+	BOOST_CHECK_EQUAL(allocator.GetAllocationNum(), 0u);
+	BOOST_CHECK(allocator.Allocate(1) != GRiTlsfAllocator::InvalidBlock);
+}
+
+BOOST_AUTO_TEST_SUITE(GRiTlsfAllocatorTest)
+
+BOOST_AUTO_TEST_CASE(ReusesFreedRange)
+{
+	GRiTlsfAllocator allocator;
+	allocator.Init(1000);
+
+	UINT a = allocator.Allocate(100);
+	UINT b = allocator.Allocate(200);
+	UINT c = allocator.Allocate(300);
+	BOOST_CHECK_EQUAL(allocator.GetOffset(a), 0u);
+	BOOST_CHECK_EQUAL(allocator.GetOffset(b), 100u);
+	BOOST_CHECK_EQUAL(allocator.GetOffset(c), 300u);
+	BOOST_CHECK_EQUAL(allocator.GetUsedSize(), 600u);
+
+	allocator.Free(b);
+	UINT d = allocator.Allocate(150);
+	BOOST_CHECK_EQUAL(allocator.GetOffset(d), 100u);
+	BOOST_CHECK(allocator.Allocate(500) == GRiTlsfAllocator::InvalidBlock);
+
+	allocator.Free(a);
+	allocator.Free(c);
+	allocator.Free(d);
+	BOOST_CHECK(allocator.Validate());
+	BOOST_CHECK_EQUAL(allocator.GetUsedSize(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(RandomSmallSizes)
+{
+	TestRandom(1, 100, 1);
+	TestRandom(17, 1000, 5);
+	TestRandom(1000, 20000, 64);
+}
+
+BOOST_AUTO_TEST_CASE(RandomLargeSizes)
+{
+	TestRandom(100000, 50000, 3000);
+	TestRandom(65536, 30000, 65536);
+	TestRandom(12345, 20000, 12345);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
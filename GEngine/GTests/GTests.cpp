@@ -0,0 +1,5 @@
+// Headless checks for the renderer infrastructure, nothing here needs a device or a window.
+// Benchmark suites and the suites on the shipped models, which need the FBX SDK runtime, are disabled by default.
+// Run them with --run_test=<suite> --log_level=message from the solution directory, the results are test messages.
+#define BOOST_TEST_MODULE GTests
+#include <boost/test/included/unit_test.hpp>